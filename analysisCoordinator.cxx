@@ -0,0 +1,137 @@
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <stdlib.h>   // Standard utility libraries
+#include <assert.h>   // Standard c++ debugging tool. Terminates the program if expression given evaluates to 0.
+#include <vector>     // C++ vector class
+#include <unistd.h>   // fork for the local worker processes
+#include <sys/wait.h> // waitpid for the local worker processes
+
+// Includes from Root
+#include <TString.h>
+#include <TFile.h>
+
+// Own includes
+#include "src/JetBackgroundAnalyzer.h"
+#include "src/ConfigurationCard.h"
+#include "src/FileListReader.h"
+#include "src/WorkUnitCoordinator.h"
+#include "src/WorkUnitWorker.h"
+
+using namespace std;
+
+/*
+ *  Split the analysis into units of work and serve them to workers connecting over the network. The histograms of
+ *  all units are merged to one output file. Workers on other machines are started with analysisWorker.
+ *
+ *  Command line arguments:
+ *  argv[1] = List of files to be analyzed, given in text file
+ *  argv[2] = Card file with binning and cut information for the analysis
+ *  argv[3] = .root file to which the histograms are written
+ *  argv[4] = Index for the EOS location from where the input files are searched
+ *  argv[5] = True: Search input files from local machine. False (default): Search input files from grid with xrootd
+ *  argv[6] = Port in which the coordinator listens for workers. Default: 9090
+ *  argv[7] = Number of workers started on this machine. Default: 0
+ *  argv[8] = Number of entries in one unit of work. Units are split at cluster boundaries. 0 (default) = One unit for each file
+ *  argv[9] = Time in seconds a worker can use for one unit before the unit is given to another worker. 0 = No limit. Default: 7200
+ */
+int main(int argc, char **argv) {
+
+  //==== Read arguments =====
+  if ( argc<5 ) {
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout<<"+ Usage of the macro: " << endl;
+    cout<<"+  "<<argv[0]<<" [fileNameFile] [configurationCard] [outputFileName] [fileLocation] <runLocal> <port> <nLocalWorkers> <unitEntries> <unitTimeout>"<<endl;
+    cout<<"+  fileNameFile: Text file containing the list of files used in the analysis." <<endl;
+    cout<<"+  configurationCard: Card file with binning and cut information for the analysis." <<endl;
+    cout<<"+  outputFileName: .root file to which the histograms are written." <<endl;
+    cout<<"+  fileLocation: Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2, 3 = Use xrootd to find the data." << endl;
+    cout<<"+  runLocal: True: Search input files from local machine. False (default): Search input files from grid with xrootd." << endl;
+    cout<<"+  port: Port in which the coordinator listens for workers. Default: 9090." << endl;
+    cout<<"+  nLocalWorkers: Number of workers started on this machine. Default: 0." << endl;
+    cout<<"+  unitEntries: Number of entries in one unit of work. 0 (default) = One unit for each file." << endl;
+    cout<<"+  unitTimeout: Seconds a worker can use for one unit before the unit is given to another worker. 0 = No limit. Default: 7200." << endl;
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout << endl << endl;
+    exit(1);
+  }
+
+  // Read the command line arguments
+  TString fileNameFile = argv[1];
+  const char* cardName = argv[2];
+  TString outputFileName = argv[3];
+  const int fileSearchIndex = atoi(argv[4]);
+  bool runLocal = false;
+  if(argc >= 6) runLocal = checkBool(argv[5]);
+  int port = 9090;
+  if(argc >= 7) port = atoi(argv[6]);
+  int nLocalWorkers = 0;
+  if(argc >= 8) nLocalWorkers = atoi(argv[7]);
+  int unitEntries = 0;
+  if(argc >= 9) unitEntries = atoi(argv[8]);
+  int unitTimeout = 7200;
+  if(argc >= 10) unitTimeout = atoi(argv[9]);
+
+  // Read the card
+  ConfigurationCard *configurationCard = new ConfigurationCard(cardName);
+  int debugLevel = configurationCard->Get("DebugLevel");
+
+  // Read the file names used for the analysis to a vector
+  std::vector<TString> fileNameVector;
+  std::vector<int> firstEntries;
+  std::vector<int> lastEntries;
+  fileNameVector.clear();
+  ReadFileList(fileNameVector,fileNameFile,debugLevel,fileSearchIndex,runLocal,&firstEntries,&lastEntries);
+
+  // Split the files into units of work
+  WorkUnitCoordinator* coordinator = new WorkUnitCoordinator(port, outputFileName);
+  coordinator->SetUnitTimeout(unitTimeout);
+  JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(fileNameVector, configurationCard);
+  jetBackgroundAnalysis->SetFileEntryRanges(firstEntries, lastEntries);
+  std::vector<Int_t> unitFiles;
+  std::vector<Int_t> unitFirstEntries;
+  std::vector<Int_t> unitLastEntries;
+  jetBackgroundAnalysis->FindTaskRanges(unitEntries, 4, unitFiles, unitFirstEntries, unitLastEntries);
+  for(int iUnit = 0; iUnit < (int)unitFiles.size(); iUnit++){
+    coordinator->AddUnit(fileNameVector.at(unitFiles.at(iUnit)), unitFirstEntries.at(iUnit), unitLastEntries.at(iUnit));
+  }
+  delete jetBackgroundAnalysis;
+  cout << "Serving " << coordinator->GetNUnits() << " units of work in port " << port << endl;
+
+  // Everything printed before the fork would otherwise be printed again by each worker
+  cout.flush();
+
+  // Start the local workers. They connect to the coordinator in the same way as the workers on other machines.
+  std::vector<pid_t> workerIds(nLocalWorkers);
+  for(int iWorker = 0; iWorker < nLocalWorkers; iWorker++){
+    workerIds.at(iWorker) = fork();
+    if(workerIds.at(iWorker) < 0){
+      cout << "Error! Could not start local worker " << iWorker << endl;
+      assert(0);
+    }
+    if(workerIds.at(iWorker) == 0){
+      coordinator->Close();
+      WorkUnitWorker worker("localhost", port, configurationCard);
+      worker.Run();
+      exit(0);
+    }
+  }
+
+  // Serve the units until all the results are merged
+  coordinator->Run();
+
+  // The card is written after the merge, since it is the same for all the units
+  TFile* outputFile = new TFile(outputFileName, "UPDATE");
+  configurationCard->WriteCard(outputFile);
+  outputFile->Close();
+  delete outputFile;
+
+  // The local workers stop once they are told that all the work is done
+  for(int iWorker = 0; iWorker < nLocalWorkers; iWorker++){
+    int status;
+    waitpid(workerIds.at(iWorker), &status, 0);
+  }
+
+  delete coordinator;
+  delete configurationCard;
+
+}
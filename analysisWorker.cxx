@@ -0,0 +1,54 @@
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <stdlib.h>   // Standard utility libraries
+
+// Includes from Root
+#include <TString.h>
+
+// Own includes
+#include "src/ConfigurationCard.h"
+#include "src/WorkUnitWorker.h"
+
+using namespace std;
+
+/*
+ *  Worker for the analysis served by analysisCoordinator. The worker asks units of work from the coordinator,
+ *  analyzes them and sends the histograms back until all the work is done.
+ *
+ *  Command line arguments:
+ *  argv[1] = Host in which the coordinator runs
+ *  argv[2] = Port in which the coordinator listens for workers
+ *  argv[3] = Card file with binning and cut information for the analysis. Should be the same as for the coordinator
+ */
+int main(int argc, char **argv) {
+
+  //==== Read arguments =====
+  if ( argc<4 ) {
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout<<"+ Usage of the macro: " << endl;
+    cout<<"+  "<<argv[0]<<" [host] [port] [configurationCard]"<<endl;
+    cout<<"+  host: Host in which the coordinator runs." <<endl;
+    cout<<"+  port: Port in which the coordinator listens for workers." <<endl;
+    cout<<"+  configurationCard: Card file with binning and cut information for the analysis. Use the same card as for the coordinator." <<endl;
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout << endl << endl;
+    exit(1);
+  }
+
+  // Read the command line arguments
+  TString host = argv[1];
+  const int port = atoi(argv[2]);
+  const char* cardName = argv[3];
+
+  // Read the card
+  ConfigurationCard *configurationCard = new ConfigurationCard(cardName);
+
+  // Analyze units until the coordinator has no more work
+  WorkUnitWorker* worker = new WorkUnitWorker(host, port, configurationCard);
+  int nUnits = worker->Run();
+  cout << "Analyzed " << nUnits << " units of work" << endl;
+
+  delete worker;
+  delete configurationCard;
+
+}
@@ -0,0 +1,72 @@
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <stdlib.h>   // Standard utility libraries
+#include <vector>     // C++ vector class
+
+// Includes from Root
+#include <TString.h>
+
+// Own includes
+#include "src/JetBackgroundAnalyzer.h"
+#include "src/ConfigurationCard.h"
+#include "src/FileListReader.h"
+
+using namespace std;
+
+/*
+ *  Build the event index files used to skip reading the event information from the forest in the analysis
+ *
+ *  Command line arguments:
+ *  argv[1] = List of files to be indexed, given in text file
+ *  argv[2] = Card file with the configuration for the analysis
+ *  argv[3] = Directory to which the event index files are written
+ *  argv[4] = Index for the EOS location from where the input files are searched
+ *  argv[5] = True: Search input files from local machine. False (default): Search input files from grid with xrootd
+ *  argv[6] = Number of threads used to build the index. Default: 4
+ */
+int main(int argc, char **argv) {
+  
+  //==== Read arguments =====
+  if ( argc<5 ) {
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout<<"+ Usage of the macro: " << endl;
+    cout<<"+  "<<argv[0]<<" [fileNameFile] [configurationCard] [outputDirectory] [fileLocation] <runLocal> <nThreads>"<<endl;
+    cout<<"+  fileNameFile: Text file containing the list of files for which the event index is built." <<endl;
+    cout<<"+  configurationCard: Card file with the configuration for the analysis." <<endl;
+    cout<<"+  outputDirectory: Directory to which the event index files are written. Use the same as EventIndexDirectory in the card." <<endl;
+    cout<<"+  fileLocation: Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2, 3 = Use xrootd to find the data." << endl;
+    cout<<"+  runLocal: True: Search input files from local machine. False (default): Search input files from grid with xrootd." << endl;
+    cout<<"+  nThreads: Number of threads used to build the index. Default: 4." << endl;
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout << endl << endl;
+    exit(1);
+  }
+  
+  // Read the command line arguments
+  TString fileNameFile = argv[1];
+  const char* cardName = argv[2];
+  TString outputDirectory = argv[3];
+  const int fileSearchIndex = atoi(argv[4]);
+  bool runLocal = false;
+  if(argc >= 6) runLocal = checkBool(argv[5]);
+  int nThreads = 4;
+  if(argc >= 7) nThreads = atoi(argv[6]);
+  
+  // Read the card
+  ConfigurationCard *configurationCard = new ConfigurationCard(cardName);
+  int debugLevel = configurationCard->Get("DebugLevel");
+  
+  // Read the file names for which the index is built to a vector
+  std::vector<TString> fileNameVector;
+  fileNameVector.clear();
+  ReadFileList(fileNameVector,fileNameFile,debugLevel,fileSearchIndex,runLocal);
+  
+  // Build the index. The analyzer provides the event weights stored in the index.
+  JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(fileNameVector, configurationCard);
+  jetBackgroundAnalysis->BuildEventIndex(outputDirectory, nThreads);
+  
+  // Delete all created objects
+  delete configurationCard;
+  delete jetBackgroundAnalysis;
+  
+}
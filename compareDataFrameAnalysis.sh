@@ -0,0 +1,54 @@
+#!/bin/bash
+
+if [ "$#" -lt 2 ]; then
+  echo "Usage of the script:"
+  echo "$0 fileList card [-t tolerance]"
+  echo "fileList = List of files analyzed in both ways. Use a small sample, for example testFileList.txt"
+  echo "card = Card used for both analyses. RandomSeed is fixed for the comparison"
+  echo "-t tolerance = Largest accepted relative difference in the bin contents. Default: 1e-6"
+  echo "The files are analyzed with the event loop and with RDataFrame, and the outputs are compared histogram by histogram."
+  echo "The script exits with 0 if all the histograms agree, and with 1 otherwise."
+  exit 1
+fi
+
+FILELIST=$1  # List of analyzed files
+CARD=$2      # Card used for the analyses
+shift 2      # Shift the arguments by 2 to read the optional arguments
+
+# Read the optional arguments
+while getopts ":t:" opt; do
+case $opt in
+t) TOLERANCE="$OPTARG"
+;;
+\?) echo "Invalid option -$OPTARG" >&2
+exit 1
+;;
+esac
+done
+
+# Set default values to optional arguments if they are not given
+TOLERANCE=${TOLERANCE:-1e-6}
+
+# All the files of the comparison are kept in a temporary directory
+WORKDIR=`mktemp -d`
+
+# Both analyses need the same smearing, so the random seed is fixed. The event index that RDataFrame builds goes to the temporary directory.
+sed -e 's/^RandomSeed .*/RandomSeed 1234/' -e 's#^EventIndexDirectory .*#EventIndexDirectory '${WORKDIR}'/eventIndex#' $CARD > $WORKDIR/card.input
+
+./jetBackgroundAnalysis $FILELIST $WORKDIR/card.input $WORKDIR/eventLoop.root 0 true || { echo "The event loop analysis failed"; exit 1; }
+./jetBackgroundAnalysis $FILELIST $WORKDIR/card.input $WORKDIR/dataFrame.root 0 true --rdf || { echo "The RDataFrame analysis failed"; exit 1; }
+
+root -l -b -q 'plotting/compareOutputFiles.C("'${WORKDIR}'/eventLoop.root","'${WORKDIR}'/dataFrame.root",'${TOLERANCE}')' | tee $WORKDIR/comparison.txt
+
+# The macro prints the number of compared and differing histograms on the last line
+SUMMARY=`grep "^Compared" $WORKDIR/comparison.txt`
+NCOMPARED=`echo $SUMMARY | awk '{print $2}'`
+NDIFFERENT=`echo $SUMMARY | awk '{print $4}'`
+
+if [ -z "$NCOMPARED" ] || [ "$NCOMPARED" -eq 0 ] || [ "$NDIFFERENT" -ne 0 ]; then
+  echo "The event loop and RDataFrame outputs differ. The outputs are kept in $WORKDIR"
+  exit 1
+fi
+
+echo "The event loop and RDataFrame outputs agree in $NCOMPARED histograms"
+rm -r $WORKDIR
@@ -0,0 +1,72 @@
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <stdlib.h>   // Standard utility libraries
+#include <vector>     // C++ vector class
+
+// Includes from Root
+#include <TString.h>
+
+// Own includes
+#include "src/JetBackgroundAnalyzer.h"
+#include "src/ConfigurationCard.h"
+#include "src/FileListReader.h"
+
+using namespace std;
+
+/*
+ *  Convert the forest files to column cache files that the analysis can read through a memory map
+ *
+ *  Command line arguments:
+ *  argv[1] = List of files to be converted, given in text file
+ *  argv[2] = Card file with the configuration for the analysis
+ *  argv[3] = Directory to which the column cache files are written
+ *  argv[4] = Index for the EOS location from where the input files are searched
+ *  argv[5] = True: Search input files from local machine. False (default): Search input files from grid with xrootd
+ *  argv[6] = Number of events in each chunk of the cache. Default: 500
+ */
+int main(int argc, char **argv) {
+  
+  //==== Read arguments =====
+  if ( argc<5 ) {
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout<<"+ Usage of the macro: " << endl;
+    cout<<"+  "<<argv[0]<<" [fileNameFile] [configurationCard] [outputDirectory] [fileLocation] <runLocal> <chunkSize>"<<endl;
+    cout<<"+  fileNameFile: Text file containing the list of forest files that are converted." <<endl;
+    cout<<"+  configurationCard: Card file with the configuration for the analysis." <<endl;
+    cout<<"+  outputDirectory: Directory to which the column cache files are written. Use the same as ColumnCacheDirectory in the card." <<endl;
+    cout<<"+  fileLocation: Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2, 3 = Use xrootd to find the data." << endl;
+    cout<<"+  runLocal: True: Search input files from local machine. False (default): Search input files from grid with xrootd." << endl;
+    cout<<"+  chunkSize: Number of events in each chunk of the cache. Default: 500." << endl;
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout << endl << endl;
+    exit(1);
+  }
+  
+  // Read the command line arguments
+  TString fileNameFile = argv[1];
+  const char* cardName = argv[2];
+  TString outputDirectory = argv[3];
+  const int fileSearchIndex = atoi(argv[4]);
+  bool runLocal = false;
+  if(argc >= 6) runLocal = checkBool(argv[5]);
+  int chunkSize = 500;
+  if(argc >= 7) chunkSize = atoi(argv[6]);
+  
+  // Read the card
+  ConfigurationCard *configurationCard = new ConfigurationCard(cardName);
+  int debugLevel = configurationCard->Get("DebugLevel");
+  
+  // Read the names of the converted files to a vector
+  std::vector<TString> fileNameVector;
+  fileNameVector.clear();
+  ReadFileList(fileNameVector,fileNameFile,debugLevel,fileSearchIndex,runLocal);
+  
+  // Write the caches. The jet collection is taken from the card in the same way as in the analysis.
+  JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(fileNameVector, configurationCard);
+  jetBackgroundAnalysis->WriteColumnCache(outputDirectory, chunkSize);
+  
+  // Delete all created objects
+  delete configurationCard;
+  delete jetBackgroundAnalysis;
+  
+}
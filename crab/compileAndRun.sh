@@ -10,6 +10,11 @@ LOCATION=${4#*=}
 # Untar the input file list
 tar xf input_files.tar.gz
 
+# If balanced job file lists are given, use them instead of the lists made by CRAB
+if [ -f jobFileLists.tar.gz ]; then
+  tar xf jobFileLists.tar.gz
+fi
+
 # Unzip tar ball
 tar -xvzf jetBackgroundAnalysis.tar.gz
 
@@ -10,6 +10,7 @@ outputFile=jobTag+'.root'
 fileLocation='2'  # Locations: 0 = Purdue, 1 = CERN, 2 = Vanderbilt, 3 = Search with xrootd
 
 inputList='pythiaHydjet2018_miniAODforest.txt'
+nBalancedJobs = 0  # Number of job file lists in jobFileLists.tar.gz written by splitJobs. 0 = Let CRAB split the files
 
 config.section_("General")
 config.General.requestName = jobTag
@@ -30,6 +31,13 @@ config.Data.userInputFiles = open(inputList).readlines()
 config.Data.splitting = 'FileBased'
 config.Data.unitsPerJob = 20
 config.Data.totalUnits = len(config.Data.userInputFiles)
+
+# With balanced job file lists, CRAB makes one job for each list. The files given by CRAB are replaced by the lists in the job.
+if nBalancedJobs > 0:
+  config.JobType.inputFiles.append('jobFileLists.tar.gz')
+  config.Data.unitsPerJob = 1
+  config.Data.userInputFiles = config.Data.userInputFiles[:nBalancedJobs]
+  config.Data.totalUnits = nBalancedJobs
 config.Data.outputPrimaryDataset = 'jetBackgroundHistograms'
 config.Data.outLFNDirBase = '/store/user/jviinika/'+config.General.requestName
 config.Data.publication = False
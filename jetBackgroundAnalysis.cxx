@@ -9,6 +9,10 @@
 #include <iomanip>    // Libraries for checking boolean input
 #include <algorithm>  // Libraries for checking boolean input
 #include <cctype>     // Libraries for checking boolean input
+#include <cstring>    // Comparison of the command line options
+#include <chrono>     // Timing of the worker processes
+#include <unistd.h>   // fork for the worker processes
+#include <sys/wait.h> // waitpid for the worker processes
 
 // Includes from Root
 #include <TString.h>
@@ -17,98 +21,216 @@
 #include <TMath.h>
 #include <TObjArray.h>
 #include <TObjString.h>
+#include <TFileMerger.h>
+#include <TSystem.h>
+#include <TH1F.h>
 
 // Own includes
 #include "src/JetBackgroundAnalyzer.h"
 #include "src/ConfigurationCard.h"
 #include "src/JetBackgroundHistograms.h"
+#include "src/FileListReader.h"
+#include "src/JetRecordTable.h"
 
 using namespace std;
 
 /*
- * File list reader
+ * Name of the jet record file written next to an output file
  *
  *  Arguments:
- *    std::vector<TString> &fileNameVector = Vector filled with filenames found in the file
- *    TString fileNameFile = Text file containing one analysis file name in each line
- *    int debug = Level of debug messages shown
- *    int locationIndex = Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2,  3 = Use xrootd to find the data
- *    bool runLocal = True: Local run mode. False: Crab run mode
+ *   TString outputFileName = .root file to which the histograms are written
+ *
+ *  return: Name of the jet record file
+ */
+TString getJetRecordFileName(TString outputFileName){
+  TString jetRecordFileName = outputFileName;
+  jetRecordFileName.ReplaceAll(".root", "_jetRecords.bin");
+  if(jetRecordFileName == outputFileName) jetRecordFileName.Append("_jetRecords.bin");
+  return jetRecordFileName;
+}
+
+/*
+ * Run the analysis over a list of files and write the histograms and the card to a file
+ *
+ *  Arguments:
+ *   std::vector<TString> fileNameVector = Files to be analyzed
+ *   std::vector<int> firstEntries = First analyzed entry of each file
+ *   std::vector<int> lastEntries = Entry after the last analyzed entry of each file. -1 = End of the file
+ *   ConfigurationCard* configurationCard = Card with the analysis configuration
+ *   TString outputFileName = .root file to which the histograms are written
+ *   bool useDataFrame = True: Run the analysis with RDataFrame. False: Run the hand-written event loop
  */
-void ReadFileList(std::vector<TString> &fileNameVector, TString fileNameFile, int debug, int locationIndex, bool runLocal)
-{
+void analyzeFiles(std::vector<TString> fileNameVector, std::vector<int> firstEntries, std::vector<int> lastEntries, ConfigurationCard* configurationCard, TString outputFileName, bool useDataFrame = false){
   
-  // Possible location for the input files
-  const char* fileLocation[] = {"root://eos.cms.rcac.purdue.edu/", "root://eoscms.cern.ch/", "root://xrootd-vanderbilt.sites.opensciencegrid.org/", "root://cmsxrootd.fnal.gov/"};
+  // Variable for histograms in the analysis
+  JetBackgroundHistograms* histograms;
   
-  // Set up the file names file for reading
-  ifstream file_stream(fileNameFile);
-  std::string line;
-  fileNameVector.clear();
-  if( debug > 0 ) std::cout << "Open file " << fileNameFile.Data() << " to extract files to run over" << std::endl;
+  // Run the analysis over the list of files
+  JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(fileNameVector, configurationCard);
+  jetBackgroundAnalysis->SetFileEntryRanges(firstEntries, lastEntries);
   
-  // Open the file names file for reading
-  if( file_stream.is_open() ) {
-    if( debug > 0) std::cout << "Opened " << fileNameFile.Data() << " for reading" << std::endl;
-    int lineNumber = 0;
-    
-    // Loop over the lines in the file
-    while( !file_stream.eof() ) {
-      getline(file_stream, line);
-      if( debug > 0) std::cout << lineNumber << ": " << line << std::endl;
-      TString lineString(line);
-      
-      // Put all non-empty lines to file names vector
-      if( lineString.CompareTo("", TString::kExact) != 0 ) {
-        
-        if(runLocal){
-          // For local running, it is assumed that the file name is directly the centents of the line
-          fileNameVector.push_back(lineString);
-          
-        } else {
-          // For crab running, the line will have format ["file1", "file2", ... , "fileN"]
-          TObjArray* fileNameArray = lineString.Tokenize(" ");  // Tokenize the string from every ' ' character
-          int numberOfFiles = fileNameArray->GetEntries();
-          TObjString* currentFileNameObject;
-          TString currentFileName;
-          for(int i = 0; i < numberOfFiles; i++){   // Loop over all the files in the array
-            currentFileNameObject = (TObjString *)fileNameArray->At(i);
-            currentFileName = currentFileNameObject->String();
-            
-            // Strip unwanted characters
-            currentFileName.Remove(TString::kBoth,'['); // Remove possible parantheses
-            currentFileName.Remove(TString::kBoth,']'); // Remove possible parantheses
-            currentFileName.Remove(TString::kBoth,','); // Remove commas
-            currentFileName.Remove(TString::kBoth,'"'); // Remove quotation marks
-            
-            // After stripping characters not belonging to the file name, we can add the file to list
-            currentFileName.Prepend(fileLocation[locationIndex]);  // If not running locally, we need to give xrootd path
-            fileNameVector.push_back(currentFileName);
-          }
-        }
-        
-      } // Empty line if
-      
-      
-      lineNumber++;
-    } // Loop over lines in the file
-    
-  // If cannot read the file, give error and end program
+  // If requested, write the jet records for refilling the histograms next to the output file
+  if(configurationCard->Get("WriteJetRecords") == 1){
+    jetBackgroundAnalysis->SetJetRecordFileName(getJetRecordFileName(outputFileName));
+  }
+  if(useDataFrame){
+    jetBackgroundAnalysis->RunDataFrameAnalysis();
   } else {
-    std::cout << "Error, could not open " << fileNameFile.Data() << " for reading" << std::endl;
-    assert(0);
+    jetBackgroundAnalysis->RunAnalysis();
   }
+  histograms = jetBackgroundAnalysis->GetHistograms();
+  
+  // Write the histograms and card to file
+  TFile* outputFile = new TFile(outputFileName, "RECREATE");
+  histograms->Write();
+  configurationCard->WriteCard(outputFile);
+  outputFile->Close();
+  
+  // After writing to the file, delete all created objects
+  delete jetBackgroundAnalysis;
+  delete outputFile;
 }
 
 /*
- *  Convert string to boolean value
+ * Analyze the files in several forked worker processes and merge the results. The file list is split into
+ * consecutive parts of about equal size, and each worker writes the histograms of its part to a partial output
+ * file. The partial files are merged to the output file after all the workers have finished. If jet records are
+ * written, the record files of the workers are joined in the same order to the record file of the output file.
+ *
+ *  Arguments:
+ *   std::vector<TString> fileNameVector = Files to be analyzed
+ *   std::vector<int> firstEntries = First analyzed entry of each file
+ *   std::vector<int> lastEntries = Entry after the last analyzed entry of each file. -1 = End of the file
+ *   ConfigurationCard* configurationCard = Card with the analysis configuration
+ *   TString outputFileName = .root file to which the merged histograms are written
+ *   int nProcesses = Number of worker processes
  */
-bool checkBool(string str) {
-  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
-  std::istringstream is(str);
-  bool b;
-  is >> std::boolalpha >> b;
-  return b;
+void analyzeFilesInProcesses(std::vector<TString> fileNameVector, std::vector<int> firstEntries, std::vector<int> lastEntries, ConfigurationCard* configurationCard, TString outputFileName, int nProcesses){
+  
+  const int nFiles = fileNameVector.size();
+  if(nProcesses > nFiles) nProcesses = nFiles;
+  
+  // Names of the partial output files
+  std::vector<TString> partialFileNames;
+  for(int iProcess = 0; iProcess < nProcesses; iProcess++){
+    TString partialFileName = outputFileName;
+    partialFileName.ReplaceAll(".root", Form("_part%d.root", iProcess));
+    if(partialFileName == outputFileName) partialFileName.Append(Form("_part%d.root", iProcess));
+    partialFileNames.push_back(partialFileName);
+  }
+  
+  // Everything printed before the fork would otherwise be printed again by each worker
+  cout.flush();
+  
+  // Start the workers. Each worker analyzes consecutive files, such that the per file histograms can be joined in order.
+  std::vector<pid_t> workerIds(nProcesses);
+  std::vector<int> workerFiles(nProcesses);
+  std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  int firstFile = 0;
+  for(int iProcess = 0; iProcess < nProcesses; iProcess++){
+    workerFiles.at(iProcess) = nFiles / nProcesses + (iProcess < nFiles % nProcesses ? 1 : 0);
+    std::vector<TString> workerFileNames(fileNameVector.begin() + firstFile, fileNameVector.begin() + firstFile + workerFiles.at(iProcess));
+    std::vector<int> workerFirstEntries(firstEntries.begin() + firstFile, firstEntries.begin() + firstFile + workerFiles.at(iProcess));
+    std::vector<int> workerLastEntries(lastEntries.begin() + firstFile, lastEntries.begin() + firstFile + workerFiles.at(iProcess));
+    firstFile += workerFiles.at(iProcess);
+    
+    workerIds.at(iProcess) = fork();
+    if(workerIds.at(iProcess) < 0){
+      cout << "Error! Could not start worker process " << iProcess << endl;
+      assert(0);
+    }
+    
+    // The worker analyzes its files and exits
+    if(workerIds.at(iProcess) == 0){
+      analyzeFiles(workerFileNames, workerFirstEntries, workerLastEntries, configurationCard, partialFileNames.at(iProcess));
+      exit(0);
+    }
+  }
+  
+  // Wait for all the workers to finish and record the time each of them used
+  std::vector<double> workerTime(nProcesses, 0);
+  bool workerFailed = false;
+  for(int iFinished = 0; iFinished < nProcesses; iFinished++){
+    int status;
+    pid_t finishedId = waitpid(-1, &status, 0);
+    for(int iProcess = 0; iProcess < nProcesses; iProcess++){
+      if(workerIds.at(iProcess) != finishedId) continue;
+      workerTime.at(iProcess) = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+      if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        cout << "Error! Worker process " << iProcess << " did not finish successfully" << endl;
+        workerFailed = true;
+      }
+    }
+  }
+  if(workerFailed){
+    cout << "Error! The partial results are left in the partial output files and are not merged" << endl;
+    assert(0);
+  }
+  
+  // Collect the number of events and memory usage of each worker. The memory histograms cannot be added, so they are joined separately.
+  TH1F* fileMemory = new TH1F("fileMemory","fileMemory",nFiles,-0.5,nFiles-0.5);
+  TH1F* peakMemory = new TH1F("peakMemory","peakMemory",1,-0.5,0.5);
+  fileMemory->SetDirectory(0);
+  peakMemory->SetDirectory(0);
+  firstFile = 0;
+  for(int iProcess = 0; iProcess < nProcesses; iProcess++){
+    TFile* partialFile = TFile::Open(partialFileNames.at(iProcess));
+    TH1F* partialEvents = (TH1F*)partialFile->Get("nEvents");
+    TH1F* partialFileMemory = (TH1F*)partialFile->Get("fileMemory");
+    TH1F* partialPeakMemory = (TH1F*)partialFile->Get("peakMemory");
+    double nEvents = partialEvents->GetBinContent(JetBackgroundHistograms::kAll+1);
+    cout << "Worker " << iProcess << ": " << workerFiles.at(iProcess) << " files, " << nEvents << " events in " << workerTime.at(iProcess) << " s, " << nEvents / workerTime.at(iProcess) << " events/s" << endl;
+    for(int iFile = 0; iFile < workerFiles.at(iProcess); iFile++){
+      fileMemory->SetBinContent(firstFile+iFile+1, partialFileMemory->GetBinContent(iFile+1));
+    }
+    firstFile += workerFiles.at(iProcess);
+    peakMemory->SetBinContent(1, TMath::Max(peakMemory->GetBinContent(1), partialPeakMemory->GetBinContent(1)));
+    partialFile->Close();
+    delete partialFile;
+  }
+  
+  // Merge the histograms from the partial files. The card and the memory usage are written separately.
+  TFileMerger merger(false);
+  merger.OutputFile(outputFileName, "RECREATE");
+  for(const TString& partialFileName : partialFileNames) merger.AddFile(partialFileName);
+  merger.AddObjectNames("JCard fileMemory peakMemory");
+  if(!merger.PartialMerge(TFileMerger::kAll | TFileMerger::kRegular | TFileMerger::kSkipListed)){
+    cout << "Error! Could not merge the partial output files to " << outputFileName.Data() << endl;
+    assert(0);
+  }
+  
+  TFile* outputFile = new TFile(outputFileName, "UPDATE");
+  fileMemory->Write();
+  peakMemory->Write();
+  configurationCard->WriteCard(outputFile);
+  outputFile->Close();
+  delete outputFile;
+  delete fileMemory;
+  delete peakMemory;
+  
+  // Join the jet records of the workers in the order of the files, such that they can be used as if they came from one process
+  if(configurationCard->Get("WriteJetRecords") == 1){
+    const TString jetRecordFileName = getJetRecordFileName(outputFileName);
+    JetRecordTable* jetRecords = new JetRecordTable();
+    if(!jetRecords->Create(jetRecordFileName, 100000, configurationCard->Get("EventPlaneOrders"))){
+      cout << "Error! Could not create the jet record file " << jetRecordFileName.Data() << endl;
+      assert(0);
+    }
+    for(const TString& partialFileName : partialFileNames){
+      JetRecordTable partialRecords;
+      if(!partialRecords.Open(getJetRecordFileName(partialFileName))){
+        cout << "Error! Could not read the jet record file " << getJetRecordFileName(partialFileName).Data() << endl;
+        assert(0);
+      }
+      jetRecords->AppendTable(partialRecords);
+    }
+    jetRecords->Close();
+    delete jetRecords;
+    for(const TString& partialFileName : partialFileNames) gSystem->Unlink(getJetRecordFileName(partialFileName));
+  }
+  
+  // The partial files are not needed after a successful merge
+  for(const TString& partialFileName : partialFileNames) gSystem->Unlink(partialFileName);
 }
 
 /*
@@ -121,19 +243,43 @@ bool checkBool(string str) {
  *  argv[4] = Index for the EOS location from where the input files are searched
  *  argv[5] = True: Search input files from local machine. False (default): Search input files from grid with xrootd
  *  argc[6] = Index for the used mixing list for CRAB running
+ *
+ *  Options:
+ *  -j N = Analyze the files in N forked worker processes and merge the results to the output file
+ *  --rdf = Run the analysis with RDataFrame and implicit multithreading instead of the hand-written event loop
  */
 int main(int argc, char **argv) {
   
+  //==== Read options =====
+  // The options can be given anywhere on the command line and are removed from the argument list
+  int nProcesses = 1;
+  bool useDataFrame = false;
+  int nArguments = 1;
+  for(int iArgument = 1; iArgument < argc; iArgument++){
+    if(strcmp(argv[iArgument], "-j") == 0 && iArgument+1 < argc){
+      nProcesses = atoi(argv[++iArgument]);
+    } else if(strncmp(argv[iArgument], "-j", 2) == 0 && isdigit(argv[iArgument][2])){
+      nProcesses = atoi(argv[iArgument]+2);
+    } else if(strcmp(argv[iArgument], "--rdf") == 0){
+      useDataFrame = true;
+    } else {
+      argv[nArguments++] = argv[iArgument];
+    }
+  }
+  argc = nArguments;
+  
   //==== Read arguments =====
   if ( argc<5 ) {
     cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
     cout<<"+ Usage of the macro: " << endl;
-    cout<<"+  "<<argv[0]<<" [fileNameFile] [configurationCard] [outputFileName] [fileLocation] <runLocal> "<<endl;
+    cout<<"+  "<<argv[0]<<" [fileNameFile] [configurationCard] [outputFileName] [fileLocation] <runLocal> <-j nProcesses> <--rdf>"<<endl;
     cout<<"+  fileNameFile: Text file containing the list of files used in the analysis. For crab analysis a job id should be given here." <<endl;
     cout<<"+  configurationCard: Card file with binning and cut information for the analysis." <<endl;
     cout<<"+  outputFileName: .root file to which the histograms are written." <<endl;
     cout<<"+  fileLocation: Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2, 3 = Use xrootd to find the data." << endl;
     cout<<"+  runLocal: True: Search input files from local machine. False (default): Search input files from grid with xrootd." << endl;
+    cout<<"+  -j nProcesses: Analyze the files in this many parallel processes and merge the results. Default 1." << endl;
+    cout<<"+  --rdf: Run the analysis with RDataFrame using AnalysisThreads threads, or all the cores if it is 0." << endl;
     cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
     cout << endl << endl;
     exit(1);
@@ -171,29 +317,25 @@ int main(int argc, char **argv) {
     cout << endl;
   }
   
-  // Read the file names used for the analysis to a vector
+  // Read the file names used for the analysis to a vector. Files split between jobs have an entry range.
   std::vector<TString> fileNameVector;
+  std::vector<int> firstEntries;
+  std::vector<int> lastEntries;
   fileNameVector.clear();
-  ReadFileList(fileNameVector,fileNameFile,debugLevel,fileSearchIndex,runLocal);
+  ReadFileList(fileNameVector,fileNameFile,debugLevel,fileSearchIndex,runLocal,&firstEntries,&lastEntries);
   
-  // Variable for histograms in the analysis
-  JetBackgroundHistograms* histograms;
-  
-  // Run the analysis over the list of files
-  JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(fileNameVector, configurationCard);
-  jetBackgroundAnalysis->RunAnalysis();
-  histograms = jetBackgroundAnalysis->GetHistograms();
-  
-  // Write the histograms and card to file
-  TFile* outputFile = new TFile(outputFileName, "RECREATE");
-  histograms->Write();
-  configurationCard->WriteCard(outputFile);
-  outputFile->Close();
+  // Run the analysis over the list of files, either directly or split between several processes.
+  // RDataFrame uses its own thread pool, so the files are not split between processes for it.
+  if(useDataFrame){
+    if(nProcesses > 1) cout << "Warning! The -j option is ignored with --rdf. Set AnalysisThreads in the card instead." << endl;
+    analyzeFiles(fileNameVector, firstEntries, lastEntries, configurationCard, outputFileName, true);
+  } else if(nProcesses > 1 && fileNameVector.size() > 1){
+    analyzeFilesInProcesses(fileNameVector, firstEntries, lastEntries, configurationCard, outputFileName, nProcesses);
+  } else {
+    analyzeFiles(fileNameVector, firstEntries, lastEntries, configurationCard, outputFileName);
+  }
   
-  // After writing to the file, delete all created objects
   delete configurationCard;
-  delete jetBackgroundAnalysis;
-  delete outputFile;
   
 }
 
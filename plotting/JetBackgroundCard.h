@@ -25,6 +25,7 @@ public:
   enum enumCardEntries{
     kMaxParticleEtaEventPlane,    // Maximum eta for particles included in the event plane calculation
     kMaxParticlePtEventPlane,     // Maximum pT for particles included in the event plane calculation
+    kEventPlaneOrders,            // Number of flow harmonics for which the event plane is determined
     kJetType,                     // 0 = Reconstructed jets, 1 = Generator level
     kJetSubtraction,              // 0 = Calo PU jets, 1 = csPF jets, 2 = flowPuCsPF jets
     kJetAxis,                     // 0 = E-scheme axis, 1 = WTA axis
@@ -45,7 +46,7 @@ public:
 private:
   
   // Names for each entry read from the configuration card
-  const char* fCardEntryNames[knEntries] = {"MaxParticleEtaEventPlane", "MaxParticlePtEventPlane", "JetType", "JetSubtraction", "JetAxis", "JetEtaCut", "MinJetPtCut", "MaxJetPtCut", "MinMaxTrackPtFraction", "MaxMaxTrackPtFraction", "MinJetPtClosure", "ZVertexCut", "LowPtHatCut", "HighPtHatCut", "CentralityBinEdges", "JetPtBinEdges", "PtHatBinEdges"};
+  const char* fCardEntryNames[knEntries] = {"MaxParticleEtaEventPlane", "MaxParticlePtEventPlane", "EventPlaneOrders", "JetType", "JetSubtraction", "JetAxis", "JetEtaCut", "MinJetPtCut", "MaxJetPtCut", "MinMaxTrackPtFraction", "MaxMaxTrackPtFraction", "MinJetPtClosure", "ZVertexCut", "LowPtHatCut", "HighPtHatCut", "CentralityBinEdges", "JetPtBinEdges", "PtHatBinEdges"};
 
   const char* fInputFileSaveName = "InputFile";
   
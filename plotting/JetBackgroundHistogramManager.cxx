@@ -82,7 +82,7 @@ JetBackgroundHistogramManager::JetBackgroundHistogramManager() :
     // Jet-event plane correlation histograms
     for(int iJetType = 0; iJetType < knJetTypes; iJetType++){
       for(int iJetPt = 0; iJetPt < kMaxJetPtBins; iJetPt++){
-        for(int iOrder = 0; iOrder < JetBackgroundHistograms::knEventPlanes; iOrder++){
+        for(int iOrder = 0; iOrder < kMaxEventPlaneOrders; iOrder++){
           fhJetEventPlane[iJetType][iOrder][iCentrality][iJetPt] = NULL;
         } // Event plane order loop
       } // Jet pT loop
@@ -225,7 +225,7 @@ JetBackgroundHistogramManager::JetBackgroundHistogramManager(const JetBackground
     // Jet-event plane correlation histograms
     for(int iJetType = 0; iJetType < knJetTypes; iJetType++){
       for(int iJetPt = 0; iJetPt < kMaxJetPtBins; iJetPt++){
-        for(int iOrder = 0; iOrder < JetBackgroundHistograms::knEventPlanes; iOrder++){
+        for(int iOrder = 0; iOrder < kMaxEventPlaneOrders; iOrder++){
           fhJetEventPlane[iJetType][iOrder][iCentrality][iJetPt] = in.fhJetEventPlane[iJetType][iOrder][iCentrality][iJetPt];
         } // Event plane order loop
       } // Jet pT loop
@@ -592,8 +592,11 @@ void JetBackgroundHistogramManager::LoadJetEventPlaneHistograms(){
   
   // Open the multidimensional histogram from which the histograms are projected
   for(int iJetType = 0; iJetType < knJetTypes; iJetType++){
-    for(int iOrder = 0; iOrder < JetBackgroundHistograms::knEventPlanes; iOrder++){
+    for(int iOrder = 0; iOrder < kMaxEventPlaneOrders; iOrder++){
       histogramArray = (THnSparseD*) fInputFile->Get(Form("%sEventPlaneOrder%d", fJetHistogramName[iJetType], iOrder+2));
+
+      // Only the event plane orders up to EventPlaneOrders in the analysis card are written to the file
+      if(histogramArray == NULL) continue;
   
       for(int iCentrality = fFirstLoadedCentralityBin; iCentrality <= fLastLoadedCentralityBin; iCentrality++){
 
@@ -944,7 +947,10 @@ void JetBackgroundHistogramManager::WriteJetEventPlaneHistograms(){
   if(!fLoadJetEventPlaneCorrelationHistograms) return;  // Only write the histograms if they are loaded
 
   for(int iJetType = 0; iJetType < knJetTypes; iJetType++){
-    for(int iOrder = 0; iOrder < JetBackgroundHistograms::knEventPlanes; iOrder++){
+    for(int iOrder = 0; iOrder < kMaxEventPlaneOrders; iOrder++){
+
+      // Only the event plane orders found from the input file are written
+      if(fhJetEventPlane[iJetType][iOrder][fFirstLoadedCentralityBin][fnJetPtBins] == NULL) continue;
   
       // Create a directory for the histograms if it does not already exist
       histogramNamer = Form("%sEventPlaneOrder%d", fJetHistogramName[iJetType], iOrder+2);
@@ -1075,7 +1081,7 @@ void JetBackgroundHistogramManager::LoadProcessedHistograms(){
   // Load the jet-event plane correlation histograms from the processed file
   if(fLoadJetEventPlaneCorrelationHistograms){
     for(int iJetType = 0; iJetType < knJetTypes; iJetType++){
-      for(int iOrder = 0; iOrder < JetBackgroundHistograms::knEventPlanes; iOrder++){
+      for(int iOrder = 0; iOrder < kMaxEventPlaneOrders; iOrder++){
   
         // There are different folders for each jet type and each event plane order
         folderNamer = Form("%sEventPlaneOrder%d", fJetHistogramName[iJetType], iOrder+2);
@@ -27,6 +27,7 @@ public:
   
   // Dimensions for histogram arrays
   static const int kMaxCentralityBins = 5;       // Maximum allowed number of centrality bins
+  static const int kMaxEventPlaneOrders = 6;     // Maximum allowed number of event plane orders
   static const int kMaxJetPtBins = 20;           // Maximum allowed number of jet pT bins for closure histograms
   static const int knGenJetPtBins = 45;          // Number of generator level jet pT bins for jet pT closures
   static const int knJetEtaBins = 50;            // Number of jet eta bins for jet pT closures
@@ -194,7 +195,7 @@ private:
   TH2D* fhJetPtResponseMatrix[kMaxCentralityBins]; // Jet pT response matrix
 
   // Histograms for jet-event plane correlation
-  TH1D* fhJetEventPlane[knJetTypes][JetBackgroundHistograms::knEventPlanes][kMaxCentralityBins][kMaxJetPtBins];
+  TH1D* fhJetEventPlane[knJetTypes][kMaxEventPlaneOrders][kMaxCentralityBins][kMaxJetPtBins];
 
   // Private methods
   void InitializeFromCard(); // Initialize several member variables from JetBackgroundCard
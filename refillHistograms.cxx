@@ -0,0 +1,74 @@
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <stdlib.h>   // Standard utility libraries
+#include <assert.h>   // Standard c++ debugging tool. Terminates the program if expression given evaluates to 0.
+
+// Includes from Root
+#include <TString.h>
+#include <TFile.h>
+
+// Own includes
+#include "src/ConfigurationCard.h"
+#include "src/JetBackgroundHistograms.h"
+#include "src/JetRecordTable.h"
+
+using namespace std;
+
+/*
+ *  Fill the analysis histograms again from the jet records written by the analysis, using the binning from a new card
+ *
+ *  Command line arguments:
+ *  argv[1] = Jet record file written by the analysis with WriteJetRecords 1
+ *  argv[2] = Card file with the new binning
+ *  argv[3] = .root file to which the histograms are written
+ */
+int main(int argc, char **argv) {
+  
+  //==== Read arguments =====
+  if ( argc<4 ) {
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout<<"+ Usage of the macro: " << endl;
+    cout<<"+  "<<argv[0]<<" [jetRecordFile] [configurationCard] [outputFileName]"<<endl;
+    cout<<"+  jetRecordFile: Jet record file written by the analysis when WriteJetRecords is 1 in the card." <<endl;
+    cout<<"+  configurationCard: Card file with the binning for the histograms. The cuts in this card are not applied again." <<endl;
+    cout<<"+  outputFileName: .root file to which the histograms are written." <<endl;
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout << endl << endl;
+    exit(1);
+  }
+  
+  // Read the command line arguments
+  TString jetRecordFileName = argv[1];
+  const char* cardName = argv[2];
+  TString outputFileName = argv[3];
+  
+  // Read the card
+  ConfigurationCard *configurationCard = new ConfigurationCard(cardName);
+  int debugLevel = configurationCard->Get("DebugLevel");
+  
+  // Open the jet records
+  JetRecordTable* jetRecords = new JetRecordTable();
+  if(!jetRecords->Open(jetRecordFileName)){
+    cout << "Error! Could not read the jet records from file: " << jetRecordFileName.Data() << endl;
+    assert(0);
+  }
+  if(debugLevel > 0) cout << "Refilling histograms from " << jetRecords->GetNEvents() << " events and " << jetRecords->GetNJets() << " jet records" << endl;
+  
+  // Create the histograms with the binning from the card and fill them from the records
+  JetBackgroundHistograms* histograms = new JetBackgroundHistograms(configurationCard);
+  histograms->CreateHistograms();
+  jetRecords->FillHistograms(histograms);
+  
+  // Write the histograms and card to file
+  TFile* outputFile = new TFile(outputFileName, "RECREATE");
+  histograms->Write();
+  configurationCard->WriteCard(outputFile);
+  outputFile->Close();
+  
+  // After writing to the file, delete all created objects
+  delete configurationCard;
+  delete histograms;
+  delete jetRecords;
+  delete outputFile;
+  
+}
@@ -0,0 +1,242 @@
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <fstream>    // File stream for input/output to/from files
+#include <stdlib.h>   // Standard utility libraries
+#include <assert.h>   // Standard c++ debugging tool. Terminates the program if expression given evaluates to 0.
+#include <vector>     // C++ vector class
+#include <algorithm>  // Sorting the pieces of work
+
+// Includes from Root
+#include <TString.h>
+#include <TMath.h>
+#include <TSystem.h>
+
+// Own includes
+#include "src/JetBackgroundAnalyzer.h"
+#include "src/ConfigurationCard.h"
+#include "src/FileListReader.h"
+#include "src/FileManifest.h"
+
+using namespace std;
+
+// Range of entries in one file given to one job
+struct JobPiece{
+  int fileIndex;      // Index of the file in the manifest
+  int firstEntry;     // First entry of the piece
+  int lastEntry;      // Entry after the last entry of the piece
+  double cost;        // Estimated work needed to analyze the piece
+};
+
+/*
+ * Divide the good files in the manifest into pieces. Files that are estimated to take longer than one average job
+ * are split into entry ranges of about equal size. If the clusters of the jet tree are known, the ranges start at
+ * cluster boundaries.
+ *
+ *  Arguments:
+ *   const FileManifest& manifest = Checked files with the number of entries and particle multiplicities
+ *   const int nJobs = Number of jobs the work is divided to
+ *   const double particleCost = Cost of analyzing one generator level particle compared to the rest of the event
+ *
+ *  return: Pieces of work covering all the entries in the good files
+ */
+std::vector<JobPiece> findPieces(const FileManifest& manifest, const int nJobs, const double particleCost){
+
+  // The cost of each file is estimated from the number of events and the particles in them
+  std::vector<double> eventCost(manifest.GetNFiles(), 0);
+  double totalCost = 0;
+  for(int iFile = 0; iFile < manifest.GetNFiles(); iFile++){
+    if(!manifest.IsGood(iFile)) continue;
+    eventCost.at(iFile) = 1 + particleCost * manifest.fMeanParticles.at(iFile);
+    totalCost += manifest.fnEntries.at(iFile) * eventCost.at(iFile);
+  }
+  const double jobCost = totalCost / nJobs;
+
+  std::vector<JobPiece> pieces;
+  for(int iFile = 0; iFile < manifest.GetNFiles(); iFile++){
+    if(!manifest.IsGood(iFile) || manifest.fnEntries.at(iFile) == 0) continue;
+
+    const int nEntries = manifest.fnEntries.at(iFile);
+    const int nPieces = TMath::Max(1, (int)TMath::Ceil(nEntries * eventCost.at(iFile) / jobCost - 1e-9));
+    const std::vector<Long64_t>& clusterStarts = manifest.fClusterStarts.at(iFile);
+
+    int firstEntry = 0;
+    int lastEntry;
+    for(int iPiece = 1; iPiece <= nPieces; iPiece++){
+      lastEntry = (Long64_t)nEntries * iPiece / nPieces;
+
+      // Move the end of the piece to the next cluster boundary, such that no cluster is read by two jobs
+      if(iPiece < nPieces && !clusterStarts.empty()){
+        std::vector<Long64_t>::const_iterator nextCluster = std::lower_bound(clusterStarts.begin(), clusterStarts.end(), (Long64_t)lastEntry);
+        lastEntry = (nextCluster == clusterStarts.end()) ? nEntries : *nextCluster;
+      }
+      if(lastEntry <= firstEntry) continue;
+
+      pieces.push_back({iFile, firstEntry, lastEntry, (lastEntry - firstEntry) * eventCost.at(iFile)});
+      firstEntry = lastEntry;
+      if(firstEntry >= nEntries) break;
+    }
+  }
+
+  return pieces;
+}
+
+/*
+ * Assign the pieces to jobs with the longest processing time first rule: the pieces are taken from the most expensive
+ * to the cheapest, and each piece is given to the job that has the least work so far.
+ *
+ *  Arguments:
+ *   std::vector<JobPiece> pieces = Pieces of work
+ *   const int nJobs = Number of jobs
+ *   std::vector<double>& jobCosts = Filled with the total estimated cost of each job
+ *
+ *  return: Pieces of each job, in the order of the files in the manifest
+ */
+std::vector<std::vector<JobPiece>> assignPieces(std::vector<JobPiece> pieces, const int nJobs, std::vector<double>& jobCosts){
+
+  std::sort(pieces.begin(), pieces.end(), [](const JobPiece& first, const JobPiece& second){ return first.cost > second.cost; });
+
+  std::vector<std::vector<JobPiece>> jobPieces(nJobs);
+  jobCosts.assign(nJobs, 0);
+  for(const JobPiece& piece : pieces){
+    int cheapestJob = std::min_element(jobCosts.begin(), jobCosts.end()) - jobCosts.begin();
+    jobPieces.at(cheapestJob).push_back(piece);
+    jobCosts.at(cheapestJob) += piece.cost;
+  }
+
+  // Inside a job the files are read in the original order
+  for(std::vector<JobPiece>& job : jobPieces){
+    std::sort(job.begin(), job.end(), [](const JobPiece& first, const JobPiece& second){ return first.fileIndex != second.fileIndex ? first.fileIndex < second.fileIndex : first.firstEntry < second.firstEntry; });
+  }
+
+  return jobPieces;
+}
+
+/*
+ * Write the file list of one job in the format read by the analysis
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the file list
+ *   const std::vector<JobPiece>& pieces = Pieces of work in the job
+ *   const FileManifest& manifest = Manifest with the file names
+ *   const bool runLocal = True: One file name per line. False: CRAB format with the redirector removed from the file names
+ */
+void writeJobFileList(const TString fileName, const std::vector<JobPiece>& pieces, const FileManifest& manifest, const bool runLocal){
+
+  ofstream fileList(fileName.Data());
+  if(!fileList.is_open()){
+    cout << "Error! Could not create the job file list: " << fileName.Data() << endl;
+    assert(0);
+  }
+
+  if(!runLocal) fileList << "[";
+  for(unsigned int iPiece = 0; iPiece < pieces.size(); iPiece++){
+    const JobPiece& piece = pieces.at(iPiece);
+    TString pieceName = runLocal ? manifest.fFileNames.at(piece.fileIndex) : GetLogicalFileName(manifest.fFileNames.at(piece.fileIndex));
+    if(piece.firstEntry > 0 || piece.lastEntry < manifest.fnEntries.at(piece.fileIndex)) pieceName += Form(":%d-%d", piece.firstEntry, piece.lastEntry);
+    if(runLocal){
+      fileList << pieceName.Data() << endl;
+    } else {
+      fileList << (iPiece > 0 ? ", " : "") << "\"" << pieceName.Data() << "\"";
+    }
+  }
+  if(!runLocal) fileList << "]" << endl;
+
+  fileList.close();
+}
+
+/*
+ *  Split the files into job file lists with about the same amount of work in each job
+ *
+ *  Command line arguments:
+ *  argv[1] = List of files to be split, given in text file, or a manifest written by validateFileList
+ *  argv[2] = Card file with the configuration for the analysis
+ *  argv[3] = Directory to which the job file lists job_input_file_list_N.txt are written
+ *  argv[4] = Number of jobs
+ *  argv[5] = Index for the EOS location from where the input files are searched
+ *  argv[6] = True: Search input files from local machine. False (default): Search input files from grid with xrootd
+ *  argv[7] = Cost of analyzing one generator level particle compared to the rest of the event. Default: 0.01
+ *  argv[8] = Number of threads used to check the files. Default: 4
+ */
+int main(int argc, char **argv) {
+
+  //==== Read arguments =====
+  if ( argc<6 ) {
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout<<"+ Usage of the macro: " << endl;
+    cout<<"+  "<<argv[0]<<" [fileNameFile] [configurationCard] [outputDirectory] [nJobs] [fileLocation] <runLocal> <particleCost> <nThreads>"<<endl;
+    cout<<"+  fileNameFile: Text file containing the list of files, or a manifest written by validateFileList." <<endl;
+    cout<<"+  configurationCard: Card file with the configuration for the analysis. Used when checking the files." <<endl;
+    cout<<"+  outputDirectory: Directory to which the job file lists job_input_file_list_N.txt are written." <<endl;
+    cout<<"+  nJobs: Number of jobs." <<endl;
+    cout<<"+  fileLocation: Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2, 3 = Use xrootd to find the data." << endl;
+    cout<<"+  runLocal: True: Search input files from local machine and write local file lists. False (default): Search input files from grid with xrootd and write CRAB file lists." << endl;
+    cout<<"+  particleCost: Cost of analyzing one generator level particle compared to the rest of the event. Default: 0.01." << endl;
+    cout<<"+  nThreads: Number of threads used to check the files. Default: 4." << endl;
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout << endl << endl;
+    exit(1);
+  }
+
+  // Read the command line arguments
+  TString fileNameFile = argv[1];
+  const char* cardName = argv[2];
+  TString outputDirectory = argv[3];
+  const int nJobs = atoi(argv[4]);
+  const int fileSearchIndex = atoi(argv[5]);
+  bool runLocal = false;
+  if(argc >= 7) runLocal = checkBool(argv[6]);
+  double particleCost = 0.01;
+  if(argc >= 8) particleCost = atof(argv[7]);
+  int nThreads = 4;
+  if(argc >= 9) nThreads = atoi(argv[8]);
+
+  if(nJobs < 1){
+    cout << "Error! The number of jobs needs to be at least one, but " << nJobs << " was given" << endl;
+    assert(0);
+  }
+
+  // Read the card
+  ConfigurationCard *configurationCard = new ConfigurationCard(cardName);
+  int debugLevel = configurationCard->Get("DebugLevel");
+
+  // The number of entries and particles in each file are taken from a prepared manifest, or found by checking the files
+  FileManifest manifest;
+  if(FileManifest::IsManifest(fileNameFile)){
+    manifest.Read(fileNameFile);
+  } else {
+    std::vector<TString> fileNameVector;
+    ReadFileList(fileNameVector,fileNameFile,debugLevel,fileSearchIndex,runLocal);
+    JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(fileNameVector, configurationCard);
+    manifest = jetBackgroundAnalysis->ValidateFiles(nThreads);
+    delete jetBackgroundAnalysis;
+  }
+  manifest.PrintBadFiles();
+
+  // Divide the work between the jobs
+  std::vector<double> jobCosts;
+  std::vector<std::vector<JobPiece>> jobPieces = assignPieces(findPieces(manifest, nJobs, particleCost), nJobs, jobCosts);
+
+  // Write one file list for each job. CRAB numbers the jobs starting from one.
+  gSystem->mkdir(outputDirectory, kTRUE);
+  int nEmptyJobs = 0;
+  for(int iJob = 0; iJob < nJobs; iJob++){
+    if(jobPieces.at(iJob).empty()) nEmptyJobs++;
+    writeJobFileList(Form("%s/job_input_file_list_%d.txt", outputDirectory.Data(), iJob+1), jobPieces.at(iJob), manifest, runLocal);
+    if(debugLevel > 0) cout << "Job " << iJob+1 << ": " << jobPieces.at(iJob).size() << " pieces, estimated cost " << jobCosts.at(iJob) << endl;
+  }
+
+  // Print a summary of the balance between the jobs
+  double meanCost = 0;
+  for(double jobCost : jobCosts) meanCost += jobCost;
+  meanCost /= nJobs;
+  double maxCost = *std::max_element(jobCosts.begin(), jobCosts.end());
+  double minCost = *std::min_element(jobCosts.begin(), jobCosts.end());
+  cout << "Wrote " << nJobs << " job file lists to " << outputDirectory.Data() << endl;
+  cout << "Estimated cost per job: mean " << meanCost << ", min " << minCost << ", max " << maxCost;
+  if(meanCost > 0) cout << " (max/mean " << maxCost / meanCost << ")";
+  cout << endl;
+  if(nEmptyJobs > 0) cout << "Warning! " << nEmptyJobs << " jobs have no files. Use fewer jobs." << endl;
+
+  delete configurationCard;
+
+}
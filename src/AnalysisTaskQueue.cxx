@@ -0,0 +1,229 @@
+// Queue of entry ranges analyzed in parallel, with the results merged in a fixed order
+
+// Own includes
+#include "AnalysisTaskQueue.h"
+
+/*
+ * Custom constructor
+ *
+ *  Arguments:
+ *   std::vector<JetBackgroundHistograms*> histogramPool = Empty histogram sets given to the tasks. Not owned by the queue
+ */
+AnalysisTaskQueue::AnalysisTaskQueue(std::vector<JetBackgroundHistograms*> histogramPool) :
+  fFileIndices(),
+  fFirstEntries(),
+  fLastEntries(),
+  fTaskHistograms(),
+  fTaskFinished(),
+  fSkippedFiles(),
+  fResidentMemory(),
+  fTaskTimes(),
+  fTaskWorkers(),
+  fFreeHistograms(histogramPool),
+  fWorkerTasks(),
+  fTaskOwners(),
+  fTaskTaken(),
+  fFirstPendingTask(0),
+  fnStolenTasks(0),
+  fMutex(),
+  fCondition()
+{
+  // Custom constructor
+}
+
+/*
+ * Destructor
+ */
+AnalysisTaskQueue::~AnalysisTaskQueue(){
+  // destructor
+}
+
+/*
+ * Add a range of entries in a file to the queue. The tasks must be added before the worker threads are started.
+ *
+ *  Arguments:
+ *   const Int_t fileIndex = Index of the file in the file list
+ *   const Int_t firstEntry = First entry of the range
+ *   const Int_t lastEntry = Entry after the last entry of the range. -1 = End of the file
+ */
+void AnalysisTaskQueue::AddTask(const Int_t fileIndex, const Int_t firstEntry, const Int_t lastEntry){
+  fFileIndices.push_back(fileIndex);
+  fFirstEntries.push_back(firstEntry);
+  fLastEntries.push_back(lastEntry);
+  fTaskHistograms.push_back(NULL);
+  fTaskFinished.push_back(false);
+  fSkippedFiles.push_back(std::vector<TString>());
+  fResidentMemory.push_back(0);
+  fTaskTimes.push_back(0);
+  fTaskWorkers.push_back(-1);
+  fTaskOwners.push_back(-1);
+  fTaskTaken.push_back(false);
+}
+
+// Getter for the number of tasks
+Int_t AnalysisTaskQueue::GetNTasks() const{
+  return fFileIndices.size();
+}
+
+// Getter for the index of the file of a task in the file list
+Int_t AnalysisTaskQueue::GetFileIndex(const Int_t iTask) const{
+  return fFileIndices.at(iTask);
+}
+
+// Getter for the first entry of a task
+Int_t AnalysisTaskQueue::GetFirstEntry(const Int_t iTask) const{
+  return fFirstEntries.at(iTask);
+}
+
+// Getter for the entry after the last entry of a task. -1 = End of the file
+Int_t AnalysisTaskQueue::GetLastEntry(const Int_t iTask) const{
+  return fLastEntries.at(iTask);
+}
+
+/*
+ * Deal the tasks to the workers. Runs of consecutive tasks are given to the workers in turn, with the run length
+ * chosen such that each worker gets about four runs. The tasks must be assigned before the workers are started.
+ *
+ *  Arguments:
+ *   const Int_t nWorkers = Number of worker threads taking tasks from the queue
+ */
+void AnalysisTaskQueue::AssignTasks(const Int_t nWorkers){
+  fWorkerTasks.assign(TMath::Max(nWorkers, 1), std::deque<Int_t>());
+  const Int_t runLength = TMath::Max(GetNTasks() / (4*(Int_t)fWorkerTasks.size()), 1);
+  for(Int_t iTask = 0; iTask < GetNTasks(); iTask++){
+    fTaskOwners.at(iTask) = (iTask / runLength) % fWorkerTasks.size();
+    fWorkerTasks.at(fTaskOwners.at(iTask)).push_back(iTask);
+  }
+}
+
+/*
+ * Take the next task of the worker and an empty histogram set for it. If the worker has no tasks left, the last task
+ * of the worker with the most tasks left is taken instead. Waits until a histogram set is free.
+ *
+ *  Arguments:
+ *   const Int_t workerIndex = Index of the worker taking the task
+ *   Int_t& taskIndex = Index of the taken task
+ *   JetBackgroundHistograms*& histograms = Empty histogram set to which the task is filled
+ *
+ *  return: True if a task was taken, false if all the tasks have been taken
+ */
+Bool_t AnalysisTaskQueue::TakeTask(const Int_t workerIndex, Int_t& taskIndex, JetBackgroundHistograms*& histograms){
+  std::unique_lock<std::mutex> lock(fMutex);
+
+  fCondition.wait(lock, [this]{ return fFirstPendingTask >= GetNTasks() || !fFreeHistograms.empty(); });
+  if(fFirstPendingTask >= GetNTasks()) return false;
+
+  // Take the next own task, or steal the last task from the worker with the most tasks left
+  if(!fWorkerTasks.at(workerIndex).empty()){
+    taskIndex = fWorkerTasks.at(workerIndex).front();
+  } else {
+    Int_t victimIndex = 0;
+    for(Int_t iWorker = 1; iWorker < (Int_t)fWorkerTasks.size(); iWorker++){
+      if(fWorkerTasks.at(iWorker).size() > fWorkerTasks.at(victimIndex).size()) victimIndex = iWorker;
+    }
+    taskIndex = fWorkerTasks.at(victimIndex).back();
+  }
+
+  // The last free histogram set is saved for the first task not yet taken, such that the merge can always continue
+  if(fFreeHistograms.size() == 1) taskIndex = fFirstPendingTask;
+
+  // Remove the task from the worker it was assigned to
+  std::deque<Int_t>& ownerTasks = fWorkerTasks.at(fTaskOwners.at(taskIndex));
+  ownerTasks.erase(std::find(ownerTasks.begin(), ownerTasks.end(), taskIndex));
+  if(fTaskOwners.at(taskIndex) != workerIndex) fnStolenTasks++;
+
+  fTaskTaken.at(taskIndex) = true;
+  while(fFirstPendingTask < GetNTasks() && fTaskTaken.at(fFirstPendingTask)) fFirstPendingTask++;
+
+  fTaskWorkers.at(taskIndex) = workerIndex;
+  histograms = fFreeHistograms.back();
+  fFreeHistograms.pop_back();
+  fTaskHistograms.at(taskIndex) = histograms;
+  return true;
+}
+
+/*
+ * Hand the filled histograms of a task to the merge
+ *
+ *  Arguments:
+ *   const Int_t taskIndex = Index of the finished task
+ *   const std::vector<TString> skippedFiles = Files that could not be read completely in the task
+ *   const Double_t residentMemory = Peak resident memory in MB during the task
+ *   const Double_t taskTime = Wall time in seconds used to analyze the task
+ */
+void AnalysisTaskQueue::FinishTask(const Int_t taskIndex, const std::vector<TString> skippedFiles, const Double_t residentMemory, const Double_t taskTime){
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fSkippedFiles.at(taskIndex) = skippedFiles;
+    fResidentMemory.at(taskIndex) = residentMemory;
+    fTaskTimes.at(taskIndex) = taskTime;
+    fTaskFinished.at(taskIndex) = true;
+  }
+  fCondition.notify_all();
+}
+
+/*
+ * Add the histograms of all the tasks to the total in the task order. Each histogram set is cleared and given back
+ * to the pool after it is added. Returns when all the tasks have been merged.
+ *
+ *  Arguments:
+ *   JetBackgroundHistograms* totalHistograms = Histograms to which all the tasks are added
+ */
+void AnalysisTaskQueue::MergeTasks(JetBackgroundHistograms* totalHistograms){
+  JetBackgroundHistograms* taskHistograms;
+  for(Int_t iTask = 0; iTask < GetNTasks(); iTask++){
+
+    // Wait for the task to finish
+    {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fCondition.wait(lock, [this, iTask]{ return (Bool_t)fTaskFinished.at(iTask); });
+      taskHistograms = fTaskHistograms.at(iTask);
+      fTaskHistograms.at(iTask) = NULL;
+    }
+
+    // The finished set is not touched by the workers, so it can be merged without holding the lock
+    totalHistograms->Add(taskHistograms);
+    taskHistograms->Reset();
+
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fFreeHistograms.push_back(taskHistograms);
+    }
+    fCondition.notify_all();
+  }
+}
+
+/*
+ * Getter for the files skipped in all the tasks. A file split into several tasks is listed only once.
+ *
+ *  return: Skipped files in the task order
+ */
+std::vector<TString> AnalysisTaskQueue::GetSkippedFiles() const{
+  std::vector<TString> skippedFiles;
+  for(const std::vector<TString>& taskSkippedFiles : fSkippedFiles){
+    for(const TString& skippedFile : taskSkippedFiles){
+      if(std::find(skippedFiles.begin(), skippedFiles.end(), skippedFile) == skippedFiles.end()) skippedFiles.push_back(skippedFile);
+    }
+  }
+  return skippedFiles;
+}
+
+// Getter for the peak resident memory in MB during a task
+Double_t AnalysisTaskQueue::GetResidentMemory(const Int_t iTask) const{
+  return fResidentMemory.at(iTask);
+}
+
+// Getter for the wall time in seconds used to analyze a task
+Double_t AnalysisTaskQueue::GetTaskTime(const Int_t iTask) const{
+  return fTaskTimes.at(iTask);
+}
+
+// Getter for the index of the worker that analyzed a task
+Int_t AnalysisTaskQueue::GetTaskWorker(const Int_t iTask) const{
+  return fTaskWorkers.at(iTask);
+}
+
+// Getter for the number of tasks analyzed by another worker than they were assigned to
+Int_t AnalysisTaskQueue::GetNStolenTasks() const{
+  return fnStolenTasks;
+}
@@ -0,0 +1,92 @@
+// Queue of entry ranges analyzed in parallel, with the results merged in a fixed order
+
+#ifndef ANALYSISTASKQUEUE_H
+#define ANALYSISTASKQUEUE_H
+
+// C++ includes
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TMath.h>
+
+// Own includes
+#include "JetBackgroundHistograms.h"
+
+/*
+ * Tasks for the multithreaded analysis. Each task is a range of entries in one input file. The worker threads fill
+ * a separate histogram set for each task. The finished histogram sets are added to the total in the order of the
+ * tasks, independent of which thread analyzed which task and when. Together with random numbers that are seeded
+ * separately for each task, this makes the result independent of the number of threads.
+ *
+ * The tasks are dealt to the workers in short runs of consecutive tasks, such that a worker mostly reads nearby
+ * entries of the same file. A worker that has analyzed all of its own tasks steals the last task of the worker with
+ * the most tasks left, so all the workers stay busy until the end.
+ *
+ * The histogram sets are taken from a fixed pool. A set is given back to the pool after it has been merged, which
+ * limits the number of filled sets waiting for the merge. The last free set is only given to the first task that is
+ * not yet taken, so the oldest unmerged task can always be analyzed and the merge can always continue.
+ */
+class AnalysisTaskQueue{
+
+public:
+
+  // Constructors and destructor
+  AnalysisTaskQueue(std::vector<JetBackgroundHistograms*> histogramPool);     // Custom constructor
+  AnalysisTaskQueue(const AnalysisTaskQueue& in) = delete;                    // The queue is shared between threads and cannot be copied
+  ~AnalysisTaskQueue();                                                       // Destructor
+  AnalysisTaskQueue& operator=(const AnalysisTaskQueue& obj) = delete;        // The queue is shared between threads and cannot be copied
+
+  // Methods for setting up the tasks
+  void AddTask(const Int_t fileIndex, const Int_t firstEntry, const Int_t lastEntry); // Add a range of entries in a file to the queue
+  Int_t GetNTasks() const;                     // Getter for the number of tasks
+  Int_t GetFileIndex(const Int_t iTask) const; // Getter for the index of the file of a task in the file list
+  Int_t GetFirstEntry(const Int_t iTask) const; // Getter for the first entry of a task
+  Int_t GetLastEntry(const Int_t iTask) const;  // Getter for the entry after the last entry of a task. -1 = End of the file
+  void AssignTasks(const Int_t nWorkers);       // Deal the tasks to the workers before the workers are started
+
+  // Methods for the worker threads
+  Bool_t TakeTask(const Int_t workerIndex, Int_t& taskIndex, JetBackgroundHistograms*& histograms); // Take the next task of the worker, or steal one, and a histogram set for it
+  void FinishTask(const Int_t taskIndex, const std::vector<TString> skippedFiles, const Double_t residentMemory, const Double_t taskTime); // Hand the filled histograms of a task to the merge
+
+  // Methods for the merging thread
+  void MergeTasks(JetBackgroundHistograms* totalHistograms); // Add the histograms of all the tasks to the total in the task order
+  std::vector<TString> GetSkippedFiles() const;              // Getter for the files skipped in all the tasks in the task order
+  Double_t GetResidentMemory(const Int_t iTask) const;       // Getter for the peak resident memory in MB during a task
+  Double_t GetTaskTime(const Int_t iTask) const;             // Getter for the wall time in seconds used to analyze a task
+  Int_t GetTaskWorker(const Int_t iTask) const;              // Getter for the index of the worker that analyzed a task
+  Int_t GetNStolenTasks() const;                             // Getter for the number of tasks analyzed by another worker than they were assigned to
+
+private:
+
+  // Task definitions
+  std::vector<Int_t> fFileIndices;     // Index of the file of each task in the file list
+  std::vector<Int_t> fFirstEntries;    // First entry of each task
+  std::vector<Int_t> fLastEntries;     // Entry after the last entry of each task. -1 = End of the file
+
+  // Task results
+  std::vector<JetBackgroundHistograms*> fTaskHistograms; // Histogram set used by each task. NULL before the task is taken and after it is merged
+  std::vector<Bool_t> fTaskFinished;                     // Flag for the finished tasks
+  std::vector<std::vector<TString>> fSkippedFiles;       // Files skipped in each task
+  std::vector<Double_t> fResidentMemory;                 // Peak resident memory in MB during each task
+  std::vector<Double_t> fTaskTimes;                      // Wall time in seconds used to analyze each task
+  std::vector<Int_t> fTaskWorkers;                       // Index of the worker that analyzed each task
+
+  // Shared state
+  std::vector<JetBackgroundHistograms*> fFreeHistograms; // Histogram sets that are not used by any task
+  std::vector<std::deque<Int_t>> fWorkerTasks;           // Tasks waiting for each worker in increasing task order
+  std::vector<Int_t> fTaskOwners;                        // Worker to which each task is assigned
+  std::vector<Bool_t> fTaskTaken;                        // Flag for the tasks that have been taken by a worker
+  Int_t fFirstPendingTask;                               // Index of the first task that is not taken
+  Int_t fnStolenTasks;                                   // Number of tasks taken by another worker than they were assigned to
+  std::mutex fMutex;                                     // Protects the shared state
+  std::condition_variable fCondition;                    // Signals freed histogram sets and finished tasks
+
+};
+
+#endif
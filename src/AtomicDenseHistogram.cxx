@@ -0,0 +1,166 @@
+// Dense histogram shared between threads, filled with atomic additions and converted to a THnSparse when written
+
+// Own includes
+#include "AtomicDenseHistogram.h"
+
+/*
+ * THnBase keeps the statistics of the fills in protected members. A derived class may name them, and the member
+ * pointers found that way can be used with any THnBase. The class is never instantiated.
+ */
+class THnStatisticsAccess : public THnBase{
+public:
+  static Double_t THnBase::* SumWeights(){ return &THnStatisticsAccess::fTsumw; }
+  static Double_t THnBase::* SumWeights2(){ return &THnStatisticsAccess::fTsumw2; }
+  static TArrayD THnBase::* SumWeightsX(){ return &THnStatisticsAccess::fTsumwx; }
+  static TArrayD THnBase::* SumWeightsX2(){ return &THnStatisticsAccess::fTsumwx2; }
+};
+
+/*
+ * Custom constructor
+ *
+ *  Arguments:
+ *   const THnSparse* templateHistogram = Histogram from which the binning is copied. Not used after the constructor.
+ */
+AtomicDenseHistogram::AtomicDenseHistogram(const THnSparse* templateHistogram) :
+  fAxes(),
+  fStrides(),
+  fSumWeights(),
+  fSumWeights2(),
+  fnEntries(0),
+  fTotalWeights(0),
+  fTotalWeights2(0),
+  fTotalWeightsX(),
+  fTotalWeightsX2()
+{
+  // Custom constructor
+
+  // The first dimension changes fastest in the bin array. Each axis has also the underflow and overflow bins.
+  Long64_t nBins = 1;
+  for(Int_t iDimension = 0; iDimension < templateHistogram->GetNdimensions(); iDimension++){
+    fAxes.push_back(*templateHistogram->GetAxis(iDimension));
+    fStrides.push_back(nBins);
+    nBins *= fAxes.back().GetNbins() + 2;
+  }
+
+  // Value initialization sets all the sums to zero
+  fSumWeights = std::vector<std::atomic<Double_t>>(nBins);
+  fSumWeights2 = std::vector<std::atomic<Double_t>>(nBins);
+  fTotalWeightsX = std::vector<std::atomic<Double_t>>(fAxes.size());
+  fTotalWeightsX2 = std::vector<std::atomic<Double_t>>(fAxes.size());
+}
+
+/*
+ * Destructor
+ */
+AtomicDenseHistogram::~AtomicDenseHistogram(){
+  // destructor
+}
+
+/*
+ * Add a weighted entry to the bin containing the values. Can be called from several threads at the same time.
+ *
+ *  Arguments:
+ *   const Double_t* values = Value for each dimension of the histogram
+ *   const Double_t weight = Weight of the entry
+ */
+void AtomicDenseHistogram::Fill(const Double_t* values, const Double_t weight){
+  Long64_t bin = 0;
+  for(UInt_t iDimension = 0; iDimension < fAxes.size(); iDimension++){
+    bin += fAxes[iDimension].FindFixBin(values[iDimension]) * fStrides[iDimension];
+    AtomicAdd(fTotalWeightsX[iDimension], weight*values[iDimension]);
+    AtomicAdd(fTotalWeightsX2[iDimension], weight*values[iDimension]*values[iDimension]);
+  }
+  AtomicAdd(fSumWeights[bin], weight);
+  AtomicAdd(fSumWeights2[bin], weight*weight);
+  AtomicAdd(fTotalWeights, weight);
+  AtomicAdd(fTotalWeights2, weight*weight);
+  fnEntries.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+ * Add the contents to a THnSparse with the same binning and clear the bins. Only the filled bins are created in the
+ * THnSparse. Must not be called while the histogram is filled.
+ *
+ * The bin contents and errors are added directly. The totals summed over the fills are added to the statistics of
+ * the THnSparse in the same way as a Fill adds them, which is only done when the THnSparse calculates errors.
+ *
+ *  Arguments:
+ *   THnSparse* histogram = Histogram to which the contents are added. Needs to have the binning of the template histogram.
+ */
+void AtomicDenseHistogram::AddTo(THnSparse* histogram){
+
+  if(histogram->GetNdimensions() != (Int_t)fAxes.size()){
+    cout << "Error! Cannot add a dense histogram with " << fAxes.size() << " dimensions to " << histogram->GetName() << " with " << histogram->GetNdimensions() << " dimensions" << endl;
+    assert(0);
+  }
+
+  const Double_t nEntries = histogram->GetEntries() + fnEntries.exchange(0);
+  std::vector<Int_t> coordinates(fAxes.size());
+  Long64_t sparseBin;
+  for(Long64_t iBin = 0; iBin < GetNBins(); iBin++){
+    if(fSumWeights2[iBin].load(std::memory_order_relaxed) == 0) continue;
+
+    // Find the bin number along each axis from the position in the bin array
+    for(UInt_t iDimension = 0; iDimension < fAxes.size(); iDimension++){
+      coordinates[iDimension] = (iBin / fStrides[iDimension]) % (fAxes[iDimension].GetNbins() + 2);
+    }
+
+    sparseBin = histogram->GetBin(coordinates.data());
+    histogram->AddBinContent(sparseBin, fSumWeights[iBin].load(std::memory_order_relaxed));
+    histogram->AddBinError2(sparseBin, fSumWeights2[iBin].load(std::memory_order_relaxed));
+    fSumWeights[iBin].store(0, std::memory_order_relaxed);
+    fSumWeights2[iBin].store(0, std::memory_order_relaxed);
+  }
+
+  // Add the totals of the fills to the statistics of the THnSparse
+  const Double_t totalWeights = fTotalWeights.exchange(0);
+  const Double_t totalWeights2 = fTotalWeights2.exchange(0);
+  if(histogram->GetCalculateErrors()){
+    histogram->*THnStatisticsAccess::SumWeights() += totalWeights;
+    histogram->*THnStatisticsAccess::SumWeights2() += totalWeights2;
+  }
+  for(UInt_t iDimension = 0; iDimension < fAxes.size(); iDimension++){
+    const Double_t totalWeightsX = fTotalWeightsX[iDimension].exchange(0);
+    const Double_t totalWeightsX2 = fTotalWeightsX2[iDimension].exchange(0);
+    if(!histogram->GetCalculateErrors()) continue;
+    (histogram->*THnStatisticsAccess::SumWeightsX())[iDimension] += totalWeightsX;
+    (histogram->*THnStatisticsAccess::SumWeightsX2())[iDimension] += totalWeightsX2;
+  }
+
+  histogram->SetEntries(nEntries);
+}
+
+// Getter for the number of bins including underflow and overflow
+Long64_t AtomicDenseHistogram::GetNBins() const{
+  return fSumWeights.size();
+}
+
+/*
+ * Number of dense bins needed for a THnSparse, including the underflow and overflow bins. Can be used to check
+ * the memory needed before creating a dense histogram. Each bin takes 16 bytes.
+ *
+ *  Arguments:
+ *   const THnSparse* histogram = Histogram for which the bins are counted
+ *
+ *  return: Number of bins in the dense histogram
+ */
+Long64_t AtomicDenseHistogram::GetNBins(const THnSparse* histogram){
+  Long64_t nBins = 1;
+  for(Int_t iDimension = 0; iDimension < histogram->GetNdimensions(); iDimension++){
+    nBins *= histogram->GetAxis(iDimension)->GetNbins() + 2;
+  }
+  return nBins;
+}
+
+/*
+ * Add a value to an atomic sum. The compare and exchange is repeated until no other thread has changed the sum
+ * between reading it and writing the new value.
+ *
+ *  Arguments:
+ *   std::atomic<Double_t>& sum = Sum to which the value is added
+ *   const Double_t value = Value added to the sum
+ */
+void AtomicDenseHistogram::AtomicAdd(std::atomic<Double_t>& sum, const Double_t value){
+  Double_t oldSum = sum.load(std::memory_order_relaxed);
+  while(!sum.compare_exchange_weak(oldSum, oldSum + value, std::memory_order_relaxed)){}
+}
@@ -0,0 +1,64 @@
+// Dense histogram shared between threads, filled with atomic additions and converted to a THnSparse when written
+
+#ifndef ATOMICDENSEHISTOGRAM_H
+#define ATOMICDENSEHISTOGRAM_H
+
+// C++ includes
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TAxis.h>
+#include <THnSparse.h>
+
+using namespace std;
+
+/*
+ * Histogram with one preallocated array element for each bin of a THnSparse, including the underflow and overflow
+ * bins. The sum of weights and the sum of squared weights in each bin are added with lock-free atomic operations,
+ * so any number of threads can fill the same histogram without copies or locks. The memory use does not grow with
+ * the number of threads, but the dense arrays are only practical for histograms with a moderate number of bins.
+ *
+ * Next to the bins, the totals of the weights, squared weights, and weight times value and squared value along each
+ * axis are summed over all the fills, such that the statistics of the THnSparse are the same as if it was filled
+ * directly. The additions from different threads happen in an arbitrary order, so the rounding of the sums can differ
+ * between runs in the last digits.
+ */
+class AtomicDenseHistogram{
+
+public:
+
+  // Constructors and destructor
+  AtomicDenseHistogram(const THnSparse* templateHistogram);             // Custom constructor
+  AtomicDenseHistogram(const AtomicDenseHistogram& in) = delete;        // The bins are shared between threads and cannot be copied
+  ~AtomicDenseHistogram();                                              // Destructor
+  AtomicDenseHistogram& operator=(const AtomicDenseHistogram& obj) = delete; // The bins are shared between threads and cannot be copied
+
+  // Methods
+  void Fill(const Double_t* values, const Double_t weight);  // Add a weighted entry to the bin containing the values
+  void AddTo(THnSparse* histogram);                          // Add the contents to a THnSparse with the same binning and clear the bins
+  Long64_t GetNBins() const;                                 // Getter for the number of bins including underflow and overflow
+
+  // Static helper methods
+  static Long64_t GetNBins(const THnSparse* histogram);      // Number of dense bins needed for a THnSparse
+
+private:
+
+  void AtomicAdd(std::atomic<Double_t>& sum, const Double_t value); // Add a value to an atomic sum
+
+  std::vector<TAxis> fAxes;                        // Binning of each dimension, copied from the template histogram
+  std::vector<Long64_t> fStrides;                  // Distance in the bin array between consecutive bins of each dimension
+  std::vector<std::atomic<Double_t>> fSumWeights;  // Sum of weights in each bin
+  std::vector<std::atomic<Double_t>> fSumWeights2; // Sum of squared weights in each bin
+  std::atomic<Long64_t> fnEntries;                 // Number of fills
+  std::atomic<Double_t> fTotalWeights;             // Sum of weights over all fills
+  std::atomic<Double_t> fTotalWeights2;            // Sum of squared weights over all fills
+  std::vector<std::atomic<Double_t>> fTotalWeightsX;  // Sum of weight times value for each dimension over all fills
+  std::vector<std::atomic<Double_t>> fTotalWeightsX2; // Sum of weight times squared value for each dimension over all fills
+
+};
+
+#endif
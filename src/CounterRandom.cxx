@@ -0,0 +1,180 @@
+// Counter-based random number generator giving the same random numbers for an object regardless of the processing order
+
+// Own includes
+#include "CounterRandom.h"
+
+/*
+ * Default constructor
+ */
+CounterRandom::CounterRandom() :
+  fSeed(0)
+{
+  // Default constructor
+}
+
+/*
+ * Custom constructor
+ *
+ *  Arguments:
+ *   const ULong64_t seed = Global seed
+ */
+CounterRandom::CounterRandom(const ULong64_t seed) :
+  fSeed(seed)
+{
+  // Custom constructor
+}
+
+/*
+ * Copy constructor
+ */
+CounterRandom::CounterRandom(const CounterRandom& in) :
+  fSeed(in.fSeed)
+{
+  // Copy constructor
+}
+
+/*
+ * Destructor
+ */
+CounterRandom::~CounterRandom(){
+  // destructor
+}
+
+/*
+ * Assignment operator
+ */
+CounterRandom& CounterRandom::operator=(const CounterRandom& in){
+  // Assignment operator
+
+  if (&in==this) return *this;
+
+  fSeed = in.fSeed;
+
+  return *this;
+}
+
+// Setter for the global seed
+void CounterRandom::SetSeed(const ULong64_t seed){
+  fSeed = seed;
+}
+
+// Getter for the global seed
+ULong64_t CounterRandom::GetSeed() const{
+  return fSeed;
+}
+
+/*
+ * Uniform random number for an object
+ *
+ *  Arguments:
+ *   const ULong64_t fileId = Identifier of the input file from GetFileId
+ *   const Long64_t entry = Entry of the event in the file
+ *   const Int_t jetIndex = Index of the jet in the event
+ *   const Int_t stream = Purpose of the random number, from enumRandomStream
+ *
+ *  return: Random number in (0,1]
+ */
+Double_t CounterRandom::Uniform(const ULong64_t fileId, const Long64_t entry, const Int_t jetIndex, const Int_t stream) const{
+  UInt_t output[4];
+  Philox(fileId, entry, jetIndex, stream, output);
+  return ToUnitInterval(output[0], output[1]);
+}
+
+/*
+ * Gaussian random number for an object. Both uniform numbers needed by the Box-Muller transformation come from the
+ * same counter, so each object gets exactly one number from each stream.
+ *
+ *  Arguments:
+ *   const Double_t mean = Mean of the Gaussian distribution
+ *   const Double_t sigma = Width of the Gaussian distribution
+ *   const ULong64_t fileId = Identifier of the input file from GetFileId
+ *   const Long64_t entry = Entry of the event in the file
+ *   const Int_t jetIndex = Index of the jet in the event
+ *   const Int_t stream = Purpose of the random number, from enumRandomStream
+ *
+ *  return: Gaussian random number
+ */
+Double_t CounterRandom::Gaus(const Double_t mean, const Double_t sigma, const ULong64_t fileId, const Long64_t entry, const Int_t jetIndex, const Int_t stream) const{
+  UInt_t output[4];
+  Philox(fileId, entry, jetIndex, stream, output);
+  const Double_t radius = TMath::Sqrt(-2 * TMath::Log(ToUnitInterval(output[0], output[1])));
+  const Double_t angle = TMath::TwoPi() * ToUnitInterval(output[2], output[3]);
+  return mean + sigma * radius * TMath::Cos(angle);
+}
+
+/*
+ * Compute four random 32-bit words with ten rounds of the Philox4x32 function. The counter is made of the file
+ * identifier, the entry, the jet index and the stream, and the key is the global seed.
+ *
+ *  Arguments:
+ *   const ULong64_t fileId = Identifier of the input file from GetFileId
+ *   const Long64_t entry = Entry of the event in the file
+ *   const Int_t jetIndex = Index of the jet in the event
+ *   const Int_t stream = Purpose of the random number, from enumRandomStream
+ *   UInt_t* output = Array of four words to which the random bits are written
+ */
+void CounterRandom::Philox(const ULong64_t fileId, const Long64_t entry, const Int_t jetIndex, const Int_t stream, UInt_t* output) const{
+
+  // Multipliers and Weyl sequence constants of Philox4x32
+  const ULong64_t multiplier0 = 0xD2511F53;
+  const ULong64_t multiplier1 = 0xCD9E8D57;
+  const UInt_t keyIncrement0 = 0x9E3779B9;
+  const UInt_t keyIncrement1 = 0xBB67AE85;
+
+  // Entries in a file fit to 32 bits and jets in an event to 16 bits, which leaves 16 bits for the stream
+  output[0] = (UInt_t)entry;
+  output[1] = ((UInt_t)jetIndex & 0xFFFF) | ((UInt_t)stream << 16);
+  output[2] = (UInt_t)fileId;
+  output[3] = (UInt_t)(fileId >> 32);
+
+  UInt_t key0 = (UInt_t)fSeed;
+  UInt_t key1 = (UInt_t)(fSeed >> 32);
+  ULong64_t product0, product1;
+  UInt_t word0, word2;
+
+  for(Int_t iRound = 0; iRound < 10; iRound++){
+    product0 = multiplier0 * output[0];
+    product1 = multiplier1 * output[2];
+    word0 = (UInt_t)(product1 >> 32) ^ output[1] ^ key0;
+    word2 = (UInt_t)(product0 >> 32) ^ output[3] ^ key1;
+    output[1] = (UInt_t)product1;
+    output[3] = (UInt_t)product0;
+    output[0] = word0;
+    output[2] = word2;
+    key0 += keyIncrement0;
+    key1 += keyIncrement1;
+  }
+}
+
+/*
+ * Convert 64 random bits to a double precision number in (0,1]. Zero is excluded so that the logarithm in the
+ * Box-Muller transformation is always finite.
+ *
+ *  Arguments:
+ *   const UInt_t highBits = Upper 32 random bits
+ *   const UInt_t lowBits = Lower 32 random bits
+ *
+ *  return: Random number in (0,1]
+ */
+Double_t CounterRandom::ToUnitInterval(const UInt_t highBits, const UInt_t lowBits){
+  const ULong64_t randomBits = ((ULong64_t)highBits << 32) | lowBits;
+  return ((randomBits >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Identifier for a file computed from its name with the 64-bit FNV-1a hash. Give the name without the redirector,
+ * such that the identifier does not depend on from where the file is read.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the file
+ *
+ *  return: Identifier of the file
+ */
+ULong64_t CounterRandom::GetFileId(const TString fileName){
+  ULong64_t hash = 0xCBF29CE484222325ULL;
+  for(Ssiz_t iCharacter = 0; iCharacter < fileName.Length(); iCharacter++){
+    hash ^= (UChar_t)fileName[iCharacter];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
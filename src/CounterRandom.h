@@ -0,0 +1,53 @@
+// Counter-based random number generator giving the same random numbers for an object regardless of the processing order
+
+#ifndef COUNTERRANDOM_H
+#define COUNTERRANDOM_H
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TMath.h>
+
+using namespace std;
+
+/*
+ * Random numbers computed from a key and a counter with the Philox4x32-10 function (Salmon et al., "Parallel random
+ * numbers: as easy as 1, 2, 3", SC11). The key is the global seed and the counter identifies the object for which
+ * the number is drawn: the input file, the entry in the file, the jet in the event and the purpose of the number.
+ * There is no state that changes when numbers are drawn, so the same jet always gets the same random number, no
+ * matter how many threads, tasks or jobs the analysis is split into or in which order the events are analyzed.
+ * The generator can be used from any number of threads at the same time.
+ */
+class CounterRandom{
+
+public:
+
+  // Independent random streams for the different uses in the analysis
+  enum enumRandomStream{kJetSmearing, kClosureJetSmearing, knRandomStreams};
+
+  // Constructors and destructor
+  CounterRandom();                                    // Default constructor
+  CounterRandom(const ULong64_t seed);                // Custom constructor
+  CounterRandom(const CounterRandom& in);             // Copy constructor
+  ~CounterRandom();                                   // Destructor
+  CounterRandom& operator=(const CounterRandom& obj); // Equal sign operator
+
+  // Methods
+  void SetSeed(const ULong64_t seed);     // Setter for the global seed
+  ULong64_t GetSeed() const;              // Getter for the global seed
+  Double_t Uniform(const ULong64_t fileId, const Long64_t entry, const Int_t jetIndex, const Int_t stream) const; // Uniform random number in (0,1]
+  Double_t Gaus(const Double_t mean, const Double_t sigma, const ULong64_t fileId, const Long64_t entry, const Int_t jetIndex, const Int_t stream) const; // Gaussian random number
+
+  // Static helper methods
+  static ULong64_t GetFileId(const TString fileName); // Identifier for a file computed from its name
+
+private:
+
+  void Philox(const ULong64_t fileId, const Long64_t entry, const Int_t jetIndex, const Int_t stream, UInt_t* output) const; // Compute four random 32-bit words for a counter
+  static Double_t ToUnitInterval(const UInt_t highBits, const UInt_t lowBits); // Convert 64 random bits to a number in (0,1]
+
+  ULong64_t fSeed;   // Global seed used as the key of the generator
+
+};
+
+#endif
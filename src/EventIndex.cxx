@@ -0,0 +1,366 @@
+// Index of the event information in one forest file, stored in a sidecar file next to the analysis
+
+// Own includes
+#include "EventIndex.h"
+
+/*
+ * Default constructor
+ */
+EventIndex::EventIndex() :
+  fVz(),
+  fCentrality(),
+  fHiBin(),
+  fPtHat(),
+  fEventWeight(),
+  fPrimaryVertexFilterBit(),
+  fHfCoincidenceFilterBit(),
+  fClusterCompatibilityFilterBit(),
+  fVzWeight(),
+  fCentralityWeight(),
+  fSourceFile(""),
+  fSourceUUID("")
+{
+  // Default constructor
+}
+
+/*
+ * Copy constructor
+ */
+EventIndex::EventIndex(const EventIndex& in) :
+  fVz(in.fVz),
+  fCentrality(in.fCentrality),
+  fHiBin(in.fHiBin),
+  fPtHat(in.fPtHat),
+  fEventWeight(in.fEventWeight),
+  fPrimaryVertexFilterBit(in.fPrimaryVertexFilterBit),
+  fHfCoincidenceFilterBit(in.fHfCoincidenceFilterBit),
+  fClusterCompatibilityFilterBit(in.fClusterCompatibilityFilterBit),
+  fVzWeight(in.fVzWeight),
+  fCentralityWeight(in.fCentralityWeight),
+  fSourceFile(in.fSourceFile),
+  fSourceUUID(in.fSourceUUID)
+{
+  // Copy constructor
+}
+
+/*
+ * Destructor
+ */
+EventIndex::~EventIndex(){
+  // destructor
+}
+
+/*
+ * Assignment operator
+ */
+EventIndex& EventIndex::operator=(const EventIndex& in){
+  // Assignment operator
+
+  if (&in==this) return *this;
+
+  fVz = in.fVz;
+  fCentrality = in.fCentrality;
+  fHiBin = in.fHiBin;
+  fPtHat = in.fPtHat;
+  fEventWeight = in.fEventWeight;
+  fPrimaryVertexFilterBit = in.fPrimaryVertexFilterBit;
+  fHfCoincidenceFilterBit = in.fHfCoincidenceFilterBit;
+  fClusterCompatibilityFilterBit = in.fClusterCompatibilityFilterBit;
+  fVzWeight = in.fVzWeight;
+  fCentralityWeight = in.fCentralityWeight;
+  fSourceFile = in.fSourceFile;
+  fSourceUUID = in.fSourceUUID;
+
+  return *this;
+}
+
+/*
+ * Remove all the entries from the index
+ */
+void EventIndex::Clear(){
+  fVz.clear();
+  fCentrality.clear();
+  fHiBin.clear();
+  fPtHat.clear();
+  fEventWeight.clear();
+  fPrimaryVertexFilterBit.clear();
+  fHfCoincidenceFilterBit.clear();
+  fClusterCompatibilityFilterBit.clear();
+  fVzWeight.clear();
+  fCentralityWeight.clear();
+  fSourceFile = "";
+  fSourceUUID = "";
+}
+
+/*
+ * Set the forest file described by the index. The redirector is removed from the name, such that the same
+ * index can be used when the file is read through a different xrootd redirector.
+ *
+ *  Arguments:
+ *   const TString sourceFile = Name of the forest file
+ *   const TString sourceUUID = UUID of the forest file
+ */
+void EventIndex::SetSourceFile(const TString sourceFile, const TString sourceUUID){
+  fSourceFile = GetLogicalFileName(sourceFile);
+  fSourceUUID = sourceUUID;
+}
+
+/*
+ * Add the event information from an event view as the next entry in the index
+ *
+ *  Arguments:
+ *   const EventView* eventView = Event view containing the event information of the next entry
+ */
+void EventIndex::AddEvent(const EventView* eventView){
+  fVz.push_back(eventView->fVz);
+  fCentrality.push_back(eventView->fCentrality);
+  fHiBin.push_back(eventView->fHiBin);
+  fPtHat.push_back(eventView->fPtHat);
+  fEventWeight.push_back(eventView->fEventWeight);
+  fPrimaryVertexFilterBit.push_back(eventView->fPrimaryVertexFilterBit);
+  fHfCoincidenceFilterBit.push_back(eventView->fHfCoincidenceFilterBit);
+  fClusterCompatibilityFilterBit.push_back(eventView->fClusterCompatibilityFilterBit);
+  fVzWeight.push_back(eventView->fVzWeight);
+  fCentralityWeight.push_back(eventView->fCentralityWeight);
+}
+
+// Getter for the number of entries in the index
+Long64_t EventIndex::GetNEntries() const{
+  return fVz.size();
+}
+
+// Getter for the logical name of the forest file described by the index
+TString EventIndex::GetSourceFile() const{
+  return fSourceFile;
+}
+
+// Getter for the UUID of the forest file described by the index
+TString EventIndex::GetSourceUUID() const{
+  return fSourceUUID;
+}
+
+/*
+ * Check that the index describes the given forest file. If the forest file has been reprocessed such that the UUID
+ * or the number of entries has changed, the index is stale and should not be used.
+ *
+ *  Arguments:
+ *   const TString sourceFile = Name of the forest file
+ *   const TString sourceUUID = UUID of the forest file
+ *   const Long64_t nEntries = Number of entries in the forest file
+ *
+ *  return: True if the index can be used for the given file, false otherwise
+ */
+Bool_t EventIndex::Matches(const TString sourceFile, const TString sourceUUID, const Long64_t nEntries) const{
+  if(fSourceFile != GetLogicalFileName(sourceFile)) return false;
+  if(fSourceUUID != sourceUUID) return false;
+  return GetNEntries() == nEntries;
+}
+
+/*
+ * Copy the event information for one entry to an event view
+ *
+ *  Arguments:
+ *   const Long64_t entry = Entry in the forest file
+ *   EventView* eventView = Event view to which the information is copied
+ */
+void EventIndex::FillEventInformation(const Long64_t entry, EventView* eventView) const{
+  eventView->fVz = fVz[entry];
+  eventView->fCentrality = fCentrality[entry];
+  eventView->fHiBin = fHiBin[entry];
+  eventView->fPtHat = fPtHat[entry];
+  eventView->fEventWeight = fEventWeight[entry];
+  eventView->fPrimaryVertexFilterBit = fPrimaryVertexFilterBit[entry];
+  eventView->fHfCoincidenceFilterBit = fHfCoincidenceFilterBit[entry];
+  eventView->fClusterCompatibilityFilterBit = fClusterCompatibilityFilterBit[entry];
+  eventView->fVzWeight = fVzWeight[entry];
+  eventView->fCentralityWeight = fCentralityWeight[entry];
+}
+
+/*
+ * Find the entries for which pT hat is inside the given range. Only these entries need to be visited in the analysis.
+ *
+ *  Arguments:
+ *   const Double_t minimumPtHat = Minimum accepted pT hat
+ *   const Double_t maximumPtHat = Maximum accepted pT hat. The range is open from this side
+ *
+ *  return: Entries inside the pT hat range in increasing order
+ */
+std::vector<Long64_t> EventIndex::GetEntriesInPtHatRange(const Double_t minimumPtHat, const Double_t maximumPtHat) const{
+  std::vector<Long64_t> selectedEntries;
+  for(Long64_t iEntry = 0; iEntry < GetNEntries(); iEntry++){
+    if(fPtHat[iEntry] < minimumPtHat || fPtHat[iEntry] >= maximumPtHat) continue;
+    selectedEntries.push_back(iEntry);
+  }
+  return selectedEntries;
+}
+
+/*
+ * Write the index to a sidecar file. The arrays are written to a tree with one entry for each forest entry. The entry
+ * number in the forest file is written as well, such that the index tree can be used as a friend of a chain of
+ * forest files to find the entry of each event in its own file.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the sidecar file
+ */
+void EventIndex::Write(const TString fileName) const{
+
+  TFile* indexFile = TFile::Open(fileName, "RECREATE");
+  if(!indexFile || indexFile->IsZombie()){
+    cout << "Error! Could not create the event index file: " << fileName.Data() << endl;
+    assert(0);
+  }
+
+  // Variables connected to the tree branches
+  Float_t vz, centrality, ptHat, eventWeight, vzWeight, centralityWeight;
+  Int_t entry, hiBin;
+  UChar_t primaryVertexFilterBit, hfCoincidenceFilterBit, clusterCompatibilityFilterBit;
+
+  TTree* indexTree = new TTree("eventIndex", "eventIndex");
+  indexTree->Branch("entry", &entry, "entry/I");
+  indexTree->Branch("vz", &vz, "vz/F");
+  indexTree->Branch("centrality", &centrality, "centrality/F");
+  indexTree->Branch("hiBin", &hiBin, "hiBin/I");
+  indexTree->Branch("ptHat", &ptHat, "ptHat/F");
+  indexTree->Branch("eventWeight", &eventWeight, "eventWeight/F");
+  indexTree->Branch("primaryVertexFilterBit", &primaryVertexFilterBit, "primaryVertexFilterBit/b");
+  indexTree->Branch("hfCoincidenceFilterBit", &hfCoincidenceFilterBit, "hfCoincidenceFilterBit/b");
+  indexTree->Branch("clusterCompatibilityFilterBit", &clusterCompatibilityFilterBit, "clusterCompatibilityFilterBit/b");
+  indexTree->Branch("vzWeight", &vzWeight, "vzWeight/F");
+  indexTree->Branch("centralityWeight", &centralityWeight, "centralityWeight/F");
+
+  for(Long64_t iEntry = 0; iEntry < GetNEntries(); iEntry++){
+    entry = iEntry;
+    vz = fVz[iEntry];
+    centrality = fCentrality[iEntry];
+    hiBin = fHiBin[iEntry];
+    ptHat = fPtHat[iEntry];
+    eventWeight = fEventWeight[iEntry];
+    primaryVertexFilterBit = fPrimaryVertexFilterBit[iEntry];
+    hfCoincidenceFilterBit = fHfCoincidenceFilterBit[iEntry];
+    clusterCompatibilityFilterBit = fClusterCompatibilityFilterBit[iEntry];
+    vzWeight = fVzWeight[iEntry];
+    centralityWeight = fCentralityWeight[iEntry];
+    indexTree->Fill();
+  }
+
+  // The name and UUID of the forest file are stored next to the tree to detect stale indices
+  TNamed sourceFile("sourceFile", fSourceFile.Data());
+  TNamed sourceUUID("sourceUUID", fSourceUUID.Data());
+  indexTree->Write();
+  sourceFile.Write();
+  sourceUUID.Write();
+
+  indexFile->Close();
+  delete indexFile;
+}
+
+/*
+ * Read the index from a sidecar file
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the sidecar file
+ *
+ *  return: True if the index was read, false if the file does not exist or does not contain an index with entry numbers
+ */
+Bool_t EventIndex::Read(const TString fileName){
+
+  Clear();
+
+  // A missing index is not an error. The analysis reads the event information from the forest in that case.
+  if(gSystem->AccessPathName(fileName)) return false;
+
+  TFile* indexFile = TFile::Open(fileName);
+  if(!indexFile || indexFile->IsZombie()){
+    if(indexFile) delete indexFile;
+    return false;
+  }
+
+  TTree* indexTree = (TTree*) indexFile->Get("eventIndex");
+  TNamed* sourceFile = (TNamed*) indexFile->Get("sourceFile");
+  TNamed* sourceUUID = (TNamed*) indexFile->Get("sourceUUID");
+  if(!indexTree || !sourceFile || !sourceUUID || !indexTree->GetBranch("entry")){
+    indexFile->Close();
+    delete indexFile;
+    return false;
+  }
+
+  // Variables connected to the tree branches
+  Float_t vz, centrality, ptHat, eventWeight, vzWeight, centralityWeight;
+  Int_t entry, hiBin;
+  UChar_t primaryVertexFilterBit, hfCoincidenceFilterBit, clusterCompatibilityFilterBit;
+
+  indexTree->SetBranchAddress("entry", &entry);
+  indexTree->SetBranchAddress("vz", &vz);
+  indexTree->SetBranchAddress("centrality", &centrality);
+  indexTree->SetBranchAddress("hiBin", &hiBin);
+  indexTree->SetBranchAddress("ptHat", &ptHat);
+  indexTree->SetBranchAddress("eventWeight", &eventWeight);
+  indexTree->SetBranchAddress("primaryVertexFilterBit", &primaryVertexFilterBit);
+  indexTree->SetBranchAddress("hfCoincidenceFilterBit", &hfCoincidenceFilterBit);
+  indexTree->SetBranchAddress("clusterCompatibilityFilterBit", &clusterCompatibilityFilterBit);
+  indexTree->SetBranchAddress("vzWeight", &vzWeight);
+  indexTree->SetBranchAddress("centralityWeight", &centralityWeight);
+
+  // The entry numbers must follow the order of the tree, otherwise the index is not usable as a friend of the forest
+  const Long64_t nEntries = indexTree->GetEntries();
+  for(Long64_t iEntry = 0; iEntry < nEntries; iEntry++){
+    indexTree->GetEntry(iEntry);
+    if(entry != iEntry){
+      cout << "Warning! The entry numbers in the event index " << fileName.Data() << " are not in order. The index is not used." << endl;
+      indexFile->Close();
+      delete indexFile;
+      Clear();
+      return false;
+    }
+    fVz.push_back(vz);
+    fCentrality.push_back(centrality);
+    fHiBin.push_back(hiBin);
+    fPtHat.push_back(ptHat);
+    fEventWeight.push_back(eventWeight);
+    fPrimaryVertexFilterBit.push_back(primaryVertexFilterBit);
+    fHfCoincidenceFilterBit.push_back(hfCoincidenceFilterBit);
+    fClusterCompatibilityFilterBit.push_back(clusterCompatibilityFilterBit);
+    fVzWeight.push_back(vzWeight);
+    fCentralityWeight.push_back(centralityWeight);
+  }
+  fSourceFile = sourceFile->GetTitle();
+  fSourceUUID = sourceUUID->GetTitle();
+
+  indexFile->Close();
+  delete indexFile;
+  return true;
+}
+
+/*
+ * Remove the xrootd redirector from a file name. For example root://cmsxrootd.fnal.gov//store/file.root -> /store/file.root
+ *
+ *  Arguments:
+ *   const TString fileName = File name, possibly including a redirector
+ *
+ *  return: File name without the redirector
+ */
+TString EventIndex::GetLogicalFileName(const TString fileName){
+  if(!fileName.BeginsWith("root://")) return fileName;
+  Ssiz_t pathStart = fileName.Index("/", 7);
+  if(pathStart < 0) return fileName;
+  TString logicalFileName = fileName(pathStart, fileName.Length()-pathStart);
+  while(logicalFileName.BeginsWith("//")) logicalFileName.Remove(0,1);
+  return logicalFileName;
+}
+
+/*
+ * Name of the sidecar file for a forest file. Forest files in different datasets often share the same base name,
+ * so a hash of the logical file name is added to make the name unique.
+ *
+ *  Arguments:
+ *   const TString directory = Directory where the index files are kept
+ *   const TString sourceFile = Name of the forest file
+ *
+ *  return: Name of the index file
+ */
+TString EventIndex::GetIndexFileName(const TString directory, const TString sourceFile){
+  TString logicalFileName = GetLogicalFileName(sourceFile);
+  TString baseName = gSystem->BaseName(logicalFileName);
+  baseName.ReplaceAll(".root", "");
+  return Form("%s/%s_%08x_eventIndex.root", directory.Data(), baseName.Data(), logicalFileName.Hash());
+}
@@ -0,0 +1,82 @@
+// Index of the event information in one forest file, stored in a sidecar file next to the analysis
+
+#ifndef EVENTINDEX_H
+#define EVENTINDEX_H
+
+// C++ includes
+#include <iostream>
+#include <vector>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TNamed.h>
+#include <TSystem.h>
+
+// Own includes
+#include "EventView.h"
+
+using namespace std;
+
+/*
+ * Event information for all the entries in one forest file stored as separate arrays for each quantity.
+ *
+ * The index is built once with a pass over the heavy ion and skim trees, and written to a small sidecar file.
+ * In later runs the event information, the event selection and the vz and centrality weights are taken from the
+ * index, such that the event information branches do not need to be read, and the entries outside of the pT hat
+ * range are never touched. The index depends on the weight functions in the analyzer, so it needs to be rebuilt
+ * if these are changed. The cut values are not stored, they are applied when the index is used. The UUID of the forest
+ * file is stored with the index, such that a forest file that is produced again with the same name is not matched.
+ * The sidecar tree also has the entry number of each event in the forest file, which the RDataFrame analysis reads
+ * by adding the index tree as a friend of the forest trees.
+ */
+class EventIndex{
+
+public:
+
+  // Constructors and destructor
+  EventIndex();                                 // Default constructor
+  EventIndex(const EventIndex& in);             // Copy constructor
+  ~EventIndex();                                // Destructor
+  EventIndex& operator=(const EventIndex& obj); // Equal sign operator
+
+  // Methods
+  void Clear();                                       // Remove all the entries from the index
+  void SetSourceFile(const TString sourceFile, const TString sourceUUID); // Set the forest file described by the index
+  void AddEvent(const EventView* eventView);          // Add the event information from an event view as the next entry in the index
+  Long64_t GetNEntries() const;                       // Getter for the number of entries in the index
+  TString GetSourceFile() const;                      // Getter for the logical name of the forest file described by the index
+  TString GetSourceUUID() const;                      // Getter for the UUID of the forest file described by the index
+  Bool_t Matches(const TString sourceFile, const TString sourceUUID, const Long64_t nEntries) const; // Check that the index describes the given forest file
+  void FillEventInformation(const Long64_t entry, EventView* eventView) const; // Copy the event information for one entry to an event view
+  std::vector<Long64_t> GetEntriesInPtHatRange(const Double_t minimumPtHat, const Double_t maximumPtHat) const; // Find the entries inside the pT hat range
+  void Write(const TString fileName) const;           // Write the index to a sidecar file
+  Bool_t Read(const TString fileName);                // Read the index from a sidecar file
+
+  // Static helper methods
+  static TString GetLogicalFileName(const TString fileName);                          // Remove the xrootd redirector from a file name
+  static TString GetIndexFileName(const TString directory, const TString sourceFile); // Name of the sidecar file for a forest file
+
+  // Event information. Each array has one element for each entry in the forest file
+  std::vector<Float_t> fVz;                            // Vertex z-position
+  std::vector<Float_t> fCentrality;                    // Centrality in percent
+  std::vector<Int_t> fHiBin;                           // CMS hiBin
+  std::vector<Float_t> fPtHat;                         // pT hat
+  std::vector<Float_t> fEventWeight;                   // pT hat weight from the forest
+  std::vector<UChar_t> fPrimaryVertexFilterBit;        // Filter bit for primary vertex
+  std::vector<UChar_t> fHfCoincidenceFilterBit;        // Filter bit for energy recorded in HF calorimeter towers
+  std::vector<UChar_t> fClusterCompatibilityFilterBit; // Filter bit for cluster compatibility
+  std::vector<Float_t> fVzWeight;                      // Precomputed vz weight
+  std::vector<Float_t> fCentralityWeight;              // Precomputed centrality weight
+
+private:
+
+  TString fSourceFile;  // Logical name of the forest file described by the index
+  TString fSourceUUID;  // UUID of the forest file described by the index
+
+};
+
+#endif
@@ -0,0 +1,348 @@
+// Event plane Q-vectors for all the entries in one forest file, stored in a sidecar file next to the analysis
+
+// Own includes
+#include "EventPlaneCache.h"
+
+/*
+ * Default constructor
+ */
+EventPlaneCache::EventPlaneCache() :
+  fnOrders(0),
+  fMultiplicity(),
+  fQx(),
+  fQy(),
+  fAngle(),
+  fSourceFile(""),
+  fSourceUUID(""),
+  fParticleSelection("")
+{
+  // Default constructor
+}
+
+/*
+ * Copy constructor
+ */
+EventPlaneCache::EventPlaneCache(const EventPlaneCache& in) :
+  fnOrders(in.fnOrders),
+  fMultiplicity(in.fMultiplicity),
+  fQx(in.fQx),
+  fQy(in.fQy),
+  fAngle(in.fAngle),
+  fSourceFile(in.fSourceFile),
+  fSourceUUID(in.fSourceUUID),
+  fParticleSelection(in.fParticleSelection)
+{
+  // Copy constructor
+}
+
+/*
+ * Destructor
+ */
+EventPlaneCache::~EventPlaneCache(){
+  // destructor
+}
+
+/*
+ * Assignment operator
+ */
+EventPlaneCache& EventPlaneCache::operator=(const EventPlaneCache& in){
+  // Assignment operator
+
+  if (&in==this) return *this;
+
+  fnOrders = in.fnOrders;
+  fMultiplicity = in.fMultiplicity;
+  fQx = in.fQx;
+  fQy = in.fQy;
+  fAngle = in.fAngle;
+  fSourceFile = in.fSourceFile;
+  fSourceUUID = in.fSourceUUID;
+  fParticleSelection = in.fParticleSelection;
+
+  return *this;
+}
+
+/*
+ * Prepare an empty cache for a forest file. The entries are filled with SetEvent in any order.
+ *
+ *  Arguments:
+ *   const TString sourceFile = Name of the forest file
+ *   const TString sourceUUID = UUID of the forest file
+ *   const Long64_t nEntries = Number of entries in the forest file
+ *   const Double_t maxParticleEta = Maximum particle |eta| used for the event plane
+ *   const Double_t maxParticlePt = Maximum particle pT used for the event plane
+ *   const Int_t nOrders = Number of event plane orders, starting from the second
+ */
+void EventPlaneCache::Reset(const TString sourceFile, const TString sourceUUID, const Long64_t nEntries, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders){
+  fnOrders = nOrders;
+  fMultiplicity.assign(nEntries, 0);
+  fQx.assign(nOrders, std::vector<Double_t>(nEntries, 0));
+  fQy.assign(nOrders, std::vector<Double_t>(nEntries, 0));
+  fAngle.assign(nOrders, std::vector<Float_t>(nEntries, 0));
+  fSourceFile = EventIndex::GetLogicalFileName(sourceFile);
+  fSourceUUID = sourceUUID;
+  fParticleSelection = GetParticleSelection(maxParticleEta, maxParticlePt, nOrders);
+}
+
+/*
+ * Store the Q-vectors of an event view as the given entry
+ *
+ *  Arguments:
+ *   const Long64_t entry = Entry in the forest file
+ *   const EventView* eventView = Event view with the Q-vectors filled
+ */
+void EventPlaneCache::SetEvent(const Long64_t entry, const EventView* eventView){
+  fMultiplicity[entry] = eventView->fEventPlaneMultiplicity;
+  for(Int_t iOrder = 0; iOrder < fnOrders; iOrder++){
+    fQx[iOrder][entry] = eventView->fEventPlaneQx[iOrder];
+    fQy[iOrder][entry] = eventView->fEventPlaneQy[iOrder];
+    fAngle[iOrder][entry] = (1.0/(iOrder+2.0)) * TMath::ATan2(eventView->fEventPlaneQy[iOrder], eventView->fEventPlaneQx[iOrder]);
+  }
+}
+
+/*
+ * Copy the Q-vectors of one entry to an event view
+ *
+ *  Arguments:
+ *   const Long64_t entry = Entry in the forest file
+ *   EventView* eventView = Event view to which the Q-vectors are copied
+ */
+void EventPlaneCache::FillEventPlane(const Long64_t entry, EventView* eventView) const{
+  eventView->fHasEventPlane = true;
+  eventView->fEventPlaneMultiplicity = fMultiplicity[entry];
+  eventView->fEventPlaneQx.resize(fnOrders);
+  eventView->fEventPlaneQy.resize(fnOrders);
+  for(Int_t iOrder = 0; iOrder < fnOrders; iOrder++){
+    eventView->fEventPlaneQx[iOrder] = fQx[iOrder][entry];
+    eventView->fEventPlaneQy[iOrder] = fQy[iOrder][entry];
+  }
+}
+
+// Getter for the number of entries in the cache
+Long64_t EventPlaneCache::GetNEntries() const{
+  return fMultiplicity.size();
+}
+
+// Getter for the number of event plane orders in the cache
+Int_t EventPlaneCache::GetNOrders() const{
+  return fnOrders;
+}
+
+/*
+ * Check that the cache was made from the given forest file with the given particle selection and number of orders
+ *
+ *  Arguments:
+ *   const TString sourceFile = Name of the forest file
+ *   const Double_t maxParticleEta = Maximum particle |eta| used for the event plane
+ *   const Double_t maxParticlePt = Maximum particle pT used for the event plane
+ *   const Int_t nOrders = Number of event plane orders, starting from the second
+ *
+ *  return: True if the file and particle selection match, false otherwise
+ */
+Bool_t EventPlaneCache::MatchesSelection(const TString sourceFile, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders) const{
+  if(fSourceFile != EventIndex::GetLogicalFileName(sourceFile)) return false;
+  return fParticleSelection == GetParticleSelection(maxParticleEta, maxParticlePt, nOrders);
+}
+
+/*
+ * Check that the cache can be used for a forest file. In addition to the file and particle selection, the UUID
+ * and the number of entries must match, otherwise the forest file has been reprocessed after the cache was made.
+ *
+ *  Arguments:
+ *   const TString sourceFile = Name of the forest file
+ *   const TString sourceUUID = UUID of the forest file
+ *   const Long64_t nEntries = Number of entries in the forest file
+ *   const Double_t maxParticleEta = Maximum particle |eta| used for the event plane
+ *   const Double_t maxParticlePt = Maximum particle pT used for the event plane
+ *   const Int_t nOrders = Number of event plane orders, starting from the second
+ *
+ *  return: True if the cache can be used for the given file, false otherwise
+ */
+Bool_t EventPlaneCache::Matches(const TString sourceFile, const TString sourceUUID, const Long64_t nEntries, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders) const{
+  if(!MatchesSelection(sourceFile, maxParticleEta, maxParticlePt, nOrders)) return false;
+  if(fSourceUUID != sourceUUID) return false;
+  if(fnOrders != nOrders) return false;
+  return GetNEntries() == nEntries;
+}
+
+/*
+ * Write the cache to a sidecar file. The Q-vectors are written to a tree with one entry for each forest entry, with
+ * one array element for each event plane order.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the sidecar file
+ */
+void EventPlaneCache::Write(const TString fileName) const{
+
+  TFile* cacheFile = TFile::Open(fileName, "RECREATE");
+  if(!cacheFile || cacheFile->IsZombie()){
+    cout << "Error! Could not create the event plane cache file: " << fileName.Data() << endl;
+    assert(0);
+  }
+
+  // Variables connected to the tree branches
+  Int_t multiplicity;
+  std::vector<Double_t> qx(fnOrders), qy(fnOrders);
+  std::vector<Float_t> angle(fnOrders);
+
+  TTree* cacheTree = new TTree("eventPlane", "eventPlane");
+  cacheTree->Branch("multiplicity", &multiplicity, "multiplicity/I");
+  cacheTree->Branch("qx", qx.data(), Form("qx[%d]/D", fnOrders));
+  cacheTree->Branch("qy", qy.data(), Form("qy[%d]/D", fnOrders));
+  cacheTree->Branch("angle", angle.data(), Form("angle[%d]/F", fnOrders));
+
+  for(Long64_t iEntry = 0; iEntry < GetNEntries(); iEntry++){
+    multiplicity = fMultiplicity[iEntry];
+    for(Int_t iOrder = 0; iOrder < fnOrders; iOrder++){
+      qx[iOrder] = fQx[iOrder][iEntry];
+      qy[iOrder] = fQy[iOrder][iEntry];
+      angle[iOrder] = fAngle[iOrder][iEntry];
+    }
+    cacheTree->Fill();
+  }
+
+  // The forest file, its UUID and the particle selection are stored next to the tree to detect stale caches
+  TNamed sourceFile("sourceFile", fSourceFile.Data());
+  TNamed sourceUUID("sourceUUID", fSourceUUID.Data());
+  TNamed particleSelection("particleSelection", fParticleSelection.Data());
+  cacheTree->Write();
+  sourceFile.Write();
+  sourceUUID.Write();
+  particleSelection.Write();
+
+  cacheFile->Close();
+  delete cacheFile;
+}
+
+/*
+ * Read the cache from a sidecar file
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the sidecar file
+ *
+ *  return: True if the cache was read, false if the file does not exist or does not contain an event plane cache
+ */
+Bool_t EventPlaneCache::Read(const TString fileName){
+
+  Reset("", "", 0, 0, 0, 0);
+  fParticleSelection = "";
+
+  // A missing cache is not an error. The event plane is determined from the particles in that case.
+  if(gSystem->AccessPathName(fileName)) return false;
+
+  TFile* cacheFile = TFile::Open(fileName);
+  if(!cacheFile || cacheFile->IsZombie()){
+    if(cacheFile) delete cacheFile;
+    return false;
+  }
+
+  TTree* cacheTree = (TTree*) cacheFile->Get("eventPlane");
+  TNamed* sourceFile = (TNamed*) cacheFile->Get("sourceFile");
+  TNamed* sourceUUID = (TNamed*) cacheFile->Get("sourceUUID");
+  TNamed* particleSelection = (TNamed*) cacheFile->Get("particleSelection");
+  if(!cacheTree || !sourceFile || !sourceUUID || !particleSelection || !cacheTree->GetLeaf("qx")){
+    cacheFile->Close();
+    delete cacheFile;
+    return false;
+  }
+
+  // The number of event plane orders is the length of the Q-vector arrays
+  const Long64_t nEntries = cacheTree->GetEntries();
+  Reset("", "", nEntries, 0, 0, cacheTree->GetLeaf("qx")->GetLen());
+
+  // Variables connected to the tree branches
+  Int_t multiplicity;
+  std::vector<Double_t> qx(fnOrders), qy(fnOrders);
+  std::vector<Float_t> angle(fnOrders);
+
+  cacheTree->SetBranchAddress("multiplicity", &multiplicity);
+  cacheTree->SetBranchAddress("qx", qx.data());
+  cacheTree->SetBranchAddress("qy", qy.data());
+  cacheTree->SetBranchAddress("angle", angle.data());
+
+  for(Long64_t iEntry = 0; iEntry < nEntries; iEntry++){
+    cacheTree->GetEntry(iEntry);
+    fMultiplicity[iEntry] = multiplicity;
+    for(Int_t iOrder = 0; iOrder < fnOrders; iOrder++){
+      fQx[iOrder][iEntry] = qx[iOrder];
+      fQy[iOrder][iEntry] = qy[iOrder];
+      fAngle[iOrder][iEntry] = angle[iOrder];
+    }
+  }
+  fSourceFile = sourceFile->GetTitle();
+  fSourceUUID = sourceUUID->GetTitle();
+  fParticleSelection = particleSelection->GetTitle();
+
+  cacheFile->Close();
+  delete cacheFile;
+  return true;
+}
+
+/*
+ * Read only the forest file, its UUID and the particle selection from a sidecar file, without reading the Q-vectors. This is
+ * enough to check the selection with MatchesSelection. The cache has no entries after this.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the sidecar file
+ *
+ *  return: True if the header was read, false if the file does not exist or does not contain an event plane cache
+ */
+Bool_t EventPlaneCache::ReadHeader(const TString fileName){
+
+  Reset("", "", 0, 0, 0, 0);
+  fParticleSelection = "";
+
+  if(gSystem->AccessPathName(fileName)) return false;
+
+  TFile* cacheFile = TFile::Open(fileName);
+  if(!cacheFile || cacheFile->IsZombie()){
+    if(cacheFile) delete cacheFile;
+    return false;
+  }
+
+  TNamed* sourceFile = (TNamed*) cacheFile->Get("sourceFile");
+  TNamed* sourceUUID = (TNamed*) cacheFile->Get("sourceUUID");
+  TNamed* particleSelection = (TNamed*) cacheFile->Get("particleSelection");
+  const Bool_t hasHeader = sourceFile && sourceUUID && particleSelection && cacheFile->GetListOfKeys()->FindObject("eventPlane");
+  if(hasHeader){
+    fSourceFile = sourceFile->GetTitle();
+    fSourceUUID = sourceUUID->GetTitle();
+    fParticleSelection = particleSelection->GetTitle();
+  }
+
+  cacheFile->Close();
+  delete cacheFile;
+  return hasHeader;
+}
+
+/*
+ * Description of the particle selection used to determine the event plane
+ *
+ *  Arguments:
+ *   const Double_t maxParticleEta = Maximum particle |eta| used for the event plane
+ *   const Double_t maxParticlePt = Maximum particle pT used for the event plane
+ *   const Int_t nOrders = Number of event plane orders, starting from the second
+ *
+ *  return: Description of the particle selection
+ */
+TString EventPlaneCache::GetParticleSelection(const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders){
+  return Form("|eta| < %g, pT < %g, Hydjet particles, orders 2-%d", maxParticleEta, maxParticlePt, nOrders+1);
+}
+
+/*
+ * Name of the sidecar file for a forest file and particle selection
+ *
+ *  Arguments:
+ *   const TString directory = Directory where the cache files are kept
+ *   const TString sourceFile = Name of the forest file
+ *   const Double_t maxParticleEta = Maximum particle |eta| used for the event plane
+ *   const Double_t maxParticlePt = Maximum particle pT used for the event plane
+ *   const Int_t nOrders = Number of event plane orders, starting from the second
+ *
+ *  return: Name of the cache file
+ */
+TString EventPlaneCache::GetCacheFileName(const TString directory, const TString sourceFile, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders){
+  TString indexFileName = EventIndex::GetIndexFileName(directory, sourceFile);
+  indexFileName.ReplaceAll("_eventIndex.root", Form("_%08x_eventPlane.root", GetParticleSelection(maxParticleEta, maxParticlePt, nOrders).Hash()));
+  return indexFileName;
+}
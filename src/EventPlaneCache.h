@@ -0,0 +1,77 @@
+// Event plane Q-vectors for all the entries in one forest file, stored in a sidecar file next to the analysis
+
+#ifndef EVENTPLANECACHE_H
+#define EVENTPLANECACHE_H
+
+// C++ includes
+#include <iostream>
+#include <vector>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TNamed.h>
+#include <TSystem.h>
+#include <TMath.h>
+
+// Own includes
+#include "EventView.h"
+#include "EventIndex.h"
+
+using namespace std;
+
+/*
+ * Q-vector components, multiplicity and event plane angles determined from the generator level particles
+ * for each entry in one forest file.
+ *
+ * The event plane only depends on the particle selection, which is given by the maximum particle eta and pT and
+ * the requirement that the particles come from Hydjet, and the number of event plane orders is given with the
+ * selection. When the cache for a file and particle selection exists, the generator level particle tree does not
+ * need to be read at all. The particle selection is part of the sidecar file name, such that caches for different selections can be kept next to each other. The UUID of the forest
+ * file is stored with the cache, such that a forest file that is produced again with the same name is not matched.
+ */
+class EventPlaneCache{
+
+public:
+
+  // Constructors and destructor
+  EventPlaneCache();                                      // Default constructor
+  EventPlaneCache(const EventPlaneCache& in);             // Copy constructor
+  ~EventPlaneCache();                                     // Destructor
+  EventPlaneCache& operator=(const EventPlaneCache& obj); // Equal sign operator
+
+  // Methods
+  void Reset(const TString sourceFile, const TString sourceUUID, const Long64_t nEntries, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders); // Prepare an empty cache for a forest file
+  void SetEvent(const Long64_t entry, const EventView* eventView);         // Store the Q-vectors from an event view
+  void FillEventPlane(const Long64_t entry, EventView* eventView) const;   // Copy the Q-vectors of one entry to an event view
+  Long64_t GetNEntries() const;                                            // Getter for the number of entries in the cache
+  Int_t GetNOrders() const;                                                // Getter for the number of event plane orders in the cache
+  Bool_t MatchesSelection(const TString sourceFile, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders) const; // Check the forest file and particle selection
+  Bool_t Matches(const TString sourceFile, const TString sourceUUID, const Long64_t nEntries, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders) const; // Check that the cache can be used for a forest file
+  void Write(const TString fileName) const;   // Write the cache to a sidecar file
+  Bool_t Read(const TString fileName);        // Read the cache from a sidecar file
+  Bool_t ReadHeader(const TString fileName);  // Read only the forest file and particle selection from a sidecar file
+
+  // Static helper methods
+  static TString GetParticleSelection(const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders); // Description of the particle selection
+  static TString GetCacheFileName(const TString directory, const TString sourceFile, const Double_t maxParticleEta, const Double_t maxParticlePt, const Int_t nOrders); // Name of the sidecar file
+
+private:
+
+  // Q-vectors for each entry in the forest file
+  Int_t fnOrders;                                   // Number of event plane orders, starting from the second
+  std::vector<Int_t> fMultiplicity;                 // Number of particles used for the Q-vectors
+  std::vector<std::vector<Double_t>> fQx;           // x-components of the Q-vectors for each order
+  std::vector<std::vector<Double_t>> fQy;           // y-components of the Q-vectors for each order
+  std::vector<std::vector<Float_t>> fAngle;         // Event plane angles for each order
+
+  TString fSourceFile;         // Logical name of the forest file described by the cache
+  TString fSourceUUID;         // UUID of the forest file described by the cache
+  TString fParticleSelection;  // Particle selection used to determine the Q-vectors
+
+};
+
+#endif
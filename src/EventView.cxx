@@ -0,0 +1,314 @@
+// Structure-of-arrays snapshot of the information needed from one event in the jet background analysis
+
+// Own includes
+#include "EventView.h"
+
+/*
+ * Default constructor for jet collection
+ */
+EventViewJets::EventViewJets() :
+  fnJets(0),
+  fPt(),
+  fPhi(),
+  fEta(),
+  fMaxTrackPt(),
+  fFlavor(),
+  fHasMatch(),
+  fMatchedIndex(),
+  fMatchedPt(),
+  fMatchedPhi(),
+  fMatchedEta()
+{
+  // Default constructor
+}
+
+/*
+ * Copy constructor for jet collection
+ */
+EventViewJets::EventViewJets(const EventViewJets& in) :
+  fnJets(in.fnJets),
+  fPt(in.fPt),
+  fPhi(in.fPhi),
+  fEta(in.fEta),
+  fMaxTrackPt(in.fMaxTrackPt),
+  fFlavor(in.fFlavor),
+  fHasMatch(in.fHasMatch),
+  fMatchedIndex(in.fMatchedIndex),
+  fMatchedPt(in.fMatchedPt),
+  fMatchedPhi(in.fMatchedPhi),
+  fMatchedEta(in.fMatchedEta)
+{
+  // Copy constructor
+}
+
+/*
+ * Destructor for jet collection
+ */
+EventViewJets::~EventViewJets(){
+  // destructor
+}
+
+/*
+ * Assignment operator for jet collection
+ */
+EventViewJets& EventViewJets::operator=(const EventViewJets& in){
+  // Assignment operator
+
+  if (&in==this) return *this;
+
+  fnJets = in.fnJets;
+  fPt = in.fPt;
+  fPhi = in.fPhi;
+  fEta = in.fEta;
+  fMaxTrackPt = in.fMaxTrackPt;
+  fFlavor = in.fFlavor;
+  fHasMatch = in.fHasMatch;
+  fMatchedIndex = in.fMatchedIndex;
+  fMatchedPt = in.fMatchedPt;
+  fMatchedPhi = in.fMatchedPhi;
+  fMatchedEta = in.fMatchedEta;
+
+  return *this;
+}
+
+/*
+ * Set the number of jets in the collection. The arrays keep their capacity, so there are no
+ * reallocations once the collection has seen the largest event.
+ *
+ *  Arguments:
+ *   const Int_t nJets = Number of jets in the collection
+ */
+void EventViewJets::Resize(const Int_t nJets){
+  fnJets = nJets;
+  fPt.resize(nJets);
+  fPhi.resize(nJets);
+  fEta.resize(nJets);
+  fMaxTrackPt.resize(nJets);
+  fFlavor.resize(nJets);
+  fHasMatch.resize(nJets);
+  fMatchedIndex.resize(nJets);
+  fMatchedPt.resize(nJets);
+  fMatchedPhi.resize(nJets);
+  fMatchedEta.resize(nJets);
+}
+
+/*
+ * Default constructor for particle collection
+ */
+EventViewParticles::EventViewParticles() :
+  fnParticles(0),
+  fPt(0),
+  fPhi(0),
+  fEta(0),
+  fSubevent(0),
+  fPtStorage(),
+  fPhiStorage(),
+  fEtaStorage(),
+  fSubeventStorage()
+{
+  // Default constructor
+}
+
+/*
+ * Copy constructor for particle collection. Copied particles are pointed to in the memory of the new collection.
+ */
+EventViewParticles::EventViewParticles(const EventViewParticles& in) :
+  fnParticles(in.fnParticles),
+  fPt(in.fPt),
+  fPhi(in.fPhi),
+  fEta(in.fEta),
+  fSubevent(in.fSubevent),
+  fPtStorage(in.fPtStorage),
+  fPhiStorage(in.fPhiStorage),
+  fEtaStorage(in.fEtaStorage),
+  fSubeventStorage(in.fSubeventStorage)
+{
+  // Copy constructor
+  if(in.OwnsMemory()) Point(fnParticles, fPtStorage.data(), fPhiStorage.data(), fEtaStorage.data(), fSubeventStorage.data());
+}
+
+/*
+ * Destructor for particle collection
+ */
+EventViewParticles::~EventViewParticles(){
+  // destructor
+}
+
+/*
+ * Assignment operator for particle collection. Copied particles are pointed to in the memory of this collection.
+ */
+EventViewParticles& EventViewParticles::operator=(const EventViewParticles& in){
+  // Assignment operator
+
+  if (&in==this) return *this;
+
+  if(in.OwnsMemory()){
+    Copy(in.fnParticles, in.fPt, in.fPhi, in.fEta, in.fSubevent);
+  } else {
+    Point(in.fnParticles, in.fPt, in.fPhi, in.fEta, in.fSubevent);
+  }
+
+  return *this;
+}
+
+/*
+ * Remove all the particles from the collection
+ */
+void EventViewParticles::Clear(){
+  Point(0, 0, 0, 0, 0);
+}
+
+/*
+ * Point the collection to particle arrays owned by someone else, for example the branch memory of the forest
+ * reader. Nothing is copied, and the particles are valid only as long as the arrays are.
+ *
+ *  Arguments:
+ *   const Int_t nParticles = Number of particles in the arrays
+ *   const Float_t* pt = Particle pT array
+ *   const Float_t* phi = Particle phi array
+ *   const Float_t* eta = Particle eta array
+ *   const Int_t* subevent = Particle subevent index array
+ */
+void EventViewParticles::Point(const Int_t nParticles, const Float_t* pt, const Float_t* phi, const Float_t* eta, const Int_t* subevent){
+  fnParticles = nParticles;
+  fPt = pt;
+  fPhi = phi;
+  fEta = eta;
+  fSubevent = subevent;
+}
+
+/*
+ * Copy the particle arrays to the memory of the collection. The memory keeps its capacity, so there are no
+ * reallocations once the collection has seen the largest event.
+ *
+ *  Arguments:
+ *   const Int_t nParticles = Number of particles in the arrays
+ *   const Float_t* pt = Particle pT array
+ *   const Float_t* phi = Particle phi array
+ *   const Float_t* eta = Particle eta array
+ *   const Int_t* subevent = Particle subevent index array
+ */
+void EventViewParticles::Copy(const Int_t nParticles, const Float_t* pt, const Float_t* phi, const Float_t* eta, const Int_t* subevent){
+  fPtStorage.assign(pt, pt + nParticles);
+  fPhiStorage.assign(phi, phi + nParticles);
+  fEtaStorage.assign(eta, eta + nParticles);
+  fSubeventStorage.assign(subevent, subevent + nParticles);
+  Point(nParticles, fPtStorage.data(), fPhiStorage.data(), fEtaStorage.data(), fSubeventStorage.data());
+}
+
+/*
+ * Check if the arrays point to the memory owned by the collection
+ *
+ *  return: True if the particles are copied to the collection, false if the collection points to memory owned by someone else
+ */
+Bool_t EventViewParticles::OwnsMemory() const{
+  return fnParticles > 0 && fPt == fPtStorage.data();
+}
+
+/*
+ * Default constructor
+ */
+EventView::EventView() :
+  fEntry(-1),
+  fFileId(0),
+  fFileEntry(-1),
+  fVz(0),
+  fCentrality(0),
+  fHiBin(0),
+  fPtHat(0),
+  fEventWeight(0),
+  fPrimaryVertexFilterBit(0),
+  fHfCoincidenceFilterBit(0),
+  fClusterCompatibilityFilterBit(0),
+  fVzWeight(1),
+  fCentralityWeight(1),
+  fHasEventPlane(false),
+  fEventPlaneMultiplicity(0),
+  fEventPlaneQx(),
+  fEventPlaneQy(),
+  fReconstructedJets(),
+  fGeneratorJets(),
+  fCalorimeterJets(),
+  fParticles()
+{
+  // Default constructor
+}
+
+/*
+ * Copy constructor
+ */
+EventView::EventView(const EventView& in) :
+  fEntry(in.fEntry),
+  fFileId(in.fFileId),
+  fFileEntry(in.fFileEntry),
+  fVz(in.fVz),
+  fCentrality(in.fCentrality),
+  fHiBin(in.fHiBin),
+  fPtHat(in.fPtHat),
+  fEventWeight(in.fEventWeight),
+  fPrimaryVertexFilterBit(in.fPrimaryVertexFilterBit),
+  fHfCoincidenceFilterBit(in.fHfCoincidenceFilterBit),
+  fClusterCompatibilityFilterBit(in.fClusterCompatibilityFilterBit),
+  fVzWeight(in.fVzWeight),
+  fCentralityWeight(in.fCentralityWeight),
+  fHasEventPlane(in.fHasEventPlane),
+  fEventPlaneMultiplicity(in.fEventPlaneMultiplicity),
+  fEventPlaneQx(in.fEventPlaneQx),
+  fEventPlaneQy(in.fEventPlaneQy),
+  fReconstructedJets(in.fReconstructedJets),
+  fGeneratorJets(in.fGeneratorJets),
+  fCalorimeterJets(in.fCalorimeterJets),
+  fParticles(in.fParticles)
+{
+  // Copy constructor
+}
+
+/*
+ * Destructor
+ */
+EventView::~EventView(){
+  // destructor
+}
+
+/*
+ * Assignment operator
+ */
+EventView& EventView::operator=(const EventView& in){
+  // Assignment operator
+
+  if (&in==this) return *this;
+
+  fEntry = in.fEntry;
+  fFileId = in.fFileId;
+  fFileEntry = in.fFileEntry;
+  fVz = in.fVz;
+  fCentrality = in.fCentrality;
+  fHiBin = in.fHiBin;
+  fPtHat = in.fPtHat;
+  fEventWeight = in.fEventWeight;
+  fPrimaryVertexFilterBit = in.fPrimaryVertexFilterBit;
+  fHfCoincidenceFilterBit = in.fHfCoincidenceFilterBit;
+  fClusterCompatibilityFilterBit = in.fClusterCompatibilityFilterBit;
+  fVzWeight = in.fVzWeight;
+  fCentralityWeight = in.fCentralityWeight;
+  fHasEventPlane = in.fHasEventPlane;
+  fEventPlaneMultiplicity = in.fEventPlaneMultiplicity;
+  fEventPlaneQx = in.fEventPlaneQx;
+  fEventPlaneQy = in.fEventPlaneQy;
+  fReconstructedJets = in.fReconstructedJets;
+  fGeneratorJets = in.fGeneratorJets;
+  fCalorimeterJets = in.fCalorimeterJets;
+  fParticles = in.fParticles;
+
+  return *this;
+}
+
+/*
+ * Empty all the jet and particle collections. Used for events for which only the event information is read.
+ */
+void EventView::ClearCollections(){
+  fReconstructedJets.Resize(0);
+  fGeneratorJets.Resize(0);
+  fCalorimeterJets.Resize(0);
+  fParticles.Clear();
+}
@@ -0,0 +1,129 @@
+// Structure-of-arrays snapshot of the information needed from one event in the jet background analysis
+
+#ifndef EVENTVIEW_H
+#define EVENTVIEW_H
+
+// C++ includes
+#include <vector>
+
+// Root includes
+#include <Rtypes.h>
+
+/*
+ * Jet collection stored as separate contiguous arrays for each jet property.
+ * The jet axis is resolved and the matching to the other jet collection is done when the view is filled,
+ * such that the analysis can loop over plain arrays without any branching per access.
+ */
+class EventViewJets{
+
+public:
+
+  // Constructors and destructor
+  EventViewJets();                                      // Default constructor
+  EventViewJets(const EventViewJets& in);               // Copy constructor
+  ~EventViewJets();                                     // Destructor
+  EventViewJets& operator=(const EventViewJets& obj);   // Equal sign operator
+
+  // Methods
+  void Resize(const Int_t nJets); // Set the number of jets in the collection. Memory is only reallocated if the collection grows
+
+  // Jet properties. The arrays have fnJets valid elements
+  Int_t fnJets;                      // Number of jets in the collection
+  std::vector<Float_t> fPt;          // Jet pT. Raw pT for reconstructed jets
+  std::vector<Float_t> fPhi;         // Jet phi for the selected jet axis
+  std::vector<Float_t> fEta;         // Jet eta for the selected jet axis
+  std::vector<Float_t> fMaxTrackPt;  // Maximum track pT inside the jet. -999 if not defined for the collection
+  std::vector<Int_t> fFlavor;        // Flavor of the initiating parton. -999 if not defined
+  std::vector<UChar_t> fHasMatch;    // 1 if the jet has a matching jet in the other jet collection, 0 if not
+  std::vector<Int_t> fMatchedIndex;  // Index of the matching jet in the other jet collection. -1 if no match is found
+  std::vector<Float_t> fMatchedPt;   // pT of the matching jet. Raw pT for reconstructed jets. -999 if no match is found
+  std::vector<Float_t> fMatchedPhi;  // phi of the matching jet for the selected jet axis. -999 if no match is found
+  std::vector<Float_t> fMatchedEta;  // eta of the matching jet for the selected jet axis. -999 if no match is found
+
+};
+
+/*
+ * Particle collection stored as separate contiguous arrays for each particle property. The arrays either point
+ * directly to the memory where the forest reader reads the particle branches, which is valid until the reader loads
+ * the next event, or to copies owned by the collection when the event is analyzed after the reader has moved on.
+ */
+class EventViewParticles{
+
+public:
+
+  // Constructors and destructor
+  EventViewParticles();                                           // Default constructor
+  EventViewParticles(const EventViewParticles& in);               // Copy constructor
+  ~EventViewParticles();                                          // Destructor
+  EventViewParticles& operator=(const EventViewParticles& obj);   // Equal sign operator
+
+  // Methods
+  void Clear(); // Remove all the particles from the collection
+  void Point(const Int_t nParticles, const Float_t* pt, const Float_t* phi, const Float_t* eta, const Int_t* subevent); // Point the collection to particle arrays owned by someone else
+  void Copy(const Int_t nParticles, const Float_t* pt, const Float_t* phi, const Float_t* eta, const Int_t* subevent);  // Copy the particle arrays to the memory of the collection
+  Bool_t OwnsMemory() const; // Check if the arrays point to the memory owned by the collection
+
+  // Particle properties. The arrays have fnParticles valid elements
+  Int_t fnParticles;               // Number of particles in the collection
+  const Float_t* fPt;              // Particle pT
+  const Float_t* fPhi;             // Particle phi
+  const Float_t* fEta;             // Particle eta
+  const Int_t* fSubevent;          // Subevent index. 0 = PYTHIA, (>0) = HYDJET
+
+private:
+
+  // Memory for the copied particles. Reused between events, so there are no reallocations once the collection has seen the largest event
+  std::vector<Float_t> fPtStorage;      // Copied particle pT
+  std::vector<Float_t> fPhiStorage;     // Copied particle phi
+  std::vector<Float_t> fEtaStorage;     // Copied particle eta
+  std::vector<Int_t> fSubeventStorage;  // Copied subevent index
+
+};
+
+/*
+ * Snapshot of all the information needed from one event in the analysis. The view owns its memory, so
+ * it stays valid after the reader has moved on to other events, and the memory is reused between events.
+ */
+class EventView{
+
+public:
+
+  // Constructors and destructor
+  EventView();                                  // Default constructor
+  EventView(const EventView& in);               // Copy constructor
+  ~EventView();                                 // Destructor
+  EventView& operator=(const EventView& obj);   // Equal sign operator
+
+  // Methods
+  void ClearCollections(); // Empty all jet and particle collections
+
+  // Event information
+  Long64_t fEntry;                        // Global index of the event over all the input files
+  ULong64_t fFileId;                      // Identifier of the input file computed from its logical file name
+  Int_t fFileEntry;                       // Entry of the event in its input file
+  Float_t fVz;                            // Vertex z-position
+  Float_t fCentrality;                    // Centrality in percent
+  Int_t fHiBin;                           // CMS hiBin. Negative values are set to 1
+  Float_t fPtHat;                         // pT hat
+  Float_t fEventWeight;                   // Event weight in MC
+  Int_t fPrimaryVertexFilterBit;          // Filter bit for primary vertex
+  Int_t fHfCoincidenceFilterBit;          // Filter bit for energy recorded in HF calorimeter towers
+  Int_t fClusterCompatibilityFilterBit;   // Filter bit for cluster compatibility
+  Float_t fVzWeight;                      // Weight for vz in MC
+  Float_t fCentralityWeight;              // Weight for centrality in MC
+
+  // Event plane Q-vectors from generator level particles, when they are taken from the event plane cache
+  Bool_t fHasEventPlane;                                // True if the Q-vectors below are filled. Otherwise they are calculated from the particles
+  Int_t fEventPlaneMultiplicity;                        // Number of particles used for the Q-vectors
+  std::vector<Double_t> fEventPlaneQx;                  // x-components of the Q-vectors, starting from the second order
+  std::vector<Double_t> fEventPlaneQy;                  // y-components of the Q-vectors, starting from the second order
+
+  // Jet and particle collections
+  EventViewJets fReconstructedJets;     // Reconstructed jets matched to generator level jets
+  EventViewJets fGeneratorJets;         // Generator level jets matched to reconstructed jets
+  EventViewJets fCalorimeterJets;       // Calorimeter jets. No matching or flavor information
+  EventViewParticles fParticles;        // Generator level particles
+
+};
+
+#endif
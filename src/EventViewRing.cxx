@@ -0,0 +1,127 @@
+// Single producer, single consumer ring buffer of event views
+
+// C++ includes
+#include <thread>
+
+// Own includes
+#include "EventViewRing.h"
+
+/*
+ * Custom constructor
+ *
+ *  Arguments:
+ *   const Int_t ringDepth = Number of event view slots in the ring
+ */
+EventViewRing::EventViewRing(const Int_t ringDepth) :
+  fnSlots(ringDepth > 0 ? ringDepth : 1),
+  fSlots(fnSlots),
+  fWriteIndex(0),
+  fReadIndex(0),
+  fFinished(false),
+  fnSleeping(0),
+  fSleepMutex(),
+  fSleepCondition()
+{
+  // Custom constructor
+}
+
+/*
+ * Destructor
+ */
+EventViewRing::~EventViewRing(){
+  // destructor
+}
+
+/*
+ * Wait until there is a free slot in the ring and return it for writing. Until CommitWrite is called,
+ * the same slot is returned again, so a slot that was not needed can be reused for the next event.
+ *
+ *  return: Slot to which the producer can write the next event
+ */
+EventView* EventViewRing::BeginWrite(){
+
+  // Only the producer changes the write index, so it can be read without synchronization
+  const Long64_t writeIndex = fWriteIndex.load(std::memory_order_relaxed);
+
+  // Wait until the consumer has given back the slot written fnSlots events ago
+  WaitUntil([&]{ return writeIndex - fReadIndex.load() < fnSlots; });
+
+  return &fSlots[writeIndex % fnSlots];
+}
+
+/*
+ * Publish the slot returned by the previous BeginWrite to the consumer
+ */
+void EventViewRing::CommitWrite(){
+  fWriteIndex.store(fWriteIndex.load(std::memory_order_relaxed) + 1);
+  WakeUp();
+}
+
+/*
+ * Tell the consumer that all the events have been written
+ */
+void EventViewRing::Finish(){
+  fFinished.store(true);
+  WakeUp();
+}
+
+/*
+ * Wait until there is a published slot in the ring and return it for reading
+ *
+ *  return: Oldest published slot. NULL if the producer has finished and all the slots have been read
+ */
+EventView* EventViewRing::BeginRead(){
+
+  // Only the consumer changes the read index, so it can be read without synchronization
+  const Long64_t readIndex = fReadIndex.load(std::memory_order_relaxed);
+
+  // Wait until the producer has published a new slot or has finished
+  WaitUntil([&]{ return fWriteIndex.load() != readIndex || fFinished.load(); });
+
+  // The finished flag is set after the last slot is published, so the write index tells if anything is left
+  if(fWriteIndex.load() == readIndex) return NULL;
+
+  return &fSlots[readIndex % fnSlots];
+}
+
+/*
+ * Give the slot returned by the previous BeginRead back to the producer
+ */
+void EventViewRing::CommitRead(){
+  fReadIndex.store(fReadIndex.load(std::memory_order_relaxed) + 1);
+  WakeUp();
+}
+
+/*
+ * Wait until a condition depending on the counters of the other thread is true. The condition is first checked
+ * in a short spin, since the other thread usually moves on quickly. After that the thread sleeps on the condition
+ * variable. The sleeping thread is counted before the condition is checked under the mutex, and the other thread
+ * moves its counter before it looks at the count, so one of them always sees the other and no wake up is lost.
+ *
+ *  Arguments:
+ *   Condition isReady = Callable returning true when the wait is over
+ */
+template <typename Condition> void EventViewRing::WaitUntil(Condition isReady){
+
+  // Spin for a short while
+  for(Int_t iSpin = 0; iSpin < fnSpinIterations; iSpin++){
+    if(isReady()) return;
+    std::this_thread::yield();
+  }
+
+  // Sleep until the other thread wakes this one up
+  std::unique_lock<std::mutex> lock(fSleepMutex);
+  fnSleeping++;
+  fSleepCondition.wait(lock, isReady);
+  fnSleeping--;
+}
+
+/*
+ * Wake up the other thread if it is sleeping in WaitUntil. The mutex is taken such that the notification cannot
+ * be sent between the check of the condition and the start of the sleep in the other thread.
+ */
+void EventViewRing::WakeUp(){
+  if(fnSleeping.load() == 0) return;
+  std::lock_guard<std::mutex> lock(fSleepMutex);
+  fSleepCondition.notify_all();
+}
@@ -0,0 +1,70 @@
+// Single producer, single consumer ring buffer of event views
+
+#ifndef EVENTVIEWRING_H
+#define EVENTVIEWRING_H
+
+// C++ includes
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// Root includes
+#include <Rtypes.h>
+
+// Own includes
+#include "EventView.h"
+
+/*
+ * Ring buffer connecting a decoding thread that reads events from the forest to the analysis thread.
+ *
+ * The ring has a fixed number of preallocated event view slots. The producer fills the slot it gets from
+ * BeginWrite and publishes it with CommitWrite. The consumer gets the oldest published slot from BeginRead
+ * and gives it back with CommitRead. When all slots are full, the producer waits for the consumer, such that
+ * the number of decoded events waiting for analysis is bounded by the depth of the ring. Only one thread can
+ * produce and only one thread can consume events.
+ *
+ * The slots are handed over with atomic counters. A thread that has to wait first spins for a short while, and
+ * then sleeps on a condition variable until the other thread moves its counter, such that a long wait does not
+ * keep a core busy.
+ */
+class EventViewRing{
+
+public:
+
+  // Constructors and destructor
+  EventViewRing(const Int_t ringDepth);                        // Custom constructor
+  EventViewRing(const EventViewRing& in) = delete;             // The ring is shared between threads and cannot be copied
+  ~EventViewRing();                                            // Destructor
+  EventViewRing& operator=(const EventViewRing& obj) = delete; // The ring is shared between threads and cannot be copied
+
+  // Methods for the producer thread
+  EventView* BeginWrite();  // Wait for a free slot and return it for writing
+  void CommitWrite();       // Publish the slot returned by the previous BeginWrite to the consumer
+  void Finish();            // Tell the consumer that no more events are coming
+
+  // Methods for the consumer thread
+  EventView* BeginRead();   // Wait for a published slot and return it for reading. Return NULL when all events are analyzed
+  void CommitRead();        // Give the slot returned by the previous BeginRead back to the producer
+
+private:
+
+  // Methods
+  template <typename Condition> void WaitUntil(Condition isReady); // Wait until the condition is true, first spinning and then sleeping
+  void WakeUp();                                                   // Wake up the other thread if it is sleeping
+
+  static const Int_t fCacheLineSize = 64;   // Size of a cache line in bytes. The counters are kept in different cache lines
+  static const Int_t fnSpinIterations = 100; // Number of times the condition is checked before a waiting thread goes to sleep
+
+  const Int_t fnSlots;                      // Number of slots in the ring
+  std::vector<EventView> fSlots;            // Preallocated event views
+  alignas(fCacheLineSize) std::atomic<Long64_t> fWriteIndex; // Number of slots published by the producer
+  alignas(fCacheLineSize) std::atomic<Long64_t> fReadIndex;  // Number of slots given back by the consumer
+  alignas(fCacheLineSize) std::atomic<Bool_t> fFinished;     // Flag telling that the producer has finished
+  alignas(fCacheLineSize) std::atomic<Int_t> fnSleeping;     // Number of threads sleeping on the condition variable
+  std::mutex fSleepMutex;                                    // Mutex for the condition variable
+  std::condition_variable fSleepCondition;                   // Condition variable on which a waiting thread sleeps
+
+};
+
+#endif
@@ -0,0 +1,198 @@
+// Helper functions for reading the list of analyzed files and the command line arguments
+
+// Own includes
+#include "FileListReader.h"
+
+using namespace std;
+
+// Possible location for the input files
+const char* fileLocation[] = {"root://eos.cms.rcac.purdue.edu/", "root://eoscms.cern.ch/", "root://xrootd-vanderbilt.sites.opensciencegrid.org/", "root://cmsxrootd.fnal.gov/"};
+const int nFileLocations = sizeof(fileLocation)/sizeof(fileLocation[0]);
+
+/*
+ * File list reader
+ *
+ *  Arguments:
+ *    std::vector<TString> &fileNameVector = Vector filled with filenames found in the file
+ *    TString fileNameFile = Text file containing one analysis file name in each line
+ *    int debug = Level of debug messages shown
+ *    int locationIndex = Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2,  3 = Use xrootd to find the data
+ *    bool runLocal = True: Local run mode. False: Crab run mode
+ *    std::vector<int>* firstEntries = If given, filled with the first analyzed entry of each file
+ *    std::vector<int>* lastEntries = If given, filled with the entry after the last analyzed entry of each file. -1 = End of the file
+ *
+ *  If the file is a manifest written by validateFileList, only the files that passed the checks are used.
+ *
+ *  A file name in the list can end with an entry range, for example file.root:0-50000 for the first 50000 entries.
+ *  The range is removed from the file name and given in the entry vectors. Files without a range are analyzed fully.
+ */
+void ReadFileList(std::vector<TString> &fileNameVector, TString fileNameFile, int debug, int locationIndex, bool runLocal, std::vector<int>* firstEntries, std::vector<int>* lastEntries)
+{
+  
+  if(firstEntries) firstEntries->clear();
+  if(lastEntries) lastEntries->clear();
+  
+  // A manifest already has the full file names, so the location is not added to them
+  if(FileManifest::IsManifest(fileNameFile)){
+    FileManifest manifest;
+    manifest.Read(fileNameFile);
+    manifest.PrintBadFiles();
+    fileNameVector = manifest.GetGoodFiles();
+    if( debug > 0 ) std::cout << "Using " << fileNameVector.size() << " good files out of " << manifest.GetNFiles() << " from manifest " << fileNameFile.Data() << std::endl;
+    if(firstEntries) firstEntries->assign(fileNameVector.size(), 0);
+    if(lastEntries) lastEntries->assign(fileNameVector.size(), -1);
+    return;
+  }
+  
+  // Set up the file names file for reading
+  ifstream file_stream(fileNameFile);
+  std::string line;
+  fileNameVector.clear();
+  if( debug > 0 ) std::cout << "Open file " << fileNameFile.Data() << " to extract files to run over" << std::endl;
+  
+  // Open the file names file for reading
+  if( file_stream.is_open() ) {
+    if( debug > 0) std::cout << "Opened " << fileNameFile.Data() << " for reading" << std::endl;
+    int lineNumber = 0;
+    
+    // Loop over the lines in the file
+    while( !file_stream.eof() ) {
+      getline(file_stream, line);
+      if( debug > 0) std::cout << lineNumber << ": " << line << std::endl;
+      TString lineString(line);
+      
+      // Put all non-empty lines to file names vector
+      if( lineString.CompareTo("", TString::kExact) != 0 ) {
+        
+        if(runLocal){
+          // For local running, it is assumed that the file name is directly the centents of the line
+          fileNameVector.push_back(lineString);
+          
+        } else {
+          // For crab running, the line will have format ["file1", "file2", ... , "fileN"]
+          TObjArray* fileNameArray = lineString.Tokenize(" ");  // Tokenize the string from every ' ' character
+          int numberOfFiles = fileNameArray->GetEntries();
+          TObjString* currentFileNameObject;
+          TString currentFileName;
+          for(int i = 0; i < numberOfFiles; i++){   // Loop over all the files in the array
+            currentFileNameObject = (TObjString *)fileNameArray->At(i);
+            currentFileName = currentFileNameObject->String();
+            
+            // Strip unwanted characters
+            currentFileName.Remove(TString::kBoth,'['); // Remove possible parantheses
+            currentFileName.Remove(TString::kBoth,']'); // Remove possible parantheses
+            currentFileName.Remove(TString::kBoth,','); // Remove commas
+            currentFileName.Remove(TString::kBoth,'"'); // Remove quotation marks
+            
+            // After stripping characters not belonging to the file name, we can add the file to list
+            currentFileName.Prepend(fileLocation[locationIndex]);  // If not running locally, we need to give xrootd path
+            fileNameVector.push_back(currentFileName);
+          }
+        }
+        
+      } // Empty line if
+      
+      
+      lineNumber++;
+    } // Loop over lines in the file
+    
+  // If cannot read the file, give error and end program
+  } else {
+    std::cout << "Error, could not open " << fileNameFile.Data() << " for reading" << std::endl;
+    assert(0);
+  }
+  
+  // Separate the entry ranges from the file names
+  int firstEntry, lastEntry;
+  for(TString& fileName : fileNameVector){
+    SplitEntryRange(fileName, firstEntry, lastEntry);
+    if(firstEntries) firstEntries->push_back(firstEntry);
+    if(lastEntries) lastEntries->push_back(lastEntry);
+  }
+}
+
+/*
+ * Remove an entry range from the end of a file name
+ *
+ *  Arguments:
+ *    TString &fileName = File name, possibly ending with :firstEntry-lastEntry. The range is removed from the name
+ *    int &firstEntry = First entry in the range. 0 if there is no range
+ *    int &lastEntry = Entry after the last entry in the range. -1 if there is no range
+ *
+ *  return: True if the file name had an entry range
+ */
+bool SplitEntryRange(TString &fileName, int &firstEntry, int &lastEntry){
+  firstEntry = 0;
+  lastEntry = -1;
+  
+  // The range is after the last colon. Colons in the redirector part are followed by something else than a range.
+  Ssiz_t colonPosition = fileName.Last(':');
+  if(colonPosition == kNPOS) return false;
+  TString range = fileName(colonPosition+1, fileName.Length()-colonPosition-1);
+  Ssiz_t dashPosition = range.First('-');
+  if(dashPosition == kNPOS) return false;
+  TString firstString = range(0, dashPosition);
+  TString lastString = range(dashPosition+1, range.Length()-dashPosition-1);
+  if(!firstString.IsDigit() || !lastString.IsDigit()) return false;
+  
+  firstEntry = firstString.Atoi();
+  lastEntry = lastString.Atoi();
+  fileName.Remove(colonPosition);
+  return true;
+}
+
+/*
+ * Get the names of the same file through all the known redirectors. Used to fail over to another redirector
+ * when a file cannot be read through the one given in the file list.
+ *
+ *  Arguments:
+ *    TString fileName = Name of the file as given in the file list
+ *
+ *  return: The given file name first, followed by the file through the other redirectors. Only the given name for files not read through a known redirector
+ */
+std::vector<TString> GetRedirectorAlternatives(TString fileName){
+  std::vector<TString> alternatives;
+  alternatives.push_back(fileName);
+  
+  // Find the redirector used for the file
+  int usedLocation = -1;
+  for(int iLocation = 0; iLocation < nFileLocations; iLocation++){
+    if(fileName.BeginsWith(fileLocation[iLocation])) usedLocation = iLocation;
+  }
+  if(usedLocation < 0) return alternatives;
+  
+  // The same logical file name through the other redirectors
+  TString logicalFileName = fileName(strlen(fileLocation[usedLocation]), fileName.Length() - strlen(fileLocation[usedLocation]));
+  for(int iLocation = 0; iLocation < nFileLocations; iLocation++){
+    if(iLocation == usedLocation) continue;
+    alternatives.push_back(TString(fileLocation[iLocation]) + logicalFileName);
+  }
+  
+  return alternatives;
+}
+
+/*
+ * Remove the redirector from a file name, such that the redirector can be added again when the file list is read
+ *
+ *  Arguments:
+ *    TString fileName = Name of the file, possibly read through one of the known redirectors
+ *
+ *  return: The file name without the redirector. The name as given for files not read through a known redirector
+ */
+TString GetLogicalFileName(TString fileName){
+  for(int iLocation = 0; iLocation < nFileLocations; iLocation++){
+    if(fileName.BeginsWith(fileLocation[iLocation])) return fileName(strlen(fileLocation[iLocation]), fileName.Length() - strlen(fileLocation[iLocation]));
+  }
+  return fileName;
+}
+
+/*
+ *  Convert string to boolean value
+ */
+bool checkBool(string str) {
+  std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+  std::istringstream is(str);
+  bool b;
+  is >> std::boolalpha >> b;
+  return b;
+}
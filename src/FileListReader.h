@@ -0,0 +1,31 @@
+// Helper functions for reading the list of analyzed files and the command line arguments
+
+#ifndef FILELISTREADER_H
+#define FILELISTREADER_H
+
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <fstream>    // File stream for input/output to/from files
+#include <assert.h>   // Standard c++ debugging tool. Terminates the program if expression given evaluates to 0.
+#include <vector>     // C++ vector class
+#include <sstream>    // Libraries for checking boolean input
+#include <string>     // Libraries for checking boolean input
+#include <algorithm>  // Libraries for checking boolean input
+#include <cctype>     // Libraries for checking boolean input
+#include <cstring>    // Length of the redirector names
+
+// Includes from Root
+#include <TString.h>
+#include <TObjArray.h>
+#include <TObjString.h>
+
+// Own includes
+#include "FileManifest.h"
+
+void ReadFileList(std::vector<TString> &fileNameVector, TString fileNameFile, int debug, int locationIndex, bool runLocal, std::vector<int>* firstEntries = NULL, std::vector<int>* lastEntries = NULL); // Read the analyzed file names from a text file
+bool SplitEntryRange(TString &fileName, int &firstEntry, int &lastEntry); // Remove an entry range from the end of a file name
+TString GetLogicalFileName(TString fileName); // Remove the redirector from a file name
+std::vector<TString> GetRedirectorAlternatives(TString fileName); // Get the names of the same file through all the known redirectors
+bool checkBool(std::string str); // Convert string to boolean value
+
+#endif
@@ -0,0 +1,228 @@
+// Manifest of validated forest files, written by validateFileList and accepted by the analysis in place of a file list
+
+// Own includes
+#include "FileManifest.h"
+
+// First line of a manifest file. Used to tell a manifest apart from a plain file list
+const char* FileManifest::fHeaderLine = "# jetBackgroundSubtraction file manifest";
+
+/*
+ * Default constructor
+ */
+FileManifest::FileManifest() :
+  fFileNames(),
+  fProblems(),
+  fnEntries(),
+  fZipBytes(),
+  fnClusters(),
+  fMeanParticles(),
+  fClusterStarts()
+{
+  // Default constructor
+}
+
+/*
+ * Copy constructor
+ */
+FileManifest::FileManifest(const FileManifest& in) :
+  fFileNames(in.fFileNames),
+  fProblems(in.fProblems),
+  fnEntries(in.fnEntries),
+  fZipBytes(in.fZipBytes),
+  fnClusters(in.fnClusters),
+  fMeanParticles(in.fMeanParticles),
+  fClusterStarts(in.fClusterStarts)
+{
+  // Copy constructor
+}
+
+/*
+ * Destructor
+ */
+FileManifest::~FileManifest(){
+  // destructor
+}
+
+/*
+ * Assignment operator
+ */
+FileManifest& FileManifest::operator=(const FileManifest& in){
+  // Assignment operator
+
+  if (&in==this) return *this;
+
+  fFileNames = in.fFileNames;
+  fProblems = in.fProblems;
+  fnEntries = in.fnEntries;
+  fZipBytes = in.fZipBytes;
+  fnClusters = in.fnClusters;
+  fMeanParticles = in.fMeanParticles;
+  fClusterStarts = in.fClusterStarts;
+
+  return *this;
+}
+
+/*
+ * Prepare an unchecked manifest for the given files. The check results are set with SetFile, which can be done
+ * from several threads at the same time as long as each thread sets different files.
+ *
+ *  Arguments:
+ *   const std::vector<TString> fileNames = Names of the files in the manifest
+ */
+void FileManifest::Reset(const std::vector<TString> fileNames){
+  fFileNames = fileNames;
+  fProblems.assign(fileNames.size(), "Not checked");
+  fnEntries.assign(fileNames.size(), 0);
+  fZipBytes.assign(fileNames.size(), 0);
+  fnClusters.assign(fileNames.size(), 0);
+  fMeanParticles.assign(fileNames.size(), 0);
+  fClusterStarts.assign(fileNames.size(), std::vector<Long64_t>());
+}
+
+/*
+ * Set the check result for one file
+ *
+ *  Arguments:
+ *   const Int_t iFile = Index of the file in the manifest
+ *   const TString problem = Description of the problem with the file. Empty string if the file is good
+ *   const Long64_t nEntries = Number of entries in the forest
+ *   const Long64_t zipBytes = Compressed size of the trees read in the analysis
+ *   const Int_t nClusters = Number of clusters in the jet tree
+ *   const Double_t meanParticles = Estimated mean number of generator level particles in an event
+ *   const std::vector<Long64_t> clusterStarts = First entry of each cluster in the jet tree
+ */
+void FileManifest::SetFile(const Int_t iFile, const TString problem, const Long64_t nEntries, const Long64_t zipBytes, const Int_t nClusters, const Double_t meanParticles, const std::vector<Long64_t> clusterStarts){
+  fProblems.at(iFile) = problem;
+  fnEntries.at(iFile) = nEntries;
+  fZipBytes.at(iFile) = zipBytes;
+  fnClusters.at(iFile) = nClusters;
+  fMeanParticles.at(iFile) = meanParticles;
+  fClusterStarts.at(iFile) = clusterStarts;
+}
+
+// Getter for the number of files in the manifest
+Int_t FileManifest::GetNFiles() const{
+  return fFileNames.size();
+}
+
+// Check if a file can be analyzed
+Bool_t FileManifest::IsGood(const Int_t iFile) const{
+  return fProblems.at(iFile) == "";
+}
+
+/*
+ * Getter for the names of the files that can be analyzed
+ *
+ *  return: Names of the good files in the order they are in the manifest
+ */
+std::vector<TString> FileManifest::GetGoodFiles() const{
+  std::vector<TString> goodFiles;
+  for(Int_t iFile = 0; iFile < GetNFiles(); iFile++){
+    if(IsGood(iFile)) goodFiles.push_back(fFileNames.at(iFile));
+  }
+  return goodFiles;
+}
+
+/*
+ * Write the manifest to a text file
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the manifest file
+ */
+void FileManifest::Write(const TString fileName) const{
+
+  ofstream manifestFile(fileName.Data());
+  if(!manifestFile.is_open()){
+    cout << "Error! Could not create the manifest file: " << fileName.Data() << endl;
+    assert(0);
+  }
+
+  manifestFile << fHeaderLine << endl;
+  manifestFile << "# status entries compressedBytes clusters meanParticles fileName" << endl;
+  for(Int_t iFile = 0; iFile < GetNFiles(); iFile++){
+    manifestFile << (IsGood(iFile) ? "good " : "bad ") << fnEntries.at(iFile) << " " << fZipBytes.at(iFile) << " " << fnClusters.at(iFile) << " " << fMeanParticles.at(iFile) << " " << fFileNames.at(iFile).Data();
+    if(!IsGood(iFile)) manifestFile << " # " << fProblems.at(iFile).Data();
+    manifestFile << endl;
+  }
+
+  manifestFile.close();
+}
+
+/*
+ * Read the manifest from a text file
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the manifest file
+ *
+ *  return: True if the manifest was read, false if the file does not exist or is not a manifest
+ */
+Bool_t FileManifest::Read(const TString fileName){
+
+  Reset(std::vector<TString>());
+  if(!IsManifest(fileName)) return false;
+
+  ifstream manifestFile(fileName.Data());
+  std::string line;
+  std::string status;
+  std::string name;
+  Long64_t nEntries;
+  Long64_t zipBytes;
+  Int_t nClusters;
+  Double_t meanParticles;
+
+  while(getline(manifestFile, line)){
+
+    // Skip the comment lines and empty lines
+    if(line.empty() || line[0] == '#') continue;
+
+    std::istringstream lineStream(line);
+    if(!(lineStream >> status >> nEntries >> zipBytes >> nClusters >> meanParticles >> name)){
+      cout << "Error! Could not understand the line in manifest " << fileName.Data() << ": " << line << endl;
+      cout << "The columns should be: status entries compressedBytes clusters meanParticles fileName" << endl;
+      assert(0);
+    }
+
+    // For bad files the problem is written after the file name
+    TString problem = "";
+    if(status != "good"){
+      std::string::size_type problemStart = line.find(" # ");
+      problem = (problemStart == std::string::npos) ? "Marked bad in the manifest" : line.substr(problemStart + 3).c_str();
+    }
+
+    fFileNames.push_back(name.c_str());
+    fProblems.push_back(problem);
+    fnEntries.push_back(nEntries);
+    fZipBytes.push_back(zipBytes);
+    fnClusters.push_back(nClusters);
+    fMeanParticles.push_back(meanParticles);
+    fClusterStarts.push_back(std::vector<Long64_t>());
+  }
+
+  return true;
+}
+
+/*
+ * Print the files that cannot be analyzed together with the problem
+ */
+void FileManifest::PrintBadFiles() const{
+  for(Int_t iFile = 0; iFile < GetNFiles(); iFile++){
+    if(IsGood(iFile)) continue;
+    cout << "Skipping bad file " << fFileNames.at(iFile).Data() << ": " << fProblems.at(iFile).Data() << endl;
+  }
+}
+
+/*
+ * Check if a text file is a manifest instead of a plain file list
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the text file
+ *
+ *  return: True if the first line of the file is the manifest header
+ */
+Bool_t FileManifest::IsManifest(const TString fileName){
+  ifstream textFile(fileName.Data());
+  if(!textFile.is_open()) return false;
+  std::string firstLine;
+  getline(textFile, firstLine);
+  return firstLine == fHeaderLine;
+}
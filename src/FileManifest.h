@@ -0,0 +1,71 @@
+// Manifest of validated forest files, written by validateFileList and accepted by the analysis in place of a file list
+
+#ifndef FILEMANIFEST_H
+#define FILEMANIFEST_H
+
+// C++ includes
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+
+using namespace std;
+
+/*
+ * Result of checking each file in a file list before the analysis.
+ *
+ * For each file the manifest tells if the file can be analyzed, and if not, what the problem is. For good files the
+ * number of entries, the compressed size of the trees, the number of clusters in the jet tree and the mean number of
+ * generator level particles in an event are stored, such that the jobs can be split according to the amount of work
+ * in each file.
+ *
+ * The manifest is a text file with one line for each file:
+ *   good <entries> <compressed bytes> <clusters> <mean particles> <file name>
+ *   bad 0 0 0 0 <file name> # <problem>
+ * Manifests written before the mean particles were added are read with zero mean particles.
+ */
+class FileManifest{
+
+public:
+
+  // Constructors and destructor
+  FileManifest();                                   // Default constructor
+  FileManifest(const FileManifest& in);             // Copy constructor
+  ~FileManifest();                                  // Destructor
+  FileManifest& operator=(const FileManifest& obj); // Equal sign operator
+
+  // Methods
+  void Reset(const std::vector<TString> fileNames);   // Prepare an unchecked manifest for the given files
+  void SetFile(const Int_t iFile, const TString problem, const Long64_t nEntries, const Long64_t zipBytes, const Int_t nClusters, const Double_t meanParticles, const std::vector<Long64_t> clusterStarts = std::vector<Long64_t>()); // Set the check result for one file
+  Int_t GetNFiles() const;                            // Getter for the number of files in the manifest
+  Bool_t IsGood(const Int_t iFile) const;             // Check if a file can be analyzed
+  std::vector<TString> GetGoodFiles() const;          // Getter for the names of the files that can be analyzed
+  void Write(const TString fileName) const;           // Write the manifest to a text file
+  Bool_t Read(const TString fileName);                // Read the manifest from a text file
+  void PrintBadFiles() const;                         // Print the files that cannot be analyzed together with the problem
+
+  // Static helper methods
+  static Bool_t IsManifest(const TString fileName);   // Check if a text file is a manifest instead of a plain file list
+
+  // Check results. Each array has one element for each file in the manifest
+  std::vector<TString> fFileNames;    // Names of the files
+  std::vector<TString> fProblems;     // Description of the problem with the file. Empty for good files
+  std::vector<Long64_t> fnEntries;    // Number of entries in the forest
+  std::vector<Long64_t> fZipBytes;    // Compressed size of the trees read in the analysis
+  std::vector<Int_t> fnClusters;      // Number of clusters in the jet tree
+  std::vector<Double_t> fMeanParticles; // Estimated mean number of generator level particles in an event
+  std::vector<std::vector<Long64_t>> fClusterStarts; // First entry of each cluster in the jet tree. Only known after checking the files, not written to the manifest file
+
+private:
+
+  static const char* fHeaderLine;     // First line of a manifest file
+
+};
+
+#endif
@@ -0,0 +1,409 @@
+// Memory mapped columnar cache for the forest branches used in the analysis
+
+// C++ includes
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Root includes
+#include <TSystem.h>
+
+// Own includes
+#include "ForestColumnCache.h"
+#include "EventIndex.h"
+
+// Collection to which each column belongs
+const Int_t ForestColumnCache::fColumnCollection[knCacheColumns] = {
+  kEventInformation, kEventInformation, kEventInformation, kEventInformation, kEventInformation, kEventInformation, kEventInformation,
+  kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets, kReconstructedJets,
+  kGeneratorJets, kGeneratorJets, kGeneratorJets, kGeneratorJets, kGeneratorJets,
+  kCalorimeterJets, kCalorimeterJets, kCalorimeterJets,
+  kGeneratorParticles, kGeneratorParticles, kGeneratorParticles, kGeneratorParticles};
+
+// Names of the columns. These are the forest branch names with the type of the values
+const char* ForestColumnCache::fColumnNames[knCacheColumns] = {
+  "vz/F", "hiBin/I", "pthat/F", "weight/F", "pprimaryVertexFilter/I", "pphfCoincFilter2Th4/I", "pclusterCompatibilityFilter/I",
+  "jtpt/F", "jtphi/F", "WTAphi/F", "jteta/F", "WTAeta/F", "rawpt/F", "trackMax/F", "refpt/F", "refeta/F", "refphi/F", "matchedPartonFlavor/I",
+  "genpt/F", "genphi/F", "WTAgenphi/F", "geneta/F", "WTAgeneta/F",
+  "calopt/F", "calophi/F", "caloeta/F",
+  "pt/F", "phi/F", "eta/F", "sube/I"};
+
+/*
+ * Default constructor
+ */
+ForestColumnCache::ForestColumnCache() :
+  fHeader(),
+  fOutputFile(),
+  fChunkPositions(),
+  fnChunkEntries(0),
+  fFileDescriptor(-1),
+  fMappedFile(NULL),
+  fMappedSize(0),
+  fChunkTable(NULL)
+{
+  // Default constructor
+  memset(&fHeader, 0, sizeof(CacheHeader));
+  for(Int_t iCollection = 0; iCollection < knCacheCollections; iCollection++){
+    fCurrentCount[iCollection] = 0;
+  }
+}
+
+/*
+ * Destructor
+ */
+ForestColumnCache::~ForestColumnCache(){
+  // destructor
+  if(fOutputFile.is_open()) Close();
+  if(fMappedFile) munmap(fMappedFile, fMappedSize);
+  if(fFileDescriptor >= 0) close(fFileDescriptor);
+}
+
+/*
+ * Start writing a new cache file
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the cache file
+ *   const TString sourceFile = Name of the forest file that is converted
+ *   const TString sourceUUID = UUID of the forest file that is converted
+ *   const Long64_t sourceSize = Size of the forest file that is converted in bytes
+ *   const Int_t jetType = Jet collection that is converted. 0 = Calo PU jets, 1 = PF CS jets, 2 = Flow subtracted PF CS jets
+ *   const Int_t chunkSize = Number of events in each chunk
+ *
+ *  return: True if the file was created, false otherwise
+ */
+Bool_t ForestColumnCache::Create(const TString fileName, const TString sourceFile, const TString sourceUUID, const Long64_t sourceSize, const Int_t jetType, const Int_t chunkSize){
+
+  fOutputFile.open(fileName.Data(), ios::out | ios::binary | ios::trunc);
+  if(!fOutputFile.is_open()) return false;
+
+  // Fill the header. The number of events and the chunk table are updated when the file is closed
+  memset(&fHeader, 0, sizeof(CacheHeader));
+  memcpy(fHeader.fMagic, "JBGCACHE", 8);
+  fHeader.fVersion = fVersion;
+  fHeader.fJetType = jetType;
+  fHeader.fSchemaHash = GetSchemaHash();
+  fHeader.fChunkSize = chunkSize > 0 ? chunkSize : 1;
+  strncpy(fHeader.fSourceFile, EventIndex::GetLogicalFileName(sourceFile).Data(), fnSourceFileChars-1);
+  strncpy(fHeader.fSourceUUID, sourceUUID.Data(), fnUUIDChars-1);
+  fHeader.fSourceSize = sourceSize;
+  fOutputFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(CacheHeader));
+  WritePadding();
+
+  // Prepare the buffers for the first chunk
+  fChunkPositions.clear();
+  fnChunkEntries = 0;
+  for(Int_t iCollection = 0; iCollection < knCacheCollections; iCollection++){
+    fCurrentCount[iCollection] = (iCollection == kEventInformation) ? 1 : 0;
+    fChunkOffsets[iCollection].assign(1, 0);
+  }
+  for(Int_t iColumn = 0; iColumn < knCacheColumns; iColumn++){
+    fChunkData[iColumn].clear();
+  }
+
+  return true;
+}
+
+/*
+ * Set the number of values in a collection for the current event. Must be called before the columns of the collection are filled.
+ *
+ *  Arguments:
+ *   const Int_t collection = Collection for which the number of values is set
+ *   const Int_t count = Number of values in the collection for the current event
+ */
+void ForestColumnCache::SetCount(const Int_t collection, const Int_t count){
+  if(collection == kEventInformation) return;
+  fCurrentCount[collection] = count;
+  if(count > fHeader.fMaximumCount[collection]) fHeader.fMaximumCount[collection] = count;
+}
+
+/*
+ * Add the values of a column for the current event. The number of values is given by the collection of the column.
+ *
+ *  Arguments:
+ *   const Int_t column = Filled column
+ *   const void* values = Array of 4 byte values for the column
+ */
+void ForestColumnCache::Fill(const Int_t column, const void* values){
+  const char* valueBytes = static_cast<const char*>(values);
+  const Int_t nBytes = 4*fCurrentCount[fColumnCollection[column]];
+  fChunkData[column].insert(fChunkData[column].end(), valueBytes, valueBytes + nBytes);
+}
+
+/*
+ * Move to the next event. When the chunk is full, it is written to the file.
+ */
+void ForestColumnCache::FinishEvent(){
+  for(Int_t iCollection = 0; iCollection < knCacheCollections; iCollection++){
+    fChunkOffsets[iCollection].push_back(fChunkOffsets[iCollection].back() + fCurrentCount[iCollection]);
+  }
+  fnChunkEntries++;
+  fHeader.fnEntries++;
+  if(fnChunkEntries == fHeader.fChunkSize) WriteChunk();
+}
+
+/*
+ * Write the buffered events as a chunk
+ */
+void ForestColumnCache::WriteChunk(){
+
+  if(fnChunkEntries == 0) return;
+
+  ChunkHeader chunkHeader;
+  memset(&chunkHeader, 0, sizeof(ChunkHeader));
+  chunkHeader.fFirstEntry = fHeader.fnEntries - fnChunkEntries;
+  chunkHeader.fnEntries = fnChunkEntries;
+
+  // The chunk header is written first with placeholder positions and rewritten after the blocks
+  const Long64_t chunkPosition = fOutputFile.tellp();
+  fOutputFile.write(reinterpret_cast<const char*>(&chunkHeader), sizeof(ChunkHeader));
+
+  // Event offsets for each collection
+  for(Int_t iCollection = 0; iCollection < knCacheCollections; iCollection++){
+    if(iCollection == kEventInformation){
+      chunkHeader.fOffsetPosition[iCollection] = -1;
+      continue;
+    }
+    chunkHeader.fOffsetPosition[iCollection] = fOutputFile.tellp();
+    fOutputFile.write(reinterpret_cast<const char*>(fChunkOffsets[iCollection].data()), sizeof(Int_t)*fChunkOffsets[iCollection].size());
+    WritePadding();
+  }
+
+  // Values of each column
+  for(Int_t iColumn = 0; iColumn < knCacheColumns; iColumn++){
+    chunkHeader.fColumnPosition[iColumn] = fOutputFile.tellp();
+    fOutputFile.write(fChunkData[iColumn].data(), fChunkData[iColumn].size());
+    WritePadding();
+  }
+
+  // Update the chunk header with the final positions
+  const Long64_t endPosition = fOutputFile.tellp();
+  fOutputFile.seekp(chunkPosition);
+  fOutputFile.write(reinterpret_cast<const char*>(&chunkHeader), sizeof(ChunkHeader));
+  fOutputFile.seekp(endPosition);
+  fChunkPositions.push_back(chunkPosition);
+
+  // Empty the buffers for the next chunk. The memory is kept for reuse
+  fnChunkEntries = 0;
+  for(Int_t iCollection = 0; iCollection < knCacheCollections; iCollection++){
+    fChunkOffsets[iCollection].assign(1, 0);
+  }
+  for(Int_t iColumn = 0; iColumn < knCacheColumns; iColumn++){
+    fChunkData[iColumn].clear();
+  }
+}
+
+/*
+ * Pad the output file to a multiple of 8 bytes, such that all the blocks are aligned in the memory map
+ */
+void ForestColumnCache::WritePadding(){
+  const char padding[8] = {0};
+  const Long64_t position = fOutputFile.tellp();
+  if(position % 8 != 0) fOutputFile.write(padding, 8 - position % 8);
+}
+
+/*
+ * Write the remaining events and the chunk table, and close the file
+ */
+void ForestColumnCache::Close(){
+
+  if(!fOutputFile.is_open()) return;
+
+  WriteChunk();
+
+  // Table of chunk positions at the end of the file
+  fHeader.fnChunks = fChunkPositions.size();
+  fHeader.fChunkTablePosition = fOutputFile.tellp();
+  fOutputFile.write(reinterpret_cast<const char*>(fChunkPositions.data()), sizeof(Long64_t)*fChunkPositions.size());
+
+  // The header is written last, so a file from an interrupted conversion does not have a valid chunk table
+  fOutputFile.seekp(0);
+  fOutputFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(CacheHeader));
+  fOutputFile.close();
+}
+
+/*
+ * Map a cache file to memory
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the cache file
+ *
+ *  return: True if the file is a valid cache file, false otherwise
+ */
+Bool_t ForestColumnCache::Open(const TString fileName){
+
+  fFileDescriptor = open(fileName.Data(), O_RDONLY);
+  if(fFileDescriptor < 0) return false;
+
+  struct stat fileStatus;
+  if(fstat(fFileDescriptor, &fileStatus) != 0 || fileStatus.st_size < (Long64_t)sizeof(CacheHeader)) return false;
+  fMappedSize = fileStatus.st_size;
+
+  void* mappedFile = mmap(NULL, fMappedSize, PROT_READ, MAP_SHARED, fFileDescriptor, 0);
+  if(mappedFile == MAP_FAILED) return false;
+  fMappedFile = static_cast<char*>(mappedFile);
+
+  // The events are read roughly in order, so tell the kernel to read ahead
+  madvise(fMappedFile, fMappedSize, MADV_SEQUENTIAL);
+
+  // Check that the file is a complete cache file
+  memcpy(&fHeader, fMappedFile, sizeof(CacheHeader));
+  if(memcmp(fHeader.fMagic, "JBGCACHE", 8) != 0) return false;
+  if(fHeader.fVersion != fVersion) return false;
+  if(fHeader.fChunkTablePosition <= 0 || fHeader.fChunkTablePosition + fHeader.fnChunks*(Long64_t)sizeof(Long64_t) > fMappedSize) return false;
+
+  fChunkTable = reinterpret_cast<const Long64_t*>(fMappedFile + fHeader.fChunkTablePosition);
+  return true;
+}
+
+/*
+ * Check that the cache was made from a forest file with the given name for the given jet collection, and that it
+ * has been written with the same column layout as is used in this code. This does not need the forest file, but it
+ * cannot tell if the forest file has been rewritten after the cache was made.
+ *
+ *  Arguments:
+ *   const TString sourceFile = Name of the forest file
+ *   const Int_t jetType = Jet collection used in the analysis
+ *
+ *  return: True if the cache can describe the forest file with the current reader
+ */
+Bool_t ForestColumnCache::MatchesConfiguration(const TString sourceFile, const Int_t jetType) const{
+  if(!fMappedFile) return false;
+  if(fHeader.fSchemaHash != GetSchemaHash()) return false;
+  if(fHeader.fJetType != jetType) return false;
+  return EventIndex::GetLogicalFileName(sourceFile) == TString(fHeader.fSourceFile);
+}
+
+/*
+ * Check that the cache describes the given version of the forest file and jet collection, and that it has been
+ * written with the same column layout as is used in this code. If the forest file has been rewritten, the UUID,
+ * the size or the number of entries changes and the cache is stale.
+ *
+ *  Arguments:
+ *   const TString sourceFile = Name of the forest file
+ *   const TString sourceUUID = UUID of the forest file
+ *   const Long64_t sourceSize = Size of the forest file in bytes
+ *   const Long64_t nEntries = Number of entries in the jet tree of the forest file
+ *   const Int_t jetType = Jet collection used in the analysis
+ *
+ *  return: True if the cache can be used in place of the forest file
+ */
+Bool_t ForestColumnCache::Matches(const TString sourceFile, const TString sourceUUID, const Long64_t sourceSize, const Long64_t nEntries, const Int_t jetType) const{
+  if(!MatchesConfiguration(sourceFile, jetType)) return false;
+  if(fHeader.fnEntries != nEntries) return false;
+  if(fHeader.fSourceSize != sourceSize) return false;
+  return sourceUUID == TString(fHeader.fSourceUUID);
+}
+
+// Getter for the number of events in the cache
+Long64_t ForestColumnCache::GetNEntries() const{
+  return fHeader.fnEntries;
+}
+
+// Getter for the largest number of values in a collection in any event
+Int_t ForestColumnCache::GetMaximumCount(const Int_t collection) const{
+  if(collection == kEventInformation) return 1;
+  return fHeader.fMaximumCount[collection];
+}
+
+// Getter for the UUID of the forest file
+TString ForestColumnCache::GetSourceUUID() const{
+  return TString(fHeader.fSourceUUID);
+}
+
+// Getter for the size of the forest file in bytes
+Long64_t ForestColumnCache::GetSourceSize() const{
+  return fHeader.fSourceSize;
+}
+
+/*
+ * Chunk in which an event is stored
+ *
+ *  Arguments:
+ *   const Long64_t entry = Event in the cache
+ *
+ *  return: Header of the chunk containing the event
+ */
+const ForestColumnCache::ChunkHeader* ForestColumnCache::GetChunk(const Long64_t entry) const{
+  return reinterpret_cast<const ChunkHeader*>(fMappedFile + fChunkTable[entry / fHeader.fChunkSize]);
+}
+
+/*
+ * Getter for the number of values in a collection for an event
+ *
+ *  Arguments:
+ *   const Int_t collection = Collection
+ *   const Long64_t entry = Event in the cache
+ *
+ *  return: Number of values in the collection for the event
+ */
+Int_t ForestColumnCache::GetCount(const Int_t collection, const Long64_t entry) const{
+  if(collection == kEventInformation) return 1;
+  const ChunkHeader* chunk = GetChunk(entry);
+  const Int_t* offsets = reinterpret_cast<const Int_t*>(fMappedFile + chunk->fOffsetPosition[collection]);
+  const Long64_t localEntry = entry - chunk->fFirstEntry;
+  return offsets[localEntry+1] - offsets[localEntry];
+}
+
+/*
+ * Pointer to the values of a column for an event inside the memory map
+ *
+ *  Arguments:
+ *   const Int_t column = Column
+ *   const Long64_t entry = Event in the cache
+ *
+ *  return: Pointer to the first value of the event in the column
+ */
+const char* ForestColumnCache::GetValues(const Int_t column, const Long64_t entry) const{
+  const ChunkHeader* chunk = GetChunk(entry);
+  const Int_t collection = fColumnCollection[column];
+  const Long64_t localEntry = entry - chunk->fFirstEntry;
+  Long64_t firstValue = localEntry;
+  if(collection != kEventInformation){
+    firstValue = reinterpret_cast<const Int_t*>(fMappedFile + chunk->fOffsetPosition[collection])[localEntry];
+  }
+  return fMappedFile + chunk->fColumnPosition[column] + 4*firstValue;
+}
+
+// Pointer to the values of a Float_t column for an event
+const Float_t* ForestColumnCache::GetFloatValues(const Int_t column, const Long64_t entry) const{
+  return reinterpret_cast<const Float_t*>(GetValues(column, entry));
+}
+
+// Pointer to the values of an Int_t column for an event
+const Int_t* ForestColumnCache::GetIntValues(const Int_t column, const Long64_t entry) const{
+  return reinterpret_cast<const Int_t*>(GetValues(column, entry));
+}
+
+/*
+ * Hash of the column layout compiled into this code. If columns are added, removed or reordered, old caches are not used.
+ *
+ *  return: FNV-1a hash of the column names and collections
+ */
+ULong64_t ForestColumnCache::GetSchemaHash(){
+  ULong64_t hash = 14695981039346656037ULL;
+  for(Int_t iColumn = 0; iColumn < knCacheColumns; iColumn++){
+    TString columnDescription = Form("%s:%d;", fColumnNames[iColumn], fColumnCollection[iColumn]);
+    for(Int_t iChar = 0; iChar < columnDescription.Length(); iChar++){
+      hash ^= static_cast<unsigned char>(columnDescription[iChar]);
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+/*
+ * Name of the cache file for a forest file. The same naming is used as for the event index.
+ *
+ *  Arguments:
+ *   const TString directory = Directory where the cache files are kept
+ *   const TString sourceFile = Name of the forest file
+ *
+ *  return: Name of the cache file
+ */
+TString ForestColumnCache::GetCacheFileName(const TString directory, const TString sourceFile){
+  TString cacheFileName = EventIndex::GetIndexFileName(directory, sourceFile);
+  cacheFileName.ReplaceAll("_eventIndex.root", "_columnCache.bin");
+  return cacheFileName;
+}
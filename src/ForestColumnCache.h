@@ -0,0 +1,132 @@
+// Memory mapped columnar cache for the forest branches used in the analysis
+
+#ifndef FORESTCOLUMNCACHE_H
+#define FORESTCOLUMNCACHE_H
+
+// C++ includes
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+
+using namespace std;
+
+/*
+ * Columnar copy of the forest branches needed in the analysis for one forest file.
+ *
+ * Each branch is stored as a column of 4 byte values. Columns with several values per event belong to a collection
+ * (reconstructed jets, generator level jets, calorimeter jets or generator level particles) that gives the number
+ * of values for each event. The events are grouped into chunks. Inside a chunk each column is a contiguous block,
+ * and each collection has the offsets of the events inside the chunk. The file is written chunk by chunk and read
+ * through a memory map, such that the values of an event are copied to the reader arrays without decompression or streaming.
+ *
+ * The header records the forest file, its UUID and size, the number of events, the jet collection and a hash of the
+ * column layout, such that a cache that does not describe the current forest file or reader is detected. The UUID and
+ * size are stored such that the cache can be used without opening the forest file.
+ */
+class ForestColumnCache{
+
+public:
+
+  // Columns in the cache. Each column has 4 bytes per value, either Float_t or Int_t
+  enum enumCacheColumn{kVz, kHiBin, kPtHat, kEventWeight, kPrimaryVertexFilterBit, kHfCoincidenceFilterBit, kClusterCompatibilityFilterBit,
+    kJetPt, kJetPhi, kJetWTAPhi, kJetEta, kJetWTAEta, kJetRawPt, kJetMaxTrackPt, kJetRefPt, kJetRefEta, kJetRefPhi, kJetRefFlavor,
+    kGenJetPt, kGenJetPhi, kGenJetWTAPhi, kGenJetEta, kGenJetWTAEta,
+    kCaloJetPt, kCaloJetPhi, kCaloJetEta,
+    kGenParticlePt, kGenParticlePhi, kGenParticleEta, kGenParticleSubevent, knCacheColumns};
+
+  // Collections giving the number of values in a column for each event. Event information has one value for each event
+  enum enumCacheCollection{kEventInformation, kReconstructedJets, kGeneratorJets, kCalorimeterJets, kGeneratorParticles, knCacheCollections};
+
+  // Constructors and destructor
+  ForestColumnCache();                                              // Default constructor
+  ForestColumnCache(const ForestColumnCache& in) = delete;          // The cache owns an open file or memory map and cannot be copied
+  ~ForestColumnCache();                                             // Destructor
+  ForestColumnCache& operator=(const ForestColumnCache& obj) = delete; // The cache owns an open file or memory map and cannot be copied
+
+  // Methods for writing the cache
+  Bool_t Create(const TString fileName, const TString sourceFile, const TString sourceUUID, const Long64_t sourceSize, const Int_t jetType, const Int_t chunkSize); // Start writing a new cache file
+  void SetCount(const Int_t collection, const Int_t count);  // Set the number of values in a collection for the current event
+  void Fill(const Int_t column, const void* values);         // Add the values of a column for the current event
+  void FinishEvent();                                        // Move to the next event
+  void Close();                                              // Write the remaining events and the chunk table, and close the file
+
+  // Methods for reading the cache
+  Bool_t Open(const TString fileName);                                // Map a cache file to memory
+  Bool_t MatchesConfiguration(const TString sourceFile, const Int_t jetType) const; // Check the forest file name, jet collection and column layout of the cache
+  Bool_t Matches(const TString sourceFile, const TString sourceUUID, const Long64_t sourceSize, const Long64_t nEntries, const Int_t jetType) const; // Check that the cache describes the given version of the forest file and jet collection
+  Long64_t GetNEntries() const;                                       // Getter for the number of events in the cache
+  Int_t GetMaximumCount(const Int_t collection) const;                // Getter for the largest number of values in a collection in any event
+  TString GetSourceUUID() const;                                      // Getter for the UUID of the forest file
+  Long64_t GetSourceSize() const;                                     // Getter for the size of the forest file in bytes
+  Int_t GetCount(const Int_t collection, const Long64_t entry) const;  // Getter for the number of values in a collection for an event
+  const Float_t* GetFloatValues(const Int_t column, const Long64_t entry) const; // Pointer to the values of a Float_t column for an event
+  const Int_t* GetIntValues(const Int_t column, const Long64_t entry) const;     // Pointer to the values of an Int_t column for an event
+
+  // Static helper methods
+  static TString GetCacheFileName(const TString directory, const TString sourceFile); // Name of the cache file for a forest file
+
+private:
+
+  static const Int_t fVersion = 2;            // Version of the file layout
+  static const Int_t fnSourceFileChars = 1024; // Maximum length of the source file name in the header
+  static const Int_t fnUUIDChars = 40;        // Maximum length of the source file UUID in the header
+
+  // Header in the beginning of the file
+  struct CacheHeader{
+    char fMagic[8];                              // Identifier for the file type
+    Int_t fVersion;                              // Version of the file layout
+    Int_t fJetType;                              // Jet collection in the cache. 0 = Calo PU jets, 1 = PF CS jets, 2 = Flow subtracted PF CS jets
+    ULong64_t fSchemaHash;                       // Hash of the column layout
+    Long64_t fnEntries;                          // Number of events in the cache
+    Long64_t fChunkTablePosition;                // Position of the table of chunk positions in the file
+    Int_t fChunkSize;                            // Number of events in each chunk. The last chunk can be smaller
+    Int_t fnChunks;                              // Number of chunks in the file
+    Int_t fMaximumCount[knCacheCollections];     // Largest number of values in each collection in any event
+    char fSourceFile[fnSourceFileChars];         // Logical name of the forest file
+    char fSourceUUID[fnUUIDChars];               // UUID of the forest file
+    Long64_t fSourceSize;                        // Size of the forest file in bytes
+  };
+
+  // Header in the beginning of each chunk
+  struct ChunkHeader{
+    Long64_t fFirstEntry;                             // First event in the chunk
+    Int_t fnEntries;                                  // Number of events in the chunk
+    Int_t fPadding;                                   // Keeps the positions aligned
+    Long64_t fColumnPosition[knCacheColumns];         // Positions of the column blocks in the file
+    Long64_t fOffsetPosition[knCacheCollections];     // Positions of the event offsets of each collection in the file. -1 for event information
+  };
+
+  // Methods
+  static ULong64_t GetSchemaHash(); // Hash of the column layout compiled into this code
+  void WriteChunk();                // Write the buffered events as a chunk
+  void WritePadding();              // Pad the output file to a multiple of 8 bytes
+  const char* GetValues(const Int_t column, const Long64_t entry) const; // Pointer to the values of a column for an event
+  const ChunkHeader* GetChunk(const Long64_t entry) const;               // Chunk in which an event is stored
+
+  // Static tables describing the columns
+  static const Int_t fColumnCollection[knCacheColumns];    // Collection to which each column belongs
+  static const char* fColumnNames[knCacheColumns];         // Name of each column, used for the schema hash
+
+  // Writing
+  CacheHeader fHeader;                                    // Header of the cache file
+  ofstream fOutputFile;                                   // Output file when writing
+  std::vector<Long64_t> fChunkPositions;                  // Positions of the chunks written so far
+  Int_t fCurrentCount[knCacheCollections];                // Number of values in each collection for the current event
+  std::vector<Int_t> fChunkOffsets[knCacheCollections];   // Offsets of the buffered events in each collection
+  std::vector<char> fChunkData[knCacheColumns];           // Buffered values of each column
+  Int_t fnChunkEntries;                                   // Number of buffered events
+
+  // Reading
+  Int_t fFileDescriptor;          // Descriptor of the mapped file. -1 if no file is mapped
+  char* fMappedFile;              // Memory mapped cache file
+  Long64_t fMappedSize;           // Size of the memory map in bytes
+  const Long64_t* fChunkTable;    // Positions of the chunks in the mapped file
+
+};
+
+#endif
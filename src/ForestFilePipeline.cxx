@@ -0,0 +1,341 @@
+// Pipeline that prepares the next input file in the background while the current one is analyzed
+
+// Root includes
+#include <TROOT.h>
+
+// Own includes
+#include "ForestFilePipeline.h"
+
+/*
+ * Custom constructor. The first file is prepared when it is requested, such that the settings given after
+ * the construction apply to all the files.
+ *
+ *  Arguments:
+ *   std::vector<TString> fileNames = List of files going through the pipeline
+ *   const MonteCarloForestReader& readerTemplate = Configured forest reader. A copy of this is used for each file
+ *   const Bool_t prefetchNextFile = True: Prepare the next file in a background thread. False: Prepare each file only when it is needed
+ *   const TString columnCacheDirectory = Directory where the column caches are searched for. Empty string disables the column caches
+ *   std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>> fileBranchGroups = Branch groups read from each file. If empty, the groups of the reader template are used for all files
+ *   RemoteFileCache* remoteFileCache = Cache providing local copies of remote files. Not owned by the pipeline. NULL streams the remote files
+ */
+ForestFilePipeline::ForestFilePipeline(std::vector<TString> fileNames, const MonteCarloForestReader& readerTemplate, const Bool_t prefetchNextFile, const TString columnCacheDirectory, std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>> fileBranchGroups, RemoteFileCache* remoteFileCache) :
+  fFileNames(fileNames),
+  fPrefetchNextFile(prefetchNextFile),
+  fColumnCacheDirectory(columnCacheDirectory),
+  fRevalidateColumnCache(false),
+  fFileBranchGroups(fileBranchGroups),
+  fRemoteFileCache(remoteFileCache),
+  fOpenAttempts(1),
+  fRetryDelay(0),
+  fSkippedFiles(),
+  fPreparedFile(),
+  fFileIndex(-1),
+  fCurrentSlot(fnSlots-1),
+  fFirstEntry(0)
+{
+  // Custom constructor
+
+  // Each slot has its own reader with identical configuration
+  for(Int_t iSlot = 0; iSlot < fnSlots; iSlot++){
+    fReaders[iSlot] = new MonteCarloForestReader(readerTemplate);
+    fFiles[iSlot] = NULL;
+    fCaches[iSlot] = NULL;
+    fSourceUUIDs[iSlot] = "";
+  }
+
+  // Files are opened and read in two threads, which requires ROOT to protect its global state
+  if(fPrefetchNextFile) ROOT::EnableThreadSafety();
+}
+
+/*
+ * Destructor
+ */
+ForestFilePipeline::~ForestFilePipeline(){
+  // destructor
+
+  // Wait for the background thread to finish before closing the files
+  if(fPreparedFile.valid()) fPreparedFile.wait();
+
+  for(Int_t iSlot = 0; iSlot < fnSlots; iSlot++){
+    CloseFile(iSlot);
+    delete fReaders[iSlot];
+  }
+}
+
+/*
+ * Setter for the retry policy used when a file cannot be opened. Each redirector is tried the given number of
+ * times, and the waiting time between the attempts is doubled after each failed attempt. This should be set before
+ * the first file is requested.
+ *
+ *  Arguments:
+ *   const Int_t openAttempts = Number of attempts to open the file through each redirector
+ *   const Int_t retryDelay = Waiting time in seconds after the first failed attempt
+ */
+void ForestFilePipeline::SetRetryPolicy(const Int_t openAttempts, const Int_t retryDelay){
+  fOpenAttempts = TMath::Max(openAttempts, 1);
+  fRetryDelay = TMath::Max(retryDelay, 0);
+}
+
+/*
+ * Setter for checking the column caches against the forest files. Without revalidation, a column cache is used
+ * based on the forest file UUID and size stored in it, and the forest file is not opened. This should be set
+ * before the first file is requested.
+ *
+ *  Arguments:
+ *   const Bool_t revalidate = True: Open the forest file and compare its UUID, size and entries to the cache. False: Use the cache without opening the forest file
+ */
+void ForestFilePipeline::SetColumnCacheRevalidation(const Bool_t revalidate){
+  fRevalidateColumnCache = revalidate;
+}
+
+/*
+ * Move to the next file in the list. The file that was analyzed before is closed, the next file is taken from
+ * the background thread, and preparing the file after that is started in the freed slot. Files that cannot be
+ * opened through any redirector are skipped and remembered, such that the analysis can continue with the rest.
+ *
+ *  return: True if the pipeline moved to a new file, false if all the files have been analyzed
+ */
+Bool_t ForestFilePipeline::NextFile(){
+
+  // Close the file that was analyzed and update the global entry offset
+  if(fFileIndex >= 0){
+    fFirstEntry += fReaders[fCurrentSlot]->GetNEvents();
+    CloseFile(fCurrentSlot);
+  }
+
+  Bool_t fileIsGood = false;
+  while(!fileIsGood){
+
+    // Check if there are files left
+    fFileIndex++;
+    if(fFileIndex >= (Int_t)fFileNames.size()) return false;
+    fCurrentSlot = fFileIndex % fnSlots;
+
+    // Get the next file from the background thread, or prepare it now if it is not being prepared
+    if(fPreparedFile.valid()){
+      fileIsGood = fPreparedFile.get();
+    } else {
+      fileIsGood = PrepareFile(fFileIndex, fCurrentSlot);
+    }
+
+    // The reason for a failure is already printed when the file was prepared. Skip the file.
+    if(!fileIsGood){
+      cout << "Warning! Skipping the file that could not be read: " << fFileNames.at(fFileIndex).Data() << endl;
+      fSkippedFiles.push_back(fFileNames.at(fFileIndex));
+      CloseFile(fCurrentSlot);
+    }
+
+    // Start preparing the next file in the other slot while this one is analyzed
+    if(fPrefetchNextFile && fFileIndex+1 < (Int_t)fFileNames.size()){
+      fPreparedFile = std::async(std::launch::async, &ForestFilePipeline::PrepareFile, this, fFileIndex+1, (fFileIndex+1) % fnSlots);
+    }
+  }
+
+  return true;
+}
+
+/*
+ * Open the current file again after access to it was lost in the middle of the analysis. The reader in the current
+ * slot is connected to the new file, so the analysis can continue from the entry where it was.
+ *
+ *  return: True if the file was opened again with the same number of entries, false if the file cannot be read anymore
+ */
+Bool_t ForestFilePipeline::ReopenFile(){
+
+  // A column cache does not depend on remote access
+  if(!fFiles[fCurrentSlot]) return true;
+
+  const Long64_t nEvents = fReaders[fCurrentSlot]->GetNEvents();
+  CloseFile(fCurrentSlot);
+
+  fFiles[fCurrentSlot] = OpenFile(fFileNames.at(fFileIndex));
+  if(!fFiles[fCurrentSlot]) return false;
+  if(fSourceUUIDs[fCurrentSlot] != fFiles[fCurrentSlot]->GetUUID().AsString()){
+    cout << "Error! The reopened file has a different UUID: " << fFileNames.at(fFileIndex).Data() << endl;
+    return false;
+  }
+
+  fReaders[fCurrentSlot]->ReadForestFromFile(fFiles[fCurrentSlot]);
+  if(fReaders[fCurrentSlot]->GetNEvents() != nEvents){
+    cout << "Error! The reopened file has " << fReaders[fCurrentSlot]->GetNEvents() << " entries instead of " << nEvents << ": " << fFileNames.at(fFileIndex).Data() << endl;
+    return false;
+  }
+
+  return true;
+}
+
+/*
+ * Open a file, retrying with an increasing waiting time and failing over to the other known redirectors if the
+ * file cannot be opened through the one in the file list. If there is a remote file cache, the local copy is
+ * tried first.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the file in the file list
+ *
+ *  return: Opened file that is not a zombie. NULL if the file could not be opened through any redirector
+ */
+TFile* ForestFilePipeline::OpenFile(const TString fileName) const{
+
+  TFile* openedFile;
+
+  // A local copy does not need retries
+  if(fRemoteFileCache){
+    const TString localFileName = fRemoteFileCache->GetLocalFile(fileName);
+    if(localFileName != fileName){
+      openedFile = TFile::Open(localFileName);
+      if(openedFile && openedFile->IsOpen() && !openedFile->IsZombie()) return openedFile;
+      if(openedFile) delete openedFile;
+    }
+  }
+
+  Int_t retryDelay;
+  for(const TString& redirectedFileName : GetRedirectorAlternatives(fileName)){
+    retryDelay = fRetryDelay;
+    for(Int_t iAttempt = 0; iAttempt < fOpenAttempts; iAttempt++){
+
+      openedFile = TFile::Open(redirectedFileName);
+
+      // Check that the file exists, is open and is not a zombie
+      if(!openedFile){
+        cout << "Error! Could not find the file: " << redirectedFileName.Data() << endl;
+      } else if(!openedFile->IsOpen()){
+        cout << "Error! Could not open the file: " << redirectedFileName.Data() << endl;
+      } else if(openedFile->IsZombie()){
+        cout << "Error! The following file is a zombie: " << redirectedFileName.Data() << endl;
+      } else {
+        return openedFile;
+      }
+      if(openedFile) delete openedFile;
+
+      // Wait a bit longer after each failure before trying again
+      if(iAttempt+1 < fOpenAttempts){
+        cout << "Trying again in " << retryDelay << " seconds" << endl;
+        gSystem->Sleep(retryDelay*1000);
+        retryDelay *= 2;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Open a file, check that it is good and connect it to the forest reader in the given slot. After that read the
+ * first event, which brings the first cluster of baskets of all the connected branches to the read cache.
+ * When prefetching is enabled, this is run in the background thread, and a failure is reported immediately
+ * such that it is seen before the analysis reaches the file.
+ *
+ *  Arguments:
+ *   const Int_t fileIndex = Index of the prepared file in the file list
+ *   const Int_t slot = Slot to which the file is prepared
+ *
+ *  return: True if the file is ready for analysis, false if there was a problem with the file
+ */
+Bool_t ForestFilePipeline::PrepareFile(const Int_t fileIndex, const Int_t slot){
+
+  const TString fileName = fFileNames.at(fileIndex);
+
+  // Some files might not need all the branch groups, for example if the information is found from sidecar files
+  if(!fFileBranchGroups.empty()) fReaders[slot]->SetBranchGroups(fFileBranchGroups.at(fileIndex));
+
+  // If there is a column cache for the file, read the events from there. The cache knows the UUID and size of the
+  // forest file it was made from, so the forest file is only opened if the cache is revalidated. Then only the
+  // header and the jet tree metadata of the forest are read to check that the cache is up to date.
+  if(fColumnCacheDirectory != ""){
+    const TString cacheFileName = ForestColumnCache::GetCacheFileName(fColumnCacheDirectory, fileName);
+    fCaches[slot] = new ForestColumnCache();
+    if(fCaches[slot]->Open(cacheFileName)){
+      if(fRevalidateColumnCache){
+        fFiles[slot] = OpenFile(fileName);
+        if(!fFiles[slot]) return false;
+      }
+
+      // The size of a local forest file is found from the file system without opening the file
+      FileStat_t fileInfo;
+      const Bool_t localFileChanged = !RemoteFileCache::IsRemoteFile(fileName) && gSystem->GetPathInfo(fileName, fileInfo) == 0 && fileInfo.fSize != fCaches[slot]->GetSourceSize();
+
+      if(!localFileChanged && fReaders[slot]->ReadForestFromCache(fCaches[slot], fFiles[slot], fileName)){
+        if(fFiles[slot]){
+          fFiles[slot]->Close();
+          delete fFiles[slot];
+          fFiles[slot] = NULL;
+        }
+        fSourceUUIDs[slot] = fCaches[slot]->GetSourceUUID();
+        return true;
+      }
+      cout << "Warning! The column cache " << cacheFileName.Data() << " does not match the file " << fileName.Data() << ". Reading the forest instead." << endl;
+    }
+    delete fCaches[slot];
+    fCaches[slot] = NULL;
+  }
+
+  // Open the file through the first redirector that works, unless it was already opened to check the column cache
+  if(!fFiles[slot]) fFiles[slot] = OpenFile(fileName);
+  if(!fFiles[slot]) return false;
+  fSourceUUIDs[slot] = fFiles[slot]->GetUUID().AsString();
+
+  // Connect the forest to the reader and warm up the read cache with the first cluster
+  fReaders[slot]->ReadForestFromFile(fFiles[slot]);
+  if(fReaders[slot]->GetNEvents() > 0) fReaders[slot]->GetEvent(0);
+
+  return true;
+}
+
+/*
+ * Close the file or the column cache in the given slot. The reader releases its trees and read caches first,
+ * such that nothing from the closed file stays in memory.
+ *
+ *  Arguments:
+ *   const Int_t slot = Slot of the closed file
+ */
+void ForestFilePipeline::CloseFile(const Int_t slot){
+  fReaders[slot]->BurnForest();
+  if(fCaches[slot]){
+    delete fCaches[slot];
+    fCaches[slot] = NULL;
+  }
+  if(!fFiles[slot]) return;
+  fFiles[slot]->Close();
+  delete fFiles[slot];
+  fFiles[slot] = NULL;
+}
+
+// Getter for the reader connected to the current file
+MonteCarloForestReader* ForestFilePipeline::GetReader() const{
+  return fReaders[fCurrentSlot];
+}
+
+// Getter for the current file
+TFile* ForestFilePipeline::GetFile() const{
+  return fFiles[fCurrentSlot];
+}
+
+// Getter for the name of the current file
+TString ForestFilePipeline::GetFileName() const{
+  return fFileNames.at(fFileIndex);
+}
+
+// Getter for the UUID of the current forest file. Sidecar files of the forest file are checked against this
+TString ForestFilePipeline::GetSourceUUID() const{
+  return fSourceUUIDs[fCurrentSlot];
+}
+
+// Getter for the index of the current file in the file list
+Int_t ForestFilePipeline::GetFileIndex() const{
+  return fFileIndex;
+}
+
+// Getter for the number of files in the pipeline
+Int_t ForestFilePipeline::GetNFiles() const{
+  return fFileNames.size();
+}
+
+// Getter for the files that were skipped because they could not be read
+std::vector<TString> ForestFilePipeline::GetSkippedFiles() const{
+  return fSkippedFiles;
+}
+
+// Getter for the global index of the first entry in the current file
+Long64_t ForestFilePipeline::GetFirstEntry() const{
+  return fFirstEntry;
+}
@@ -0,0 +1,96 @@
+// Pipeline that prepares the next input file in the background while the current one is analyzed
+
+#ifndef FORESTFILEPIPELINE_H
+#define FORESTFILEPIPELINE_H
+
+// C++ includes
+#include <vector>
+#include <future>
+#include <bitset>
+#include <assert.h>
+
+// Root includes
+#include <TString.h>
+#include <TFile.h>
+#include <TSystem.h>
+#include <TMath.h>
+
+// Own includes
+#include "MonteCarloForestReader.h"
+#include "ForestColumnCache.h"
+#include "RemoteFileCache.h"
+#include "FileListReader.h"
+
+/*
+ * Files in the pipeline are analyzed one after another. While the event loop runs over the current file, the next
+ * file is opened, validated and connected to a second forest reader in a background thread. The first cluster of
+ * baskets is also read to the read cache, such that the latency of opening the file and reading the first
+ * baskets over xrootd is hidden behind the analysis of the previous file.
+ *
+ * If a column cache directory is given, the events are read from the memory mapped column cache of a file when
+ * there is a cache matching the file. The cache stores the UUID and size of the forest file it was made from, so
+ * the forest file is not opened at all unless revalidation of the caches is requested. A local forest file is
+ * still compared to the stored size through the file system.
+ *
+ * If a remote file cache is given, remote files are opened from their local copies in the cache.
+ *
+ * A file that cannot be opened is tried again with an increasing waiting time, and then through the other known
+ * redirectors. If none of them work, the file is skipped and the analysis continues with the next file.
+ *
+ * Entries are addressed with a global index over all the files in the list, in the same way as in a TChain.
+ */
+class ForestFilePipeline{
+
+public:
+
+  // Constructors and destructor
+  ForestFilePipeline(std::vector<TString> fileNames, const MonteCarloForestReader& readerTemplate, const Bool_t prefetchNextFile, const TString columnCacheDirectory = "", std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>> fileBranchGroups = std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>>(), RemoteFileCache* remoteFileCache = NULL); // Custom constructor
+  ForestFilePipeline(const ForestFilePipeline& in) = delete;             // The pipeline owns a background thread and cannot be copied
+  ~ForestFilePipeline();                                                 // Destructor
+  ForestFilePipeline& operator=(const ForestFilePipeline& obj) = delete; // The pipeline owns a background thread and cannot be copied
+
+  // Methods
+  void SetRetryPolicy(const Int_t openAttempts, const Int_t retryDelay); // Setter for the number of attempts and waiting time when opening a file fails
+  void SetColumnCacheRevalidation(const Bool_t revalidate);              // Setter for opening the forest file to check that a column cache is up to date
+  Bool_t NextFile();                          // Move to the next file in the list. Return false if there are no more files
+  Bool_t ReopenFile();                        // Open the current file again after access to it was lost
+  std::vector<TString> GetSkippedFiles() const; // Getter for the files that were skipped because they could not be read
+  MonteCarloForestReader* GetReader() const;  // Getter for the reader connected to the current file
+  TFile* GetFile() const;                     // Getter for the current file. NULL if the events are read from a column cache
+  TString GetFileName() const;                // Getter for the name of the current file
+  TString GetSourceUUID() const;              // Getter for the UUID of the current forest file
+  Int_t GetFileIndex() const;                 // Getter for the index of the current file in the file list
+  Int_t GetNFiles() const;                    // Getter for the number of files in the pipeline
+  Long64_t GetFirstEntry() const;             // Getter for the global index of the first entry in the current file
+
+private:
+
+  static const Int_t fnSlots = 2;   // One slot for the file being analyzed and one for the file being prepared
+
+  // Methods
+  Bool_t PrepareFile(const Int_t fileIndex, const Int_t slot); // Open, validate and connect a file to the reader in the given slot
+  void CloseFile(const Int_t slot);                            // Close the file in the given slot
+  TFile* OpenFile(const TString fileName) const;               // Open a file with retries and redirector failover
+
+  // Data members
+  std::vector<TString> fFileNames;                // Names of the files in the pipeline
+  Bool_t fPrefetchNextFile;                       // Flag for preparing the next file in a background thread
+  TString fColumnCacheDirectory;                  // Directory of the column caches. Empty if column caches are not used
+  Bool_t fRevalidateColumnCache;                  // Flag for opening the forest file to check the UUID and size stored in a column cache
+  std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>> fFileBranchGroups; // Branch groups read from each file. Empty if the template configuration is used for all files
+  RemoteFileCache* fRemoteFileCache;              // Cache providing local copies of remote files. NULL if remote files are streamed
+  Int_t fOpenAttempts;                            // Number of attempts to open a file through each redirector
+  Int_t fRetryDelay;                              // Waiting time in seconds after the first failed attempt to open a file
+  std::vector<TString> fSkippedFiles;             // Files that were skipped because they could not be opened
+  MonteCarloForestReader* fReaders[fnSlots];      // Forest readers for the current and the next file
+  TFile* fFiles[fnSlots];                         // Current and next input file
+  ForestColumnCache* fCaches[fnSlots];            // Column caches for the current and the next file
+  TString fSourceUUIDs[fnSlots];                  // UUIDs of the current and the next forest file
+  std::future<Bool_t> fPreparedFile;              // Result of preparing the next file in the background
+  Int_t fFileIndex;                               // Index of the current file in the file list
+  Int_t fCurrentSlot;                             // Slot of the current file
+  Long64_t fFirstEntry;                           // Global index of the first entry in the current file
+
+};
+
+#endif
@@ -3,6 +3,12 @@
 // Root includes
 #include <TFile.h>
 #include <TMath.h>
+#include <TEnv.h>
+#include <TROOT.h>
+#include <TTreeCacheUnzip.h>
+#include <TSystem.h>
+#include <TChain.h>
+#include <ROOT/RDataFrame.hxx>
 
 // Own includes
 #include "JetBackgroundAnalyzer.h"
@@ -14,6 +20,8 @@ using namespace std;
  */
 JetBackgroundAnalyzer::JetBackgroundAnalyzer() :
   fFileNames(0),
+  fFileFirstEntries(),
+  fFileLastEntries(),
   fCard(0),
   fHistograms(0),
   fVzWeightFunction(0),
@@ -22,7 +30,11 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer() :
   fSmearingFunction(0),
   fJetCorrector2018(),
   fCaloJetCorrector2018(),
+  fCandidateSmearingFunction(0),
+  fCandidateJetCorrector(),
+  fCandidateCaloJetCorrector(),
   fRng(0),
+  fSmearingRandom(),
   fJetType(0),
   fJetSubtraction(2),
   fDebugLevel(0),
@@ -34,6 +46,12 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer() :
   fTotalEventWeight(1),
   fMaxParticleEtaEventPlane(2),
   fMaxParticlePtEventPlane(5),
+  fnEventPlaneOrders(0),
+  fEventPlaneQ(),
+  fEventPlaneQx(),
+  fEventPlaneQy(),
+  fEventPlaneAngle(),
+  fRecordDeltaPhi(),
   fJetAxis(0),
   fVzCut(0),
   fMinimumPtHat(0),
@@ -44,7 +62,38 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer() :
   fMinimumMaxTrackPtFraction(0),
   fMaximumMaxTrackPtFraction(0),
   fJetClosureMinimumPt(0),
-  fFillJetPtClosure(false)
+  fFillJetPtClosure(false),
+  fReadCacheSize(0),
+  fAsyncPrefetch(false),
+  fUnzipThreads(0),
+  fAlignedTreeReading(false),
+  fStagedEventLoading(false),
+  fPrefetchNextFile(false),
+  fDecodeRingDepth(0),
+  fUseEventIndex(false),
+  fEventIndexDirectory(""),
+  fIndexEventCounts(),
+  fUseColumnCache(false),
+  fColumnCacheDirectory(""),
+  fRevalidateColumnCache(false),
+  fUseEventPlaneCache(false),
+  fEventPlaneCacheDirectory(""),
+  fUseRemoteFileCache(false),
+  fRemoteFileCacheDirectory(""),
+  fRemoteFileCacheSize(0),
+  fRevalidateRemoteFileCache(false),
+  fFileOpenAttempts(1),
+  fFileRetryDelay(0),
+  fSkippedFiles(),
+  fAnalysisThreads(0),
+  fThreadTaskEntries(0),
+  fRandomSeed(0),
+  fDenseHistograms(),
+  fJetRecordFileName(""),
+  fJetRecords(NULL),
+  fMemorySoftLimit(0),
+  fPeakResidentMemory(0),
+  fFileResidentMemory()
 {
   // Default constructor
   fHistograms = new JetBackgroundHistograms();
@@ -62,17 +111,27 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer() :
  */
 JetBackgroundAnalyzer::JetBackgroundAnalyzer(std::vector<TString> fileNameVector, ConfigurationCard *newCard) :
   fFileNames(fileNameVector),
+  fFileFirstEntries(),
+  fFileLastEntries(),
   fCard(newCard),
   fHistograms(0),
   fJetCorrector2018(),
   fCaloJetCorrector2018(),
+  fCandidateSmearingFunction(0),
+  fCandidateJetCorrector(),
+  fCandidateCaloJetCorrector(),
   fVzWeight(1),
   fCentralityWeight(1),
   fPtHatWeight(1),
-  fTotalEventWeight(1)
+  fTotalEventWeight(1),
+  fJetRecordFileName(""),
+  fJetRecords(NULL),
+  fPeakResidentMemory(0),
+  fFileResidentMemory()
 {
   // Custom constructor
   fHistograms = new JetBackgroundHistograms(fCard);
+  fHistograms->SetNumberOfFiles(fFileNames.size());
   fHistograms->CreateHistograms();
   
   // Initialize readers to null
@@ -83,6 +142,9 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer(std::vector<TString> fileNameVector
   
   // Function for smearing the jet pT for systemtic uncertainties
   fSmearingFunction = new TF1("fSmearingFunction","pol4",0,500);
+  
+  // Separate smearing function for the jet candidate check in staged loading, since it can run in the decoding thread
+  if(fStagedEventLoading) fCandidateSmearingFunction = new TF1("fCandidateSmearingFunction","pol4",0,500);
     
   // The vz weight function is rederived from the miniAOD dataset.
   // Macro used for derivation: deriveMonteCarloWeights.C, Git hash: d4eab1cd188da72f5a81b8902cb6cc55ea1baf23
@@ -106,6 +168,10 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer(std::vector<TString> fileNameVector
   // Initialize the random number generator with a random seed
   fRng = new TRandom3();
   fRng->SetSeed(0);
+  if(fRandomSeed > 0) fRng->SetSeed(fRandomSeed);
+  
+  // The smearing of each jet is determined by the seed, the file, the entry and the jet. With a seed of zero, a random seed is used.
+  fSmearingRandom.SetSeed((fRandomSeed > 0) ? (ULong64_t)fRandomSeed : (ULong64_t)(fRng->Rndm()*kMaxInt) + 1);
   
 }
 
@@ -115,13 +181,19 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer(std::vector<TString> fileNameVector
 JetBackgroundAnalyzer::JetBackgroundAnalyzer(const JetBackgroundAnalyzer& in) :
   fEventReader(in.fEventReader),
   fFileNames(in.fFileNames),
+  fFileFirstEntries(in.fFileFirstEntries),
+  fFileLastEntries(in.fFileLastEntries),
   fCard(in.fCard),
   fHistograms(in.fHistograms),
   fVzWeightFunction(in.fVzWeightFunction),
   fCentralityWeightFunctionCentral(in.fCentralityWeightFunctionCentral),
   fCentralityWeightFunctionPeripheral(in.fCentralityWeightFunctionPeripheral),
   fSmearingFunction(in.fSmearingFunction),
+  fCandidateSmearingFunction(in.fCandidateSmearingFunction),
+  fCandidateJetCorrector(in.fCandidateJetCorrector),
+  fCandidateCaloJetCorrector(in.fCandidateCaloJetCorrector),
   fRng(in.fRng),
+  fSmearingRandom(in.fSmearingRandom),
   fJetType(in.fJetType),
   fJetSubtraction(in.fJetSubtraction),
   fDebugLevel(in.fDebugLevel),
@@ -133,6 +205,12 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer(const JetBackgroundAnalyzer& in) :
   fTotalEventWeight(in.fTotalEventWeight),
   fMaxParticleEtaEventPlane(in.fMaxParticleEtaEventPlane),
   fMaxParticlePtEventPlane(in.fMaxParticlePtEventPlane),
+  fnEventPlaneOrders(in.fnEventPlaneOrders),
+  fEventPlaneQ(in.fEventPlaneQ),
+  fEventPlaneQx(in.fEventPlaneQx),
+  fEventPlaneQy(in.fEventPlaneQy),
+  fEventPlaneAngle(in.fEventPlaneAngle),
+  fRecordDeltaPhi(in.fRecordDeltaPhi),
   fJetAxis(in.fJetAxis),
   fVzCut(in.fVzCut),
   fMinimumPtHat(in.fMinimumPtHat),
@@ -143,7 +221,38 @@ JetBackgroundAnalyzer::JetBackgroundAnalyzer(const JetBackgroundAnalyzer& in) :
   fMinimumMaxTrackPtFraction(in.fMinimumMaxTrackPtFraction),
   fMaximumMaxTrackPtFraction(in.fMaximumMaxTrackPtFraction),
   fJetClosureMinimumPt(in.fJetClosureMinimumPt),
-  fFillJetPtClosure(in.fFillJetPtClosure)
+  fFillJetPtClosure(in.fFillJetPtClosure),
+  fReadCacheSize(in.fReadCacheSize),
+  fAsyncPrefetch(in.fAsyncPrefetch),
+  fUnzipThreads(in.fUnzipThreads),
+  fAlignedTreeReading(in.fAlignedTreeReading),
+  fStagedEventLoading(in.fStagedEventLoading),
+  fPrefetchNextFile(in.fPrefetchNextFile),
+  fDecodeRingDepth(in.fDecodeRingDepth),
+  fUseEventIndex(in.fUseEventIndex),
+  fEventIndexDirectory(in.fEventIndexDirectory),
+  fIndexEventCounts(in.fIndexEventCounts),
+  fUseColumnCache(in.fUseColumnCache),
+  fColumnCacheDirectory(in.fColumnCacheDirectory),
+  fRevalidateColumnCache(in.fRevalidateColumnCache),
+  fUseEventPlaneCache(in.fUseEventPlaneCache),
+  fEventPlaneCacheDirectory(in.fEventPlaneCacheDirectory),
+  fUseRemoteFileCache(in.fUseRemoteFileCache),
+  fRemoteFileCacheDirectory(in.fRemoteFileCacheDirectory),
+  fRemoteFileCacheSize(in.fRemoteFileCacheSize),
+  fRevalidateRemoteFileCache(in.fRevalidateRemoteFileCache),
+  fFileOpenAttempts(in.fFileOpenAttempts),
+  fFileRetryDelay(in.fFileRetryDelay),
+  fSkippedFiles(in.fSkippedFiles),
+  fAnalysisThreads(in.fAnalysisThreads),
+  fThreadTaskEntries(in.fThreadTaskEntries),
+  fRandomSeed(in.fRandomSeed),
+  fDenseHistograms(in.fDenseHistograms),
+  fJetRecordFileName(in.fJetRecordFileName),
+  fJetRecords(in.fJetRecords),
+  fMemorySoftLimit(in.fMemorySoftLimit),
+  fPeakResidentMemory(in.fPeakResidentMemory),
+  fFileResidentMemory(in.fFileResidentMemory)
 {
   // Copy constructor
 }
@@ -158,13 +267,19 @@ JetBackgroundAnalyzer& JetBackgroundAnalyzer::operator=(const JetBackgroundAnaly
   
   fEventReader = in.fEventReader;
   fFileNames = in.fFileNames;
+  fFileFirstEntries = in.fFileFirstEntries;
+  fFileLastEntries = in.fFileLastEntries;
   fCard = in.fCard;
   fHistograms = in.fHistograms;
   fVzWeightFunction = in.fVzWeightFunction;
   fCentralityWeightFunctionCentral = in.fCentralityWeightFunctionCentral;
   fCentralityWeightFunctionPeripheral = in.fCentralityWeightFunctionPeripheral;
   fSmearingFunction = in.fSmearingFunction;
+  fCandidateSmearingFunction = in.fCandidateSmearingFunction;
+  fCandidateJetCorrector = in.fCandidateJetCorrector;
+  fCandidateCaloJetCorrector = in.fCandidateCaloJetCorrector;
   fRng = in.fRng;
+  fSmearingRandom = in.fSmearingRandom;
   fJetType = in.fJetType;
   fJetSubtraction = in.fJetSubtraction;
   fDebugLevel = in.fDebugLevel;
@@ -176,6 +291,12 @@ JetBackgroundAnalyzer& JetBackgroundAnalyzer::operator=(const JetBackgroundAnaly
   fTotalEventWeight = in.fTotalEventWeight;
   fMaxParticleEtaEventPlane = in.fMaxParticleEtaEventPlane;
   fMaxParticlePtEventPlane = in.fMaxParticlePtEventPlane;
+  fnEventPlaneOrders = in.fnEventPlaneOrders;
+  fEventPlaneQ = in.fEventPlaneQ;
+  fEventPlaneQx = in.fEventPlaneQx;
+  fEventPlaneQy = in.fEventPlaneQy;
+  fEventPlaneAngle = in.fEventPlaneAngle;
+  fRecordDeltaPhi = in.fRecordDeltaPhi;
   fJetAxis = in.fJetAxis;
   fVzCut = in.fVzCut;
   fMinimumPtHat = in.fMinimumPtHat;
@@ -187,6 +308,37 @@ JetBackgroundAnalyzer& JetBackgroundAnalyzer::operator=(const JetBackgroundAnaly
   fMaximumMaxTrackPtFraction = in.fMaximumMaxTrackPtFraction;
   fJetClosureMinimumPt = in.fJetClosureMinimumPt;
   fFillJetPtClosure = in.fFillJetPtClosure;
+  fReadCacheSize = in.fReadCacheSize;
+  fAsyncPrefetch = in.fAsyncPrefetch;
+  fUnzipThreads = in.fUnzipThreads;
+  fAlignedTreeReading = in.fAlignedTreeReading;
+  fStagedEventLoading = in.fStagedEventLoading;
+  fPrefetchNextFile = in.fPrefetchNextFile;
+  fDecodeRingDepth = in.fDecodeRingDepth;
+  fUseEventIndex = in.fUseEventIndex;
+  fEventIndexDirectory = in.fEventIndexDirectory;
+  fIndexEventCounts = in.fIndexEventCounts;
+  fUseColumnCache = in.fUseColumnCache;
+  fColumnCacheDirectory = in.fColumnCacheDirectory;
+  fRevalidateColumnCache = in.fRevalidateColumnCache;
+  fUseEventPlaneCache = in.fUseEventPlaneCache;
+  fEventPlaneCacheDirectory = in.fEventPlaneCacheDirectory;
+  fUseRemoteFileCache = in.fUseRemoteFileCache;
+  fRemoteFileCacheDirectory = in.fRemoteFileCacheDirectory;
+  fRemoteFileCacheSize = in.fRemoteFileCacheSize;
+  fRevalidateRemoteFileCache = in.fRevalidateRemoteFileCache;
+  fFileOpenAttempts = in.fFileOpenAttempts;
+  fFileRetryDelay = in.fFileRetryDelay;
+  fSkippedFiles = in.fSkippedFiles;
+  fAnalysisThreads = in.fAnalysisThreads;
+  fThreadTaskEntries = in.fThreadTaskEntries;
+  fRandomSeed = in.fRandomSeed;
+  fDenseHistograms = in.fDenseHistograms;
+  fJetRecordFileName = in.fJetRecordFileName;
+  fJetRecords = in.fJetRecords;
+  fMemorySoftLimit = in.fMemorySoftLimit;
+  fPeakResidentMemory = in.fPeakResidentMemory;
+  fFileResidentMemory = in.fFileResidentMemory;
   
   return *this;
 }
@@ -204,6 +356,9 @@ JetBackgroundAnalyzer::~JetBackgroundAnalyzer(){
   if(fCentralityWeightFunctionCentral) delete fCentralityWeightFunctionCentral;
   if(fCentralityWeightFunctionPeripheral) delete fCentralityWeightFunctionPeripheral;
   if(fSmearingFunction) delete fSmearingFunction;
+  if(fCandidateJetCorrector) delete fCandidateJetCorrector;
+  if(fCandidateCaloJetCorrector) delete fCandidateCaloJetCorrector;
+  if(fCandidateSmearingFunction) delete fCandidateSmearingFunction;
   if(fRng) delete fRng;
   if(fEventReader) delete fEventReader;
 }
@@ -227,6 +382,14 @@ void JetBackgroundAnalyzer::ReadConfigurationFromCard(){
 
   fMaxParticleEtaEventPlane = fCard->Get("MaxParticleEtaEventPlane"); // Maximum eta value for particles used to determine the event plane
   fMaxParticlePtEventPlane = fCard->Get("MaxParticlePtEventPlane");   // Maximum pT value for particles used to determine the event plane
+  fnEventPlaneOrders = TMath::Max(0, static_cast<Int_t>(fCard->Get("EventPlaneOrders"))); // Number of flow harmonics for which the event plane is determined
+  
+  // The event plane of each event is determined to the same memory, allocated once for the number of harmonics
+  fEventPlaneQ.assign(fnEventPlaneOrders, 0);
+  fEventPlaneQx.assign(fnEventPlaneOrders, 0);
+  fEventPlaneQy.assign(fnEventPlaneOrders, 0);
+  fEventPlaneAngle.assign(fnEventPlaneOrders, 0);
+  fRecordDeltaPhi.assign(fnEventPlaneOrders, 0);
   
   //****************************************
   //          Jet selection cuts
@@ -253,6 +416,37 @@ void JetBackgroundAnalyzer::ReadConfigurationFromCard(){
   //***************************************
   fFillJetPtClosure = (fCard->Get("FillJetPtClosure") == 1); // Flag to fill jet pT closure histograms
   
+  //************************************************
+  //          Reading of the input files
+  //************************************************
+  fReadCacheSize = fCard->Get("ReadCacheSize");          // Size of the read cache for each tree in MB
+  fAsyncPrefetch = (fCard->Get("AsyncPrefetch") == 1);   // Flag for prefetching the next cluster of baskets asynchronously
+  fUnzipThreads = fCard->Get("UnzipThreads");            // Number of threads used for decompressing baskets
+  fAlignedTreeReading = (fCard->Get("AlignedTreeReading") == 1); // Flag for reading all the trees with a single entry load
+  fStagedEventLoading = (fCard->Get("StagedEventLoading") == 1); // Flag for loading the events in stages
+  fPrefetchNextFile = (fCard->Get("PrefetchNextFile") == 1);     // Flag for preparing the next file in the background
+  fDecodeRingDepth = fCard->Get("DecodeRingDepth");              // Number of decoded events that can wait for the analysis thread
+  fUseEventIndex = (fCard->Get("UseEventIndex") == 1);           // Flag for taking the event information from the event index
+  fEventIndexDirectory = fCard->GetStr("EventIndexDirectory");   // Directory where the event index files are kept
+  fUseColumnCache = (fCard->Get("UseColumnCache") == 1);         // Flag for reading the events from the column caches
+  fColumnCacheDirectory = fCard->GetStr("ColumnCacheDirectory"); // Directory where the column cache files are kept
+  fRevalidateColumnCache = (fCard->Get("ColumnCacheRevalidate") == 1); // Flag for checking the forest file before using a column cache
+  fUseEventPlaneCache = (fCard->Get("UseEventPlaneCache") == 1); // Flag for reading and writing the event plane cache
+  fEventPlaneCacheDirectory = fCard->GetStr("EventPlaneCacheDirectory"); // Directory where the event plane cache files are kept
+  fUseRemoteFileCache = (fCard->Get("UseRemoteFileCache") == 1); // Flag for reading remote files from local copies
+  fRemoteFileCacheDirectory = fCard->GetStr("RemoteFileCacheDirectory"); // Directory where the local copies of remote files are kept
+  fRemoteFileCacheSize = fCard->Get("RemoteFileCacheSize");      // Maximum size of the remote file cache in MB
+  fRevalidateRemoteFileCache = (fCard->Get("RemoteFileCacheRevalidate") == 1); // Flag for checking the remote file before using a local copy
+  fAnalysisThreads = fCard->Get("AnalysisThreads");              // Number of worker threads in the multithreaded analysis
+  fThreadTaskEntries = fCard->Get("ThreadTaskEntries");          // Number of entries in one task of the multithreaded analysis
+  fRandomSeed = fCard->Get("RandomSeed");                        // Seed for the random numbers. 0 = Different in each run
+  for(Int_t iGroup = 0; iGroup < JetBackgroundHistograms::knDenseHistogramGroups; iGroup++){
+    fDenseHistograms.set(iGroup, fCard->Get("SharedDenseHistograms", iGroup) == 1); // Groups of histograms shared between the threads
+  }
+  fFileOpenAttempts = fCard->Get("FileOpenAttempts");            // Number of attempts to open a file through each redirector
+  fFileRetryDelay = fCard->Get("FileRetryDelay");                // Waiting time in seconds after the first failed attempt
+  fMemorySoftLimit = fCard->Get("MemorySoftLimit");              // Resident memory in MB above which a warning is printed
+  
   //************************************************
   //              Debug messages
   //************************************************
@@ -261,601 +455,1721 @@ void JetBackgroundAnalyzer::ReadConfigurationFromCard(){
 
 /*
  * Main analysis loop
+ *
+ *  Arguments:
+ *   const Int_t rangeBegin = First entry analyzed from each file
+ *   const Int_t rangeEnd = Entry after the last entry analyzed from each file. -1 = End of the file
  */
-void JetBackgroundAnalyzer::RunAnalysis(){
+void JetBackgroundAnalyzer::RunAnalysis(const Int_t rangeBegin, const Int_t rangeEnd){
+  
+  // The multithreaded analysis splits whole files to tasks, so a range of entries is analyzed in one thread
+  if(fAnalysisThreads > 0 && (rangeBegin > 0 || rangeEnd >= 0)){
+    cout << "Warning! A range of entries is analyzed in one thread. AnalysisThreads " << fAnalysisThreads << " is ignored." << endl;
+    fAnalysisThreads = 0;
+  }
+  
+  // The records are written in the order the events are analyzed, which is not fixed when several threads are used
+  if(fJetRecordFileName != "" && fAnalysisThreads > 0){
+    cout << "Error! Jet records cannot be written in the multithreaded analysis. Set AnalysisThreads 0 or WriteJetRecords 0 in the card." << endl;
+    assert(0);
+  }
   
   //************************************************
   //  Define variables needed in the analysis loop
   //************************************************
   
-  // Input files and forest readers for analysis
-  TFile* inputFile;
-  
-  // Event variables
-  Int_t nEvents = 0;                // Number of events
-  Double_t vz = 0;                  // Vertex z-position
-  Double_t centrality = 0;          // Event centrality
-  Int_t hiBin = 0;                  // CMS hiBin (centrality * 2)
-  Double_t ptHat = 0;               // pT hat for MC events
-  
-  // Variables for jets
-  Int_t nJets = 0;                  // Number of jets in an event
-  Double_t jetPt = 0;               // pT of the i:th jet in the event
-  Double_t jetPhi = 0;              // phi of the i:th jet in the event
-  Double_t jetEta = 0;              // eta of the i:th jet in the event
-  Int_t jetFlavor = 0;              // Flavor of the jet. 0 = Quark jet. 1 = Gluon jet.
-  Int_t matchingJetExists = 0;      // Flag for having a matching jet. 0 = No match found. 1 = Match exist
-
-  // Variables for leading jet
-  Double_t leadingJetPt = 0;        // pT of the leading jet
-  Double_t leadingJetPhi = 0;       // phi of the leading jet
-  Double_t leadingJetEta = 0;       // eta of the leading jet
-  Int_t leadingJetFlavor = 0;       // Flavor of the leading jet. 0 = Quark jet. 1 = Gluon jet, 2 = Flavor undetermined
-  Int_t leadingJetMatch = 0;        // 0 = No match found. 1 = Match exist
-
-  // Variables for matched reconstructed jet
-  Double_t reconstructedJetPt = 0;   // pT of the reconstructed jet
-  Double_t reconstructedJetPhi = 0;  // phi of the reconstructed jet
-  Double_t reconstructedJetEta = 0;  // eta of the reconstructed jet
-
-  // Variables for particles
-  Int_t nParticles = 0;             // Number of generator level particles
-  Double_t particlePt = 0;          // pT of a generator level particle
-  Double_t particleEta = 0;         // eta of a generator level particle
-  Double_t particlePhi = 0;         // phi of a generator level particle
-  
-  // Variables for smearing study
-  Double_t smearingFactor = 0;       // Larger of the JEC uncertainties
-  
-  // Variables for jet matching and closure
-  Int_t partonFlavor = -999;        // Code for parton flavor in Monte Carlo
-
-  // Event plane study related variables
-  const Int_t nFlowComponentsEP = 3;                  // Number of flow component to which the event plane is determined
-  Double_t eventPlaneQ[nFlowComponentsEP] = {0};      // Magnitude of the event plane Q-vector
-  Double_t eventPlaneMultiplicity = 0;                // Particle multiplicity in the event plane
-  Double_t eventPlaneQx[nFlowComponentsEP] = {0};     // x-component of the event plane vector
-  Double_t eventPlaneQy[nFlowComponentsEP] = {0};     // y-component of the event plane vector
-  Double_t jetEventPlaneDeltaPhi = 0;                 // DeltaPhi between jet and event plane angle
-  Double_t eventPlaneAngle[nFlowComponentsEP] = {0};  // Manually calculated event plane angle
-  
-  // File name helper variables
-  TString currentFile;
-  
-  // Fillers for THnSparses
-  const Int_t nFillJet = 6;         // Inclusive and leading jets
-  const Int_t nFillEventPlane = 3;  // Correlation between inclusive and leading jets with event plane
-  const Int_t nAxesClosure = 7;     // Jet pT closure
-  Double_t fillerJet[nFillJet];
-  Double_t fillerEventPlane[nFillEventPlane];
-  Double_t fillerClosure[nAxesClosure];
-  
   // For 2018 PbPb and 2017 pp data, we need to correct jet pT
-  std::string correctionFileRelative = "jetEnergyCorrections/Autumn18_HI_V8_MC_L2Relative_AK4PF.txt";
-  std::string correctionFileCalo = "jetEnergyCorrections/Autumn18_HI_V8_MC_L2Relative_AK4Calo.txt";
-  
-  vector<string> correctionFiles;
-  correctionFiles.push_back(correctionFileRelative);
-  fJetCorrector2018 = new JetCorrector(correctionFiles);
-
-  vector<string> correctionFilesCalo;
-  correctionFilesCalo.push_back(correctionFileCalo);
-  fCaloJetCorrector2018 = new JetCorrector(correctionFilesCalo);
+  CreateJetCorrectors();
   
   //************************************************
   //      Find forest readers for data files
   //************************************************
 
   fEventReader = new MonteCarloForestReader(fJetSubtraction, fJetAxis);
+  fEventReader->SetReadCacheSize(static_cast<Long64_t>(fReadCacheSize)*1024*1024);
+  fEventReader->SetAlignedReading(fAlignedTreeReading);
+  fEventReader->SetBranchGroups(GetRequiredBranchGroups());
+  
+  //************************************************
+  //       Configure reading of the input files
+  //************************************************
+  
+  // These settings are global for the whole process, so the previous values are restored after the analysis
+  const Int_t previousAsyncPrefetching = gEnv->GetValue("TFile.AsyncPrefetching", 0);
+  const Bool_t previousImplicitMT = ROOT::IsImplicitMTEnabled();
+  const Bool_t previousParallelUnzip = TTreeCacheUnzip::IsParallelUnzip();
+  
+  // With asynchronous prefetching, the next cluster of baskets is read while the current one is analyzed
+  if(fAsyncPrefetch) gEnv->SetValue("TFile.AsyncPrefetching", 1);
+  
+  // Decompress the baskets in the read cache in parallel using the implicit multithreading thread pool
+  if(fUnzipThreads > 0){
+    ROOT::EnableImplicitMT(fUnzipThreads);
+    TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+  }
   
   //************************************************
   //       Main analysis loop over all files
   //************************************************
   
-  // Loop over files
-  Int_t nFiles = fFileNames.size();
-  for(Int_t iFile = 0; iFile < nFiles; iFile++) {
-    
-    //************************************************
-    //              Find and open files
-    //************************************************
-    
-    // Find the filename and open the input file
-    currentFile = fFileNames.at(iFile);
-    inputFile = TFile::Open(currentFile);
-    
-    // Check that the file exists
-    if(!inputFile){
-      cout << "Error! Could not find the file: " << currentFile.Data() << endl;
-      assert(0);
-    }
-
-    // Check that the file is open
-    if(!inputFile->IsOpen()){
-      cout << "Error! Could not open the file: " << currentFile.Data() << endl;
-      assert(0);
+  // Files with an event plane cache do not need the generator level particles. Only the header of the cache is read here.
+  // The full cache is read and checked against the number of entries when the file is opened.
+  std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>> fileBranchGroups;
+  if(fUseEventPlaneCache){
+    EventPlaneCache eventPlaneCache;
+    for(const TString& fileName : fFileNames){
+      fileBranchGroups.push_back(fEventReader->GetBranchGroups());
+      if(!eventPlaneCache.ReadHeader(EventPlaneCache::GetCacheFileName(fEventPlaneCacheDirectory, fileName, fMaxParticleEtaEventPlane, fMaxParticlePtEventPlane, fnEventPlaneOrders))) continue;
+      if(!eventPlaneCache.MatchesSelection(fileName, fMaxParticleEtaEventPlane, fMaxParticlePtEventPlane, fnEventPlaneOrders)) continue;
+      fileBranchGroups.back().reset(MonteCarloForestReader::kGeneratorParticles);
     }
-    
-    // Check that the file is not zombie
-    if(inputFile->IsZombie()){
-      cout << "Error! The following file is a zombie: " << currentFile.Data() << endl;
+  }
+  
+  // If requested, the events and jets filled to the histograms are also written to a record file
+  if(fJetRecordFileName != ""){
+    fJetRecords = new JetRecordTable();
+    if(!fJetRecords->Create(fJetRecordFileName, 100000, fnEventPlaneOrders)){
+      cout << "Error! Could not create the jet record file: " << fJetRecordFileName.Data() << endl;
       assert(0);
     }
+  }
+  
+  // Remote files can be copied to a local cache in the background, two files ahead of the analysis
+  RemoteFileCache* remoteFileCache = NULL;
+  if(fUseRemoteFileCache){
+    remoteFileCache = new RemoteFileCache(fRemoteFileCacheDirectory, fRemoteFileCacheSize, 2, fRevalidateRemoteFileCache);
+    remoteFileCache->StartDownloads(fFileNames);
+  }
+  
+  // The files are opened and connected to the readers in a pipeline, which prepares the next file while the current one is analyzed.
+  // In the multithreaded analysis each worker thread opens its own files instead.
+  ForestFilePipeline* filePipeline = NULL;
+  if(fAnalysisThreads == 0){
+    filePipeline = new ForestFilePipeline(fFileNames, *fEventReader, fPrefetchNextFile, fUseColumnCache ? fColumnCacheDirectory : "", fileBranchGroups, remoteFileCache);
+    filePipeline->SetRetryPolicy(fFileOpenAttempts, fFileRetryDelay);
+    filePipeline->SetColumnCacheRevalidation(fRevalidateColumnCache);
+  }
+  
+  if(fAnalysisThreads > 0){
     
-    // Print the used files
-    if(fDebugLevel > 0) cout << "Reading from file: " << currentFile.Data() << endl;
+    // The files are split into tasks that are analyzed in parallel by the worker threads
+    AnalyzeFilesInThreads(fileBranchGroups, remoteFileCache);
     
-    //************************************************
-    //            Read forest from file
-    //************************************************
+  } else if(fDecodeRingDepth > 0){
     
-    // If file is good, read the forest from the file
-    fEventReader->ReadForestFromFile(inputFile);  // There might be a memory leak in handling the forest...
-
-    nEvents = fEventReader->GetNEvents();
-
-    //************************************************
-    //         Main event loop for each file
-    //************************************************
+    // The events are decoded in a separate thread and passed to the analysis through a ring of event views.
+    // Both threads use ROOT at the same time, so ROOT needs to protect its global state.
+    ROOT::EnableThreadSafety();
+    EventViewRing eventRing(fDecodeRingDepth);
+    std::thread decodeThread(&JetBackgroundAnalyzer::DecodeFiles, this, filePipeline, &eventRing, rangeBegin, rangeEnd);
     
-    for(Int_t iEvent = 0; iEvent < nEvents; iEvent++){ // nEvents
-
-      // For each event, chack that the file stays open:
-      // This is to try to combat file read errors occasionally happening during CRAB running.
-      // Will need to monitor the situation and see if this really works.
-      if(!inputFile->IsOpen() || inputFile->IsZombie()){
-        cout << "Error! Lost access to the file: " << currentFile.Data() << endl;
-        assert(0);
-      }
-      
-      //************************************************
-      //         Read basic event information
-      //************************************************
-      
-      // Print to console how the analysis is progressing
-      if(fDebugLevel > 1 && iEvent % 1000 == 0) cout << "Analyzing event " << iEvent << endl;
-      
-      // Read the event to memory
-      fEventReader->GetEvent(iEvent);
-
-      // Get vz, centrality and pT hat information
-      vz = fEventReader->GetVz();
-      centrality = fEventReader->GetCentrality();
-      hiBin = fEventReader->GetHiBin();
-      ptHat = fEventReader->GetPtHat();
-      
-      // We need to apply pT hat cuts before getting pT hat weight. There might be rare events above the upper
-      // limit from which the weights are calculated, which could cause the code to crash.
-      if(ptHat < fMinimumPtHat || ptHat >= fMaximumPtHat) continue;
-      
-      // Get the weighting for the event
-      fVzWeight = GetVzWeight(vz);  // vz weight
-      fCentralityWeight = GetCentralityWeight(hiBin); // centrality weight
-
-      // Event weight for 2018 MC
-      fPtHatWeight = fEventReader->GetEventWeight(); // 2018 MC
-      fTotalEventWeight = fVzWeight*fCentralityWeight*fPtHatWeight;
-      
-      // Fill event counter histogram
-      fHistograms->fhEvents->Fill(JetBackgroundHistograms::kAll);          // All the events looped over
-      
-      //  ============================================
-      //  ===== Apply all the event quality cuts =====
-      //  ============================================
-
-      // Check event cuts
-      if(!PassEventCuts(fEventReader, true)) continue;
-      
-      // Fill the event information histograms for the events that pass the event cuts
-      fHistograms->fhVertexZ->Fill(vz,fPtHatWeight);                         // z vertex distribution from all events
-      fHistograms->fhVertexZWeighted->Fill(vz,fTotalEventWeight);            // z-vertex distribution weighted with the weight function
-      fHistograms->fhCentrality->Fill(centrality, fPtHatWeight);             // Centrality filled from all events
-      fHistograms->fhCentralityWeighted->Fill(centrality,fTotalEventWeight); // Centrality weighted with the centrality weighting function
-      fHistograms->fhPtHat->Fill(ptHat);                                     // pT hat histogram
-      fHistograms->fhPtHatWeighted->Fill(ptHat,fTotalEventWeight);           // pT het histogram weighted with corresponding cross section and event number
-      
-      // ======================================
-      // ===== Event quality cuts applied =====
-      // ======================================
-
-      //******************************************************************
-      //    Determine the event plane from generator level information
-      //******************************************************************
-
-      // Before calculating the event plane, reset all the variables from the previous event
-      eventPlaneMultiplicity = 0;
-      for(Int_t iFlow = 0; iFlow < nFlowComponentsEP; iFlow++){
-        eventPlaneQ[iFlow] = 0;
-        eventPlaneQx[iFlow] = 0;
-        eventPlaneQy[iFlow] = 0;
-      }
-
-      // Loop over all generator level particles in the event
-      nParticles = fEventReader->GetNGenParticles();
-      for(Int_t iParticle = 0; iParticle < nParticles; iParticle++){
-
-        // Get the particle information
-        particlePt = fEventReader->GetGenParticlePt(iParticle);
-        particleEta = fEventReader->GetGenParticleEta(iParticle);
-        particlePhi = fEventReader->GetGenParticlePhi(iParticle);
-
-        // Cuts for particles used in event plane calculation
-        if(TMath::Abs(particleEta) > fMaxParticleEtaEventPlane) continue;  // Only consider particles from mid-rapidity
-        if(fEventReader->GetGenParticleSubevent(iParticle) == 0) continue; // Only use Hydjet-particles for event plane calculation
-        if(particlePt > fMaxParticlePtEventPlane) continue;  // Ignore high-pT particles for event plane calculation
-
-        // Determine the event planes from order 2 to order 2+nFlowComponentsEP-1
-        for(int iFlow = 0; iFlow < nFlowComponentsEP; iFlow++){
-          eventPlaneQx[iFlow] += TMath::Cos((iFlow+2.0)*(particlePhi));
-          eventPlaneQy[iFlow] += TMath::Sin((iFlow+2.0)*(particlePhi));
-        }
-        eventPlaneMultiplicity += 1;
-
-      }
-
-      // Do not allow zero multiplicity to avoid dividing by zero problems
-      if(eventPlaneMultiplicity == 0) eventPlaneMultiplicity += 1;
-          
-      // Calculate the Q-vector magnitudes and event plane angles for orders 2 tp 2+nFlowComponentsEP-1
-      for(int iFlow = 0; iFlow < nFlowComponentsEP; iFlow++){
-        eventPlaneQ[iFlow] = TMath::Sqrt(eventPlaneQx[iFlow]*eventPlaneQx[iFlow] + eventPlaneQy[iFlow]*eventPlaneQy[iFlow]);
-        eventPlaneAngle[iFlow] = (1.0/(iFlow+2.0)) * TMath::ATan2(eventPlaneQy[iFlow], eventPlaneQx[iFlow]);
-      }
-
-      // Normalize the Q-vector with multiplicity
-      for(int iFlow = 0; iFlow < nFlowComponentsEP; iFlow++){
-        eventPlaneQ[iFlow] /= TMath::Sqrt(eventPlaneMultiplicity);
-      }
-
-      //***********************************************************
-      //       First jet loop for event plane correlations
-      //***********************************************************
-
-      // Reser the leading jet variables for this event
-      leadingJetPt = 0;
-      leadingJetEta = -999;
-      leadingJetPhi = -999;
-      leadingJetFlavor = -999;
-      leadingJetMatch = -999;
-
-      // Jet loop
-      nJets = fEventReader->GetNJets(fJetType);
-      for(Int_t jetIndex = 0; jetIndex < nJets; jetIndex++){
-        
-        jetPt = fEventReader->GetJetRawPt(fJetType, jetIndex);  // Get the raw pT and do manual correction later
-        jetPhi = fEventReader->GetJetPhi(fJetType, jetIndex);
-        jetEta = fEventReader->GetJetEta(fJetType, jetIndex);
-        jetFlavor = -999;
-          
-        //  ========================================
-        //  ======== Apply jet quality cuts ========
-        //  ========================================
-          
-        if(TMath::Abs(jetEta) >= fJetEtaCut) continue; // Cut for jet eta
-          
-        // No jet quality cuts for generator level jets
-        if(!(fJetType == MonteCarloForestReader::kGeneratorLevelJet)){              
-          if(fMinimumMaxTrackPtFraction >= fEventReader->GetJetMaxTrackPt(jetIndex)/fEventReader->GetJetRawPt(jetIndex)){
-            continue; // Cut for jets with only very low pT particles
-          }
-          if(fMaximumMaxTrackPtFraction <= fEventReader->GetJetMaxTrackPt(jetIndex)/fEventReader->GetJetRawPt(jetIndex)){
-            continue; // Cut for jets where all the pT is taken by one track
-          }
-        }
-          
-        //  ========================================
-        //  ======= Jet quality cuts applied =======
-        //  ========================================
-
-        // No jet pT correction or smearing for generator level jets
-        if(!(fJetType == MonteCarloForestReader::kGeneratorLevelJet)){
+    // Analyze the events in the order they are decoded until the decoding thread has finished
+    const EventView* eventView;
+    while((eventView = eventRing.BeginRead()) != NULL){
+      AnalyzeEvent(eventView);
+      eventRing.CommitRead();
+    }
     
-          // For reconstructed jets do a correction for the jet pT
-          fJetCorrector2018->SetJetPT(jetPt);
-          fJetCorrector2018->SetJetEta(jetEta);
-          fJetCorrector2018->SetJetPhi(jetPhi);
-          
-          jetPt = fJetCorrector2018->GetCorrectedPT();
-          
-          // Apply gaussian smearing to take into account overly optimistic jet energy resolution
-          if(fSmearResolution){
-            smearingFactor = GetSmearingFactor(jetPt, jetEta, centrality);
-            jetPt = jetPt * fRng->Gaus(1,smearingFactor);
-          }
-            
-        } // Jet pT correction
-          
-        // After the jet pT can been corrected, apply analysis jet pT cuts
-        if(jetPt < fJetMinimumPtCut) continue;
-        if(jetPt > fJetMaximumPtCut) continue;
-
-        // Check if the current jet has a matching jet
-        matchingJetExists = 0;
-        if(fEventReader->HasMatchingJet(fJetType, jetIndex)){
-          // Require that one pT is not less than half of the other pT
-          if(jetPt*0.5 < fEventReader->GetMatchedPt(fJetType, jetIndex) && fEventReader->GetMatchedPt(fJetType, jetIndex) * 0.5 < jetPt){
-            matchingJetExists = 1;
-          }
-        }
-
-        // Find the jet flavor and translate it into a quark [-6,-1] U [1,6] or gluon (21)
-        // In the jet flavor is not any of these values, it remains undeterined
-        jetFlavor = JetBackgroundHistograms::kUndetermined;
-        partonFlavor = fEventReader->GetJetFlavor(fJetType, jetIndex);
-        if(TMath::Abs(partonFlavor) == 21) jetFlavor = JetBackgroundHistograms::kGluon;
-        if(TMath::Abs(partonFlavor) < 7){
-          if(partonFlavor != 0) jetFlavor = JetBackgroundHistograms::kQuark;
-        }
-
-        // After the event selection, update the leading jet variables
-        if(jetPt > leadingJetPt){
-          leadingJetPt = jetPt;
-          leadingJetPhi = jetPhi;
-          leadingJetEta = jetEta;
-          leadingJetFlavor = jetFlavor;
-          leadingJetMatch = matchingJetExists;
-        }
-        
-        //************************************************
-        //         Fill histograms for all jets
-        //************************************************
-          
-        // Fill the axes in correct order
-        fillerJet[0] = jetPt;             // Axis 0 = any jet pT
-        fillerJet[1] = jetPhi;            // Axis 1 = any jet phi
-        fillerJet[2] = jetEta;            // Axis 2 = any jet eta
-        fillerJet[3] = centrality;        // Axis 3 = centrality
-        fillerJet[4] = jetFlavor;         // Axis 4 = flavor of the jet
-        fillerJet[5] = matchingJetExists; // Axis 5 = flag is matching jet exists
-          
-        fHistograms->fhInclusiveJet->Fill(fillerJet,fTotalEventWeight); // Fill the data point to histogram
-
-        //**********************************************************************
-        //      Fill histograms for inclusive jet - event plane correlation
-        //**********************************************************************
-
-        for(int iFlow = 0; iFlow < nFlowComponentsEP; iFlow++){
-          
-          // Determine the deltaPhi between jet axis and the event plane in the interval [-pi/2,3pi/2]
-          jetEventPlaneDeltaPhi = jetPhi - eventPlaneAngle[iFlow];
-          while(jetEventPlaneDeltaPhi > (1.5*TMath::Pi())){jetEventPlaneDeltaPhi += -2*TMath::Pi();}
-          while(jetEventPlaneDeltaPhi < (-0.5*TMath::Pi())){jetEventPlaneDeltaPhi += 2*TMath::Pi();}
-
-          // Require matching generator level jet with at least 80 GeV
-          if(fEventReader->HasMatchingGenJet(jetIndex)){
-
-            // Fill the jet - event plane correlation histograms
-            fillerEventPlane[0] = jetEventPlaneDeltaPhi;  // Axis 0: DeltaPhi between jet and event plane
-            fillerEventPlane[1] = jetPt;                  // Axis 1: Jet pT
-            fillerEventPlane[2] = centrality;             // Axis 2: centrality
-
-            fHistograms->fhInclusiveJetEventPlane[iFlow]->Fill(fillerEventPlane, fTotalEventWeight);
-          }
-
-        }
-        
-      } // End of jet loop
-
-      // If a leading jet exists, fill the leading jet histograms
-      if(leadingJetPt > 0){
-
-        //***************************************************
-        //         Fill histograms for leading jets
-        //***************************************************
-
-        // Fill the axes in correct order
-        fillerJet[0] = leadingJetPt;       // Axis 0 = leading jet pT
-        fillerJet[1] = leadingJetPhi;      // Axis 1 = leading jet phi
-        fillerJet[2] = leadingJetEta;      // Axis 2 = leading jet eta
-        fillerJet[3] = centrality;         // Axis 3 = centrality
-        fillerJet[4] = leadingJetFlavor;   // Axis 4 = flavor of the leading jet
-        fillerJet[5] = leadingJetMatch;    // Axis 5 = flag if matching jet exists
-          
-        fHistograms->fhLeadingJet->Fill(fillerJet,fTotalEventWeight); // Fill the data point to histogram
-
-        //**********************************************************************
-        //      Fill histograms for leading jet - event plane correlation
-        //**********************************************************************
-
-        for(int iFlow = 0; iFlow < nFlowComponentsEP; iFlow++){
-          
-          // Determine the deltaPhi between jet axis and the event plane in the interval [-pi/2,3pi/2]
-          jetEventPlaneDeltaPhi = leadingJetPhi - eventPlaneAngle[iFlow];
-          while(jetEventPlaneDeltaPhi > (1.5*TMath::Pi())){jetEventPlaneDeltaPhi += -2*TMath::Pi();}
-          while(jetEventPlaneDeltaPhi < (-0.5*TMath::Pi())){jetEventPlaneDeltaPhi += 2*TMath::Pi();}
-
-          // Fill the jet - event plane correlation histograms
-          fillerEventPlane[0] = jetEventPlaneDeltaPhi;  // Axis 0: DeltaPhi between jet and event plane
-          fillerEventPlane[1] = leadingJetPt;           // Axis 1: Leading jet pT
-          fillerEventPlane[2] = centrality;             // Axis 2: centrality
-
-          fHistograms->fhLeadingJetEventPlane[iFlow]->Fill(fillerEventPlane, fTotalEventWeight);
-
-        }
-      } // Filling leading jet histograms
-
-      //*******************************************************************
-      //     If selected, fill the histograms also for calorimeter jets
-      //*******************************************************************
-      if(fDoCalorimeterJets){
-
-        nJets = fEventReader->GetNJets(fJetType);
-        for(Int_t jetIndex = 0; jetIndex < nJets; jetIndex++){
-
-          // Find the calorimeter jet kinematics
-          jetPt = fEventReader->GetCalorimeterJetPt(jetIndex);
-          jetPhi = fEventReader->GetCalorimeterJetPhi(jetIndex);
-          jetEta = fEventReader->GetCalorimeterJetEta(jetIndex);
-
-          // Select the jets from a defined eta region
-          if(TMath::Abs(jetEta) >= fJetEtaCut) continue; // Cut for jet eta
-
-          // Do jet energy correction for calorimeter jets
-          fCaloJetCorrector2018->SetJetPT(jetPt);
-          fCaloJetCorrector2018->SetJetEta(jetEta);
-          fCaloJetCorrector2018->SetJetPhi(jetPhi);
-          
-          jetPt = fCaloJetCorrector2018->GetCorrectedPT();
-
-          // After the jet pT can been corrected, apply analysis jet pT cuts
-          if(jetPt < fJetMinimumPtCut) continue;
-          if(jetPt > fJetMaximumPtCut) continue;
-
-          //************************************************
-          //         Fill histograms for all jets
-          //************************************************
-          
-          // Fill the axes in correct order
-          fillerJet[0] = jetPt;             // Axis 0 = calorimeter jet pT
-          fillerJet[1] = jetPhi;            // Axis 1 = calorimeter jet phi
-          fillerJet[2] = jetEta;            // Axis 2 = calorimeter jet eta
-          fillerJet[3] = centrality;        // Axis 3 = centrality
-          fillerJet[4] = 0;                 // Axis 4 = not used for calorimeter jets
-          fillerJet[5] = 0;                 // Axis 5 = not used for calorimeter jets
-          
-          fHistograms->fhCalorimeterJet->Fill(fillerJet,fTotalEventWeight); // Fill the data point to histogram
-
-          //**********************************************************************
-          //      Fill histograms for calorimeter jet - event plane correlation
-          //**********************************************************************
-
-          for(int iFlow = 0; iFlow < nFlowComponentsEP; iFlow++){
-          
-            // Determine the deltaPhi between jet axis and the event plane in the interval [-pi/2,3pi/2]
-            jetEventPlaneDeltaPhi = jetPhi - eventPlaneAngle[iFlow];
-            while(jetEventPlaneDeltaPhi > (1.5*TMath::Pi())){jetEventPlaneDeltaPhi += -2*TMath::Pi();}
-            while(jetEventPlaneDeltaPhi < (-0.5*TMath::Pi())){jetEventPlaneDeltaPhi += 2*TMath::Pi();}
-
-            // Fill the jet - event plane correlation histograms
-            fillerEventPlane[0] = jetEventPlaneDeltaPhi;  // Axis 0: DeltaPhi between jet and event plane
-            fillerEventPlane[1] = jetPt;                  // Axis 1: Jet pT
-            fillerEventPlane[2] = centrality;             // Axis 2: centrality
-
-            fHistograms->fhCalorimeterJetEventPlane[iFlow]->Fill(fillerEventPlane, fTotalEventWeight);
-          } // Flow order loop
-
-        } // Calorimeter jet loop
-      } // Calorimeter jet if
-
-      //**************************************************
-      //       Second jet loop for jet pT closure
-      //**************************************************
-
-      // Only fill the jet pT closure plots if selected
-      if(!fFillJetPtClosure) continue;
-
-      // Loop over all generator level jets
-      nJets = fEventReader->GetNGeneratorJets();
-      for(Int_t jetIndex = 0; jetIndex < nJets; jetIndex++){
-
-        jetPt = fEventReader->GetGeneratorJetPt(jetIndex);
-        jetPhi = fEventReader->GetGeneratorJetPhi(jetIndex);
-        jetEta = fEventReader->GetGeneratorJetEta(jetIndex);
-
-        // Kinematic cuts for generator level jets
-        if(TMath::Abs(jetEta) >= fJetEtaCut) continue; // Cut for jet eta
-        if(jetPt < fJetClosureMinimumPt) continue;     // Cut for jet pT
-        if(jetPt > fJetMaximumPtCut) continue;         // Cut for super high pT jets
-
-        // For closure plots, we need to find a matching reconstructed jet
-        if(!fEventReader->HasMatchingRecoJet(jetIndex)) continue;
-
-        // Read the reconstructed jet information
-        reconstructedJetPt = fEventReader->GetMatchedRecoPt(jetIndex);
-        reconstructedJetEta = fEventReader->GetMatchedRecoEta(jetIndex);
-        reconstructedJetPhi = fEventReader->GetMatchedRecoPhi(jetIndex);
-        partonFlavor = fEventReader->GetGenJetFlavor(jetIndex);
-
-        // Apply jet energy correction for reconstructed jet
-        fJetCorrector2018->SetJetPT(reconstructedJetPt);
-        fJetCorrector2018->SetJetEta(reconstructedJetEta);
-        fJetCorrector2018->SetJetPhi(reconstructedJetPhi);
-
-        reconstructedJetPt = fJetCorrector2018->GetCorrectedPT();
-          
-        // Apply gaussian smearing to take into account too good jet energy resolution
-        if(fSmearResolution){
-          smearingFactor = GetSmearingFactor(reconstructedJetPt, reconstructedJetEta, centrality);
-          reconstructedJetPt = reconstructedJetPt * fRng->Gaus(1,smearingFactor);
-        }
-
-        // Define index for jet flavor using algoritm: [-6,-1] U [1,6] -> kQuark, 21 -> kGluon, anything else -> kUndetermined
-        jetFlavor = JetBackgroundHistograms::kUndetermined;
-        if(partonFlavor >= -6 && partonFlavor <= 6 && partonFlavor != 0) jetFlavor = JetBackgroundHistograms::kQuark;
-        if(partonFlavor == 21) jetFlavor = JetBackgroundHistograms::kGluon;
-
-        //************************************************
-        //       Fill histograms for jet pT closure
-        //************************************************
-
-        // Fill the different axes for the filler
-        fillerClosure[0] = jetPt;                    // Axis 0: pT of the matched generator level jet
-        fillerClosure[1] = reconstructedJetPt;       // Axis 1: pT of the matched reconstructed jet
-        fillerClosure[2] = jetEta;                   // Axis 2: eta of the jet under consideration
-        fillerClosure[3] = centrality;               // Axis 3: Centrality of the event
-        fillerClosure[4] = jetFlavor;                // Axis 4: Jet flavor type (quark/gluon)
-        fillerClosure[5] = reconstructedJetPt/jetPt; // Axis 5: Reconstructed level jet to generator level jet pT ratio
-        fillerClosure[6] = jetPhi;                   // Axis 6: phi of the jet under consideration
-  
-        // Fill the closure histogram
-        fHistograms->fhJetPtClosure->Fill(fillerClosure,fTotalEventWeight);
-
-      } // Jet pT loop for closures
-      
-    } // Event loop
+    decodeThread.join();
+    FillIndexEventCounts();
     
-    //************************************************
-    //      Cleanup at the end of the file loop
-    //************************************************
+  } else {
     
-    // Close the input files after the event has been read
-    inputFile->Close();
+    // Without the decoding thread each event is analyzed right after it is read
+    DecodeFiles(filePipeline, NULL, rangeBegin, rangeEnd);
     
-  } // File loop
+  }
+  
+  // Record the files that could not be analyzed, or were analyzed only partially, in the output
+  if(filePipeline){
+    for(const TString& skippedFile : filePipeline->GetSkippedFiles()) fSkippedFiles.push_back(skippedFile);
+  }
+  for(const TString& skippedFile : fSkippedFiles) fHistograms->fhSkippedFiles->Fill(skippedFile.Data(), 1);
+  if(fSkippedFiles.size() > 0) cout << "Warning! " << fSkippedFiles.size() << " files could not be read completely. They are listed in the skippedFiles histogram." << endl;
+  
+  // The pipeline needs to be closed before the cache it takes the files from
+  if(filePipeline) delete filePipeline;
+  if(remoteFileCache) delete remoteFileCache;
+  
+  // Record the memory usage of the analysis in the output
+  for(Int_t iFile = 0; iFile < (Int_t)fFileResidentMemory.size(); iFile++){
+    fHistograms->fhFileMemory->SetBinContent(iFile+1, fFileResidentMemory.at(iFile));
+  }
+  fHistograms->fhPeakMemory->SetBinContent(1, fPeakResidentMemory);
+  
+  // The event counter is filled before the event selection, so it is stored as a whole when the records are closed
+  if(fJetRecords){
+    fJetRecords->SetEventCounts(fHistograms->fhEvents);
+    fJetRecords->Close();
+    delete fJetRecords;
+    fJetRecords = NULL;
+  }
+  
+  // Restore the reading settings of ROOT, such that other analyses in the same process are not affected
+  gEnv->SetValue("TFile.AsyncPrefetching", previousAsyncPrefetching);
+  if(fUnzipThreads > 0){
+    TTreeCacheUnzip::SetParallelUnzip(previousParallelUnzip ? TTreeCacheUnzip::kEnable : TTreeCacheUnzip::kDisable);
+    if(!previousImplicitMT) ROOT::DisableImplicitMT();
+  }
   
 }
 
 /*
- * Get the proper vz weighting depending on analyzed system
- *
- *  Arguments:
- *   const Double_t vz = Vertex z position for the event
- *
- *   return: Multiplicative correction factor for vz
- */
-Double_t JetBackgroundAnalyzer::GetVzWeight(const Double_t vz) const{
-  return fVzWeightFunction->Eval(vz); // Weight for 2018 MC
-}
-
-/*
- * Get the proper centrality weighting depending on analyzed system
- *
- *  Arguments:
- *   const Int_t hiBin = CMS hiBin
+ * Analyze the files with ROOT's RDataFrame instead of the hand-written event loop. The forest trees of all the files
+ * are chained, and ROOT divides the entries into tasks that are read and processed in parallel with the implicit
+ * multithreading thread pool. The columns of each entry are copied to the forest reader of the processing slot, and
+ * the event is selected, weighted and analyzed with the same code as in RunAnalysis. Each slot has its own worker
+ * analyzer and histograms, which are added to the total after the event loop.
  *
- *   return: Multiplicative correction factor for the given CMS hiBin
- */
-Double_t JetBackgroundAnalyzer::GetCentralityWeight(const Int_t hiBin) const{
-
-  // No weighting for the most peripheral centrality bins. Different weight function for central and peripheral.
-  if(hiBin < 60) return fCentralityWeightFunctionCentral->Eval(hiBin/2.0);
-  return (hiBin < 194) ? fCentralityWeightFunctionPeripheral->Eval(hiBin/2.0) : 1;
-}
-
-/*
- * Get a smearing factor corresponding to worsening the smearing resolution in MC by 20 %
- * This is obtained by multiplying the MC smearing resolution by 0.666 and using this as additional
- * smearing for the data. Smearing factor depends on jet pT and centrality.
+ * Each distinct file is put to the chain once, even if the file list has several entry ranges of it, for example
+ * pieces made by splitJobs. The sample information of ROOT only has the file name, so the copies of a file could
+ * not be told apart. An entry is analyzed if it is inside any of the ranges given for its file.
  *
- *  Arguments:
- *   Double_t jetPt = Jet pT
- *   const Double_t centrality = Centrality of the event
+ * The entry of an event in its file is needed for the entry ranges and the jet pT smearing. ROOT does not number the
+ * entries by file in the multithreaded event loop, so the entry is read from the event index, which is chained as a
+ * friend of the forest trees. Files without a valid index get one built in EventIndexDirectory before the event loop.
+ * The pT hat of every entry is compared between the index and the forest to make sure that the two are aligned.
  *
- *  return: Additional smearing factor
+ * The column cache, the event plane cache, the remote file cache, jet records, shared dense
+ * histograms and retrying lost files belong to the hand-written loop and are not used here.
  */
-Double_t JetBackgroundAnalyzer::GetSmearingFactor(Double_t jetPt, Double_t jetEta, const Double_t centrality) {
+void JetBackgroundAnalyzer::RunDataFrameAnalysis(){
   
-  // For all the jets above 500 GeV, use the resolution for 500 GeV jet
+  //************************************************
+  //   Configure the reader and the thread pool
+  //************************************************
+  
+  // For 2018 PbPb and 2017 pp data, we need to correct jet pT
+  CreateJetCorrectors();
+  
+  fEventReader = new MonteCarloForestReader(fJetSubtraction, fJetAxis);
+  fEventReader->SetBranchGroups(GetRequiredBranchGroups());
+  
+  if(fUseColumnCache || fUseEventPlaneCache || fUseRemoteFileCache || fJetRecordFileName != "" || fDenseHistograms.any()){
+    cout << "Warning! The caches, the jet records and the shared dense histograms are not used with RDataFrame." << endl;
+  }
+  
+  // With AnalysisThreads 0, ROOT uses all the cores of the machine. If the thread pool is already running, it is used as it is.
+  const Bool_t previousImplicitMT = ROOT::IsImplicitMTEnabled();
+  if(!previousImplicitMT) ROOT::EnableImplicitMT(fAnalysisThreads);
+  
+  // The histograms of the slots are not needed in the global directory, and would only replace each other there
+  const Bool_t addDirectoryStatus = TH1::AddDirectoryStatus();
+  TH1::AddDirectory(kFALSE);
+  
+  //************************************************
+  //      Define the columns of the data frame
+  //************************************************
+  
+  // Each distinct file is chained once, and the entry ranges of all its pieces are collected
+  std::vector<TString> chainFileNames;
+  std::vector<std::vector<std::pair<Int_t,Int_t>>> chainFileRanges;
+  std::vector<TString>::iterator chainFile;
+  Int_t firstEntry, lastEntry;
+  for(Int_t iFile = 0; iFile < (Int_t)fFileNames.size(); iFile++){
+    chainFile = std::find(chainFileNames.begin(), chainFileNames.end(), fFileNames.at(iFile));
+    if(chainFile == chainFileNames.end()){
+      chainFileNames.push_back(fFileNames.at(iFile));
+      chainFileRanges.push_back(std::vector<std::pair<Int_t,Int_t>>());
+      chainFile = chainFileNames.end() - 1;
+    }
+    GetFileEntryRange(iFile, 0, -1, firstEntry, lastEntry);
+    chainFileRanges.at(chainFile - chainFileNames.begin()).push_back(std::make_pair(firstEntry, lastEntry));
+  }
+  
+  std::vector<TChain*> chains;
+  fEventReader->CreateForestChains(chainFileNames, chains);
+  
+  // The events are numbered over all the files in the chain, and the files are identified for the random numbers in the same way as in RunAnalysis
+  chains.at(0)->GetEntries();
+  std::vector<Long64_t> fileFirstEntries(chains.at(0)->GetTreeOffset(), chains.at(0)->GetTreeOffset() + chainFileNames.size() + 1);
+  std::vector<ULong64_t> fileIds;
+  for(const TString& fileName : chainFileNames) fileIds.push_back(CounterRandom::GetFileId(GetLogicalFileName(fileName)));
+  
+  // The entry of each event in its file is read from the event index. The index is built for the files that do not have a valid one yet.
+  std::vector<TString> indexFileNames;
+  std::vector<TString> unindexedFileNames;
+  EventIndex eventIndex;
+  TFile* inputFile;
+  for(Int_t iFile = 0; iFile < (Int_t)chainFileNames.size(); iFile++){
+    indexFileNames.push_back(EventIndex::GetIndexFileName(fEventIndexDirectory, chainFileNames.at(iFile)));
+    inputFile = TFile::Open(chainFileNames.at(iFile));
+    if(!inputFile || inputFile->IsZombie()){
+      cout << "Error! Could not open the file: " << chainFileNames.at(iFile).Data() << endl;
+      assert(0);
+    }
+    if(!eventIndex.Read(indexFileNames.back()) || !eventIndex.Matches(chainFileNames.at(iFile), inputFile->GetUUID().AsString(), fileFirstEntries.at(iFile+1) - fileFirstEntries.at(iFile))){
+      unindexedFileNames.push_back(chainFileNames.at(iFile));
+    }
+    inputFile->Close();
+    delete inputFile;
+  }
+  if(unindexedFileNames.size() > 0){
+    cout << "Building the event index for " << unindexedFileNames.size() << " files to " << fEventIndexDirectory.Data() << endl;
+    JetBackgroundAnalyzer* indexBuilder = new JetBackgroundAnalyzer(unindexedFileNames, fCard);
+    indexBuilder->BuildEventIndex(fEventIndexDirectory, fAnalysisThreads > 0 ? fAnalysisThreads : (Int_t)std::thread::hardware_concurrency());
+    delete indexBuilder;
+  }
+  
+  // The index has one entry for each entry of the forest file, so it can be read as a friend of the chain
+  TChain* indexChain = new TChain("eventIndex");
+  for(const TString& indexFileName : indexFileNames) indexChain->AddFile(indexFileName);
+  chains.at(0)->AddFriend(indexChain, "eventIndex");
+  chains.push_back(indexChain);
+  
+  ROOT::RDataFrame dataFrame(*chains.at(0));
+  ROOT::RDF::RNode frame = dataFrame;
+  const UInt_t nSlots = dataFrame.GetNSlots();
+  
+  // The columns are named after the column cache. Branches that are not read are replaced by empty columns.
+  std::vector<std::string> columns(ForestColumnCache::knCacheColumns);
+  const char* branchName;
+  for(Int_t iColumn = 0; iColumn < ForestColumnCache::knCacheColumns; iColumn++){
+    columns.at(iColumn) = Form("column%d", iColumn);
+    branchName = fEventReader->GetDataFrameColumn(iColumn);
+    if(branchName){
+      frame = frame.Alias(columns.at(iColumn), branchName);
+    } else if(iColumn == ForestColumnCache::kJetRefFlavor || iColumn == ForestColumnCache::kGenParticleSubevent){
+      frame = frame.Define(columns.at(iColumn), [](){ return ROOT::RVec<Int_t>(); });
+    } else {
+      frame = frame.Define(columns.at(iColumn), [](){ return ROOT::RVec<Float_t>(); });
+    }
+  }
+  std::vector<std::string> countColumns(ForestColumnCache::knCacheCollections);
+  for(Int_t iCollection = ForestColumnCache::kReconstructedJets; iCollection <= ForestColumnCache::kCalorimeterJets; iCollection++){
+    countColumns.at(iCollection) = Form("count%d", iCollection);
+    branchName = fEventReader->GetDataFrameCountColumn(iCollection);
+    if(branchName){
+      frame = frame.Alias(countColumns.at(iCollection), branchName);
+    } else {
+      frame = frame.Define(countColumns.at(iCollection), [](){ return 0; });
+    }
+  }
+  
+  //************************************************
+  //      Prepare a worker for each slot
+  //************************************************
+  
+  // Each slot is a separate analyzer configured from the same card, drawing the smearing from the same seed
+  std::vector<JetBackgroundAnalyzer*> workers;
+  std::vector<EventView> eventViews(nSlots);
+  for(UInt_t iSlot = 0; iSlot < nSlots; iSlot++){
+    workers.push_back(new JetBackgroundAnalyzer(fFileNames, fCard));
+    workers.back()->CreateJetCorrectors();
+    workers.back()->fEventReader = new MonteCarloForestReader(*fEventReader);
+    workers.back()->fEventReader->ReadForestFromColumns();
+    workers.back()->fSmearingRandom.SetSeed(fSmearingRandom.GetSeed());
+  }
+  
+  //************************************************
+  //        Select and load the events
+  //************************************************
+  
+  // Find the file of each sample in the chain. When one file name is a part of another, the longest matching name is the file of the sample.
+  frame = frame.DefinePerSample("fileIndex", [&chainFileNames](unsigned int, const ROOT::RDF::RSampleInfo& sample){
+    Int_t fileIndex = -1;
+    for(Int_t iFile = 0; iFile < (Int_t)chainFileNames.size(); iFile++){
+      if(!sample.Contains(chainFileNames.at(iFile).Data())) continue;
+      if(fileIndex < 0 || chainFileNames.at(iFile).Length() > chainFileNames.at(fileIndex).Length()) fileIndex = iFile;
+    }
+    if(fileIndex < 0){
+      cout << "Error! Could not find the file of the sample " << sample.AsString() << " from the file list!" << endl;
+      assert(0);
+    }
+    return fileIndex;
+  });
+  
+  // The entry ranges of the file and the pT hat range are checked for every entry, before the jets and particles are read.
+  // The pT hat of the index must be the same as in the forest, otherwise the index is not aligned with the forest entries.
+  frame = frame.Filter([this, &chainFileNames, &chainFileRanges](Int_t fileIndex, Int_t fileEntry, Float_t ptHat, Float_t indexPtHat){
+    if(ptHat != indexPtHat){
+      cout << "Error! The event index does not match the entry " << fileEntry << " of the file " << chainFileNames.at(fileIndex).Data() << endl;
+      assert(0);
+    }
+    Bool_t inRange = false;
+    for(const std::pair<Int_t,Int_t>& range : chainFileRanges.at(fileIndex)){
+      if(fileEntry >= range.first && (range.second < 0 || fileEntry < range.second)) inRange = true;
+    }
+    return inRange && ptHat >= fMinimumPtHat && ptHat < fMaximumPtHat;
+  }, {"fileIndex", "eventIndex.entry", columns.at(ForestColumnCache::kPtHat), "eventIndex.ptHat"});
+  
+  // Copy the collections to the reader of the slot. The number of values in each collection is given to the analysis.
+  frame = frame.DefineSlot("reconstructedJets", [&workers](unsigned int slot, Int_t nJets, const ROOT::RVec<Float_t>& jetPt, const ROOT::RVec<Float_t>& jetPhi, const ROOT::RVec<Float_t>& jetWTAPhi, const ROOT::RVec<Float_t>& jetEta, const ROOT::RVec<Float_t>& jetWTAEta, const ROOT::RVec<Float_t>& jetRawPt, const ROOT::RVec<Float_t>& jetMaxTrackPt, const ROOT::RVec<Float_t>& jetRefPt, const ROOT::RVec<Float_t>& jetRefEta, const ROOT::RVec<Float_t>& jetRefPhi, const ROOT::RVec<Int_t>& jetRefFlavor){
+    MonteCarloForestReader* reader = workers.at(slot)->fEventReader;
+    reader->SetCollectionSize(ForestColumnCache::kReconstructedJets, nJets);
+    reader->LoadColumnValues(ForestColumnCache::kJetPt, jetPt.size(), jetPt.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetPhi, jetPhi.size(), jetPhi.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetWTAPhi, jetWTAPhi.size(), jetWTAPhi.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetEta, jetEta.size(), jetEta.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetWTAEta, jetWTAEta.size(), jetWTAEta.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetRawPt, jetRawPt.size(), jetRawPt.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetMaxTrackPt, jetMaxTrackPt.size(), jetMaxTrackPt.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetRefPt, jetRefPt.size(), jetRefPt.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetRefEta, jetRefEta.size(), jetRefEta.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetRefPhi, jetRefPhi.size(), jetRefPhi.data());
+    reader->LoadColumnValues(ForestColumnCache::kJetRefFlavor, jetRefFlavor.size(), jetRefFlavor.data());
+    return nJets;
+  }, {countColumns.at(ForestColumnCache::kReconstructedJets), columns.at(ForestColumnCache::kJetPt), columns.at(ForestColumnCache::kJetPhi), columns.at(ForestColumnCache::kJetWTAPhi), columns.at(ForestColumnCache::kJetEta), columns.at(ForestColumnCache::kJetWTAEta), columns.at(ForestColumnCache::kJetRawPt), columns.at(ForestColumnCache::kJetMaxTrackPt), columns.at(ForestColumnCache::kJetRefPt), columns.at(ForestColumnCache::kJetRefEta), columns.at(ForestColumnCache::kJetRefPhi), columns.at(ForestColumnCache::kJetRefFlavor)});
+  
+  frame = frame.DefineSlot("generatorJets", [&workers](unsigned int slot, Int_t nJets, const ROOT::RVec<Float_t>& jetPt, const ROOT::RVec<Float_t>& jetPhi, const ROOT::RVec<Float_t>& jetWTAPhi, const ROOT::RVec<Float_t>& jetEta, const ROOT::RVec<Float_t>& jetWTAEta){
+    MonteCarloForestReader* reader = workers.at(slot)->fEventReader;
+    reader->SetCollectionSize(ForestColumnCache::kGeneratorJets, nJets);
+    reader->LoadColumnValues(ForestColumnCache::kGenJetPt, jetPt.size(), jetPt.data());
+    reader->LoadColumnValues(ForestColumnCache::kGenJetPhi, jetPhi.size(), jetPhi.data());
+    reader->LoadColumnValues(ForestColumnCache::kGenJetWTAPhi, jetWTAPhi.size(), jetWTAPhi.data());
+    reader->LoadColumnValues(ForestColumnCache::kGenJetEta, jetEta.size(), jetEta.data());
+    reader->LoadColumnValues(ForestColumnCache::kGenJetWTAEta, jetWTAEta.size(), jetWTAEta.data());
+    return nJets;
+  }, {countColumns.at(ForestColumnCache::kGeneratorJets), columns.at(ForestColumnCache::kGenJetPt), columns.at(ForestColumnCache::kGenJetPhi), columns.at(ForestColumnCache::kGenJetWTAPhi), columns.at(ForestColumnCache::kGenJetEta), columns.at(ForestColumnCache::kGenJetWTAEta)});
+  
+  frame = frame.DefineSlot("calorimeterJets", [&workers](unsigned int slot, Int_t nJets, const ROOT::RVec<Float_t>& jetPt, const ROOT::RVec<Float_t>& jetPhi, const ROOT::RVec<Float_t>& jetEta){
+    MonteCarloForestReader* reader = workers.at(slot)->fEventReader;
+    reader->SetCollectionSize(ForestColumnCache::kCalorimeterJets, nJets);
+    reader->LoadColumnValues(ForestColumnCache::kCaloJetPt, jetPt.size(), jetPt.data());
+    reader->LoadColumnValues(ForestColumnCache::kCaloJetPhi, jetPhi.size(), jetPhi.data());
+    reader->LoadColumnValues(ForestColumnCache::kCaloJetEta, jetEta.size(), jetEta.data());
+    return nJets;
+  }, {countColumns.at(ForestColumnCache::kCalorimeterJets), columns.at(ForestColumnCache::kCaloJetPt), columns.at(ForestColumnCache::kCaloJetPhi), columns.at(ForestColumnCache::kCaloJetEta)});
+  
+  frame = frame.DefineSlot("generatorParticles", [&workers](unsigned int slot, const ROOT::RVec<Float_t>& particlePt, const ROOT::RVec<Float_t>& particlePhi, const ROOT::RVec<Float_t>& particleEta, const ROOT::RVec<Int_t>& particleSubevent){
+    MonteCarloForestReader* reader = workers.at(slot)->fEventReader;
+    reader->LoadColumnValues(ForestColumnCache::kGenParticlePt, particlePt.size(), particlePt.data());
+    reader->LoadColumnValues(ForestColumnCache::kGenParticlePhi, particlePhi.size(), particlePhi.data());
+    reader->LoadColumnValues(ForestColumnCache::kGenParticleEta, particleEta.size(), particleEta.data());
+    reader->LoadColumnValues(ForestColumnCache::kGenParticleSubevent, particleSubevent.size(), particleSubevent.data());
+    return (Int_t)particlePt.size();
+  }, {columns.at(ForestColumnCache::kGenParticlePt), columns.at(ForestColumnCache::kGenParticlePhi), columns.at(ForestColumnCache::kGenParticleEta), columns.at(ForestColumnCache::kGenParticleSubevent)});
+  
+  //************************************************
+  //           Analyze the selected events
+  //************************************************
+  
+  // The collection sizes are taken as arguments such that the collections are copied to the reader before the event is analyzed
+  frame.ForeachSlot([&](unsigned int slot, Int_t fileIndex, Int_t fileEntry, Float_t vz, Int_t hiBin, Float_t ptHat, Float_t eventWeight, Int_t primaryVertexFilterBit, Int_t hfCoincidenceFilterBit, Int_t clusterCompatibilityFilterBit, Int_t nJets, Int_t nGenJets, Int_t nCaloJets, Int_t nParticles){
+    JetBackgroundAnalyzer* worker = workers.at(slot);
+    EventView* eventView = &eventViews.at(slot);
+    
+    worker->fEventReader->LoadEventInformationFromColumns(vz, hiBin, ptHat, eventWeight, primaryVertexFilterBit, hfCoincidenceFilterBit, clusterCompatibilityFilterBit);
+    worker->fEventReader->FillEventInformation(eventView);
+    eventView->fHasEventPlane = false;
+    eventView->fVzWeight = worker->GetVzWeight(eventView->fVz);
+    eventView->fCentralityWeight = worker->GetCentralityWeight(eventView->fHiBin);
+    worker->fEventReader->FillEventCollections(eventView);
+    eventView->fEntry = fileFirstEntries.at(fileIndex) + fileEntry;
+    eventView->fFileId = fileIds.at(fileIndex);
+    eventView->fFileEntry = fileEntry;
+    
+    worker->AnalyzeEvent(eventView);
+  }, {"fileIndex", "eventIndex.entry", columns.at(ForestColumnCache::kVz), columns.at(ForestColumnCache::kHiBin), columns.at(ForestColumnCache::kPtHat), columns.at(ForestColumnCache::kEventWeight), columns.at(ForestColumnCache::kPrimaryVertexFilterBit), columns.at(ForestColumnCache::kHfCoincidenceFilterBit), columns.at(ForestColumnCache::kClusterCompatibilityFilterBit), "reconstructedJets", "generatorJets", "calorimeterJets", "generatorParticles"});
+  
+  //************************************************
+  //        Collect the results of the slots
+  //************************************************
+  
+  // The slots analyze different events in each run, so the sums can differ from the event loop in the last digits
+  for(JetBackgroundAnalyzer* worker : workers){
+    fHistograms->Add(worker->fHistograms);
+    delete worker;
+  }
+  for(TChain* chain : chains) delete chain;
+  
+  if(!previousImplicitMT) ROOT::DisableImplicitMT();
+  TH1::AddDirectory(addDirectoryStatus);
+}
+
+/*
+ * Create the jet energy correctors for particle flow and calorimeter jets
+ */
+void JetBackgroundAnalyzer::CreateJetCorrectors(){
+  
+  // For 2018 PbPb and 2017 pp data, we need to correct jet pT
+  std::string correctionFileRelative = "jetEnergyCorrections/Autumn18_HI_V8_MC_L2Relative_AK4PF.txt";
+  std::string correctionFileCalo = "jetEnergyCorrections/Autumn18_HI_V8_MC_L2Relative_AK4Calo.txt";
+  
+  vector<string> correctionFiles;
+  correctionFiles.push_back(correctionFileRelative);
+  fJetCorrector2018 = new JetCorrector(correctionFiles);
+
+  vector<string> correctionFilesCalo;
+  correctionFilesCalo.push_back(correctionFileCalo);
+  fCaloJetCorrector2018 = new JetCorrector(correctionFilesCalo);
+  
+  // The jet candidate check in staged loading can run in the decoding thread, so it needs its own correctors
+  if(fStagedEventLoading){
+    fCandidateJetCorrector = new JetCorrector(correctionFiles);
+    fCandidateCaloJetCorrector = new JetCorrector(correctionFilesCalo);
+  }
+}
+
+/*
+ * Analyze the files with several worker threads. The files are split into tasks, which are ranges of entries in one
+ * file. Each worker has its own forest readers, jet correctors, weight functions and random number generator, and
+ * fills a separate histogram set for each task. The histogram sets are added to the total in the task order, and
+ * the random numbers are seeded separately for each task, so the histograms do not depend on the number of threads.
+ *
+ *  Arguments:
+ *   const std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>>& fileBranchGroups = Branch groups read from each file. Empty if the same groups are read from all files
+ *   RemoteFileCache* remoteFileCache = Cache providing local copies of remote files. NULL if remote files are streamed
+ */
+void JetBackgroundAnalyzer::AnalyzeFilesInThreads(const std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>>& fileBranchGroups, RemoteFileCache* remoteFileCache){
+  
+  // Several threads use ROOT at the same time
+  ROOT::EnableThreadSafety();
+  
+  // The histograms of the workers are not needed in the global directory, and would only replace each other there
+  const Bool_t addDirectoryStatus = TH1::AddDirectoryStatus();
+  TH1::AddDirectory(kFALSE);
+  
+  // Pool of histogram sets for the tasks. Two sets for each worker let the workers continue while the merge is behind.
+  std::vector<JetBackgroundHistograms*> histogramPool;
+  for(Int_t iSet = 0; iSet < 2*fAnalysisThreads; iSet++){
+    histogramPool.push_back(new JetBackgroundHistograms(fCard));
+    histogramPool.back()->SetNumberOfFiles(fFileNames.size());
+    histogramPool.back()->CreateHistograms();
+  }
+  
+  // The selected THnSparses are filled by all the workers to shared dense histograms instead of the histograms of each task
+  if(fDenseHistograms.any()){
+    fHistograms->CreateDenseHistograms(fDenseHistograms);
+    for(JetBackgroundHistograms* histograms : histogramPool) histograms->ShareDenseHistograms(fHistograms);
+    if(fDebugLevel > 0) cout << "Shared dense histograms use " << fHistograms->GetDenseHistogramMemory() << " MB" << endl;
+  }
+  AnalysisTaskQueue taskQueue(histogramPool);
+  
+  // Split the files into tasks
+  std::vector<Int_t> taskFiles;
+  std::vector<Int_t> taskFirstEntries;
+  std::vector<Int_t> taskLastEntries;
+  FindTaskRanges(fThreadTaskEntries, fAnalysisThreads, taskFiles, taskFirstEntries, taskLastEntries);
+  for(Int_t iTask = 0; iTask < (Int_t)taskFiles.size(); iTask++){
+    taskQueue.AddTask(taskFiles.at(iTask), taskFirstEntries.at(iTask), taskLastEntries.at(iTask));
+  }
+  taskQueue.AssignTasks(fAnalysisThreads);
+  if(fDebugLevel > 0) cout << "Analyzing " << taskQueue.GetNTasks() << " tasks with " << fAnalysisThreads << " threads" << endl;
+  
+  // All the workers draw the smearing from the same seed, so the result does not depend on which worker analyzes a jet
+  const ULong64_t baseSeed = fSmearingRandom.GetSeed();
+  
+  // Each worker is a separate analyzer configured from the same card
+  std::vector<JetBackgroundAnalyzer*> workers;
+  std::vector<std::thread> workerThreads;
+  for(Int_t iWorker = 0; iWorker < fAnalysisThreads; iWorker++){
+    workers.push_back(new JetBackgroundAnalyzer(fFileNames, fCard));
+    workers.back()->CreateJetCorrectors();
+    workers.back()->fEventReader = new MonteCarloForestReader(*fEventReader);
+    workerThreads.push_back(std::thread(&JetBackgroundAnalyzer::AnalyzeTasks, workers.back(), iWorker, &taskQueue, &fileBranchGroups, remoteFileCache, baseSeed));
+  }
+  
+  // Merge the tasks in order while the workers are running
+  taskQueue.MergeTasks(fHistograms);
+  for(std::thread& workerThread : workerThreads) workerThread.join();
+  fHistograms->FlushDenseHistograms();
+  
+  // Collect the files that could not be read and the memory usage from all the tasks
+  for(const TString& skippedFile : taskQueue.GetSkippedFiles()) fSkippedFiles.push_back(skippedFile);
+  fPeakResidentMemory = 0;
+  fFileResidentMemory.assign(fFileNames.size(), 0);
+  for(Int_t iTask = 0; iTask < taskQueue.GetNTasks(); iTask++){
+    fFileResidentMemory.at(taskQueue.GetFileIndex(iTask)) = TMath::Max(fFileResidentMemory.at(taskQueue.GetFileIndex(iTask)), taskQueue.GetResidentMemory(iTask));
+    fPeakResidentMemory = TMath::Max(fPeakResidentMemory, taskQueue.GetResidentMemory(iTask));
+  }
+  
+  // Record the time used for each task and by each worker for tuning the task size
+  for(Int_t iTask = 0; iTask < taskQueue.GetNTasks(); iTask++){
+    fHistograms->fhTaskTime->Fill(Form("%d:%d-%d", taskQueue.GetFileIndex(iTask), taskQueue.GetFirstEntry(iTask), taskQueue.GetLastEntry(iTask)), taskQueue.GetTaskTime(iTask));
+    fHistograms->fhWorkerTime->Fill(Form("worker %d", taskQueue.GetTaskWorker(iTask)), taskQueue.GetTaskTime(iTask));
+  }
+  if(fDebugLevel > 0) cout << taskQueue.GetNStolenTasks() << " tasks were stolen by idle workers" << endl;
+  
+  for(JetBackgroundAnalyzer* worker : workers) delete worker;
+  for(JetBackgroundHistograms* histograms : histogramPool) delete histograms;
+  TH1::AddDirectory(addDirectoryStatus);
+}
+
+/*
+ * Split the input files into ranges of entries that can be analyzed independently. Without a task size, each file
+ * is one range. Otherwise the files are split into ranges of at least the given number of entries. The ranges start
+ * at cluster boundaries of the jet tree, so no cluster is read for two ranges. The clusters of each file are found by
+ * checking the files first. Files that cannot be checked are given as one range, so the problem is seen in the analysis.
+ * If an entry range is set for a file, only the entries in that range are split.
+ *
+ *  Arguments:
+ *   const Int_t taskEntries = Minimum number of entries in one range. 0 = One range for each file
+ *   const Int_t nThreads = Number of threads used to check the files
+ *   std::vector<Int_t>& fileIndices = Index of the file of each range in the file list
+ *   std::vector<Int_t>& firstEntries = First entry of each range
+ *   std::vector<Int_t>& lastEntries = Entry after the last entry of each range. -1 = End of the file
+ */
+void JetBackgroundAnalyzer::FindTaskRanges(const Int_t taskEntries, const Int_t nThreads, std::vector<Int_t>& fileIndices, std::vector<Int_t>& firstEntries, std::vector<Int_t>& lastEntries){
+  
+  fileIndices.clear();
+  firstEntries.clear();
+  lastEntries.clear();
+  
+  FileManifest manifest;
+  if(taskEntries > 0) manifest = ValidateFiles(nThreads);
+  
+  Int_t nEntries;
+  Int_t firstEntry;
+  Int_t lastEntry;
+  for(Int_t iFile = 0; iFile < (Int_t)fFileNames.size(); iFile++){
+    GetFileEntryRange(iFile, 0, -1, firstEntry, lastEntry);
+    if(taskEntries <= 0 || !manifest.IsGood(iFile) || manifest.fnEntries.at(iFile) == 0){
+      fileIndices.push_back(iFile);
+      firstEntries.push_back(firstEntry);
+      lastEntries.push_back(lastEntry);
+      continue;
+    }
+    nEntries = (lastEntry < 0) ? manifest.fnEntries.at(iFile) : TMath::Min((Long64_t)lastEntry, manifest.fnEntries.at(iFile));
+    for(const Long64_t clusterStart : manifest.fClusterStarts.at(iFile)){
+      if(clusterStart >= nEntries) break;
+      if(clusterStart - firstEntry < taskEntries) continue;
+      fileIndices.push_back(iFile);
+      firstEntries.push_back(firstEntry);
+      lastEntries.push_back(clusterStart);
+      firstEntry = clusterStart;
+    }
+    fileIndices.push_back(iFile);
+    firstEntries.push_back(firstEntry);
+    lastEntries.push_back(nEntries);
+  }
+}
+
+/*
+ * Analyze tasks taken from the task queue until all the tasks are taken. This is run in a worker analyzer, which
+ * fills the histogram set given with each task instead of its own histograms.
+ *
+ *  Arguments:
+ *   const Int_t workerIndex = Index of the worker in the task queue
+ *   AnalysisTaskQueue* taskQueue = Queue from which the tasks are taken and to which the filled histograms are given
+ *   const std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>>* fileBranchGroups = Branch groups read from each file. Empty if the same groups are read from all files
+ *   RemoteFileCache* remoteFileCache = Cache providing local copies of remote files. NULL if remote files are streamed
+ *   const ULong64_t baseSeed = Seed for the random numbers, shared by all the workers
+ */
+void JetBackgroundAnalyzer::AnalyzeTasks(const Int_t workerIndex, AnalysisTaskQueue* taskQueue, const std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>>* fileBranchGroups, RemoteFileCache* remoteFileCache, const ULong64_t baseSeed){
+  
+  JetBackgroundHistograms* workerHistograms = fHistograms;
+  JetBackgroundHistograms* taskHistograms;
+  std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>> taskBranchGroups;
+  Int_t taskIndex;
+  Int_t fileIndex;
+  std::chrono::steady_clock::time_point taskStart;
+  
+  // The random numbers of a task do not depend on which worker analyzes it
+  fSmearingRandom.SetSeed(baseSeed);
+  
+  while(taskQueue->TakeTask(workerIndex, taskIndex, taskHistograms)){
+    
+    taskStart = std::chrono::steady_clock::now();
+    
+    fHistograms = taskHistograms;
+    fSkippedFiles.clear();
+    
+    // Analyze the range of entries through a pipeline containing only the file of the task
+    fileIndex = taskQueue->GetFileIndex(taskIndex);
+    taskBranchGroups.clear();
+    if(!fileBranchGroups->empty()) taskBranchGroups.push_back(fileBranchGroups->at(fileIndex));
+    ForestFilePipeline filePipeline(std::vector<TString>(1, fFileNames.at(fileIndex)), *fEventReader, false, fUseColumnCache ? fColumnCacheDirectory : "", taskBranchGroups, remoteFileCache);
+    filePipeline.SetRetryPolicy(fFileOpenAttempts, fFileRetryDelay);
+    filePipeline.SetColumnCacheRevalidation(fRevalidateColumnCache);
+    DecodeFiles(&filePipeline, NULL, taskQueue->GetFirstEntry(taskIndex), taskQueue->GetLastEntry(taskIndex));
+    
+    for(const TString& skippedFile : filePipeline.GetSkippedFiles()) fSkippedFiles.push_back(skippedFile);
+    taskQueue->FinishTask(taskIndex, fSkippedFiles, fPeakResidentMemory, std::chrono::duration<Double_t>(std::chrono::steady_clock::now() - taskStart).count());
+  }
+  
+  // The task histograms belong to the queue, so give the worker its own histograms back before it is deleted
+  fHistograms = workerHistograms;
+}
+
+/*
+ * Loop over all the files in the pipeline and read the events to event views. Without an event ring, each
+ * event is analyzed directly after reading. With an event ring, the events are published to the ring and
+ * analyzed in another thread. The histograms, weights and random numbers are only touched in the analysis,
+ * so this can run in a separate thread.
+ *
+ *  Arguments:
+ *   ForestFilePipeline* filePipeline = Pipeline providing the input files
+ *   EventViewRing* eventRing = Ring to which the events are published. NULL if events should be analyzed directly
+ *   const Int_t rangeBegin = First entry analyzed from each file
+ *   const Int_t rangeEnd = Entry after the last entry analyzed from each file. -1 = End of the file
+ */
+void JetBackgroundAnalyzer::DecodeFiles(ForestFilePipeline* filePipeline, EventViewRing* eventRing, const Int_t rangeBegin, const Int_t rangeEnd){
+  
+  // Input files and forest readers for analysis
+  TFile* inputFile;
+  MonteCarloForestReader* fileReader;
+  Long64_t firstEntry;
+  ULong64_t fileId;
+  
+  // Event variables
+  Int_t nEvents = 0;                // Number of events
+  EventView localEventView;         // Information from the current event when there is no event ring
+  EventView* eventView = &localEventView;
+  
+  // Event index for the current file
+  EventIndex eventIndex;                  // Event information for all the entries in the file
+  Bool_t hasEventIndex;                   // True if there is a valid event index for the current file
+  std::vector<Long64_t> selectedEntries;  // Entries inside the pT hat range when an event index is used
+  EventView indexEventView;               // Event information from the index for the event selection
+  Int_t nPassedEntries;                   // Number of selected entries passing the event cuts
+  Int_t iEvent;                           // Entry in the current file
+  
+  // Range of analyzed entries in the current file
+  Bool_t fullFile;                        // True if all the entries in the file are analyzed
+  Int_t firstSelectedEvent;               // First analyzed entry, or position in the selected entries with an event index
+  Int_t lastSelectedEvent;                // Entry after the last analyzed entry, or the number of selected entries with an event index
+  
+  // Event plane cache for the current file
+  EventPlaneCache eventPlaneCache;        // Event plane Q-vectors for all the entries in the file
+  Bool_t hasEventPlaneCache;              // True if there is a valid event plane cache for the current file
+  Bool_t buildEventPlaneCache;            // True if the event plane cache is built for the current file during the analysis
+  TString eventPlaneCacheFile;            // Name of the event plane cache file for the current file
+  
+  // File name helper variables
+  TString currentFile;
+  TString sourceUUID;                     // UUID of the current forest file. The sidecar files need to match this
+  
+  // Files where the access is lost in the middle are opened again, or skipped from that point on
+  Bool_t lostFile;
+  
+  // Memory usage is sampled during the file loop
+  Bool_t memoryWarningGiven;
+  fPeakResidentMemory = 0;
+  fFileResidentMemory.assign(filePipeline->GetNFiles(), 0);
+  
+  // Events rejected with the event index are counted without reading them
+  fIndexEventCounts.assign(JetBackgroundHistograms::knEventTypes, 0);
+  
+  // Loop over files
+  while(filePipeline->NextFile()) {
+    
+    //************************************************
+    //       Get the opened file from the pipeline
+    //************************************************
+    
+    // The pipeline has already checked that the file exists, is open and is not a zombie
+    currentFile = filePipeline->GetFileName();
+    sourceUUID = filePipeline->GetSourceUUID();
+    inputFile = filePipeline->GetFile();
+    fileReader = filePipeline->GetReader();
+    firstEntry = filePipeline->GetFirstEntry();
+    fileId = CounterRandom::GetFileId(GetLogicalFileName(currentFile));
+    
+    // Print the used files
+    if(fDebugLevel > 0) cout << "Reading from file: " << currentFile.Data() << endl;
+    if(fDebugLevel > 0) fileReader->PrintPrunedBranches();
+
+    nEvents = fileReader->GetNEvents();
+    memoryWarningGiven = false;
+    lostFile = false;
+    
+    // In the multithreaded analysis, a file can be split into several entry ranges analyzed separately.
+    // A file can also be split between several jobs with entry ranges given in the file list.
+    GetFileEntryRange(filePipeline->GetFileIndex(), rangeBegin, rangeEnd, firstSelectedEvent, lastSelectedEvent);
+    fullFile = (firstSelectedEvent <= 0 && (lastSelectedEvent < 0 || lastSelectedEvent >= nEvents));
+    lastSelectedEvent = (lastSelectedEvent < 0) ? nEvents : TMath::Min(lastSelectedEvent, nEvents);
+    
+    //************************************************
+    //     Find the event plane cache for the file
+    //************************************************
+    
+    // With a valid event plane cache, the generator level particles are not needed. Otherwise the cache is built
+    // during the analysis, which requires that the particles are read for every entry in the file. If only a part of
+    // the file is analyzed, the cache is not built and the event plane is determined from the particles as usual.
+    hasEventPlaneCache = false;
+    buildEventPlaneCache = false;
+    if(fUseEventPlaneCache){
+      eventPlaneCacheFile = EventPlaneCache::GetCacheFileName(fEventPlaneCacheDirectory, currentFile, fMaxParticleEtaEventPlane, fMaxParticlePtEventPlane, fnEventPlaneOrders);
+      hasEventPlaneCache = eventPlaneCache.Read(eventPlaneCacheFile) && eventPlaneCache.Matches(currentFile, sourceUUID, nEvents, fMaxParticleEtaEventPlane, fMaxParticlePtEventPlane, fnEventPlaneOrders);
+      if(!hasEventPlaneCache){
+        buildEventPlaneCache = fullFile;
+        if(buildEventPlaneCache) eventPlaneCache.Reset(currentFile, sourceUUID, nEvents, fMaxParticleEtaEventPlane, fMaxParticlePtEventPlane, fnEventPlaneOrders);
+        
+        // If the cache looked valid before the file was opened, the particle branches are not connected. Connect them now.
+        if(!fileReader->GetBranchGroups().test(MonteCarloForestReader::kGeneratorParticles)){
+          cout << "Warning! The event plane cache for the file " << currentFile.Data() << " is stale. Reading the particles again." << endl;
+          fileReader->SetBranchGroups(GetRequiredBranchGroups());
+          if(inputFile) fileReader->ReadForestFromFile(inputFile);
+        }
+      }
+      if(fDebugLevel > 0){
+        if(hasEventPlaneCache) cout << "Using event plane cache " << eventPlaneCacheFile.Data() << endl;
+        else if(buildEventPlaneCache) cout << "Building event plane cache " << eventPlaneCacheFile.Data() << endl;
+      }
+    }
+    
+    //************************************************
+    //     Find the event index for the file
+    //************************************************
+    
+    // With a valid event index, only the entries inside the pT hat range are visited
+    hasEventIndex = false;
+    if(fUseEventIndex){
+      hasEventIndex = eventIndex.Read(EventIndex::GetIndexFileName(fEventIndexDirectory, currentFile));
+      if(hasEventIndex && !eventIndex.Matches(currentFile, sourceUUID, nEvents)){
+        cout << "Warning! The event index for the file " << currentFile.Data() << " is stale. Reading the event information from the forest." << endl;
+        hasEventIndex = false;
+      }
+      // The event plane cache needs all the entries in the file, so the pT hat preselection is not done when it is built
+      if(hasEventIndex && buildEventPlaneCache){
+        selectedEntries = eventIndex.GetEntriesInPtHatRange(0, std::numeric_limits<Double_t>::max());
+      } else if(hasEventIndex){
+        selectedEntries = eventIndex.GetEntriesInPtHatRange(fMinimumPtHat, fMaximumPtHat);
+      }
+      
+      // Only keep the selected entries inside the analyzed range
+      if(hasEventIndex){
+        selectedEntries.erase(std::remove_if(selectedEntries.begin(), selectedEntries.end(), [firstSelectedEvent, lastSelectedEvent](Long64_t entry){ return entry < firstSelectedEvent || entry >= lastSelectedEvent; }), selectedEntries.end());
+        if(fDebugLevel > 0) cout << "Using event index with " << selectedEntries.size() << " entries in the pT hat range" << endl;
+      }
+      
+      // The entries failing the event cuts are counted directly from the index and are not visited in the event loop.
+      // The remaining entries are given to the reader as an entry list, such that the read cache skips the baskets
+      // that only contain rejected events. When the event plane cache is built, all the entries need to be read.
+      if(hasEventIndex && !buildEventPlaneCache){
+        nPassedEntries = 0;
+        for(const Long64_t entry : selectedEntries){
+          eventIndex.FillEventInformation(entry, &indexEventView);
+          if(PassEventCuts(&indexEventView, false)){
+            selectedEntries[nPassedEntries++] = entry;
+            continue;
+          }
+          
+          // The passed entries are counted in the analysis. Here only the rejected ones are counted.
+          fIndexEventCounts.at(JetBackgroundHistograms::kAll)++;
+          PassEventCuts(&indexEventView, false, fIndexEventCounts.data());
+        }
+        selectedEntries.resize(nPassedEntries);
+        fileReader->SetEntryList(selectedEntries);
+        if(fDebugLevel > 0) cout << "Reading " << nPassedEntries << " entries passing the event cuts" << endl;
+      }
+      
+      if(hasEventIndex){
+        firstSelectedEvent = 0;
+        lastSelectedEvent = selectedEntries.size();
+      } else if(fDebugLevel > 0){
+        cout << "No event index found for the file" << endl;
+      }
+    }
+
+    //************************************************
+    //         Main event loop for each file
+    //************************************************
+    
+    for(Int_t iSelectedEvent = firstSelectedEvent; iSelectedEvent < lastSelectedEvent; iSelectedEvent++){
+      
+      // Without an event index all the entries in the file are visited
+      iEvent = hasEventIndex ? selectedEntries[iSelectedEvent] : iSelectedEvent;
+
+      // For each event, chack that the file stays open:
+      // This is to try to combat file read errors occasionally happening during CRAB running.
+      // If the file is lost, it is opened again, possibly through another redirector, and the analysis continues
+      // from the same entry. Column caches are read without opening the file.
+      if(inputFile && (!inputFile->IsOpen() || inputFile->IsZombie())){
+        cout << "Warning! Lost access to the file: " << currentFile.Data() << endl;
+        if(!filePipeline->ReopenFile()){
+          cout << "Warning! Could not open the file again. Skipping the remaining events after entry " << iEvent << endl;
+          fSkippedFiles.push_back(Form("%s (from entry %d)", currentFile.Data(), iEvent));
+          lostFile = true;
+          break;
+        }
+        inputFile = filePipeline->GetFile();
+        
+        // The entry lists are released together with the trees of the lost file
+        if(hasEventIndex && !buildEventPlaneCache) fileReader->SetEntryList(selectedEntries);
+      }
+      
+      // Print to console how the analysis is progressing and check that the memory use stays below the limit
+      if(fDebugLevel > 1 && iSelectedEvent % 1000 == 0) cout << "Analyzing event " << iEvent << endl;
+      if(iSelectedEvent % 1000 == 0) UpdateMemoryUsage(currentFile, memoryWarningGiven);
+      
+      // Get a free slot from the ring. This waits if the analysis is behind by the full depth of the ring.
+      // A slot that is not committed is given again for the next event.
+      if(eventRing) eventView = eventRing->BeginWrite();
+      
+      // Read the event from the forest to the event view. Events are indexed globally over all the files.
+      // The entry is set first, since the jet pT smearing in staged loading depends on it.
+      eventView->fEntry = firstEntry + iEvent;
+      eventView->fFileId = fileId;
+      eventView->fFileEntry = iEvent;
+      if(!ReadEvent(fileReader, iEvent, eventView, hasEventIndex ? &eventIndex : NULL, (hasEventPlaneCache || buildEventPlaneCache) ? &eventPlaneCache : NULL, buildEventPlaneCache, eventRing != NULL)) continue;
+      
+      // Pass the event to the analysis thread or analyze it directly
+      if(eventRing){
+        eventRing->CommitWrite();
+      } else {
+        AnalyzeEvent(eventView);
+      }
+      
+    } // Event loop
+    
+    //************************************************
+    //      Cleanup at the end of the file loop
+    //************************************************
+    
+    // Print the amount of remote read calls needed for the file to monitor the efficiency of the read cache
+    if(fDebugLevel > 0 && inputFile && !lostFile) cout << "Read " << inputFile->GetBytesRead()/(1024*1024) << " MB from the file using " << inputFile->GetReadCalls() << " read calls" << endl;
+    
+    // Write the event plane cache built for this file, such that the next runs do not need to read the particles
+    if(buildEventPlaneCache && !lostFile){
+      gSystem->mkdir(fEventPlaneCacheDirectory, kTRUE);
+      eventPlaneCache.Write(eventPlaneCacheFile);
+    }
+    
+    // Record the memory use at the end of the file. The pipeline releases the file when moving to the next one.
+    fFileResidentMemory.at(filePipeline->GetFileIndex()) = UpdateMemoryUsage(currentFile, memoryWarningGiven);
+    if(fDebugLevel > 0) cout << "Resident memory at the end of the file: " << fFileResidentMemory.at(filePipeline->GetFileIndex()) << " MB" << endl;
+    
+  } // File loop
+  
+  // Tell the analysis thread that there are no more events coming
+  if(eventRing) eventRing->Finish();
+  
+  // Without an event ring, the histograms belong to this thread and the events counted from the index can be added
+  // directly. With an event ring, they are added after the analysis thread has finished.
+  if(!eventRing) FillIndexEventCounts();
+  
+}
+
+/*
+ * Add the events counted from the event index in DecodeFiles to the event counter histogram. Each counted event
+ * is filled separately, such that the counter is the same as when the events are visited in the event loop.
+ */
+void JetBackgroundAnalyzer::FillIndexEventCounts(){
+  for(Int_t iEventType = 0; iEventType < (Int_t)fIndexEventCounts.size(); iEventType++){
+    for(Long64_t iCount = 0; iCount < fIndexEventCounts.at(iEventType); iCount++){
+      fHistograms->fhEvents->Fill(iEventType);
+    }
+  }
+  fIndexEventCounts.assign(JetBackgroundHistograms::knEventTypes, 0);
+}
+
+/*
+ * Build the event index for all the input files. The files are divided dynamically between the given number of
+ * threads. Only the event information branches are read, so this is a quick pass compared to the full analysis.
+ *
+ *  Arguments:
+ *   const TString outputDirectory = Directory to which the event index files are written
+ *   const Int_t nThreads = Number of threads used to build the index
+ */
+void JetBackgroundAnalyzer::BuildEventIndex(const TString outputDirectory, const Int_t nThreads){
+  
+  // Reader template with no jet or particle branches connected
+  fEventReader = new MonteCarloForestReader(fJetSubtraction, fJetAxis);
+  fEventReader->SetReadCacheSize(static_cast<Long64_t>(fReadCacheSize)*1024*1024);
+  fEventReader->SetAlignedReading(fAlignedTreeReading);
+  fEventReader->SetBranchGroups(std::bitset<MonteCarloForestReader::knBranchGroups>());
+  
+  // Create the output directory if it does not exist yet
+  gSystem->mkdir(outputDirectory, kTRUE);
+  
+  // Several threads use ROOT at the same time
+  ROOT::EnableThreadSafety();
+  
+  std::atomic<Int_t> nextFile(0);
+  std::mutex weightMutex;
+  std::vector<std::thread> indexThreads;
+  for(Int_t iThread = 0; iThread < TMath::Max(nThreads, 1); iThread++){
+    indexThreads.push_back(std::thread(&JetBackgroundAnalyzer::BuildEventIndexForFiles, this, &nextFile, &weightMutex, outputDirectory));
+  }
+  for(std::thread& indexThread : indexThreads) indexThread.join();
+  
+}
+
+/*
+ * Build and write the event index for files taken from the file list until all the files are done.
+ * This is run in several threads at the same time.
+ *
+ *  Arguments:
+ *   std::atomic<Int_t>* nextFile = Index of the next file in the file list that is not yet taken by any thread
+ *   std::mutex* weightMutex = Mutex protecting the weight functions shared between the threads
+ *   const TString outputDirectory = Directory to which the event index files are written
+ */
+void JetBackgroundAnalyzer::BuildEventIndexForFiles(std::atomic<Int_t>* nextFile, std::mutex* weightMutex, const TString outputDirectory){
+  
+  MonteCarloForestReader eventReader(*fEventReader); // Each thread has its own reader
+  EventView eventView;                               // Event information for the current event
+  EventIndex eventIndex;                             // Event index for the current file
+  TFile* inputFile;
+  TString currentFile;
+  Int_t nEvents;
+  
+  for(Int_t iFile = (*nextFile)++; iFile < (Int_t)fFileNames.size(); iFile = (*nextFile)++){
+    
+    currentFile = fFileNames.at(iFile);
+    inputFile = TFile::Open(currentFile);
+    
+    if(!inputFile || !inputFile->IsOpen() || inputFile->IsZombie()){
+      cout << "Error! Could not open the file: " << currentFile.Data() << endl;
+      assert(0);
+    }
+    
+    // Collect the event information for all the entries in the file
+    eventReader.ReadForestFromFile(inputFile);
+    nEvents = eventReader.GetNEvents();
+    eventIndex.Clear();
+    eventIndex.SetSourceFile(currentFile, inputFile->GetUUID().AsString());
+    
+    for(Int_t iEvent = 0; iEvent < nEvents; iEvent++){
+      eventReader.LoadEventInformation(iEvent);
+      eventReader.FillEventInformation(&eventView);
+      eventIndex.AddEvent(&eventView);
+    }
+    
+    // The weight functions are shared between the threads, so the weights are calculated by one thread at a time
+    {
+      std::lock_guard<std::mutex> weightLock(*weightMutex);
+      for(Int_t iEvent = 0; iEvent < nEvents; iEvent++){
+        eventIndex.fVzWeight[iEvent] = GetVzWeight(eventIndex.fVz[iEvent]);
+        eventIndex.fCentralityWeight[iEvent] = GetCentralityWeight(eventIndex.fHiBin[iEvent]);
+      }
+      if(fDebugLevel > 0) cout << "Writing event index with " << nEvents << " entries for the file: " << currentFile.Data() << endl;
+    }
+    
+    eventIndex.Write(EventIndex::GetIndexFileName(outputDirectory, currentFile));
+    
+    eventReader.BurnForest();
+    inputFile->Close();
+    delete inputFile;
+  }
+  
+}
+
+/*
+ * Check that all the input files can be analyzed. The files are divided dynamically between the given number of
+ * threads. Each file is opened and checked for the trees and branches needed with the current configuration, but
+ * no events are read.
+ *
+ *  Arguments:
+ *   const Int_t nThreads = Number of threads used to check the files
+ *
+ *  return: Manifest with the check result, entries and compressed size for each file
+ */
+FileManifest JetBackgroundAnalyzer::ValidateFiles(const Int_t nThreads){
+  
+  // Reader template with the branch groups needed in the analysis, unless the analysis has already configured one
+  if(!fEventReader){
+    fEventReader = new MonteCarloForestReader(fJetSubtraction, fJetAxis);
+    fEventReader->SetBranchGroups(GetRequiredBranchGroups());
+  }
+  
+  FileManifest manifest;
+  manifest.Reset(fFileNames);
+  
+  // Several threads use ROOT at the same time
+  ROOT::EnableThreadSafety();
+  
+  std::atomic<Int_t> nextFile(0);
+  std::vector<std::thread> validationThreads;
+  for(Int_t iThread = 0; iThread < TMath::Max(nThreads, 1); iThread++){
+    validationThreads.push_back(std::thread(&JetBackgroundAnalyzer::ValidateFilesInThread, this, &nextFile, &manifest));
+  }
+  for(std::thread& validationThread : validationThreads) validationThread.join();
+  
+  return manifest;
+}
+
+/*
+ * Check files taken from the file list until all the files are checked. This is run in several threads at the same time.
+ * Each thread sets the results only for the files it has taken, so the manifest does not need to be locked.
+ *
+ *  Arguments:
+ *   std::atomic<Int_t>* nextFile = Index of the next file in the file list that is not yet taken by any thread
+ *   FileManifest* manifest = Manifest to which the check results are set
+ */
+void JetBackgroundAnalyzer::ValidateFilesInThread(std::atomic<Int_t>* nextFile, FileManifest* manifest){
+  
+  TFile* inputFile;
+  TString currentFile;
+  TString problem;
+  Long64_t nEntries;
+  Long64_t zipBytes;
+  Int_t nClusters;
+  Double_t meanParticles;
+  std::vector<Long64_t> clusterStarts;
+  
+  for(Int_t iFile = (*nextFile)++; iFile < (Int_t)fFileNames.size(); iFile = (*nextFile)++){
+    
+    currentFile = fFileNames.at(iFile);
+    inputFile = TFile::Open(currentFile);
+    
+    if(!inputFile || !inputFile->IsOpen() || inputFile->IsZombie()){
+      manifest->SetFile(iFile, "Could not open the file", 0, 0, 0, 0);
+      if(inputFile) delete inputFile;
+      continue;
+    }
+    
+    problem = fEventReader->CheckForestFile(inputFile, nEntries, zipBytes, nClusters, meanParticles, &clusterStarts);
+    manifest->SetFile(iFile, problem, nEntries, zipBytes, nClusters, meanParticles, clusterStarts);
+    
+    inputFile->Close();
+    delete inputFile;
+  }
+  
+}
+
+/*
+ * Write the column cache for all the input files. All the branches that can be used in the analysis are copied
+ * to the cache, such that the same cache works for any configuration of the analysis using the same jet collection.
+ * Files that already have a cache made from the same forest file are skipped.
+ *
+ *  Arguments:
+ *   const TString outputDirectory = Directory to which the column cache files are written
+ *   const Int_t chunkSize = Number of events in each chunk of the cache
+ */
+void JetBackgroundAnalyzer::WriteColumnCache(const TString outputDirectory, const Int_t chunkSize){
+  
+  // Read all the branch groups stored in the cache
+  std::bitset<MonteCarloForestReader::knBranchGroups> cachedBranchGroups;
+  cachedBranchGroups.set();
+  cachedBranchGroups.reset(MonteCarloForestReader::kGeneratorParticleCharge);
+  
+  MonteCarloForestReader eventReader(fJetSubtraction, fJetAxis);
+  eventReader.SetReadCacheSize(static_cast<Long64_t>(fReadCacheSize)*1024*1024);
+  eventReader.SetAlignedReading(fAlignedTreeReading);
+  eventReader.SetBranchGroups(cachedBranchGroups);
+  
+  // Create the output directory if it does not exist yet
+  gSystem->mkdir(outputDirectory, kTRUE);
+  
+  TFile* inputFile;
+  TString currentFile;
+  TString cacheFileName;
+  TString sourceUUID;
+  Int_t nEvents;
+  
+  for(Int_t iFile = 0; iFile < (Int_t)fFileNames.size(); iFile++){
+    
+    currentFile = fFileNames.at(iFile);
+    inputFile = TFile::Open(currentFile);
+    
+    if(!inputFile || !inputFile->IsOpen() || inputFile->IsZombie()){
+      cout << "Error! Could not open the file: " << currentFile.Data() << endl;
+      assert(0);
+    }
+    
+    // Connect the forest to the reader
+    eventReader.ReadForestFromFile(inputFile);
+    nEvents = eventReader.GetNEvents();
+    
+    // Do not convert the file again if there already is an up to date cache for it
+    cacheFileName = ForestColumnCache::GetCacheFileName(outputDirectory, currentFile);
+    sourceUUID = inputFile->GetUUID().AsString();
+    {
+      ForestColumnCache existingCache;
+      if(existingCache.Open(cacheFileName) && existingCache.Matches(currentFile, sourceUUID, inputFile->GetSize(), nEvents, fJetSubtraction)){
+        if(fDebugLevel > 0) cout << "Column cache is up to date for the file: " << currentFile.Data() << endl;
+        eventReader.BurnForest();
+        inputFile->Close();
+        delete inputFile;
+        continue;
+      }
+    }
+    
+    // Copy all the events in the file to the cache
+    if(fDebugLevel > 0) cout << "Writing column cache with " << nEvents << " entries for the file: " << currentFile.Data() << endl;
+    
+    ForestColumnCache columnCache;
+    if(!columnCache.Create(cacheFileName, currentFile, sourceUUID, inputFile->GetSize(), fJetSubtraction, chunkSize)){
+      cout << "Error! Could not create the column cache file: " << cacheFileName.Data() << endl;
+      assert(0);
+    }
+    
+    for(Int_t iEvent = 0; iEvent < nEvents; iEvent++){
+      eventReader.GetEvent(iEvent);
+      eventReader.FillColumnCache(&columnCache);
+    }
+    
+    columnCache.Close();
+    
+    eventReader.BurnForest();
+    inputFile->Close();
+    delete inputFile;
+  }
+  
+}
+
+/*
+ * Read one event from the forest into an event view.
+ *
+ * Events outside of the pT hat range are rejected already here. For the other events, the event information
+ * is always copied to the view, either from the forest or from the event index. The jets and particles are only
+ * read for events passing the event cuts, unless the event information is read from the full forest entry anyway.
+ * In staged loading, the jets and particles are in addition only read for events with a jet passing the jet pT cuts. For other
+ * events the collections in the view are left empty.
+ *
+ *  Arguments:
+ *   MonteCarloForestReader* eventReader = Reader from which the event is read
+ *   Int_t iEvent = Index of the event in the forest
+ *   EventView* eventView = Event view to which the event is read. The file and entry need to be set for the jet pT smearing in staged loading
+ *   const EventIndex* eventIndex = Event index for the file. NULL if event information is read from the forest
+ *   EventPlaneCache* eventPlaneCache = Event plane cache for the file. NULL if the event plane is determined from the particles in the analysis
+ *   const Bool_t buildEventPlaneCache = True: Determine the event plane from the particles and store it to the cache. False: Take the event plane from the cache
+ *   const Bool_t copyParticles = True: Copy the particles to the view, which is needed if the event is analyzed after the next event is read. False: The view points to the particle branch memory
+ *
+ *  return: True if the event should be analyzed, false if it is outside of the pT hat range
+ */
+Bool_t JetBackgroundAnalyzer::ReadEvent(MonteCarloForestReader* eventReader, Int_t iEvent, EventView* eventView, const EventIndex* eventIndex, EventPlaneCache* eventPlaneCache, const Bool_t buildEventPlaneCache, const Bool_t copyParticles){
+  
+  // With an event index, the event information including the weights is taken directly from the index
+  if(eventIndex){
+    eventIndex->FillEventInformation(iEvent, eventView);
+  } else {
+    
+    // Read the event information to memory. In staged loading, only the information needed for event selection is read at this point
+    if(fStagedEventLoading){
+      eventReader->LoadEventInformation(iEvent);
+    } else {
+      eventReader->GetEvent(iEvent);
+    }
+    eventReader->FillEventInformation(eventView);
+  }
+  
+  // Take the event plane from the cache, or determine it for all the entries when the cache is being built
+  eventView->fHasEventPlane = false;
+  if(eventPlaneCache){
+    if(buildEventPlaneCache){
+      eventReader->LoadGenParticles(iEvent);
+      eventReader->FillEventParticles(eventView);
+      eventView->fEventPlaneQx.resize(fnEventPlaneOrders);
+      eventView->fEventPlaneQy.resize(fnEventPlaneOrders);
+      CalculateEventPlane(eventView->fParticles, fnEventPlaneOrders, eventView->fEventPlaneQx.data(), eventView->fEventPlaneQy.data(), eventView->fEventPlaneMultiplicity);
+      eventView->fHasEventPlane = true;
+      eventPlaneCache->SetEvent(iEvent, eventView);
+    } else {
+      eventPlaneCache->FillEventPlane(iEvent, eventView);
+    }
+  }
+  
+  // We need to apply pT hat cuts before getting pT hat weight. There might be rare events above the upper
+  // limit from which the weights are calculated, which could cause the code to crash.
+  if(eventView->fPtHat < fMinimumPtHat || eventView->fPtHat >= fMaximumPtHat) return false;
+  
+  // Get the weighting for the event if it is not taken from the index
+  if(!eventIndex){
+    eventView->fVzWeight = GetVzWeight(eventView->fVz);
+    eventView->fCentralityWeight = GetCentralityWeight(eventView->fHiBin);
+  }
+  
+  // Without staged loading and event index, the whole event is already in memory
+  if(!fStagedEventLoading && !eventIndex){
+    eventReader->FillEventCollections(eventView, copyParticles);
+    return true;
+  }
+  
+  // Read the rest of the event only if the event passes the event cuts
+  if(!PassEventCuts(eventView, false)){
+    eventView->ClearCollections();
+    return true;
+  }
+  
+  // Without staged loading, read the whole event at once
+  if(!fStagedEventLoading){
+    eventReader->GetEvent(iEvent);
+    eventReader->FillEventCollections(eventView, copyParticles);
+    return true;
+  }
+  
+  // In staged loading, read the jet pT:s next, and the rest of the event only if there is a jet that passes the pT cuts
+  eventReader->LoadJetPt(iEvent);
+  if(!HasJetCandidate(eventReader, eventView)){
+    eventView->ClearCollections();
+    return true;
+  }
+  
+  eventReader->LoadFullEvent(iEvent);
+  eventReader->FillEventCollections(eventView, copyParticles);
+  return true;
+}
+
+/*
+ * Analyze one event and fill the histograms
+ *
+ *  Arguments:
+ *   const EventView* eventView = Event view containing all the information needed from the event
+ */
+void JetBackgroundAnalyzer::AnalyzeEvent(const EventView* eventView){
+  
+  //************************************************
+  //  Define variables needed in the analysis
+  //************************************************
+  
+  // Variables for jets
+  Int_t nJets = 0;                  // Number of jets in an event
+  Double_t jetPt = 0;               // pT of the i:th jet in the event
+  Double_t jetPhi = 0;              // phi of the i:th jet in the event
+  Double_t jetEta = 0;              // eta of the i:th jet in the event
+  Int_t jetFlavor = 0;              // Flavor of the jet. 0 = Quark jet. 1 = Gluon jet.
+  Int_t matchingJetExists = 0;      // Flag for having a matching jet. 0 = No match found. 1 = Match exist
+  Double_t matchedJetPt = 0;        // pT of the matching jet
+
+  // Variables for leading jet
+  Double_t leadingJetPt = 0;        // pT of the leading jet
+  Double_t leadingJetPhi = 0;       // phi of the leading jet
+  Double_t leadingJetEta = 0;       // eta of the leading jet
+  Int_t leadingJetFlavor = 0;       // Flavor of the leading jet. 0 = Quark jet. 1 = Gluon jet, 2 = Flavor undetermined
+  Int_t leadingJetMatch = 0;        // 0 = No match found. 1 = Match exist
+
+  // Variables for matched reconstructed jet
+  Double_t reconstructedJetPt = 0;   // pT of the reconstructed jet
+  Double_t reconstructedJetPhi = 0;  // phi of the reconstructed jet
+  Double_t reconstructedJetEta = 0;  // eta of the reconstructed jet
+
+  // Variables for smearing study
+  Double_t smearingFactor = 0;       // Larger of the JEC uncertainties
+  
+  // Variables for jet matching and closure
+  Int_t partonFlavor = -999;        // Code for parton flavor in Monte Carlo
+
+  // Event plane study related variables. The arrays have one element for each of the fnEventPlaneOrders harmonics.
+  Double_t* eventPlaneQ = fEventPlaneQ.data();          // Magnitude of the event plane Q-vector
+  Int_t eventPlaneMultiplicity = 0;                     // Particle multiplicity in the event plane
+  Double_t* eventPlaneQx = fEventPlaneQx.data();        // x-component of the event plane vector
+  Double_t* eventPlaneQy = fEventPlaneQy.data();        // y-component of the event plane vector
+  Double_t jetEventPlaneDeltaPhi = 0;                   // DeltaPhi between jet and event plane angle
+  Double_t* recordDeltaPhi = fRecordDeltaPhi.data();    // DeltaPhi between jet and all event plane angles for the jet records
+  Double_t* eventPlaneAngle = fEventPlaneAngle.data();  // Manually calculated event plane angle
+  
+  // Fillers for THnSparses
+  const Int_t nFillJet = 6;         // Inclusive and leading jets
+  const Int_t nFillEventPlane = 3;  // Correlation between inclusive and leading jets with event plane
+  const Int_t nAxesClosure = 7;     // Jet pT closure
+  Double_t fillerJet[nFillJet];
+  Double_t fillerEventPlane[nFillEventPlane];
+  Double_t fillerClosure[nAxesClosure];
+  
+  //************************************************
+  //         Read basic event information
+  //************************************************
+
+  // Get vz, centrality and pT hat information
+  const Double_t vz = eventView->fVz;                 // Vertex z-position
+  const Double_t centrality = eventView->fCentrality; // Event centrality
+  const Double_t ptHat = eventView->fPtHat;           // pT hat for MC events
+  
+  // Get the weighting for the event. The vz and centrality weights are determined when the event is read
+  fVzWeight = eventView->fVzWeight;  // vz weight
+  fCentralityWeight = eventView->fCentralityWeight; // centrality weight
+
+  // Event weight for 2018 MC
+  fPtHatWeight = eventView->fEventWeight; // 2018 MC
+  fTotalEventWeight = fVzWeight*fCentralityWeight*fPtHatWeight;
+  
+  // Fill event counter histogram
+  fHistograms->fhEvents->Fill(JetBackgroundHistograms::kAll);          // All the events looped over
+  
+  //  ============================================
+  //  ===== Apply all the event quality cuts =====
+  //  ============================================
+
+  // Check event cuts
+  if(!PassEventCuts(eventView, true)) return;
+  
+  // Fill the event information histograms for the events that pass the event cuts
+  fHistograms->fhVertexZ->Fill(vz,fPtHatWeight);                         // z vertex distribution from all events
+  fHistograms->fhVertexZWeighted->Fill(vz,fTotalEventWeight);            // z-vertex distribution weighted with the weight function
+  fHistograms->fhCentrality->Fill(centrality, fPtHatWeight);             // Centrality filled from all events
+  fHistograms->fhCentralityWeighted->Fill(centrality,fTotalEventWeight); // Centrality weighted with the centrality weighting function
+  fHistograms->fhPtHat->Fill(ptHat);                                     // pT hat histogram
+  fHistograms->fhPtHatWeighted->Fill(ptHat,fTotalEventWeight);           // pT het histogram weighted with corresponding cross section and event number
+  if(fJetRecords) fJetRecords->AddEvent(vz, centrality, ptHat, fPtHatWeight, fTotalEventWeight);
+  
+  // ======================================
+  // ===== Event quality cuts applied =====
+  // ======================================
+
+  //******************************************************************
+  //    Determine the event plane from generator level information
+  //******************************************************************
+
+  // The Q-vectors are either read from the event plane cache or determined from the particles in the event
+  if(eventView->fHasEventPlane){
+    for(int iFlow = 0; iFlow < fnEventPlaneOrders; iFlow++){
+      eventPlaneQx[iFlow] = eventView->fEventPlaneQx[iFlow];
+      eventPlaneQy[iFlow] = eventView->fEventPlaneQy[iFlow];
+    }
+    eventPlaneMultiplicity = eventView->fEventPlaneMultiplicity;
+  } else {
+    CalculateEventPlane(eventView->fParticles, fnEventPlaneOrders, eventPlaneQx, eventPlaneQy, eventPlaneMultiplicity);
+  }
+
+  // Do not allow zero multiplicity to avoid dividing by zero problems
+  if(eventPlaneMultiplicity == 0) eventPlaneMultiplicity += 1;
+      
+  // Calculate the Q-vector magnitudes and event plane angles for orders 2 tp 2+fnEventPlaneOrders-1
+  for(int iFlow = 0; iFlow < fnEventPlaneOrders; iFlow++){
+    eventPlaneQ[iFlow] = TMath::Sqrt(eventPlaneQx[iFlow]*eventPlaneQx[iFlow] + eventPlaneQy[iFlow]*eventPlaneQy[iFlow]);
+    eventPlaneAngle[iFlow] = (1.0/(iFlow+2.0)) * TMath::ATan2(eventPlaneQy[iFlow], eventPlaneQx[iFlow]);
+  }
+
+  // Normalize the Q-vector with multiplicity
+  for(int iFlow = 0; iFlow < fnEventPlaneOrders; iFlow++){
+    eventPlaneQ[iFlow] /= TMath::Sqrt(eventPlaneMultiplicity);
+  }
+
+  //***********************************************************
+  //       First jet loop for event plane correlations
+  //***********************************************************
+
+  // Reser the leading jet variables for this event
+  leadingJetPt = 0;
+  leadingJetEta = -999;
+  leadingJetPhi = -999;
+  leadingJetFlavor = -999;
+  leadingJetMatch = -999;
+
+  // Jet loop over the analyzed jet collection
+  const EventViewJets& jets = (fJetType == MonteCarloForestReader::kGeneratorLevelJet) ? eventView->fGeneratorJets : eventView->fReconstructedJets;
+  nJets = jets.fnJets;
+  for(Int_t jetIndex = 0; jetIndex < nJets; jetIndex++){
+    
+    jetPt = jets.fPt[jetIndex];  // Raw pT for reconstructed jets. Manual correction is done later
+    jetPhi = jets.fPhi[jetIndex];
+    jetEta = jets.fEta[jetIndex];
+    jetFlavor = -999;
+      
+    //  ========================================
+    //  ======== Apply jet quality cuts ========
+    //  ========================================
+      
+    if(TMath::Abs(jetEta) >= fJetEtaCut) continue; // Cut for jet eta
+      
+    // No jet quality cuts for generator level jets
+    if(!(fJetType == MonteCarloForestReader::kGeneratorLevelJet)){              
+      if(fMinimumMaxTrackPtFraction >= jets.fMaxTrackPt[jetIndex]/jets.fPt[jetIndex]){
+        continue; // Cut for jets with only very low pT particles
+      }
+      if(fMaximumMaxTrackPtFraction <= jets.fMaxTrackPt[jetIndex]/jets.fPt[jetIndex]){
+        continue; // Cut for jets where all the pT is taken by one track
+      }
+    }
+      
+    //  ========================================
+    //  ======= Jet quality cuts applied =======
+    //  ========================================
+
+    // No jet pT correction or smearing for generator level jets
+    if(!(fJetType == MonteCarloForestReader::kGeneratorLevelJet)){
+
+      // For reconstructed jets do a correction for the jet pT
+      fJetCorrector2018->SetJetPT(jetPt);
+      fJetCorrector2018->SetJetEta(jetEta);
+      fJetCorrector2018->SetJetPhi(jetPhi);
+      
+      jetPt = fJetCorrector2018->GetCorrectedPT();
+      
+      // Apply gaussian smearing to take into account overly optimistic jet energy resolution
+      if(fSmearResolution){
+        smearingFactor = GetSmearingFactor(jetPt, jetEta, centrality);
+        jetPt = jetPt * fSmearingRandom.Gaus(1, smearingFactor, eventView->fFileId, eventView->fFileEntry, jetIndex, CounterRandom::kJetSmearing);
+      }
+        
+    } // Jet pT correction
+      
+    // After the jet pT can been corrected, apply analysis jet pT cuts
+    if(jetPt < fJetMinimumPtCut) continue;
+    if(jetPt > fJetMaximumPtCut) continue;
+
+    // Check if the current jet has a matching jet
+    matchingJetExists = 0;
+    if(jets.fHasMatch[jetIndex]){
+      // Require that one pT is not less than half of the other pT
+      matchedJetPt = jets.fMatchedPt[jetIndex];
+      if(jetPt*0.5 < matchedJetPt && matchedJetPt * 0.5 < jetPt){
+        matchingJetExists = 1;
+      }
+    }
+
+    // Find the jet flavor and translate it into a quark [-6,-1] U [1,6] or gluon (21)
+    // In the jet flavor is not any of these values, it remains undeterined
+    jetFlavor = JetBackgroundHistograms::kUndetermined;
+    partonFlavor = jets.fFlavor[jetIndex];
+    if(TMath::Abs(partonFlavor) == 21) jetFlavor = JetBackgroundHistograms::kGluon;
+    if(TMath::Abs(partonFlavor) < 7){
+      if(partonFlavor != 0) jetFlavor = JetBackgroundHistograms::kQuark;
+    }
+
+    // After the event selection, update the leading jet variables
+    if(jetPt > leadingJetPt){
+      leadingJetPt = jetPt;
+      leadingJetPhi = jetPhi;
+      leadingJetEta = jetEta;
+      leadingJetFlavor = jetFlavor;
+      leadingJetMatch = matchingJetExists;
+    }
+    
+    //************************************************
+    //         Fill histograms for all jets
+    //************************************************
+      
+    // Fill the axes in correct order
+    fillerJet[0] = jetPt;             // Axis 0 = any jet pT
+    fillerJet[1] = jetPhi;            // Axis 1 = any jet phi
+    fillerJet[2] = jetEta;            // Axis 2 = any jet eta
+    fillerJet[3] = centrality;        // Axis 3 = centrality
+    fillerJet[4] = jetFlavor;         // Axis 4 = flavor of the jet
+    fillerJet[5] = matchingJetExists; // Axis 5 = flag is matching jet exists
+      
+    JetBackgroundHistograms::Fill(fHistograms->fhInclusiveJet, fHistograms->fhDenseInclusiveJet, fillerJet, fTotalEventWeight); // Fill the data point to histogram
+
+    //**********************************************************************
+    //      Fill histograms for inclusive jet - event plane correlation
+    //**********************************************************************
+
+    for(int iFlow = 0; iFlow < fnEventPlaneOrders; iFlow++){
+      
+      // Determine the deltaPhi between jet axis and the event plane in the interval [-pi/2,3pi/2]
+      jetEventPlaneDeltaPhi = jetPhi - eventPlaneAngle[iFlow];
+      while(jetEventPlaneDeltaPhi > (1.5*TMath::Pi())){jetEventPlaneDeltaPhi += -2*TMath::Pi();}
+      while(jetEventPlaneDeltaPhi < (-0.5*TMath::Pi())){jetEventPlaneDeltaPhi += 2*TMath::Pi();}
+      recordDeltaPhi[iFlow] = jetEventPlaneDeltaPhi;
+
+      // Require a matching generator level jet for the reconstructed jet at this index
+      if(jetIndex < eventView->fReconstructedJets.fnJets && eventView->fReconstructedJets.fHasMatch[jetIndex]){
+
+        // Fill the jet - event plane correlation histograms
+        fillerEventPlane[0] = jetEventPlaneDeltaPhi;  // Axis 0: DeltaPhi between jet and event plane
+        fillerEventPlane[1] = jetPt;                  // Axis 1: Jet pT
+        fillerEventPlane[2] = centrality;             // Axis 2: centrality
+
+        JetBackgroundHistograms::Fill(fHistograms->fhInclusiveJetEventPlane[iFlow], fHistograms->fhDenseInclusiveJetEventPlane[iFlow], fillerEventPlane, fTotalEventWeight);
+      }
+
+    }
+
+    if(fJetRecords){
+      fJetRecords->AddJet(JetRecordTable::kInclusiveJetRecord, jetPt, jetPhi, jetEta, centrality, jetFlavor,
+                          (matchingJetExists ? JetRecordTable::kMatchingJetExists : 0) | (jets.fHasMatch[jetIndex] ? JetRecordTable::kHasMatchedJet : 0),
+                          fTotalEventWeight, 0, recordDeltaPhi);
+    }
+    
+  } // End of jet loop
+
+  // If a leading jet exists, fill the leading jet histograms
+  if(leadingJetPt > 0){
+
+    //***************************************************
+    //         Fill histograms for leading jets
+    //***************************************************
+
+    // Fill the axes in correct order
+    fillerJet[0] = leadingJetPt;       // Axis 0 = leading jet pT
+    fillerJet[1] = leadingJetPhi;      // Axis 1 = leading jet phi
+    fillerJet[2] = leadingJetEta;      // Axis 2 = leading jet eta
+    fillerJet[3] = centrality;         // Axis 3 = centrality
+    fillerJet[4] = leadingJetFlavor;   // Axis 4 = flavor of the leading jet
+    fillerJet[5] = leadingJetMatch;    // Axis 5 = flag if matching jet exists
+      
+    JetBackgroundHistograms::Fill(fHistograms->fhLeadingJet, fHistograms->fhDenseLeadingJet, fillerJet, fTotalEventWeight); // Fill the data point to histogram
+
+    //**********************************************************************
+    //      Fill histograms for leading jet - event plane correlation
+    //**********************************************************************
+
+    for(int iFlow = 0; iFlow < fnEventPlaneOrders; iFlow++){
+      
+      // Determine the deltaPhi between jet axis and the event plane in the interval [-pi/2,3pi/2]
+      jetEventPlaneDeltaPhi = leadingJetPhi - eventPlaneAngle[iFlow];
+      while(jetEventPlaneDeltaPhi > (1.5*TMath::Pi())){jetEventPlaneDeltaPhi += -2*TMath::Pi();}
+      while(jetEventPlaneDeltaPhi < (-0.5*TMath::Pi())){jetEventPlaneDeltaPhi += 2*TMath::Pi();}
+      recordDeltaPhi[iFlow] = jetEventPlaneDeltaPhi;
+
+      // Fill the jet - event plane correlation histograms
+      fillerEventPlane[0] = jetEventPlaneDeltaPhi;  // Axis 0: DeltaPhi between jet and event plane
+      fillerEventPlane[1] = leadingJetPt;           // Axis 1: Leading jet pT
+      fillerEventPlane[2] = centrality;             // Axis 2: centrality
+
+      JetBackgroundHistograms::Fill(fHistograms->fhLeadingJetEventPlane[iFlow], fHistograms->fhDenseLeadingJetEventPlane[iFlow], fillerEventPlane, fTotalEventWeight);
+
+    }
+
+    if(fJetRecords){
+      fJetRecords->AddJet(JetRecordTable::kLeadingJetRecord, leadingJetPt, leadingJetPhi, leadingJetEta, centrality, leadingJetFlavor,
+                          leadingJetMatch ? JetRecordTable::kMatchingJetExists : 0, fTotalEventWeight, 0, recordDeltaPhi);
+    }
+  } // Filling leading jet histograms
+
+  //*******************************************************************
+  //     If selected, fill the histograms also for calorimeter jets
+  //*******************************************************************
+  if(fDoCalorimeterJets){
+
+    const EventViewJets& caloJets = eventView->fCalorimeterJets;
+    nJets = TMath::Min(jets.fnJets, caloJets.fnJets);
+    for(Int_t jetIndex = 0; jetIndex < nJets; jetIndex++){
+
+      // Find the calorimeter jet kinematics
+      jetPt = caloJets.fPt[jetIndex];
+      jetPhi = caloJets.fPhi[jetIndex];
+      jetEta = caloJets.fEta[jetIndex];
+
+      // Select the jets from a defined eta region
+      if(TMath::Abs(jetEta) >= fJetEtaCut) continue; // Cut for jet eta
+
+      // Do jet energy correction for calorimeter jets
+      fCaloJetCorrector2018->SetJetPT(jetPt);
+      fCaloJetCorrector2018->SetJetEta(jetEta);
+      fCaloJetCorrector2018->SetJetPhi(jetPhi);
+      
+      jetPt = fCaloJetCorrector2018->GetCorrectedPT();
+
+      // After the jet pT can been corrected, apply analysis jet pT cuts
+      if(jetPt < fJetMinimumPtCut) continue;
+      if(jetPt > fJetMaximumPtCut) continue;
+
+      //************************************************
+      //         Fill histograms for all jets
+      //************************************************
+      
+      // Fill the axes in correct order
+      fillerJet[0] = jetPt;             // Axis 0 = calorimeter jet pT
+      fillerJet[1] = jetPhi;            // Axis 1 = calorimeter jet phi
+      fillerJet[2] = jetEta;            // Axis 2 = calorimeter jet eta
+      fillerJet[3] = centrality;        // Axis 3 = centrality
+      fillerJet[4] = 0;                 // Axis 4 = not used for calorimeter jets
+      fillerJet[5] = 0;                 // Axis 5 = not used for calorimeter jets
+      
+      JetBackgroundHistograms::Fill(fHistograms->fhCalorimeterJet, fHistograms->fhDenseCalorimeterJet, fillerJet, fTotalEventWeight); // Fill the data point to histogram
+
+      //**********************************************************************
+      //      Fill histograms for calorimeter jet - event plane correlation
+      //**********************************************************************
+
+      for(int iFlow = 0; iFlow < fnEventPlaneOrders; iFlow++){
+      
+        // Determine the deltaPhi between jet axis and the event plane in the interval [-pi/2,3pi/2]
+        jetEventPlaneDeltaPhi = jetPhi - eventPlaneAngle[iFlow];
+        while(jetEventPlaneDeltaPhi > (1.5*TMath::Pi())){jetEventPlaneDeltaPhi += -2*TMath::Pi();}
+        while(jetEventPlaneDeltaPhi < (-0.5*TMath::Pi())){jetEventPlaneDeltaPhi += 2*TMath::Pi();}
+        recordDeltaPhi[iFlow] = jetEventPlaneDeltaPhi;
+
+        // Fill the jet - event plane correlation histograms
+        fillerEventPlane[0] = jetEventPlaneDeltaPhi;  // Axis 0: DeltaPhi between jet and event plane
+        fillerEventPlane[1] = jetPt;                  // Axis 1: Jet pT
+        fillerEventPlane[2] = centrality;             // Axis 2: centrality
+
+        JetBackgroundHistograms::Fill(fHistograms->fhCalorimeterJetEventPlane[iFlow], fHistograms->fhDenseCalorimeterJetEventPlane[iFlow], fillerEventPlane, fTotalEventWeight);
+      } // Flow order loop
+
+      if(fJetRecords) fJetRecords->AddJet(JetRecordTable::kCalorimeterJetRecord, jetPt, jetPhi, jetEta, centrality, 0, 0, fTotalEventWeight, 0, recordDeltaPhi);
+
+    } // Calorimeter jet loop
+  } // Calorimeter jet if
+
+  //**************************************************
+  //       Second jet loop for jet pT closure
+  //**************************************************
+
+  // Only fill the jet pT closure plots if selected
+  if(!fFillJetPtClosure) return;
+
+  // Loop over all generator level jets
+  const EventViewJets& genJets = eventView->fGeneratorJets;
+  nJets = genJets.fnJets;
+  for(Int_t jetIndex = 0; jetIndex < nJets; jetIndex++){
+
+    jetPt = genJets.fPt[jetIndex];
+    jetPhi = genJets.fPhi[jetIndex];
+    jetEta = genJets.fEta[jetIndex];
+
+    // Kinematic cuts for generator level jets
+    if(TMath::Abs(jetEta) >= fJetEtaCut) continue; // Cut for jet eta
+    if(jetPt < fJetClosureMinimumPt) continue;     // Cut for jet pT
+    if(jetPt > fJetMaximumPtCut) continue;         // Cut for super high pT jets
+
+    // For closure plots, we need to find a matching reconstructed jet
+    if(!genJets.fHasMatch[jetIndex]) continue;
+
+    // Read the reconstructed jet information
+    reconstructedJetPt = genJets.fMatchedPt[jetIndex];
+    reconstructedJetEta = genJets.fMatchedEta[jetIndex];
+    reconstructedJetPhi = genJets.fMatchedPhi[jetIndex];
+    partonFlavor = genJets.fFlavor[jetIndex];
+
+    // Apply jet energy correction for reconstructed jet
+    fJetCorrector2018->SetJetPT(reconstructedJetPt);
+    fJetCorrector2018->SetJetEta(reconstructedJetEta);
+    fJetCorrector2018->SetJetPhi(reconstructedJetPhi);
+
+    reconstructedJetPt = fJetCorrector2018->GetCorrectedPT();
+      
+    // Apply gaussian smearing to take into account too good jet energy resolution
+    if(fSmearResolution){
+      smearingFactor = GetSmearingFactor(reconstructedJetPt, reconstructedJetEta, centrality);
+      reconstructedJetPt = reconstructedJetPt * fSmearingRandom.Gaus(1, smearingFactor, eventView->fFileId, eventView->fFileEntry, jetIndex, CounterRandom::kClosureJetSmearing);
+    }
+
+    // Define index for jet flavor using algoritm: [-6,-1] U [1,6] -> kQuark, 21 -> kGluon, anything else -> kUndetermined
+    jetFlavor = JetBackgroundHistograms::kUndetermined;
+    if(partonFlavor >= -6 && partonFlavor <= 6 && partonFlavor != 0) jetFlavor = JetBackgroundHistograms::kQuark;
+    if(partonFlavor == 21) jetFlavor = JetBackgroundHistograms::kGluon;
+
+    //************************************************
+    //       Fill histograms for jet pT closure
+    //************************************************
+
+    // Fill the different axes for the filler
+    fillerClosure[0] = jetPt;                    // Axis 0: pT of the matched generator level jet
+    fillerClosure[1] = reconstructedJetPt;       // Axis 1: pT of the matched reconstructed jet
+    fillerClosure[2] = jetEta;                   // Axis 2: eta of the jet under consideration
+    fillerClosure[3] = centrality;               // Axis 3: Centrality of the event
+    fillerClosure[4] = jetFlavor;                // Axis 4: Jet flavor type (quark/gluon)
+    fillerClosure[5] = reconstructedJetPt/jetPt; // Axis 5: Reconstructed level jet to generator level jet pT ratio
+    fillerClosure[6] = jetPhi;                   // Axis 6: phi of the jet under consideration
+
+    // Fill the closure histogram
+    JetBackgroundHistograms::Fill(fHistograms->fhJetPtClosure, fHistograms->fhDenseJetPtClosure, fillerClosure, fTotalEventWeight);
+    if(fJetRecords) fJetRecords->AddJet(JetRecordTable::kClosureRecord, jetPt, jetPhi, jetEta, centrality, jetFlavor, 0, fTotalEventWeight, reconstructedJetPt, NULL);
+
+  } // Jet pT loop for closures
+  
+}
+
+/*
+ * Get the proper vz weighting depending on analyzed system
+ *
+ *  Arguments:
+ *   const Double_t vz = Vertex z position for the event
+ *
+ *   return: Multiplicative correction factor for vz
+ */
+Double_t JetBackgroundAnalyzer::GetVzWeight(const Double_t vz) const{
+  return fVzWeightFunction->Eval(vz); // Weight for 2018 MC
+}
+
+/*
+ * Get the proper centrality weighting depending on analyzed system
+ *
+ *  Arguments:
+ *   const Int_t hiBin = CMS hiBin
+ *
+ *   return: Multiplicative correction factor for the given CMS hiBin
+ */
+Double_t JetBackgroundAnalyzer::GetCentralityWeight(const Int_t hiBin) const{
+
+  // No weighting for the most peripheral centrality bins. Different weight function for central and peripheral.
+  if(hiBin < 60) return fCentralityWeightFunctionCentral->Eval(hiBin/2.0);
+  return (hiBin < 194) ? fCentralityWeightFunctionPeripheral->Eval(hiBin/2.0) : 1;
+}
+
+/*
+ * Get a smearing factor corresponding to worsening the smearing resolution in MC by 20 %
+ * This is obtained by multiplying the MC smearing resolution by 0.666 and using this as additional
+ * smearing for the data. Smearing factor depends on jet pT and centrality.
+ *
+ *  Arguments:
+ *   Double_t jetPt = Jet pT
+ *   const Double_t centrality = Centrality of the event
+ *
+ *  return: Additional smearing factor
+ */
+Double_t JetBackgroundAnalyzer::GetSmearingFactor(Double_t jetPt, Double_t jetEta, const Double_t centrality, TF1* smearingFunction) {
+  
+  // By default the smearing function of the analysis is used
+  if(!smearingFunction) smearingFunction = fSmearingFunction;
+  
+  // For all the jets above 500 GeV, use the resolution for 500 GeV jet
   if(jetPt > 500) jetPt = 500;
   
   // Find the correct centrality bin
@@ -874,7 +2188,7 @@ Double_t JetBackgroundAnalyzer::GetSmearingFactor(Double_t jetPt, Double_t jetEt
   for(int iParameter = 0; iParameter < 5; iParameter++){
     // Settings for PbPb
       
-    fSmearingFunction->SetParameter(iParameter, resolutionFit[centralityBin][iParameter]);
+    smearingFunction->SetParameter(iParameter, resolutionFit[centralityBin][iParameter]);
   }
   
   // Calculation for resolution worsening: we assume the jet energy resolution is a Gaussian distribution with some certain sigma, if you would like to add a Gaussian noise to make it worse, the sigma getting larger, then it obeys the random variable rule that X=Y+Z, where Y~N(y, sigmay) and Z~N(z,sigmaz), then X~N(y+z, sqrt(sigmay^2+sigmaz^2))). In this case, we assume that noise and the resolution are independent.
@@ -887,7 +2201,7 @@ Double_t JetBackgroundAnalyzer::GetSmearingFactor(Double_t jetPt, Double_t jetEt
   // Worsening resolution by 30%: 0.831
 
   // We want to worsen resolution in MC by the amount defined by JetMet group. The scaling factor is given by a JetMet manager
-  return fSmearingFunction->Eval(jetPt)*fEnergyResolutionSmearingFinder->GetScalingFactor(jetEta);
+  return smearingFunction->Eval(jetPt)*fEnergyResolutionSmearingFinder->GetScalingFactor(jetEta);
   
 }
 
@@ -895,33 +2209,342 @@ Double_t JetBackgroundAnalyzer::GetSmearingFactor(Double_t jetPt, Double_t jetEt
  * Check if the event passes all the track cuts
  *
  *  Arguments:
- *   MonteCarloForestReader* eventReader = MonteCarloForestReader containing the event information checked for event cuts
+ *   const EventView* eventView = Event view containing the event information checked for event cuts
  *   const Bool_t fillHistograms = Flag for filling the event information histograms.
+ *   Long64_t* eventCounts = Counts for each event type, incremented for the passed cuts. NULL if the events are not counted
  *
  *   return = True if all event cuts are passed, false otherwise
  */
-Bool_t JetBackgroundAnalyzer::PassEventCuts(MonteCarloForestReader* eventReader, const Bool_t fillHistograms){
+Bool_t JetBackgroundAnalyzer::PassEventCuts(const EventView* eventView, const Bool_t fillHistograms, Long64_t* eventCounts){
   
   // Primary vertex has at least two tracks, is within 25 cm in z-rirection and within 2 cm in xy-direction. Only applied for data.
-  if(eventReader->GetPrimaryVertexFilterBit() == 0) return false;
+  if(eventView->fPrimaryVertexFilterBit == 0) return false;
   if(fillHistograms) fHistograms->fhEvents->Fill(JetBackgroundHistograms::kPrimaryVertex);
+  if(eventCounts) eventCounts[JetBackgroundHistograms::kPrimaryVertex]++;
   
   // Have at least two HF towers on each side of the detector with an energy deposit of 4 GeV. Only applied for PbPb data.
-  if(eventReader->GetHfCoincidenceFilterBit() == 0) return false;
+  if(eventView->fHfCoincidenceFilterBit == 0) return false;
   if(fillHistograms) fHistograms->fhEvents->Fill(JetBackgroundHistograms::kHfCoincidence);
+  if(eventCounts) eventCounts[JetBackgroundHistograms::kHfCoincidence]++;
   
   // Calculated from pixel clusters. Ensures that measured and predicted primary vertices are compatible. Only applied for PbPb data.
-  if(eventReader->GetClusterCompatibilityFilterBit() == 0) return false;
+  if(eventView->fClusterCompatibilityFilterBit == 0) return false;
   if(fillHistograms) fHistograms->fhEvents->Fill(JetBackgroundHistograms::kClusterCompatibility);
+  if(eventCounts) eventCounts[JetBackgroundHistograms::kClusterCompatibility]++;
   
   // Cut for vertex z-position
-  if(TMath::Abs(eventReader->GetVz()) > fVzCut) return false;
+  if(TMath::Abs(eventView->fVz) > fVzCut) return false;
   if(fillHistograms) fHistograms->fhEvents->Fill(JetBackgroundHistograms::kVzCut);
+  if(eventCounts) eventCounts[JetBackgroundHistograms::kVzCut]++;
   
   return true;
   
 }
 
+/*
+ * Determine the event plane Q-vectors from order 2 to order 2+nEventPlaneOrders-1 using the generator level particles.
+ * Only Hydjet particles inside the eta and pT range given in the card are used. This only uses the configuration of
+ * the analyzer, so it can be called from the decoding thread.
+ *
+ * The angles of the selected particles are first compacted without branches to an aligned block on the stack, and
+ * the harmonics of each full block are summed by SumEventPlaneHarmonics.
+ *
+ *  Arguments:
+ *   const EventViewParticles& particles = Generator level particles in the event
+ *   const Int_t nEventPlaneOrders = Number of harmonics determined
+ *   Double_t* eventPlaneQx = Array of nEventPlaneOrders elements to which the x-components of the Q-vectors are summed
+ *   Double_t* eventPlaneQy = Array of nEventPlaneOrders elements to which the y-components of the Q-vectors are summed
+ *   Int_t& eventPlaneMultiplicity = Number of particles used for the Q-vectors
+ */
+void JetBackgroundAnalyzer::CalculateEventPlane(const EventViewParticles& particles, const Int_t nEventPlaneOrders, Double_t* eventPlaneQx, Double_t* eventPlaneQy, Int_t& eventPlaneMultiplicity) const{
+  
+  for(Int_t iFlow = 0; iFlow < nEventPlaneOrders; iFlow++){
+    eventPlaneQx[iFlow] = 0;
+    eventPlaneQy[iFlow] = 0;
+  }
+  eventPlaneMultiplicity = 0;
+  
+  // Loop over all generator level particles in the event. The particles are stored in contiguous arrays, as this is the hottest loop in the analysis
+  const Float_t* particlePtArray = particles.fPt;
+  const Float_t* particleEtaArray = particles.fEta;
+  const Float_t* particlePhiArray = particles.fPhi;
+  const Int_t* particleSubeventArray = particles.fSubevent;
+  const Int_t nParticles = particles.fnParticles;
+  
+  alignas(64) Float_t selectedPhi[fEventPlaneBlockSize];
+  Int_t nSelected = 0;
+  for(Int_t iParticle = 0; iParticle < nParticles; iParticle++){
+    
+    // Every angle is written to the next free slot, but the slot is only taken by the particles passing the cuts:
+    // mid-rapidity, Hydjet particles and no high-pT particles
+    selectedPhi[nSelected] = particlePhiArray[iParticle];
+    nSelected += !(TMath::Abs(particleEtaArray[iParticle]) > fMaxParticleEtaEventPlane) & (particleSubeventArray[iParticle] != 0) & !(particlePtArray[iParticle] > fMaxParticlePtEventPlane);
+    
+    if(nSelected == fEventPlaneBlockSize){
+      SumEventPlaneHarmonics(selectedPhi, nSelected, nEventPlaneOrders, eventPlaneQx, eventPlaneQy);
+      eventPlaneMultiplicity += nSelected;
+      nSelected = 0;
+    }
+  }
+  
+  SumEventPlaneHarmonics(selectedPhi, nSelected, nEventPlaneOrders, eventPlaneQx, eventPlaneQy);
+  eventPlaneMultiplicity += nSelected;
+}
+
+/*
+ * Add cos(n*phi) and sin(n*phi) for orders n = 2 to 2+nEventPlaneOrders-1 of a block of particle angles to the
+ * Q-vectors. Only one sine and cosine is computed for each particle, and the higher harmonics follow from the angle
+ * addition recurrence cos((n+1)phi) = cos(n*phi)cos(phi) - sin(n*phi)sin(phi), sin((n+1)phi) = sin(n*phi)cos(phi)
+ * + cos(n*phi)sin(phi). Each step is a loop without branches over the whole block in single precision, which the
+ * compiler turns into SIMD instructions. The harmonics are summed in fEventPlaneLanes independent lanes, and the
+ * lanes are added to the double precision Q-vectors at the end of the block.
+ *
+ * Accuracy compared to the double precision TMath::Cos and TMath::Sin of each harmonic: the sine and cosine of phi
+ * are within 1e-7 of the exact values, and each step of the recurrence adds at most about 1.2e-7, so the terms of
+ * the orders 2, 3 and 4 are within 2.5e-7, 4e-7 and 5e-7. Summing at most fEventPlaneBlockSize/fEventPlaneLanes = 32
+ * terms in each lane adds a rounding error below 2e-6 per term. For a Q-vector of M particles the difference is
+ * thus always below 3e-6*M, and for Hydjet events where the terms have random signs it is about 2e-8*M. This is
+ * many orders of magnitude below the statistical fluctuation sqrt(M) of the Q-vector.
+ *
+ *  Arguments:
+ *   const Float_t* particlePhi = Aligned array of the particle angles in [-pi,pi]
+ *   const Int_t nParticles = Number of angles in the array. At most fEventPlaneBlockSize
+ *   const Int_t nEventPlaneOrders = Number of harmonics summed
+ *   Double_t* eventPlaneQx = Array to which the x-components of the Q-vectors are summed
+ *   Double_t* eventPlaneQy = Array to which the y-components of the Q-vectors are summed
+ */
+void JetBackgroundAnalyzer::SumEventPlaneHarmonics(const Float_t* particlePhi, const Int_t nParticles, const Int_t nEventPlaneOrders, Double_t* eventPlaneQx, Double_t* eventPlaneQy){
+  
+  alignas(64) Float_t particleSin[fEventPlaneBlockSize];  // Sine of the particle angle
+  alignas(64) Float_t particleCos[fEventPlaneBlockSize];  // Cosine of the particle angle
+  alignas(64) Float_t harmonicSin[fEventPlaneBlockSize];  // Sine of the current harmonic of the particle angle
+  alignas(64) Float_t harmonicCos[fEventPlaneBlockSize];  // Cosine of the current harmonic of the particle angle
+  alignas(64) Float_t laneQx[fEventPlaneLanes];           // x-component of the Q-vector summed in each lane
+  alignas(64) Float_t laneQy[fEventPlaneLanes];           // y-component of the Q-vector summed in each lane
+  Float_t sine, cosine, nextCos;
+  
+  // The second harmonic from the double angle formulas
+  for(Int_t iParticle = 0; iParticle < nParticles; iParticle++){
+    SinCos(particlePhi[iParticle], sine, cosine);
+    particleSin[iParticle] = sine;
+    particleCos[iParticle] = cosine;
+    harmonicCos[iParticle] = cosine*cosine - sine*sine;
+    harmonicSin[iParticle] = 2*sine*cosine;
+  }
+  
+  const Int_t nFullLanes = nParticles - nParticles % fEventPlaneLanes;
+  for(Int_t iFlow = 0; iFlow < nEventPlaneOrders; iFlow++){
+    
+    // Step to the next harmonic
+    if(iFlow > 0){
+      for(Int_t iParticle = 0; iParticle < nParticles; iParticle++){
+        nextCos = harmonicCos[iParticle]*particleCos[iParticle] - harmonicSin[iParticle]*particleSin[iParticle];
+        harmonicSin[iParticle] = harmonicSin[iParticle]*particleCos[iParticle] + harmonicCos[iParticle]*particleSin[iParticle];
+        harmonicCos[iParticle] = nextCos;
+      }
+    }
+    
+    // Sum the harmonic in the lanes. The remaining particles go to the first lanes.
+    for(Int_t iLane = 0; iLane < fEventPlaneLanes; iLane++){
+      laneQx[iLane] = 0;
+      laneQy[iLane] = 0;
+    }
+    for(Int_t iParticle = 0; iParticle < nFullLanes; iParticle += fEventPlaneLanes){
+      for(Int_t iLane = 0; iLane < fEventPlaneLanes; iLane++){
+        laneQx[iLane] += harmonicCos[iParticle+iLane];
+        laneQy[iLane] += harmonicSin[iParticle+iLane];
+      }
+    }
+    for(Int_t iParticle = nFullLanes; iParticle < nParticles; iParticle++){
+      laneQx[iParticle-nFullLanes] += harmonicCos[iParticle];
+      laneQy[iParticle-nFullLanes] += harmonicSin[iParticle];
+    }
+    for(Int_t iLane = 0; iLane < fEventPlaneLanes; iLane++){
+      eventPlaneQx[iFlow] += laneQx[iLane];
+      eventPlaneQy[iFlow] += laneQy[iLane];
+    }
+  }
+}
+
+/*
+ * Sine and cosine of an angle in single precision. The angle is reduced to [-pi/4,pi/4] by subtracting the nearest
+ * multiple of pi/2 in three parts (Cody-Waite), the minimax polynomials of the Cephes library are evaluated for the
+ * reduced angle, and the quadrant is applied by exchanging and negating the results. There are no branches or
+ * function calls, so the function can be inlined to vectorized loops. The error is below 1e-7 for angles in
+ * [-pi,pi], and grows slowly for larger angles.
+ *
+ *  Arguments:
+ *   const Float_t angle = Angle in radians
+ *   Float_t& sine = Sine of the angle
+ *   Float_t& cosine = Cosine of the angle
+ */
+inline void JetBackgroundAnalyzer::SinCos(const Float_t angle, Float_t& sine, Float_t& cosine){
+  
+  // Nearest multiple of pi/2. The parts of pi/2 have so few bits that the products with the quadrant are exact.
+  const Float_t scaledAngle = angle * 0.636619772f;
+  const Int_t quadrant = (Int_t)(scaledAngle + std::copysign(0.5f, scaledAngle));
+  const Float_t quadrantFloat = quadrant;
+  const Float_t reduced = ((angle - quadrantFloat * 1.5703125f) - quadrantFloat * 4.837512969970703125e-4f) - quadrantFloat * 7.54978995489188216e-8f;
+  const Float_t reducedSquare = reduced * reduced;
+  
+  // Sine and cosine of the reduced angle
+  const Float_t reducedSine = ((-1.9515295891e-4f * reducedSquare + 8.3321608736e-3f) * reducedSquare - 1.6666654611e-1f) * reducedSquare * reduced + reduced;
+  const Float_t reducedCosine = ((2.443315711809948e-5f * reducedSquare - 1.388731625493765e-3f) * reducedSquare + 4.166664568298827e-2f) * reducedSquare * reducedSquare - 0.5f * reducedSquare + 1.0f;
+  
+  // Quadrants 1 and 3 exchange the sine and cosine, quadrants 2 and 3 flip the sign of the sine, and quadrants 1 and
+  // 2 flip the sign of the cosine. The exchange is done with exact multiplications by zero and one, since the compiler
+  // does not vectorize a conditional selection here.
+  const Float_t exchange = quadrant & 1;
+  const Float_t sineSign = 1 - (quadrant & 2);
+  const Float_t cosineSign = 1 - ((quadrant + 1) & 2);
+  sine = sineSign * ((1 - exchange) * reducedSine + exchange * reducedCosine);
+  cosine = cosineSign * ((1 - exchange) * reducedCosine + exchange * reducedSine);
+}
+
+/*
+ * Find the groups of branches that need to be read from the forest for the current configuration.
+ * Branches in the other groups are not read, which saves both reading and decompressing baskets.
+ *
+ *  return: Bit for each branch group in MonteCarloForestReader::enumBranchGroup. The bit is set if the group is needed.
+ */
+std::bitset<MonteCarloForestReader::knBranchGroups> JetBackgroundAnalyzer::GetRequiredBranchGroups() const{
+  
+  std::bitset<MonteCarloForestReader::knBranchGroups> branchGroups;
+  const Bool_t reconstructedJets = (fJetType == MonteCarloForestReader::kReconstructedJet);
+  
+  // Jet pT from the forest is not used. Reconstructed jets are always corrected starting from the raw pT.
+  branchGroups.set(MonteCarloForestReader::kForestJetPt, false);
+  
+  // Reconstructed jet angles are needed for the analyzed jets and for matching in jet pT closure. Only the selected axis is read.
+  branchGroups.set(MonteCarloForestReader::kJetEScheme, (reconstructedJets || fFillJetPtClosure) && fJetAxis == 0);
+  branchGroups.set(MonteCarloForestReader::kJetWTA, (reconstructedJets || fFillJetPtClosure) && fJetAxis == 1);
+  
+  // Raw pT is needed for the jet energy correction, and as matched pT for generator level jets
+  branchGroups.set(MonteCarloForestReader::kJetRawPt);
+  
+  // Track max is only needed for reconstructed jet quality cuts
+  branchGroups.set(MonteCarloForestReader::kJetTrackMax, reconstructedJets);
+  
+  // Reference and generator level jets are needed for matching and jet flavor for all jet types
+  branchGroups.set(MonteCarloForestReader::kReferenceJets);
+  branchGroups.set(MonteCarloForestReader::kGeneratorJets);
+  
+  // WTA axis for generator level jets is needed when generator level jet angles are used
+  branchGroups.set(MonteCarloForestReader::kGeneratorJetWTA, (!reconstructedJets || fFillJetPtClosure) && fJetAxis == 1);
+  
+  // Calorimeter jets are only needed if the calorimeter jet histograms are filled
+  branchGroups.set(MonteCarloForestReader::kCalorimeterJets, fDoCalorimeterJets);
+  
+  // Generator level particles are needed to determine the event plane. Particle charge is not used in the analysis.
+  branchGroups.set(MonteCarloForestReader::kGeneratorParticles);
+  branchGroups.set(MonteCarloForestReader::kGeneratorParticleCharge, false);
+  
+  return branchGroups;
+}
+
+/*
+ * Check if any jet in the event passes the jet pT cuts. The jet energy correction and the smearing are done exactly
+ * as in AnalyzeEvent, with the same random number for each jet, so an event is only rejected if none of its jets
+ * would be filled to the histograms. The check can be looser than the analysis, since an accepted event is just read
+ * fully. Because of this, the jet quality cuts, the matching in the jet pT closure and the limit of the calorimeter
+ * jet loop are not checked here. The correctors and the smearing function are separate from those of the analysis,
+ * since this can run in the decoding thread.
+ *
+ *  Arguments:
+ *   MonteCarloForestReader* eventReader = Reader with the stage 2 jet information loaded for the current event
+ *   const EventView* eventView = Event view with the event information and the file entry of the current event
+ *
+ *  return: True if at least one jet passes the jet pT cuts, false otherwise
+ */
+Bool_t JetBackgroundAnalyzer::HasJetCandidate(MonteCarloForestReader* eventReader, const EventView* eventView){
+  
+  Double_t jetPt = 0;           // pT of the i:th jet in the event
+  Double_t jetPhi = 0;          // phi of the i:th jet in the event
+  Double_t jetEta = 0;          // eta of the i:th jet in the event
+  Double_t smearingFactor = 0;  // Smearing factor for the jet energy resolution
+  
+  // Check the jets used for the inclusive and leading jet histograms
+  for(Int_t jetIndex = 0; jetIndex < eventReader->GetNJets(fJetType); jetIndex++){
+    
+    // No jet pT correction or smearing for generator level jets
+    if(fJetType == MonteCarloForestReader::kGeneratorLevelJet){
+      jetPt = eventReader->GetGeneratorJetPt(jetIndex);
+    } else {
+      jetPt = eventReader->GetJetRawPt(jetIndex);
+      jetPhi = eventReader->GetJetPhi(jetIndex);
+      jetEta = eventReader->GetJetEta(jetIndex);
+      if(TMath::Abs(jetEta) >= fJetEtaCut) continue;
+      
+      fCandidateJetCorrector->SetJetPT(jetPt);
+      fCandidateJetCorrector->SetJetEta(jetEta);
+      fCandidateJetCorrector->SetJetPhi(jetPhi);
+      
+      jetPt = fCandidateJetCorrector->GetCorrectedPT();
+      
+      if(fSmearResolution){
+        smearingFactor = GetSmearingFactor(jetPt, jetEta, eventView->fCentrality, fCandidateSmearingFunction);
+        jetPt = jetPt * fSmearingRandom.Gaus(1, smearingFactor, eventView->fFileId, eventView->fFileEntry, jetIndex, CounterRandom::kJetSmearing);
+      }
+    }
+    
+    if(jetPt >= fJetMinimumPtCut && jetPt <= fJetMaximumPtCut) return true;
+  }
+  
+  // Check the calorimeter jets if the calorimeter jet histograms are filled
+  if(fDoCalorimeterJets){
+    for(Int_t jetIndex = 0; jetIndex < eventReader->GetNCalorimeterJets(); jetIndex++){
+      jetPt = eventReader->GetCalorimeterJetPt(jetIndex);
+      jetPhi = eventReader->GetCalorimeterJetPhi(jetIndex);
+      jetEta = eventReader->GetCalorimeterJetEta(jetIndex);
+      if(TMath::Abs(jetEta) >= fJetEtaCut) continue;
+      
+      fCandidateCaloJetCorrector->SetJetPT(jetPt);
+      fCandidateCaloJetCorrector->SetJetEta(jetEta);
+      fCandidateCaloJetCorrector->SetJetPhi(jetPhi);
+      
+      jetPt = fCandidateCaloJetCorrector->GetCorrectedPT();
+      
+      if(jetPt >= fJetMinimumPtCut && jetPt <= fJetMaximumPtCut) return true;
+    }
+  }
+  
+  // Check the generator level jets if the jet pT closure histograms are filled
+  if(fFillJetPtClosure){
+    for(Int_t jetIndex = 0; jetIndex < eventReader->GetNGeneratorJets(); jetIndex++){
+      jetPt = eventReader->GetGeneratorJetPt(jetIndex);
+      if(jetPt >= fJetClosureMinimumPt && jetPt <= fJetMaximumPtCut) return true;
+    }
+  }
+  
+  return false;
+}
+
+/*
+ * Sample the resident memory of the process and compare it to the soft limit. The warning is given before the
+ * batch system kills the job for using too much memory, such that the file where the memory grows is known.
+ *
+ *  Arguments:
+ *   const TString currentFile = File that is being analyzed
+ *   Bool_t& limitWarningGiven = Flag telling if the warning has already been given for this file. Set to true when the warning is given
+ *
+ *  return: Resident memory of the process in MB
+ */
+Double_t JetBackgroundAnalyzer::UpdateMemoryUsage(const TString currentFile, Bool_t& limitWarningGiven){
+  
+  ProcInfo_t processInfo;
+  gSystem->GetProcInfo(&processInfo);
+  const Double_t residentMemory = processInfo.fMemResident/1024.0; // fMemResident is in kB
+  
+  if(residentMemory > fPeakResidentMemory) fPeakResidentMemory = residentMemory;
+  
+  if(fMemorySoftLimit > 0 && residentMemory > fMemorySoftLimit && !limitWarningGiven){
+    cout << "Warning! Resident memory " << residentMemory << " MB exceeds the soft limit of " << fMemorySoftLimit << " MB while analyzing the file: " << currentFile.Data() << endl;
+    limitWarningGiven = true;
+  }
+  
+  return residentMemory;
+}
+
 /*
  * Getter for EEC histograms
  */
@@ -929,6 +2552,51 @@ JetBackgroundHistograms* JetBackgroundAnalyzer::GetHistograms() const{
   return fHistograms;
 }
 
+/*
+ * Setter for the file to which the jet records are written. The records allow filling the histograms again with a different binning.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the record file. Empty string means that no records are written
+ */
+void JetBackgroundAnalyzer::SetJetRecordFileName(const TString fileName){
+  fJetRecordFileName = fileName;
+}
+
+/*
+ * Setter for the range of entries analyzed from each file. The ranges are given in the job file lists of a split
+ * analysis, such that large files can be divided between several jobs.
+ *
+ *  Arguments:
+ *   const std::vector<Int_t>& firstEntries = First analyzed entry of each file
+ *   const std::vector<Int_t>& lastEntries = Entry after the last analyzed entry of each file. -1 = End of the file
+ */
+void JetBackgroundAnalyzer::SetFileEntryRanges(const std::vector<Int_t>& firstEntries, const std::vector<Int_t>& lastEntries){
+  if(firstEntries.size() != fFileNames.size() || lastEntries.size() != fFileNames.size()){
+    cout << "Error! Entry ranges are given for " << firstEntries.size() << " files, but there are " << fFileNames.size() << " files to analyze" << endl;
+    assert(0);
+  }
+  fFileFirstEntries = firstEntries;
+  fFileLastEntries = lastEntries;
+}
+
+/*
+ * Combine the range of entries analyzed from a file with another range of entries. Only the entries in both ranges are analyzed.
+ *
+ *  Arguments:
+ *   const Int_t iFile = Index of the file in the file list
+ *   const Int_t rangeBegin = First entry of the other range
+ *   const Int_t rangeEnd = Entry after the last entry of the other range. -1 = End of the file
+ *   Int_t& firstEntry = First entry in both ranges
+ *   Int_t& lastEntry = Entry after the last entry in both ranges. -1 = End of the file
+ */
+void JetBackgroundAnalyzer::GetFileEntryRange(const Int_t iFile, const Int_t rangeBegin, const Int_t rangeEnd, Int_t& firstEntry, Int_t& lastEntry) const{
+  firstEntry = TMath::Max(rangeBegin, 0);
+  lastEntry = rangeEnd;
+  if(iFile < 0 || iFile >= (Int_t)fFileFirstEntries.size()) return;
+  firstEntry = TMath::Max(firstEntry, fFileFirstEntries.at(iFile));
+  if(fFileLastEntries.at(iFile) >= 0) lastEntry = (lastEntry < 0) ? fFileLastEntries.at(iFile) : TMath::Min(lastEntry, fFileLastEntries.at(iFile));
+}
+
 /*
  * Getter for centrality bin
  */
@@ -10,6 +10,12 @@
 #include <tuple>      // For returning several arguments in a transparent manner
 #include <fstream>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <limits>
+#include <chrono>
+#include <algorithm>
 
 // Root includes
 #include <TString.h>
@@ -20,6 +26,17 @@
 #include "ConfigurationCard.h"
 #include "JetBackgroundHistograms.h"
 #include "MonteCarloForestReader.h"
+#include "EventView.h"
+#include "ForestFilePipeline.h"
+#include "RemoteFileCache.h"
+#include "EventViewRing.h"
+#include "AnalysisTaskQueue.h"
+#include "EventIndex.h"
+#include "EventPlaneCache.h"
+#include "JetRecordTable.h"
+#include "CounterRandom.h"
+#include "FileListReader.h"
+#include "FileManifest.h"
 #include "JetCorrector.h"
 #include "JetUncertainty.h"
 #include "JetMetScalingFactorManager.h"
@@ -29,6 +46,8 @@ class JetBackgroundAnalyzer{
 private:
   
   enum enumFilledHistograms{kFillEventInformation, kFillJets, kFillTracks, kFillJetConeHistograms, kFillEnergyEnergyCorrelators, kFillEnergyEnergyCorrelatorsSystematics, kFillJetPtClosure, kFillJetPtUnfoldingResponse, kFillTrackParticleMatchingHistograms, knFillTypes}; // Histograms to fill
+  static const Int_t fEventPlaneBlockSize = 256; // Number of particles compacted at a time for the event plane Q-vector kernel
+  static const Int_t fEventPlaneLanes = 8;        // Number of particles summed in parallel lanes in the event plane Q-vector kernel
   
 public:
   
@@ -40,24 +59,49 @@ public:
   JetBackgroundAnalyzer& operator=(const JetBackgroundAnalyzer& obj); // Equal sign operator
   
   // Methods
-  void RunAnalysis();                     // Run the dijet analysis
+  void RunAnalysis(const Int_t rangeBegin = 0, const Int_t rangeEnd = -1); // Run the dijet analysis. The entry range is applied to each file
+  void RunDataFrameAnalysis(); // Run the same analysis with RDataFrame and implicit multithreading
+  void BuildEventIndex(const TString outputDirectory, const Int_t nThreads); // Build the event index for all the input files
+  void WriteColumnCache(const TString outputDirectory, const Int_t chunkSize); // Write the column cache for all the input files
+  FileManifest ValidateFiles(const Int_t nThreads); // Check that all the input files can be analyzed
+  void FindTaskRanges(const Int_t taskEntries, const Int_t nThreads, std::vector<Int_t>& fileIndices, std::vector<Int_t>& firstEntries, std::vector<Int_t>& lastEntries); // Split the input files into cluster aligned ranges of entries
   JetBackgroundHistograms* GetHistograms() const;   // Getter for histograms
+  void SetJetRecordFileName(const TString fileName); // Setter for the file to which the jet records are written
+  void SetFileEntryRanges(const std::vector<Int_t>& firstEntries, const std::vector<Int_t>& lastEntries); // Setter for the range of entries analyzed from each file
 
  private:
   
   // Private methods
   void ReadConfigurationFromCard(); // Read all the configuration from the input card
   
-  Bool_t PassEventCuts(MonteCarloForestReader* eventReader, const Bool_t fillHistograms); // Check if the event passes the event cuts
+  void CreateJetCorrectors(); // Create the jet energy correctors
+  void GetFileEntryRange(const Int_t iFile, const Int_t rangeBegin, const Int_t rangeEnd, Int_t& firstEntry, Int_t& lastEntry) const; // Combine the entry range of a file with another range
+  void DecodeFiles(ForestFilePipeline* filePipeline, EventViewRing* eventRing, const Int_t rangeBegin = 0, const Int_t rangeEnd = -1); // Read the events from all the files and analyze them or pass them to the analysis thread
+  void AnalyzeFilesInThreads(const std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>>& fileBranchGroups, RemoteFileCache* remoteFileCache); // Analyze the files in tasks divided between several worker threads
+  void AnalyzeTasks(const Int_t workerIndex, AnalysisTaskQueue* taskQueue, const std::vector<std::bitset<MonteCarloForestReader::knBranchGroups>>* fileBranchGroups, RemoteFileCache* remoteFileCache, const ULong64_t baseSeed); // Analyze tasks from the queue in a worker thread
+  void BuildEventIndexForFiles(std::atomic<Int_t>* nextFile, std::mutex* weightMutex, const TString outputDirectory); // Build the event index for files taken from the file list
+  void ValidateFilesInThread(std::atomic<Int_t>* nextFile, FileManifest* manifest); // Check files taken from the file list until all the files are checked
+  Bool_t ReadEvent(MonteCarloForestReader* eventReader, Int_t iEvent, EventView* eventView, const EventIndex* eventIndex, EventPlaneCache* eventPlaneCache, const Bool_t buildEventPlaneCache, const Bool_t copyParticles); // Read an event from the forest or event index to an event view
+  void CalculateEventPlane(const EventViewParticles& particles, const Int_t nEventPlaneOrders, Double_t* eventPlaneQx, Double_t* eventPlaneQy, Int_t& eventPlaneMultiplicity) const; // Determine the event plane Q-vectors from generator level particles
+  static void SumEventPlaneHarmonics(const Float_t* particlePhi, const Int_t nParticles, const Int_t nEventPlaneOrders, Double_t* eventPlaneQx, Double_t* eventPlaneQy); // Add the harmonics of a block of particle angles to the Q-vectors
+  static void SinCos(const Float_t angle, Float_t& sine, Float_t& cosine); // Sine and cosine of an angle in single precision without branches
+  Double_t UpdateMemoryUsage(const TString currentFile, Bool_t& limitWarningGiven); // Sample the resident memory and compare it to the soft limit
+  void AnalyzeEvent(const EventView* eventView); // Fill the histograms from one event
+  Bool_t PassEventCuts(const EventView* eventView, const Bool_t fillHistograms, Long64_t* eventCounts = NULL); // Check if the event passes the event cuts
+  void FillIndexEventCounts(); // Add the events counted from the event index to the event counter
+  Bool_t HasJetCandidate(MonteCarloForestReader* eventReader, const EventView* eventView); // Check from the loaded jets if any jet in the event passes the jet pT cuts after correction and smearing
+  std::bitset<MonteCarloForestReader::knBranchGroups> GetRequiredBranchGroups() const; // Find the branch groups that need to be read from the forest for the current configuration
   Double_t GetVzWeight(const Double_t vz) const;  // Get the proper vz weighting depending on analyzed system
   Double_t GetCentralityWeight(const Int_t hiBin) const; // Get the proper centrality weighting depending on analyzed system
-  Double_t GetSmearingFactor(Double_t jetPt, Double_t jetEta, const Double_t centrality); // Getter for jet pT smearing factor
+  Double_t GetSmearingFactor(Double_t jetPt, Double_t jetEta, const Double_t centrality, TF1* smearingFunction = NULL); // Getter for jet pT smearing factor
   Int_t GetCentralityBin(const Double_t centrality) const; // Getter for centrality bin
   Double_t GetDeltaR(const Double_t eta1, const Double_t phi1, const Double_t eta2, const Double_t phi2) const; // Get deltaR between two objects
   
   // Private data members
-  MonteCarloForestReader* fEventReader;            // Reader for jets in the event
+  MonteCarloForestReader* fEventReader;            // Configured reader for jets in the event. Copied for each file in the file pipeline
   std::vector<TString> fFileNames;               // Vector for all the files to loop over
+  std::vector<Int_t> fFileFirstEntries;          // First analyzed entry of each file. Empty = All the entries in each file
+  std::vector<Int_t> fFileLastEntries;           // Entry after the last analyzed entry of each file. -1 = End of the file
   ConfigurationCard* fCard;                      // Configuration card for the analysis
   JetBackgroundHistograms* fHistograms;                    // Filled histograms
   TF1* fVzWeightFunction;                        // Weighting function for vz. Needed for MC.
@@ -66,8 +110,12 @@ public:
   TF1* fSmearingFunction;                        // Additional smearing for jets. Needed in systematic uncertainty study.
   JetCorrector* fJetCorrector2018;               // Class for making jet energy correction for 2018 data
   JetCorrector* fCaloJetCorrector2018;           // Class for making jet energy correction for calorimeter jets in 2018 data
+  TF1* fCandidateSmearingFunction;               // Smearing function for the jet candidate check in staged loading
+  JetCorrector* fCandidateJetCorrector;          // Jet energy correction for the jet candidate check in staged loading
+  JetCorrector* fCandidateCaloJetCorrector;      // Calorimeter jet energy correction for the jet candidate check in staged loading
   JetMetScalingFactorManager* fEnergyResolutionSmearingFinder; // Manager to find proper jet energy resolution scaling factors provided by the JetMet group
-  TRandom3* fRng;                                // Random number generator
+  TRandom3* fRng;                                // Random number generator for the seed when no seed is given
+  CounterRandom fSmearingRandom;                 // Random numbers for the jet pT smearing, which depend only on the seed and the jet
   
   // Analyzed data and forest types
   Int_t fJetType;                    // Type of jets used for analysis. 0 = Reconstructed jets, 1 = Generator level jets
@@ -85,6 +133,14 @@ public:
   // Event plane calculation cuts
   Double_t fMaxParticleEtaEventPlane;  // Maximum eta value for particles used to determine the event plane
   Double_t fMaxParticlePtEventPlane;   // Maximum pT value for particles used to determine the event plane
+  Int_t fnEventPlaneOrders;            // Number of flow harmonics for which the event plane is determined, starting from the second order
+  
+  // Event plane of the current event with one element for each order. Allocated when the number of orders is read from the card.
+  std::vector<Double_t> fEventPlaneQ;      // Magnitude of the event plane Q-vector
+  std::vector<Double_t> fEventPlaneQx;     // x-component of the event plane vector
+  std::vector<Double_t> fEventPlaneQy;     // y-component of the event plane vector
+  std::vector<Double_t> fEventPlaneAngle;  // Event plane angle
+  std::vector<Double_t> fRecordDeltaPhi;   // DeltaPhi between a jet and all event plane angles for the jet records
   
   // Jet selection cuts
   Int_t fJetAxis;                      // Used jet axis type. 0 = Anti-kT jet axis, 1 = Axis from leading PF candidate
@@ -100,6 +156,41 @@ public:
   
   // Jet pT closure histogram filling is optional
   Bool_t fFillJetPtClosure;            // Fill jet pT closure histograms
+  
+  // Configuration for reading the input files
+  Int_t fReadCacheSize;                // Size of the read cache for each tree in MB. 0 = No read cache
+  Bool_t fAsyncPrefetch;               // Flag for prefetching the next cluster of baskets asynchronously
+  Int_t fUnzipThreads;                 // Number of threads used to decompress baskets in parallel. 0 = No parallel unzipping
+  Bool_t fAlignedTreeReading;          // Flag for reading all the trees as friends of the jet tree
+  Bool_t fStagedEventLoading;          // Flag for loading the event information, jet pT:s and the rest of the event in stages
+  Bool_t fPrefetchNextFile;            // Flag for opening and preparing the next input file in the background while the current one is analyzed
+  Int_t fDecodeRingDepth;              // Number of event views in the ring between the decoding and analysis threads. 0 = No separate decoding thread
+  Bool_t fUseEventIndex;               // Flag for taking the event information from the event index files when they are available
+  TString fEventIndexDirectory;        // Directory where the event index files are kept
+  std::vector<Long64_t> fIndexEventCounts; // Events rejected with the event index, counted for each event type without reading them
+  Bool_t fUseColumnCache;              // Flag for reading the events from the column cache files when they are available
+  TString fColumnCacheDirectory;       // Directory where the column cache files are kept
+  Bool_t fRevalidateColumnCache;       // Flag for opening the forest file to check that a column cache is up to date
+  Bool_t fUseEventPlaneCache;          // Flag for taking the event plane from the event plane cache files, and writing them for files without one
+  TString fEventPlaneCacheDirectory;   // Directory where the event plane cache files are kept
+  Bool_t fUseRemoteFileCache;          // Flag for copying remote input files to a local cache directory and reading them from there
+  TString fRemoteFileCacheDirectory;   // Directory where the local copies of the remote input files are kept
+  Int_t fRemoteFileCacheSize;          // Maximum size of the remote file cache directory in MB
+  Bool_t fRevalidateRemoteFileCache;   // Flag for checking the size and UUID of the remote file before using a local copy
+  Int_t fFileOpenAttempts;             // Number of attempts to open an input file through each redirector
+  Int_t fFileRetryDelay;               // Waiting time in seconds after the first failed attempt to open an input file
+  std::vector<TString> fSkippedFiles;  // Files that could not be read to the end. The events read before the failure are analyzed
+  Int_t fAnalysisThreads;              // Number of worker threads analyzing the files. 0 = Analyze the files in the main thread
+  Int_t fThreadTaskEntries;            // Minimum number of entries in one cluster aligned task of the multithreaded analysis. 0 = One task for each file
+  Int_t fRandomSeed;                   // Seed for the random numbers. 0 = Different random numbers in each run
+  std::bitset<JetBackgroundHistograms::knDenseHistogramGroups> fDenseHistograms; // Groups of THnSparses filled to shared dense histograms in the multithreaded analysis
+  TString fJetRecordFileName;          // File to which the jet records are written. Empty = No jet records
+  JetRecordTable* fJetRecords;         // Records of the events and jets filled to the histograms
+  
+  // Memory usage
+  Int_t fMemorySoftLimit;                      // Resident memory in MB above which a warning is printed. 0 = No limit
+  Double_t fPeakResidentMemory;                // Largest resident memory in MB seen during the analysis
+  std::vector<Double_t> fFileResidentMemory;   // Resident memory in MB at the end of each file
 
 };
 
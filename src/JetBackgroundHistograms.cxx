@@ -21,20 +21,31 @@ JetBackgroundHistograms::JetBackgroundHistograms() :
   fhCentralityWeighted(0),
   fhPtHat(0),
   fhPtHatWeighted(0),
+  fhFileMemory(0),
+  fhPeakMemory(0),
+  fhSkippedFiles(0),
+  fhTaskTime(0),
+  fhWorkerTime(0),
   fhInclusiveJet(0),
   fhLeadingJet(0),
   fhCalorimeterJet(0),
   fhJetPtClosure(0),
-  fCard(0)
+  fhInclusiveJetEventPlane(),
+  fhLeadingJetEventPlane(),
+  fhCalorimeterJetEventPlane(),
+  fhDenseInclusiveJet(0),
+  fhDenseLeadingJet(0),
+  fhDenseCalorimeterJet(0),
+  fhDenseJetPtClosure(0),
+  fhDenseInclusiveJetEventPlane(),
+  fhDenseLeadingJetEventPlane(),
+  fhDenseCalorimeterJetEventPlane(),
+  fOwnsDenseHistograms(false),
+  fCard(0),
+  fnFiles(1),
+  fnEventPlanes(0)
 {
   // Default constructor
-
-  for(int iEventPlane = 0; iEventPlane < knEventPlanes; iEventPlane++){
-    fhInclusiveJetEventPlane[iEventPlane] = NULL;
-    fhLeadingJetEventPlane[iEventPlane] = NULL;
-    fhCalorimeterJetEventPlane[iEventPlane] = NULL;
-  }
-  
 }
 
 /*
@@ -48,19 +59,31 @@ JetBackgroundHistograms::JetBackgroundHistograms(ConfigurationCard* newCard) :
   fhCentralityWeighted(0),
   fhPtHat(0),
   fhPtHatWeighted(0),
+  fhFileMemory(0),
+  fhPeakMemory(0),
+  fhSkippedFiles(0),
+  fhTaskTime(0),
+  fhWorkerTime(0),
   fhInclusiveJet(0),
   fhLeadingJet(0),
   fhCalorimeterJet(0),
   fhJetPtClosure(0),
-  fCard(newCard)
+  fhInclusiveJetEventPlane(),
+  fhLeadingJetEventPlane(),
+  fhCalorimeterJetEventPlane(),
+  fhDenseInclusiveJet(0),
+  fhDenseLeadingJet(0),
+  fhDenseCalorimeterJet(0),
+  fhDenseJetPtClosure(0),
+  fhDenseInclusiveJetEventPlane(),
+  fhDenseLeadingJetEventPlane(),
+  fhDenseCalorimeterJetEventPlane(),
+  fOwnsDenseHistograms(false),
+  fCard(newCard),
+  fnFiles(1),
+  fnEventPlanes(0)
 {
   // Custom constructor
-
-  for(int iEventPlane = 0; iEventPlane < knEventPlanes; iEventPlane++){
-    fhInclusiveJetEventPlane[iEventPlane] = NULL;
-    fhLeadingJetEventPlane[iEventPlane] = NULL;
-    fhCalorimeterJetEventPlane[iEventPlane] = NULL;
-  }
 }
 
 /*
@@ -74,20 +97,31 @@ JetBackgroundHistograms::JetBackgroundHistograms(const JetBackgroundHistograms&
   fhCentralityWeighted(in.fhCentralityWeighted),
   fhPtHat(in.fhPtHat),
   fhPtHatWeighted(in.fhPtHatWeighted),
+  fhFileMemory(in.fhFileMemory),
+  fhPeakMemory(in.fhPeakMemory),
+  fhSkippedFiles(in.fhSkippedFiles),
+  fhTaskTime(in.fhTaskTime),
+  fhWorkerTime(in.fhWorkerTime),
   fhInclusiveJet(in.fhInclusiveJet),
   fhLeadingJet(in.fhLeadingJet),
   fhCalorimeterJet(in.fhCalorimeterJet),
   fhJetPtClosure(in.fhJetPtClosure),
-  fCard(in.fCard)
+  fhInclusiveJetEventPlane(in.fhInclusiveJetEventPlane),
+  fhLeadingJetEventPlane(in.fhLeadingJetEventPlane),
+  fhCalorimeterJetEventPlane(in.fhCalorimeterJetEventPlane),
+  fhDenseInclusiveJet(in.fhDenseInclusiveJet),
+  fhDenseLeadingJet(in.fhDenseLeadingJet),
+  fhDenseCalorimeterJet(in.fhDenseCalorimeterJet),
+  fhDenseJetPtClosure(in.fhDenseJetPtClosure),
+  fhDenseInclusiveJetEventPlane(in.fhDenseInclusiveJetEventPlane),
+  fhDenseLeadingJetEventPlane(in.fhDenseLeadingJetEventPlane),
+  fhDenseCalorimeterJetEventPlane(in.fhDenseCalorimeterJetEventPlane),
+  fOwnsDenseHistograms(in.fOwnsDenseHistograms),
+  fCard(in.fCard),
+  fnFiles(in.fnFiles),
+  fnEventPlanes(in.fnEventPlanes)
 {
   // Copy constructor
-
-  for(int iEventPlane = 0; iEventPlane < knEventPlanes; iEventPlane++){
-    fhInclusiveJetEventPlane[iEventPlane] = in.fhInclusiveJetEventPlane[iEventPlane];
-    fhLeadingJetEventPlane[iEventPlane] = in.fhLeadingJetEventPlane[iEventPlane];
-    fhCalorimeterJetEventPlane[iEventPlane] = in.fhCalorimeterJetEventPlane[iEventPlane];
-  }
-
 }
 
 /*
@@ -105,17 +139,29 @@ JetBackgroundHistograms& JetBackgroundHistograms::operator=(const JetBackgroundH
   fhCentralityWeighted = in.fhCentralityWeighted;
   fhPtHat = in.fhPtHat;
   fhPtHatWeighted = in.fhPtHatWeighted;
+  fhFileMemory = in.fhFileMemory;
+  fhPeakMemory = in.fhPeakMemory;
+  fhSkippedFiles = in.fhSkippedFiles;
+  fhTaskTime = in.fhTaskTime;
+  fhWorkerTime = in.fhWorkerTime;
   fhInclusiveJet = in.fhInclusiveJet;
   fhLeadingJet = in.fhLeadingJet;
   fhCalorimeterJet = in.fhCalorimeterJet;
   fhJetPtClosure = in.fhJetPtClosure;
+  fhInclusiveJetEventPlane = in.fhInclusiveJetEventPlane;
+  fhLeadingJetEventPlane = in.fhLeadingJetEventPlane;
+  fhCalorimeterJetEventPlane = in.fhCalorimeterJetEventPlane;
+  fhDenseInclusiveJet = in.fhDenseInclusiveJet;
+  fhDenseLeadingJet = in.fhDenseLeadingJet;
+  fhDenseCalorimeterJet = in.fhDenseCalorimeterJet;
+  fhDenseJetPtClosure = in.fhDenseJetPtClosure;
+  fhDenseInclusiveJetEventPlane = in.fhDenseInclusiveJetEventPlane;
+  fhDenseLeadingJetEventPlane = in.fhDenseLeadingJetEventPlane;
+  fhDenseCalorimeterJetEventPlane = in.fhDenseCalorimeterJetEventPlane;
+  fOwnsDenseHistograms = in.fOwnsDenseHistograms;
   fCard = in.fCard;
-
-  for(int iEventPlane = 0; iEventPlane < knEventPlanes; iEventPlane++){
-    fhInclusiveJetEventPlane[iEventPlane] = in.fhInclusiveJetEventPlane[iEventPlane];
-    fhLeadingJetEventPlane[iEventPlane] = in.fhLeadingJetEventPlane[iEventPlane];
-    fhCalorimeterJetEventPlane[iEventPlane] = in.fhCalorimeterJetEventPlane[iEventPlane];
-  }
+  fnFiles = in.fnFiles;
+  fnEventPlanes = in.fnEventPlanes;
   
   return *this;
 }
@@ -132,16 +178,34 @@ JetBackgroundHistograms::~JetBackgroundHistograms(){
   delete fhCentralityWeighted;
   delete fhPtHat;
   delete fhPtHatWeighted;
+  delete fhFileMemory;
+  delete fhPeakMemory;
+  delete fhSkippedFiles;
+  delete fhTaskTime;
+  delete fhWorkerTime;
   delete fhInclusiveJet;
   delete fhLeadingJet;
   delete fhCalorimeterJet;
   delete fhJetPtClosure;
 
-  for(int iEventPlane = 0; iEventPlane < knEventPlanes; iEventPlane++){
+  for(int iEventPlane = 0; iEventPlane < fnEventPlanes; iEventPlane++){
     delete fhInclusiveJetEventPlane[iEventPlane];
     delete fhLeadingJetEventPlane[iEventPlane];
     delete fhCalorimeterJetEventPlane[iEventPlane];
   }
+  
+  // Shared dense histograms are deleted only by the set that created them
+  if(fOwnsDenseHistograms){
+    delete fhDenseInclusiveJet;
+    delete fhDenseLeadingJet;
+    delete fhDenseCalorimeterJet;
+    delete fhDenseJetPtClosure;
+    for(int iEventPlane = 0; iEventPlane < fnEventPlanes; iEventPlane++){
+      delete fhDenseInclusiveJetEventPlane[iEventPlane];
+      delete fhDenseLeadingJetEventPlane[iEventPlane];
+      delete fhDenseCalorimeterJetEventPlane[iEventPlane];
+    }
+  }
 }
 
 /*
@@ -151,6 +215,13 @@ void JetBackgroundHistograms::SetCard(ConfigurationCard* newCard){
   fCard = newCard;
 }
 
+/*
+ * Set the number of analyzed files. The memory usage histogram has one bin for each file. Must be called before CreateHistograms.
+ */
+void JetBackgroundHistograms::SetNumberOfFiles(const Int_t nFiles){
+  fnFiles = nFiles > 0 ? nFiles : 1;
+}
+
 /*
  * Create the necessary histograms
  */
@@ -261,6 +332,18 @@ void JetBackgroundHistograms::CreateHistograms(){
   fhCentralityWeighted = new TH1F("centralityWeighted","centralityWeighted",nCentralityBins,minCentrality,maxCentrality); fhCentralityWeighted->Sumw2();
   fhPtHat = new TH1F("pthat","pthat",nPtHatBins,ptHatBins); fhPtHat->Sumw2();
   fhPtHatWeighted = new TH1F("pthatWeighted","pthatWeighted",nFinePtHatBins,minPtHat,maxPtHat); fhPtHatWeighted->Sumw2();
+  fhFileMemory = new TH1F("fileMemory","fileMemory",fnFiles,-0.5,fnFiles-0.5);
+  fhPeakMemory = new TH1F("peakMemory","peakMemory",1,-0.5,0.5);
+  
+  // The skipped files get a bin labeled with the file name. The labeled bins are merged by name with hadd.
+  fhSkippedFiles = new TH1F("skippedFiles","skippedFiles",1,0,1);
+  fhSkippedFiles->SetCanExtend(TH1::kAllAxes);
+  
+  // Timing of the multithreaded analysis. The tasks are labeled with the file index and entry range, the workers with their index.
+  fhTaskTime = new TH1F("taskTime","taskTime",1,0,1);
+  fhTaskTime->SetCanExtend(TH1::kAllAxes);
+  fhWorkerTime = new TH1F("workerTime","workerTime",1,0,1);
+  fhWorkerTime->SetCanExtend(TH1::kAllAxes);
   
   // For the event histogram, label each bin corresponding to an event cut
   for(Int_t i = 0; i < knEventTypes; i++){
@@ -369,8 +452,15 @@ void JetBackgroundHistograms::CreateHistograms(){
   lowBinBorderJetEventPlaneCorrelation[2] = minCentrality;          // low bin border for centrality
   highBinBorderJetEventPlaneCorrelation[2] = maxCentrality;         // high bin border for centrality
   
-  // Create histograms for event plane study
-  for(int iEventPlane = 0; iEventPlane < knEventPlanes; iEventPlane++){
+  // Create histograms for event plane study. Only the orders for which the event plane is determined are created.
+  fnEventPlanes = TMath::Max(0, static_cast<Int_t>(fCard->Get("EventPlaneOrders")));
+  fhInclusiveJetEventPlane.resize(fnEventPlanes, NULL);
+  fhLeadingJetEventPlane.resize(fnEventPlanes, NULL);
+  fhCalorimeterJetEventPlane.resize(fnEventPlanes, NULL);
+  fhDenseInclusiveJetEventPlane.resize(fnEventPlanes, NULL);
+  fhDenseLeadingJetEventPlane.resize(fnEventPlanes, NULL);
+  fhDenseCalorimeterJetEventPlane.resize(fnEventPlanes, NULL);
+  for(int iEventPlane = 0; iEventPlane < fnEventPlanes; iEventPlane++){
     fhInclusiveJetEventPlane[iEventPlane] = new THnSparseF(Form("inclusiveJetEventPlaneOrder%d", iEventPlane+2), Form("inclusiveJetEventPlaneOrder%d", iEventPlane+2), nAxesJetEventPlaneCorrelation, nBinsJetPtEventPlaneCorrelation, lowBinBorderJetEventPlaneCorrelation, highBinBorderJetEventPlaneCorrelation); fhInclusiveJetEventPlane[iEventPlane]->Sumw2();
     fhLeadingJetEventPlane[iEventPlane] = new THnSparseF(Form("leadingJetEventPlaneOrder%d", iEventPlane+2), Form("leadingJetEventPlaneOrder%d", iEventPlane+2), nAxesJetEventPlaneCorrelation, nBinsJetPtEventPlaneCorrelation, lowBinBorderJetEventPlaneCorrelation, highBinBorderJetEventPlaneCorrelation); fhLeadingJetEventPlane[iEventPlane]->Sumw2();
     fhCalorimeterJetEventPlane[iEventPlane] = new THnSparseF(Form("calorimeterJetEventPlaneOrder%d", iEventPlane+2), Form("calorimeterJetEventPlaneOrder%d", iEventPlane+2), nAxesJetEventPlaneCorrelation, nBinsJetPtEventPlaneCorrelation, lowBinBorderJetEventPlaneCorrelation, highBinBorderJetEventPlaneCorrelation); fhCalorimeterJetEventPlane[iEventPlane]->Sumw2();
@@ -386,6 +476,153 @@ void JetBackgroundHistograms::CreateHistograms(){
 
 }
 
+/*
+ * Add the event and jet histograms from another histogram set with the same binning. The memory usage and skipped
+ * file histograms describe the whole run and are not added.
+ *
+ *  Arguments:
+ *   const JetBackgroundHistograms* other = Histogram set that is added to this one
+ */
+void JetBackgroundHistograms::Add(const JetBackgroundHistograms* other){
+  fhVertexZ->Add(other->fhVertexZ);
+  fhVertexZWeighted->Add(other->fhVertexZWeighted);
+  fhEvents->Add(other->fhEvents);
+  fhCentrality->Add(other->fhCentrality);
+  fhCentralityWeighted->Add(other->fhCentralityWeighted);
+  fhPtHat->Add(other->fhPtHat);
+  fhPtHatWeighted->Add(other->fhPtHatWeighted);
+  fhInclusiveJet->Add(other->fhInclusiveJet);
+  fhLeadingJet->Add(other->fhLeadingJet);
+  fhCalorimeterJet->Add(other->fhCalorimeterJet);
+  fhJetPtClosure->Add(other->fhJetPtClosure);
+
+  for(int iEventPlane = 0; iEventPlane < fnEventPlanes; iEventPlane++){
+    fhInclusiveJetEventPlane[iEventPlane]->Add(other->fhInclusiveJetEventPlane[iEventPlane]);
+    fhLeadingJetEventPlane[iEventPlane]->Add(other->fhLeadingJetEventPlane[iEventPlane]);
+    fhCalorimeterJetEventPlane[iEventPlane]->Add(other->fhCalorimeterJetEventPlane[iEventPlane]);
+  }
+}
+
+/*
+ * Clear the event and jet histograms, such that the set can be filled again
+ */
+void JetBackgroundHistograms::Reset(){
+  fhVertexZ->Reset();
+  fhVertexZWeighted->Reset();
+  fhEvents->Reset();
+  fhCentrality->Reset();
+  fhCentralityWeighted->Reset();
+  fhPtHat->Reset();
+  fhPtHatWeighted->Reset();
+  fhInclusiveJet->Reset();
+  fhLeadingJet->Reset();
+  fhCalorimeterJet->Reset();
+  fhJetPtClosure->Reset();
+
+  for(int iEventPlane = 0; iEventPlane < fnEventPlanes; iEventPlane++){
+    fhInclusiveJetEventPlane[iEventPlane]->Reset();
+    fhLeadingJetEventPlane[iEventPlane]->Reset();
+    fhCalorimeterJetEventPlane[iEventPlane]->Reset();
+  }
+}
+
+/*
+ * Create shared dense histograms for the selected groups of THnSparses. The THnSparses stay empty while the dense
+ * histograms are filled, and the contents are moved to them with FlushDenseHistograms. Must be called after CreateHistograms.
+ *
+ *  Arguments:
+ *   const std::bitset<knDenseHistogramGroups> useDense = Bit for each group in enumDenseHistogramGroup telling if the group is filled to a dense histogram
+ */
+void JetBackgroundHistograms::CreateDenseHistograms(const std::bitset<knDenseHistogramGroups> useDense){
+  fOwnsDenseHistograms = true;
+  
+  if(useDense.test(kDenseJets)){
+    fhDenseInclusiveJet = new AtomicDenseHistogram(fhInclusiveJet);
+    fhDenseLeadingJet = new AtomicDenseHistogram(fhLeadingJet);
+    fhDenseCalorimeterJet = new AtomicDenseHistogram(fhCalorimeterJet);
+  }
+  
+  if(useDense.test(kDenseJetEventPlane)){
+    for(int iEventPlane = 0; iEventPlane < fnEventPlanes; iEventPlane++){
+      fhDenseInclusiveJetEventPlane[iEventPlane] = new AtomicDenseHistogram(fhInclusiveJetEventPlane[iEventPlane]);
+      fhDenseLeadingJetEventPlane[iEventPlane] = new AtomicDenseHistogram(fhLeadingJetEventPlane[iEventPlane]);
+      fhDenseCalorimeterJetEventPlane[iEventPlane] = new AtomicDenseHistogram(fhCalorimeterJetEventPlane[iEventPlane]);
+    }
+  }
+  
+  if(useDense.test(kDenseJetPtClosure)) fhDenseJetPtClosure = new AtomicDenseHistogram(fhJetPtClosure);
+}
+
+/*
+ * Fill the dense histograms of another histogram set instead of the corresponding THnSparses of this set
+ *
+ *  Arguments:
+ *   const JetBackgroundHistograms* owner = Histogram set that has created the dense histograms
+ */
+void JetBackgroundHistograms::ShareDenseHistograms(const JetBackgroundHistograms* owner){
+  fOwnsDenseHistograms = false;
+  fhDenseInclusiveJet = owner->fhDenseInclusiveJet;
+  fhDenseLeadingJet = owner->fhDenseLeadingJet;
+  fhDenseCalorimeterJet = owner->fhDenseCalorimeterJet;
+  fhDenseJetPtClosure = owner->fhDenseJetPtClosure;
+  fhDenseInclusiveJetEventPlane = owner->fhDenseInclusiveJetEventPlane;
+  fhDenseLeadingJetEventPlane = owner->fhDenseLeadingJetEventPlane;
+  fhDenseCalorimeterJetEventPlane = owner->fhDenseCalorimeterJetEventPlane;
+}
+
+/*
+ * Move the contents of the dense histograms to the corresponding THnSparses. Must not be called while the dense
+ * histograms are filled.
+ */
+void JetBackgroundHistograms::FlushDenseHistograms(){
+  if(fhDenseInclusiveJet) fhDenseInclusiveJet->AddTo(fhInclusiveJet);
+  if(fhDenseLeadingJet) fhDenseLeadingJet->AddTo(fhLeadingJet);
+  if(fhDenseCalorimeterJet) fhDenseCalorimeterJet->AddTo(fhCalorimeterJet);
+  if(fhDenseJetPtClosure) fhDenseJetPtClosure->AddTo(fhJetPtClosure);
+  for(int iEventPlane = 0; iEventPlane < (int)fhDenseInclusiveJetEventPlane.size(); iEventPlane++){
+    if(fhDenseInclusiveJetEventPlane[iEventPlane]) fhDenseInclusiveJetEventPlane[iEventPlane]->AddTo(fhInclusiveJetEventPlane[iEventPlane]);
+    if(fhDenseLeadingJetEventPlane[iEventPlane]) fhDenseLeadingJetEventPlane[iEventPlane]->AddTo(fhLeadingJetEventPlane[iEventPlane]);
+    if(fhDenseCalorimeterJetEventPlane[iEventPlane]) fhDenseCalorimeterJetEventPlane[iEventPlane]->AddTo(fhCalorimeterJetEventPlane[iEventPlane]);
+  }
+}
+
+/*
+ * Memory used by the bins of the dense histograms
+ *
+ *  return: Memory in MB
+ */
+Double_t JetBackgroundHistograms::GetDenseHistogramMemory() const{
+  Long64_t nBins = 0;
+  if(fhDenseInclusiveJet) nBins += fhDenseInclusiveJet->GetNBins() + fhDenseLeadingJet->GetNBins() + fhDenseCalorimeterJet->GetNBins();
+  if(fhDenseJetPtClosure) nBins += fhDenseJetPtClosure->GetNBins();
+  for(int iEventPlane = 0; iEventPlane < (int)fhDenseInclusiveJetEventPlane.size(); iEventPlane++){
+    if(fhDenseInclusiveJetEventPlane[iEventPlane]) nBins += fhDenseInclusiveJetEventPlane[iEventPlane]->GetNBins() + fhDenseLeadingJetEventPlane[iEventPlane]->GetNBins() + fhDenseCalorimeterJetEventPlane[iEventPlane]->GetNBins();
+  }
+  return nBins * 2 * sizeof(Double_t) / (1024.0*1024.0);
+}
+
+// Getter for the number of event plane orders for which the histograms are created
+Int_t JetBackgroundHistograms::GetNEventPlanes() const{
+  return fnEventPlanes;
+}
+
+/*
+ * Fill a THnSparse, or the dense histogram replacing it if there is one
+ *
+ *  Arguments:
+ *   THnSparseF* histogram = Histogram that is filled without a dense histogram
+ *   AtomicDenseHistogram* denseHistogram = Dense histogram that is filled instead. NULL if not used
+ *   const Double_t* values = Value for each dimension of the histogram
+ *   const Double_t weight = Weight of the entry
+ */
+void JetBackgroundHistograms::Fill(THnSparseF* histogram, AtomicDenseHistogram* denseHistogram, const Double_t* values, const Double_t weight){
+  if(denseHistogram){
+    denseHistogram->Fill(values, weight);
+  } else {
+    histogram->Fill(values, weight);
+  }
+}
+
 /*
  * Write the histograms to file
  */
@@ -399,12 +636,17 @@ void JetBackgroundHistograms::Write() const{
   fhCentralityWeighted->Write();
   fhPtHat->Write();
   fhPtHatWeighted->Write();
+  fhFileMemory->Write();
+  fhPeakMemory->Write();
+  fhSkippedFiles->Write();
+  fhTaskTime->Write();
+  fhWorkerTime->Write();
   fhInclusiveJet->Write();
   fhLeadingJet->Write();
   fhCalorimeterJet->Write();
   fhJetPtClosure->Write();
 
-  for(int iEventPlane = 0; iEventPlane < knEventPlanes; iEventPlane++){
+  for(int iEventPlane = 0; iEventPlane < fnEventPlanes; iEventPlane++){
     fhInclusiveJetEventPlane[iEventPlane]->Write();
     fhLeadingJetEventPlane[iEventPlane]->Write();
     fhCalorimeterJetEventPlane[iEventPlane]->Write();
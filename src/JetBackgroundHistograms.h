@@ -3,6 +3,10 @@
 #ifndef JETBACKGROUNDHISTOGRAMS_H
 #define JETBACKGROUNDHISTOGRAMS_H
 
+// C++ includes
+#include <bitset>
+#include <vector>
+
 // Root includes
 #include <TH1.h>
 #include <TH2.h>
@@ -10,6 +14,7 @@
 
 // Own includes
 #include "ConfigurationCard.h"
+#include "AtomicDenseHistogram.h"
 
 class JetBackgroundHistograms{
   
@@ -18,8 +23,8 @@ public:
   // Enumeration for event types to event histogram and track cuts for track cut histogram
   enum enumEventTypes {kAll, kPrimaryVertex, kHfCoincidence, kClusterCompatibility, kVzCut, knEventTypes};
   enum enumInitialPartonType {kQuark, kGluon, kUndetermined, knInitialPartonTypes};
-  enum enumEventPlaneOrder {kSecondOrderEventPlane, kThirdOrderEventPlane, kFourthOrderEventPlane, knEventPlanes};
   enum enumJetMatchingType {kNoMathcingJet, kHasMatchingJet, knMatchingTypes};
+  enum enumDenseHistogramGroup {kDenseJets, kDenseJetEventPlane, kDenseJetPtClosure, knDenseHistogramGroups};
     
   // Constructors and destructor
   JetBackgroundHistograms(); // Default constructor
@@ -33,6 +38,17 @@ public:
   void Write() const;                        // Write the histograms to a file that is opened somewhere else
   void Write(TString outputFileName) const;  // Write the histograms to a file
   void SetCard(ConfigurationCard* newCard);  // Set a new configuration card for the histogram class
+  void SetNumberOfFiles(const Int_t nFiles); // Set the number of analyzed files for the memory usage histogram
+  void Add(const JetBackgroundHistograms* other); // Add the event and jet histograms from another histogram set
+  void Reset();                              // Clear the event and jet histograms
+  void CreateDenseHistograms(const std::bitset<knDenseHistogramGroups> useDense); // Create shared dense histograms for the selected groups of THnSparses
+  void ShareDenseHistograms(const JetBackgroundHistograms* owner); // Fill the dense histograms of another set instead of the THnSparses of this set
+  void FlushDenseHistograms();               // Move the contents of the dense histograms to the THnSparses
+  Double_t GetDenseHistogramMemory() const;  // Memory in MB used by the dense histograms
+  Int_t GetNEventPlanes() const;             // Number of event plane orders for which the histograms are created
+  
+  // Static helper methods
+  static void Fill(THnSparseF* histogram, AtomicDenseHistogram* denseHistogram, const Double_t* values, const Double_t weight); // Fill a THnSparse or the dense histogram replacing it
   
   // Histograms defined public to allow easier access to them. Should not be abused
   TH1F* fhVertexZ;                 // Vertex z-position
@@ -42,17 +58,34 @@ public:
   TH1F* fhCentralityWeighted;      // Weighted centrality distribution (only meaningful for MC)
   TH1F* fhPtHat;                   // pT hat for MC events (only meaningful for MC)
   TH1F* fhPtHatWeighted;           // Weighted pT hat distribution
+  TH1F* fhFileMemory;              // Resident memory in MB at the end of each analyzed file
+  TH1F* fhPeakMemory;              // Peak resident memory in MB during the analysis
+  TH1F* fhSkippedFiles;            // Files that could not be read completely, one labeled bin for each file
+  TH1F* fhTaskTime;                // Wall time in seconds used for each task of the multithreaded analysis
+  TH1F* fhWorkerTime;              // Wall time in seconds each worker thread spent analyzing tasks
   THnSparseF* fhInclusiveJet;   // Inclusive jet information
   THnSparseF* fhLeadingJet;     // Leading jet information
   THnSparseF* fhCalorimeterJet; // Calorimeter jet information
   THnSparseF* fhJetPtClosure;   // Jet pT closure histograms. Also information for response matrix.
-  THnSparseF *fhInclusiveJetEventPlane[knEventPlanes];  // Correlation between jets and event plane angles
-  THnSparseF *fhLeadingJetEventPlane[knEventPlanes];    // Correlation between leading jets and event plane angles
-  THnSparseF *fhCalorimeterJetEventPlane[knEventPlanes];  // Correlation between calorimeter jets and event plane angles
+  std::vector<THnSparseF*> fhInclusiveJetEventPlane;    // Correlation between jets and event plane angles for each event plane order
+  std::vector<THnSparseF*> fhLeadingJetEventPlane;      // Correlation between leading jets and event plane angles for each event plane order
+  std::vector<THnSparseF*> fhCalorimeterJetEventPlane;  // Correlation between calorimeter jets and event plane angles for each event plane order
+  
+  // Dense histograms shared between threads. NULL for the THnSparses that are filled directly.
+  AtomicDenseHistogram* fhDenseInclusiveJet;    // Dense version of fhInclusiveJet
+  AtomicDenseHistogram* fhDenseLeadingJet;      // Dense version of fhLeadingJet
+  AtomicDenseHistogram* fhDenseCalorimeterJet;  // Dense version of fhCalorimeterJet
+  AtomicDenseHistogram* fhDenseJetPtClosure;    // Dense version of fhJetPtClosure
+  std::vector<AtomicDenseHistogram*> fhDenseInclusiveJetEventPlane;   // Dense versions of fhInclusiveJetEventPlane
+  std::vector<AtomicDenseHistogram*> fhDenseLeadingJetEventPlane;     // Dense versions of fhLeadingJetEventPlane
+  std::vector<AtomicDenseHistogram*> fhDenseCalorimeterJetEventPlane; // Dense versions of fhCalorimeterJetEventPlane
 
 private:
   
+  Bool_t fOwnsDenseHistograms; // Flag telling if this set has created the dense histograms and deletes them
   ConfigurationCard* fCard;    // Card for binning info
+  Int_t fnFiles;               // Number of analyzed files
+  Int_t fnEventPlanes;         // Number of event plane orders for which the histograms are created, from EventPlaneOrders in the card
   const TString kEventTypeStrings[knEventTypes] = {"All", "PrimVertex", "HfCoin2Th4", "ClustCompt", "v_{z} cut"}; // Strings corresponding to event types
   
 };
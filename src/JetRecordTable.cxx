@@ -0,0 +1,450 @@
+// Memory mapped columnar table of the jets and events filled to the histograms in the analysis
+
+// C++ includes
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Root includes
+#include <TMath.h>
+
+// Own includes
+#include "JetRecordTable.h"
+
+/*
+ * Default constructor
+ */
+JetRecordTable::JetRecordTable() :
+  fHeader(),
+  fOutputFile(),
+  fChunkSize(0),
+  fChunkPositions(),
+  fJetData(),
+  fFileDescriptor(-1),
+  fMappedFile(NULL),
+  fMappedSize(0),
+  fChunkTable(NULL)
+{
+  // Default constructor
+  memset(&fHeader, 0, sizeof(RecordHeader));
+}
+
+/*
+ * Destructor
+ */
+JetRecordTable::~JetRecordTable(){
+  // destructor
+  if(fOutputFile.is_open()) Close();
+  if(fMappedFile) munmap(fMappedFile, fMappedSize);
+  if(fFileDescriptor >= 0) close(fFileDescriptor);
+}
+
+/*
+ * Start writing a new record file
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the record file
+ *   const Int_t chunkSize = Number of jet or event records after which the buffered records are written as a chunk
+ *   const Int_t nEventPlanes = Number of event plane orders for which the deltaPhi is recorded
+ *
+ *  return: True if the file was created, false otherwise
+ */
+Bool_t JetRecordTable::Create(const TString fileName, const Int_t chunkSize, const Int_t nEventPlanes){
+
+  fOutputFile.open(fileName.Data(), ios::out | ios::binary | ios::trunc);
+  if(!fOutputFile.is_open()) return false;
+
+  // Fill the header. The numbers of records, the event counts and the chunk table are updated when the file is closed
+  memset(&fHeader, 0, sizeof(RecordHeader));
+  memcpy(fHeader.fMagic, "JBGJETRC", 8);
+  fHeader.fVersion = fVersion;
+  fHeader.fnEventPlanes = nEventPlanes > 0 ? nEventPlanes : 0;
+  fOutputFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(RecordHeader));
+  WritePadding();
+
+  fChunkSize = chunkSize > 0 ? chunkSize : 1;
+  fChunkPositions.clear();
+  for(Int_t iColumn = 0; iColumn < knEventColumns; iColumn++){
+    fEventData[iColumn].clear();
+  }
+  fJetData.assign(GetNJetColumns(), std::vector<Float_t>());
+
+  return true;
+}
+
+/*
+ * Add an event passing the event selection. The events are written in the same chunks as the jets, and a chunk is
+ * also written when enough events are buffered.
+ *
+ *  Arguments:
+ *   const Double_t vz = Vertex z-position
+ *   const Double_t centrality = Event centrality
+ *   const Double_t ptHat = pT hat of the event
+ *   const Double_t ptHatWeight = pT hat weight of the event
+ *   const Double_t totalWeight = Product of the pT hat, vz and centrality weights
+ */
+void JetRecordTable::AddEvent(const Double_t vz, const Double_t centrality, const Double_t ptHat, const Double_t ptHatWeight, const Double_t totalWeight){
+  fEventData[kEventVz].push_back(vz);
+  fEventData[kEventCentrality].push_back(centrality);
+  fEventData[kEventPtHat].push_back(ptHat);
+  fEventData[kEventPtHatWeight].push_back(ptHatWeight);
+  fEventData[kEventTotalWeight].push_back(totalWeight);
+  fHeader.fnEvents++;
+  if((Int_t)fEventData[kEventVz].size() == fChunkSize) WriteChunk();
+}
+
+/*
+ * Add a jet record. When enough jets are buffered, they are written to the file together with the buffered events.
+ *
+ *  Arguments:
+ *   const Int_t recordType = Type of the record, see enumRecordType
+ *   const Double_t pt = Corrected jet pT. Generator level jet pT for closure records
+ *   const Double_t phi = Jet phi
+ *   const Double_t eta = Jet eta
+ *   const Double_t centrality = Event centrality
+ *   const Int_t flavor = Jet flavor index, see JetBackgroundHistograms::enumInitialPartonType
+ *   const Int_t matchFlags = Bitwise combination of enumMatchFlag
+ *   const Double_t weight = Total event weight
+ *   const Double_t matchedPt = Corrected pT of the matched reconstructed jet for closure records
+ *   const Double_t* eventPlaneDeltaPhi = DeltaPhi between the jet and each event plane order. NULL for closure records
+ */
+void JetRecordTable::AddJet(const Int_t recordType, const Double_t pt, const Double_t phi, const Double_t eta, const Double_t centrality, const Int_t flavor, const Int_t matchFlags, const Double_t weight, const Double_t matchedPt, const Double_t* eventPlaneDeltaPhi){
+
+  // Integer columns are kept in the same 4 byte buffers as the floating point columns
+  Float_t integerValue;
+  memcpy(&integerValue, &recordType, sizeof(Float_t));
+  fJetData[kJetRecordType].push_back(integerValue);
+  memcpy(&integerValue, &flavor, sizeof(Float_t));
+  fJetData[kJetFlavor].push_back(integerValue);
+  memcpy(&integerValue, &matchFlags, sizeof(Float_t));
+  fJetData[kJetMatchFlags].push_back(integerValue);
+
+  fJetData[kJetPt].push_back(pt);
+  fJetData[kJetPhi].push_back(phi);
+  fJetData[kJetEta].push_back(eta);
+  fJetData[kJetCentrality].push_back(centrality);
+  fJetData[kJetWeight].push_back(weight);
+  fJetData[kJetMatchedPt].push_back(matchedPt);
+  for(Int_t iOrder = 0; iOrder < fHeader.fnEventPlanes; iOrder++){
+    fJetData[kJetDeltaPhi+iOrder].push_back(eventPlaneDeltaPhi ? eventPlaneDeltaPhi[iOrder] : 0);
+  }
+
+  fHeader.fnJets++;
+  if((Int_t)fJetData[kJetPt].size() == fChunkSize) WriteChunk();
+}
+
+/*
+ * Copy the contents of the event counter histogram to the table. The event counter is filled before the event
+ * selection, so it cannot be reconstructed from the event records.
+ *
+ *  Arguments:
+ *   TH1* eventHistogram = Event counter histogram, binned as enumEventTypes
+ */
+void JetRecordTable::SetEventCounts(TH1* eventHistogram){
+  for(Int_t iEventType = 0; iEventType < JetBackgroundHistograms::knEventTypes; iEventType++){
+    fHeader.fEventCounts[iEventType] = eventHistogram->GetBinContent(eventHistogram->FindBin(iEventType));
+  }
+}
+
+/*
+ * Add all the records of an opened record table after the records written so far, and add its event counts to the
+ * event counts of this table. The chunks of the input table are copied as they are. This is used to join the record
+ * files written by several processes to one file. Both tables must have the same event plane orders.
+ *
+ *  Arguments:
+ *   const JetRecordTable& inputTable = Record table opened for reading
+ */
+void JetRecordTable::AppendTable(const JetRecordTable& inputTable){
+
+  if(!fOutputFile.is_open() || !inputTable.fMappedFile){
+    cout << "Error! Jet records can only be appended from an opened record table to a table being written!" << endl;
+    assert(0);
+  }
+
+  if(inputTable.fHeader.fnEventPlanes != fHeader.fnEventPlanes){
+    cout << "Error! Jet records with " << inputTable.fHeader.fnEventPlanes << " event plane orders cannot be appended to records with " << fHeader.fnEventPlanes << " orders!" << endl;
+    assert(0);
+  }
+
+  // Keep the records in order by writing the buffered records first
+  WriteChunk();
+
+  for(Int_t iChunk = 0; iChunk < inputTable.fHeader.fnChunks; iChunk++){
+    const ChunkHeader* chunk = reinterpret_cast<const ChunkHeader*>(inputTable.fMappedFile + inputTable.fChunkTable[iChunk]);
+    const Long64_t* jetColumnPositions = inputTable.GetJetColumnPositions(inputTable.fChunkTable[iChunk]);
+    for(Int_t iColumn = 0; iColumn < knEventColumns; iColumn++){
+      const Float_t* values = inputTable.GetFloatColumn(chunk->fEventColumnPosition[iColumn]);
+      fEventData[iColumn].assign(values, values + chunk->fnEvents);
+    }
+    for(Int_t iColumn = 0; iColumn < GetNJetColumns(); iColumn++){
+      const Float_t* values = inputTable.GetFloatColumn(jetColumnPositions[iColumn]);
+      fJetData[iColumn].assign(values, values + chunk->fnJets);
+    }
+    WriteChunk();
+  }
+
+  fHeader.fnEvents += inputTable.fHeader.fnEvents;
+  fHeader.fnJets += inputTable.fHeader.fnJets;
+  for(Int_t iEventType = 0; iEventType < JetBackgroundHistograms::knEventTypes; iEventType++){
+    fHeader.fEventCounts[iEventType] += inputTable.fHeader.fEventCounts[iEventType];
+  }
+}
+
+/*
+ * Write the buffered records as a chunk
+ */
+void JetRecordTable::WriteChunk(){
+
+  ChunkHeader chunkHeader;
+  memset(&chunkHeader, 0, sizeof(ChunkHeader));
+  chunkHeader.fnEvents = fEventData[kEventVz].size();
+  chunkHeader.fnJets = fJetData[kJetPt].size();
+  std::vector<Long64_t> jetColumnPositions(GetNJetColumns(), 0);
+
+  if(chunkHeader.fnEvents == 0 && chunkHeader.fnJets == 0) return;
+
+  // The chunk header is written first with placeholder positions and rewritten after the blocks
+  const Long64_t chunkPosition = fOutputFile.tellp();
+  fOutputFile.write(reinterpret_cast<const char*>(&chunkHeader), sizeof(ChunkHeader));
+  fOutputFile.write(reinterpret_cast<const char*>(jetColumnPositions.data()), sizeof(Long64_t)*jetColumnPositions.size());
+
+  for(Int_t iColumn = 0; iColumn < knEventColumns; iColumn++){
+    chunkHeader.fEventColumnPosition[iColumn] = fOutputFile.tellp();
+    fOutputFile.write(reinterpret_cast<const char*>(fEventData[iColumn].data()), sizeof(Float_t)*fEventData[iColumn].size());
+    WritePadding();
+    fEventData[iColumn].clear();
+  }
+
+  for(Int_t iColumn = 0; iColumn < GetNJetColumns(); iColumn++){
+    jetColumnPositions[iColumn] = fOutputFile.tellp();
+    fOutputFile.write(reinterpret_cast<const char*>(fJetData[iColumn].data()), sizeof(Float_t)*fJetData[iColumn].size());
+    WritePadding();
+    fJetData[iColumn].clear();
+  }
+
+  // Update the chunk header with the final positions
+  const Long64_t endPosition = fOutputFile.tellp();
+  fOutputFile.seekp(chunkPosition);
+  fOutputFile.write(reinterpret_cast<const char*>(&chunkHeader), sizeof(ChunkHeader));
+  fOutputFile.write(reinterpret_cast<const char*>(jetColumnPositions.data()), sizeof(Long64_t)*jetColumnPositions.size());
+  fOutputFile.seekp(endPosition);
+  fChunkPositions.push_back(chunkPosition);
+}
+
+/*
+ * Pad the output file to a multiple of 8 bytes, such that all the blocks are aligned in the memory map
+ */
+void JetRecordTable::WritePadding(){
+  const char padding[8] = {0};
+  const Long64_t position = fOutputFile.tellp();
+  if(position % 8 != 0) fOutputFile.write(padding, 8 - position % 8);
+}
+
+/*
+ * Write the remaining records and the chunk table, and close the file
+ */
+void JetRecordTable::Close(){
+
+  if(!fOutputFile.is_open()) return;
+
+  WriteChunk();
+
+  // Table of chunk positions at the end of the file
+  fHeader.fnChunks = fChunkPositions.size();
+  fHeader.fChunkTablePosition = fOutputFile.tellp();
+  fOutputFile.write(reinterpret_cast<const char*>(fChunkPositions.data()), sizeof(Long64_t)*fChunkPositions.size());
+
+  // The header is written last, so a file from an interrupted analysis does not have a valid chunk table
+  fOutputFile.seekp(0);
+  fOutputFile.write(reinterpret_cast<const char*>(&fHeader), sizeof(RecordHeader));
+  fOutputFile.close();
+}
+
+/*
+ * Map a record file to memory
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the record file
+ *
+ *  return: True if the file is a valid record file, false otherwise
+ */
+Bool_t JetRecordTable::Open(const TString fileName){
+
+  fFileDescriptor = open(fileName.Data(), O_RDONLY);
+  if(fFileDescriptor < 0) return false;
+
+  struct stat fileStatus;
+  if(fstat(fFileDescriptor, &fileStatus) != 0 || fileStatus.st_size < (Long64_t)sizeof(RecordHeader)) return false;
+  fMappedSize = fileStatus.st_size;
+
+  void* mappedFile = mmap(NULL, fMappedSize, PROT_READ, MAP_SHARED, fFileDescriptor, 0);
+  if(mappedFile == MAP_FAILED) return false;
+  fMappedFile = static_cast<char*>(mappedFile);
+
+  // All the records are read once from the beginning to the end
+  madvise(fMappedFile, fMappedSize, MADV_SEQUENTIAL);
+
+  // Check that the file is a complete record file
+  memcpy(&fHeader, fMappedFile, sizeof(RecordHeader));
+  if(memcmp(fHeader.fMagic, "JBGJETRC", 8) != 0) return false;
+  if(fHeader.fVersion != fVersion) return false;
+  if(fHeader.fnEventPlanes < 0) return false;
+  if(fHeader.fChunkTablePosition <= 0 || fHeader.fChunkTablePosition + fHeader.fnChunks*(Long64_t)sizeof(Long64_t) > fMappedSize) return false;
+
+  fChunkTable = reinterpret_cast<const Long64_t*>(fMappedFile + fHeader.fChunkTablePosition);
+  return true;
+}
+
+// Getter for the number of event records
+Long64_t JetRecordTable::GetNEvents() const{
+  return fHeader.fnEvents;
+}
+
+// Getter for the number of jet records
+Long64_t JetRecordTable::GetNJets() const{
+  return fHeader.fnJets;
+}
+
+// Getter for the number of event plane orders in the records
+Int_t JetRecordTable::GetNEventPlanes() const{
+  return fHeader.fnEventPlanes;
+}
+
+// Number of jet columns including the deltaPhi columns
+Int_t JetRecordTable::GetNJetColumns() const{
+  return kJetDeltaPhi + fHeader.fnEventPlanes;
+}
+
+// Positions of the jet column blocks of a chunk, written right after the chunk header
+const Long64_t* JetRecordTable::GetJetColumnPositions(const Long64_t chunkPosition) const{
+  return reinterpret_cast<const Long64_t*>(fMappedFile + chunkPosition + sizeof(ChunkHeader));
+}
+
+// Pointer to a Float_t column block in the mapped file
+const Float_t* JetRecordTable::GetFloatColumn(const Long64_t position) const{
+  return reinterpret_cast<const Float_t*>(fMappedFile + position);
+}
+
+// Pointer to an Int_t column block in the mapped file
+const Int_t* JetRecordTable::GetIntColumn(const Long64_t position) const{
+  return reinterpret_cast<const Int_t*>(fMappedFile + position);
+}
+
+/*
+ * Fill the histograms from the records. The histograms are filled in the same way as in JetBackgroundAnalyzer::AnalyzeEvent,
+ * but the binning is taken from the card given to the histograms. The event plane histograms are filled for the orders
+ * that are both in the records and in the card.
+ *
+ *  Arguments:
+ *   JetBackgroundHistograms* histograms = Histograms that are filled. CreateHistograms must be called before this
+ */
+void JetRecordTable::FillHistograms(JetBackgroundHistograms* histograms) const{
+
+  if(!fMappedFile){
+    cout << "Error! Trying to fill histograms from a jet record table that has not been opened!" << endl;
+    assert(0);
+  }
+
+  // Fillers for THnSparses
+  const Int_t nFillJet = 6;         // Inclusive and leading jets
+  const Int_t nFillEventPlane = 3;  // Correlation between inclusive and leading jets with event plane
+  const Int_t nAxesClosure = 7;     // Jet pT closure
+  Double_t fillerJet[nFillJet];
+  Double_t fillerEventPlane[nFillEventPlane];
+  Double_t fillerClosure[nAxesClosure];
+
+  // Event plane orders that can be filled from the records
+  const Int_t nEventPlanes = TMath::Min(fHeader.fnEventPlanes, histograms->GetNEventPlanes());
+  if(histograms->GetNEventPlanes() > fHeader.fnEventPlanes){
+    cout << "Warning! The jet records have the event plane for " << fHeader.fnEventPlanes << " orders. The histograms of the higher orders are left empty." << endl;
+  }
+
+  // The event counter is stored as bin contents, since it is filled before any of the records
+  for(Int_t iEventType = 0; iEventType < JetBackgroundHistograms::knEventTypes; iEventType++){
+    const Int_t bin = histograms->fhEvents->FindBin(iEventType);
+    histograms->fhEvents->SetBinContent(bin, fHeader.fEventCounts[iEventType]);
+    histograms->fhEvents->SetBinError(bin, TMath::Sqrt(fHeader.fEventCounts[iEventType]));
+  }
+
+  std::vector<const Float_t*> deltaPhi(nEventPlanes);
+  for(Int_t iChunk = 0; iChunk < fHeader.fnChunks; iChunk++){
+    const ChunkHeader* chunk = reinterpret_cast<const ChunkHeader*>(fMappedFile + fChunkTable[iChunk]);
+    const Long64_t* jetColumnPositions = GetJetColumnPositions(fChunkTable[iChunk]);
+
+    // Event information histograms
+    const Float_t* vz = GetFloatColumn(chunk->fEventColumnPosition[kEventVz]);
+    const Float_t* eventCentrality = GetFloatColumn(chunk->fEventColumnPosition[kEventCentrality]);
+    const Float_t* ptHat = GetFloatColumn(chunk->fEventColumnPosition[kEventPtHat]);
+    const Float_t* ptHatWeight = GetFloatColumn(chunk->fEventColumnPosition[kEventPtHatWeight]);
+    const Float_t* totalWeight = GetFloatColumn(chunk->fEventColumnPosition[kEventTotalWeight]);
+
+    for(Int_t iEvent = 0; iEvent < chunk->fnEvents; iEvent++){
+      histograms->fhVertexZ->Fill(vz[iEvent], ptHatWeight[iEvent]);
+      histograms->fhVertexZWeighted->Fill(vz[iEvent], totalWeight[iEvent]);
+      histograms->fhCentrality->Fill(eventCentrality[iEvent], ptHatWeight[iEvent]);
+      histograms->fhCentralityWeighted->Fill(eventCentrality[iEvent], totalWeight[iEvent]);
+      histograms->fhPtHat->Fill(ptHat[iEvent]);
+      histograms->fhPtHatWeighted->Fill(ptHat[iEvent], totalWeight[iEvent]);
+    }
+
+    // Jet histograms
+    const Int_t* recordType = GetIntColumn(jetColumnPositions[kJetRecordType]);
+    const Float_t* jetPt = GetFloatColumn(jetColumnPositions[kJetPt]);
+    const Float_t* jetPhi = GetFloatColumn(jetColumnPositions[kJetPhi]);
+    const Float_t* jetEta = GetFloatColumn(jetColumnPositions[kJetEta]);
+    const Float_t* centrality = GetFloatColumn(jetColumnPositions[kJetCentrality]);
+    const Int_t* jetFlavor = GetIntColumn(jetColumnPositions[kJetFlavor]);
+    const Int_t* matchFlags = GetIntColumn(jetColumnPositions[kJetMatchFlags]);
+    const Float_t* weight = GetFloatColumn(jetColumnPositions[kJetWeight]);
+    const Float_t* matchedPt = GetFloatColumn(jetColumnPositions[kJetMatchedPt]);
+    for(Int_t iOrder = 0; iOrder < nEventPlanes; iOrder++){
+      deltaPhi[iOrder] = GetFloatColumn(jetColumnPositions[kJetDeltaPhi+iOrder]);
+    }
+
+    for(Int_t iJet = 0; iJet < chunk->fnJets; iJet++){
+
+      // Closure records have their own histogram
+      if(recordType[iJet] == kClosureRecord){
+        fillerClosure[0] = jetPt[iJet];                   // Axis 0: pT of the matched generator level jet
+        fillerClosure[1] = matchedPt[iJet];               // Axis 1: pT of the matched reconstructed jet
+        fillerClosure[2] = jetEta[iJet];                  // Axis 2: eta of the jet under consideration
+        fillerClosure[3] = centrality[iJet];              // Axis 3: Centrality of the event
+        fillerClosure[4] = jetFlavor[iJet];               // Axis 4: Jet flavor type (quark/gluon)
+        fillerClosure[5] = matchedPt[iJet]/jetPt[iJet];   // Axis 5: Reconstructed level jet to generator level jet pT ratio
+        fillerClosure[6] = jetPhi[iJet];                  // Axis 6: phi of the jet under consideration
+        histograms->fhJetPtClosure->Fill(fillerClosure, weight[iJet]);
+        continue;
+      }
+
+      THnSparseF* jetHistogram = histograms->fhInclusiveJet;
+      THnSparseF** eventPlaneHistogram = histograms->fhInclusiveJetEventPlane.data();
+      if(recordType[iJet] == kLeadingJetRecord){
+        jetHistogram = histograms->fhLeadingJet;
+        eventPlaneHistogram = histograms->fhLeadingJetEventPlane.data();
+      } else if(recordType[iJet] == kCalorimeterJetRecord){
+        jetHistogram = histograms->fhCalorimeterJet;
+        eventPlaneHistogram = histograms->fhCalorimeterJetEventPlane.data();
+      }
+
+      fillerJet[0] = jetPt[iJet];                                  // Axis 0 = jet pT
+      fillerJet[1] = jetPhi[iJet];                                 // Axis 1 = jet phi
+      fillerJet[2] = jetEta[iJet];                                 // Axis 2 = jet eta
+      fillerJet[3] = centrality[iJet];                             // Axis 3 = centrality
+      fillerJet[4] = jetFlavor[iJet];                              // Axis 4 = flavor of the jet
+      fillerJet[5] = (matchFlags[iJet] & kMatchingJetExists) ? 1 : 0; // Axis 5 = flag is matching jet exists
+      jetHistogram->Fill(fillerJet, weight[iJet]);
+
+      // For inclusive jets the event plane correlation is only filled for jets that have a matching jet
+      if(recordType[iJet] == kInclusiveJetRecord && !(matchFlags[iJet] & kHasMatchedJet)) continue;
+
+      for(Int_t iOrder = 0; iOrder < nEventPlanes; iOrder++){
+        fillerEventPlane[0] = deltaPhi[iOrder][iJet];  // Axis 0: DeltaPhi between jet and event plane
+        fillerEventPlane[1] = jetPt[iJet];             // Axis 1: Jet pT
+        fillerEventPlane[2] = centrality[iJet];        // Axis 2: centrality
+        eventPlaneHistogram[iOrder]->Fill(fillerEventPlane, weight[iJet]);
+      }
+    }
+  }
+}
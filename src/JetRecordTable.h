@@ -0,0 +1,119 @@
+// Memory mapped columnar table of the jets and events filled to the histograms in the analysis
+
+#ifndef JETRECORDTABLE_H
+#define JETRECORDTABLE_H
+
+// C++ includes
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TH1.h>
+
+// Own includes
+#include "JetBackgroundHistograms.h"
+
+using namespace std;
+
+/*
+ * Compact record of every event and jet that is filled to the histograms in the analysis.
+ *
+ * The records hold the values after all the corrections, smearing and cuts, right before they are filled to the
+ * histograms. From these, all the histograms in JetBackgroundHistograms can be filled again with a different
+ * binning from the card, without going through the forests again. Changing any of the cuts still requires
+ * running the analysis again.
+ *
+ * The records are stored in chunks. Inside a chunk each column is a contiguous block of 4 byte values.
+ * The file is read through a memory map, such that the columns can be used directly. The jets have one deltaPhi
+ * column for each event plane order, and the number of orders is stored in the header of the file.
+ */
+class JetRecordTable{
+
+public:
+
+  // Types of jet records
+  enum enumRecordType{kInclusiveJetRecord, kLeadingJetRecord, kCalorimeterJetRecord, kClosureRecord, knRecordTypes};
+
+  // Columns for the events passing the event selection
+  enum enumEventColumn{kEventVz, kEventCentrality, kEventPtHat, kEventPtHatWeight, kEventTotalWeight, knEventColumns};
+
+  // Columns for the jets. For closure records, the pT is the generator level pT and the matched pT is the reconstructed pT.
+  // The deltaPhi columns start from kJetDeltaPhi, one for each event plane order starting from the second.
+  enum enumJetColumn{kJetRecordType, kJetPt, kJetPhi, kJetEta, kJetCentrality, kJetFlavor, kJetMatchFlags, kJetWeight, kJetMatchedPt, kJetDeltaPhi};
+
+  // Bits for the match flag column
+  enum enumMatchFlag{kMatchingJetExists = 1, kHasMatchedJet = 2};
+
+  // Constructors and destructor
+  JetRecordTable();                                           // Default constructor
+  JetRecordTable(const JetRecordTable& in) = delete;          // The table owns an open file or memory map and cannot be copied
+  ~JetRecordTable();                                          // Destructor
+  JetRecordTable& operator=(const JetRecordTable& obj) = delete; // The table owns an open file or memory map and cannot be copied
+
+  // Methods for writing the table
+  Bool_t Create(const TString fileName, const Int_t chunkSize, const Int_t nEventPlanes);  // Start writing a new record file
+  void AddEvent(const Double_t vz, const Double_t centrality, const Double_t ptHat, const Double_t ptHatWeight, const Double_t totalWeight); // Add an event passing the event selection
+  void AddJet(const Int_t recordType, const Double_t pt, const Double_t phi, const Double_t eta, const Double_t centrality, const Int_t flavor, const Int_t matchFlags, const Double_t weight, const Double_t matchedPt, const Double_t* eventPlaneDeltaPhi); // Add a jet record
+  void SetEventCounts(TH1* eventHistogram);                    // Copy the event counter histogram to the table
+  void AppendTable(const JetRecordTable& inputTable);          // Add all the records and event counts of an opened record table
+  void Close();                                                // Write the remaining records and the chunk table, and close the file
+
+  // Methods for reading the table
+  Bool_t Open(const TString fileName);                         // Map a record file to memory
+  Long64_t GetNEvents() const;                                 // Getter for the number of event records
+  Long64_t GetNJets() const;                                   // Getter for the number of jet records
+  Int_t GetNEventPlanes() const;                               // Getter for the number of event plane orders in the records
+  void FillHistograms(JetBackgroundHistograms* histograms) const; // Fill the histograms from the records
+
+private:
+
+  static const Int_t fVersion = 2;  // Version of the file layout
+
+  // Header in the beginning of the file
+  struct RecordHeader{
+    char fMagic[8];                                      // Identifier for the file type
+    Int_t fVersion;                                      // Version of the file layout
+    Int_t fnChunks;                                      // Number of chunks in the file
+    Int_t fnEventPlanes;                                 // Number of event plane orders with a deltaPhi column
+    Long64_t fnEvents;                                   // Number of event records
+    Long64_t fnJets;                                     // Number of jet records
+    Long64_t fChunkTablePosition;                        // Position of the table of chunk positions in the file
+    Double_t fEventCounts[JetBackgroundHistograms::knEventTypes]; // Contents of the event counter histogram
+  };
+
+  // Header in the beginning of each chunk. It is followed by the positions of the jet column blocks in the file.
+  struct ChunkHeader{
+    Int_t fnEvents;                                 // Number of event records in the chunk
+    Int_t fnJets;                                   // Number of jet records in the chunk
+    Long64_t fEventColumnPosition[knEventColumns];  // Positions of the event column blocks in the file
+  };
+
+  // Methods
+  void WriteChunk();    // Write the buffered records as a chunk
+  void WritePadding();  // Pad the output file to a multiple of 8 bytes
+  const Float_t* GetFloatColumn(const Long64_t position) const; // Pointer to a Float_t column block in the mapped file
+  const Int_t* GetIntColumn(const Long64_t position) const;     // Pointer to an Int_t column block in the mapped file
+  const Long64_t* GetJetColumnPositions(const Long64_t chunkPosition) const; // Positions of the jet column blocks of a chunk in the mapped file
+  Int_t GetNJetColumns() const;                                 // Number of jet columns including the deltaPhi columns
+
+  // Writing
+  RecordHeader fHeader;                         // Header of the record file
+  ofstream fOutputFile;                         // Output file when writing
+  Int_t fChunkSize;                             // Number of jet or event records after which a chunk is written
+  std::vector<Long64_t> fChunkPositions;        // Positions of the chunks written so far
+  std::vector<Float_t> fEventData[knEventColumns]; // Buffered event records
+  std::vector<std::vector<Float_t>> fJetData;      // Buffered jet records. Integer columns are stored with their bit pattern
+
+  // Reading
+  Int_t fFileDescriptor;          // Descriptor of the mapped file. -1 if no file is mapped
+  char* fMappedFile;              // Memory mapped record file
+  Long64_t fMappedSize;           // Size of the memory map in bytes
+  const Long64_t* fChunkTable;    // Positions of the chunks in the mapped file
+
+};
+
+#endif
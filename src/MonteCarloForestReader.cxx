@@ -3,12 +3,39 @@
 // Own includes
 #include "MonteCarloForestReader.h"
 
+// Names of the jet trees for each jet collection. 0 = Calo PU jets, 1 = PF CS jets, 2 = Flow subtracted PF CS jets
+const char* MonteCarloForestReader::fJetTreeNames[3] = {"akPu4CaloJetAnalyzer/t", "akCs4PFJetAnalyzer/t", "akFlowPuCs4PFJetAnalyzer/t"};
+
+// Names of the branches of the cache columns in the chains made by CreateForestChains. The trees other than the jet tree are friends with an alias.
+const char* MonteCarloForestReader::fDataFrameColumns[ForestColumnCache::knCacheColumns] = {
+  "heavyIon.vz", "heavyIon.hiBin", "heavyIon.pthat", "heavyIon.weight", "skim.pprimaryVertexFilter", "skim.pphfCoincFilter2Th4", "skim.pclusterCompatibilityFilter",
+  "jtpt", "jtphi", "WTAphi", "jteta", "WTAeta", "rawpt", "trackMax", "refpt", "refeta", "refphi", "matchedPartonFlavor",
+  "genpt", "genphi", "WTAgenphi", "geneta", "WTAgeneta",
+  "calopt", "calophi", "caloeta",
+  "particles.pt", "particles.phi", "particles.eta", "particles.sube"};
+
+// Branch group to which each cache column belongs. The event information is always read.
+const Int_t MonteCarloForestReader::fColumnBranchGroups[ForestColumnCache::knCacheColumns] = {
+  -1, -1, -1, -1, -1, -1, -1,
+  kForestJetPt, kJetEScheme, kJetWTA, kJetEScheme, kJetWTA, kJetRawPt, kJetTrackMax, kReferenceJets, kReferenceJets, kReferenceJets, kReferenceJets,
+  kGeneratorJets, kGeneratorJets, kGeneratorJetWTA, kGeneratorJets, kGeneratorJetWTA,
+  kCalorimeterJets, kCalorimeterJets, kCalorimeterJets,
+  kGeneratorParticles, kGeneratorParticles, kGeneratorParticles, kGeneratorParticles};
+
 /*
  * Default constructor
  */
 MonteCarloForestReader::MonteCarloForestReader() :
   fJetType(0),
   fJetAxis(0),
+  fReadCacheSize(0),
+  fAlignedReading(false),
+  fBranchGroups(),
+  fPrunedBranches(),
+  fPrunedZipBytes(0),
+  fColumnCache(0),
+  fInputFile(0),
+  fEntryLists(),
   fHeavyIonTree(0),
   fSkimTree(0),
   fJetTree(0),
@@ -65,6 +92,11 @@ MonteCarloForestReader::MonteCarloForestReader() :
   fGenParticleEtaBranch(0),
   fGenParticleChargeBranch(0),
   fGenParticleSubeventBranch(0),
+  fHeavyIonBranches(),
+  fSkimBranches(),
+  fJetPtBranches(),
+  fJetBranches(),
+  fGenParticleBranches(),
   fVertexZ(-100),
   fHiBin(-1),
   fPtHat(0),
@@ -114,14 +146,17 @@ MonteCarloForestReader::MonteCarloForestReader() :
   fGenParticlePhiArray(0),
   fGenParticleEtaArray(0),
   fGenParticleChargeArray(0),
-  fGenParticleSubeventArray(0)
+  fGenParticleSubeventArray(0),
+  fGenParticlePtStorage(),
+  fGenParticlePhiStorage(),
+  fGenParticleEtaStorage(),
+  fGenParticleChargeStorage(),
+  fGenParticleSubeventStorage()
 {
   // Default constructor
   
-  // Initialize fJetMaxTrackPtArray to -1
-  for(Int_t i = 0; i < fnMaxJet; i++){
-    fJetMaxTrackPtArray[i] = -1;
-  }
+  // By default, read all the branch groups from the forest
+  fBranchGroups.set();
   
 }
 
@@ -135,6 +170,14 @@ MonteCarloForestReader::MonteCarloForestReader() :
 MonteCarloForestReader::MonteCarloForestReader(Int_t jetType, Int_t jetAxis) :
   fJetType(jetType),
   fJetAxis(jetAxis),
+  fReadCacheSize(0),
+  fAlignedReading(false),
+  fBranchGroups(),
+  fPrunedBranches(),
+  fPrunedZipBytes(0),
+  fColumnCache(0),
+  fInputFile(0),
+  fEntryLists(),
   fHeavyIonTree(0),
   fSkimTree(0),
   fJetTree(0),
@@ -191,6 +234,11 @@ MonteCarloForestReader::MonteCarloForestReader(Int_t jetType, Int_t jetAxis) :
   fGenParticleEtaBranch(0),
   fGenParticleChargeBranch(0),
   fGenParticleSubeventBranch(0),
+  fHeavyIonBranches(),
+  fSkimBranches(),
+  fJetPtBranches(),
+  fJetBranches(),
+  fGenParticleBranches(),
   fVertexZ(-100),
   fHiBin(-1),
   fPtHat(0),
@@ -240,14 +288,17 @@ MonteCarloForestReader::MonteCarloForestReader(Int_t jetType, Int_t jetAxis) :
   fGenParticlePhiArray(0),
   fGenParticleEtaArray(0),
   fGenParticleChargeArray(0),
-  fGenParticleSubeventArray(0)
+  fGenParticleSubeventArray(0),
+  fGenParticlePtStorage(),
+  fGenParticlePhiStorage(),
+  fGenParticleEtaStorage(),
+  fGenParticleChargeStorage(),
+  fGenParticleSubeventStorage()
 {
   // Custom constructor
   
-  // Initialize fJetMaxTrackPtArray to -1
-  for(int i = 0; i < fnMaxJet; i++){
-    fJetMaxTrackPtArray[i] = -1;
-  }
+  // By default, read all the branch groups from the forest
+  fBranchGroups.set();
   
 }
 
@@ -257,6 +308,14 @@ MonteCarloForestReader::MonteCarloForestReader(Int_t jetType, Int_t jetAxis) :
 MonteCarloForestReader::MonteCarloForestReader(const MonteCarloForestReader& in) :
   fJetType(in.fJetType),
   fJetAxis(in.fJetAxis),
+  fReadCacheSize(in.fReadCacheSize),
+  fAlignedReading(in.fAlignedReading),
+  fBranchGroups(in.fBranchGroups),
+  fPrunedBranches(in.fPrunedBranches),
+  fPrunedZipBytes(in.fPrunedZipBytes),
+  fColumnCache(in.fColumnCache),
+  fInputFile(0),
+  fEntryLists(),
   fHeavyIonTree(in.fHeavyIonTree),
   fSkimTree(in.fSkimTree),
   fJetTree(in.fJetTree),
@@ -313,6 +372,11 @@ MonteCarloForestReader::MonteCarloForestReader(const MonteCarloForestReader& in)
   fGenParticleEtaBranch(in.fGenParticleEtaBranch),
   fGenParticleChargeBranch(in.fGenParticleChargeBranch),
   fGenParticleSubeventBranch(in.fGenParticleSubeventBranch),
+  fHeavyIonBranches(in.fHeavyIonBranches),
+  fSkimBranches(in.fSkimBranches),
+  fJetPtBranches(in.fJetPtBranches),
+  fJetBranches(in.fJetBranches),
+  fGenParticleBranches(in.fGenParticleBranches),
   fVertexZ(in.fVertexZ),
   fHiBin(in.fHiBin),
   fPtHat(in.fPtHat),
@@ -339,35 +403,39 @@ MonteCarloForestReader::MonteCarloForestReader(const MonteCarloForestReader& in)
   fTrackEnergyHcalVector(in.fTrackEnergyHcalVector),
   fTrackChargeVector(in.fTrackChargeVector),
   fnGenParticles(in.fnGenParticles),
-  fGenParticlePtArray(in.fGenParticlePtArray),
-  fGenParticlePhiArray(in.fGenParticlePhiArray),
-  fGenParticleEtaArray(in.fGenParticleEtaArray),
-  fGenParticleChargeArray(in.fGenParticleChargeArray),
-  fGenParticleSubeventArray(in.fGenParticleSubeventArray)
+  fGenParticlePtArray(in.fGenParticlePtArray ? &fGenParticlePtStorage : 0),
+  fGenParticlePhiArray(in.fGenParticlePhiArray ? &fGenParticlePhiStorage : 0),
+  fGenParticleEtaArray(in.fGenParticleEtaArray ? &fGenParticleEtaStorage : 0),
+  fGenParticleChargeArray(in.fGenParticleChargeArray ? &fGenParticleChargeStorage : 0),
+  fGenParticleSubeventArray(in.fGenParticleSubeventArray ? &fGenParticleSubeventStorage : 0),
+  fGenParticlePtStorage(in.fGenParticlePtStorage),
+  fGenParticlePhiStorage(in.fGenParticlePhiStorage),
+  fGenParticleEtaStorage(in.fGenParticleEtaStorage),
+  fGenParticleChargeStorage(in.fGenParticleChargeStorage),
+  fGenParticleSubeventStorage(in.fGenParticleSubeventStorage)
 {
   // Copy constructor
   
-  for(Int_t i = 0; i < fnMaxJet; i++){
-    fJetPtArray[i] = in.fJetPtArray[i];
-    fJetPhiArray[i] = in.fJetPhiArray[i];
-    fJetWTAPhiArray[i] = in.fJetWTAPhiArray[i];
-    fJetEtaArray[i] = in.fJetEtaArray[i];
-    fJetWTAEtaArray[i] = in.fJetWTAEtaArray[i];
-    fJetRawPtArray[i] = in.fJetRawPtArray[i];
-    fJetMaxTrackPtArray[i] = in.fJetMaxTrackPtArray[i];
-    fJetRefPtArray[i] = in.fJetRefPtArray[i];
-    fJetRefEtaArray[i] = in.fJetRefEtaArray[i];
-    fJetRefPhiArray[i] = in.fJetRefPhiArray[i];
-    fJetRefFlavorArray[i] = in.fJetRefFlavorArray[i];
-    fGenJetPtArray[i] = in.fGenJetPtArray[i];
-    fGenJetPhiArray[i] = in.fGenJetPhiArray[i];
-    fGenJetWTAPhiArray[i] = in.fGenJetWTAPhiArray[i];
-    fGenJetEtaArray[i] = in.fGenJetEtaArray[i];
-    fGenJetWTAEtaArray[i] = in.fGenJetWTAEtaArray[i];
-    fCaloJetPtArray[i] = in.fCaloJetPtArray[i];
-    fCaloJetPhiArray[i] = in.fCaloJetPhiArray[i];
-    fCaloJetEtaArray[i] = in.fCaloJetEtaArray[i];
-  }
+  // Copy the jet arrays
+  fJetPtArray = in.fJetPtArray;
+  fJetPhiArray = in.fJetPhiArray;
+  fJetWTAPhiArray = in.fJetWTAPhiArray;
+  fJetEtaArray = in.fJetEtaArray;
+  fJetWTAEtaArray = in.fJetWTAEtaArray;
+  fJetRawPtArray = in.fJetRawPtArray;
+  fJetMaxTrackPtArray = in.fJetMaxTrackPtArray;
+  fJetRefPtArray = in.fJetRefPtArray;
+  fJetRefEtaArray = in.fJetRefEtaArray;
+  fJetRefPhiArray = in.fJetRefPhiArray;
+  fJetRefFlavorArray = in.fJetRefFlavorArray;
+  fGenJetPtArray = in.fGenJetPtArray;
+  fGenJetPhiArray = in.fGenJetPhiArray;
+  fGenJetWTAPhiArray = in.fGenJetWTAPhiArray;
+  fGenJetEtaArray = in.fGenJetEtaArray;
+  fGenJetWTAEtaArray = in.fGenJetWTAEtaArray;
+  fCaloJetPtArray = in.fCaloJetPtArray;
+  fCaloJetPhiArray = in.fCaloJetPhiArray;
+  fCaloJetEtaArray = in.fCaloJetEtaArray;
 }
 
 /*
@@ -380,6 +448,14 @@ MonteCarloForestReader& MonteCarloForestReader::operator=(const MonteCarloForest
   
   fJetType = in.fJetType;
   fJetAxis = in.fJetAxis;
+  fReadCacheSize = in.fReadCacheSize;
+  fAlignedReading = in.fAlignedReading;
+  fBranchGroups = in.fBranchGroups;
+  fPrunedBranches = in.fPrunedBranches;
+  fPrunedZipBytes = in.fPrunedZipBytes;
+  fColumnCache = in.fColumnCache;
+  fInputFile = NULL; // The file stays owned by the reader that opened it
+  fEntryLists.clear(); // The entry lists stay owned by the reader that set them
   fHeavyIonTree = in.fHeavyIonTree;
   fSkimTree = in.fSkimTree;
   fJetTree = in.fJetTree;
@@ -436,6 +512,11 @@ MonteCarloForestReader& MonteCarloForestReader::operator=(const MonteCarloForest
   fGenParticleEtaBranch = in.fGenParticleEtaBranch;
   fGenParticleChargeBranch = in.fGenParticleChargeBranch;
   fGenParticleSubeventBranch = in.fGenParticleSubeventBranch;
+  fHeavyIonBranches = in.fHeavyIonBranches;
+  fSkimBranches = in.fSkimBranches;
+  fJetPtBranches = in.fJetPtBranches;
+  fJetBranches = in.fJetBranches;
+  fGenParticleBranches = in.fGenParticleBranches;
   fVertexZ = in.fVertexZ;
   fHiBin = in.fHiBin;
   fPtHat = in.fPtHat;
@@ -448,27 +529,25 @@ MonteCarloForestReader& MonteCarloForestReader::operator=(const MonteCarloForest
   fEventWeight = in.fEventWeight;
   fnTracks = in.fnTracks;
   
-  for(Int_t i = 0; i < fnMaxJet; i++){
-    fJetPtArray[i] = in.fJetPtArray[i];
-    fJetPhiArray[i] = in.fJetPhiArray[i];
-    fJetWTAPhiArray[i] = in.fJetWTAPhiArray[i];
-    fJetEtaArray[i] = in.fJetEtaArray[i];
-    fJetWTAEtaArray[i] = in.fJetWTAEtaArray[i];
-    fJetRawPtArray[i] = in.fJetRawPtArray[i];
-    fJetMaxTrackPtArray[i] = in.fJetMaxTrackPtArray[i];
-    fJetRefPtArray[i] = in.fJetRefPtArray[i];
-    fJetRefEtaArray[i] = in.fJetRefEtaArray[i];
-    fJetRefPhiArray[i] = in.fJetRefPhiArray[i];
-    fJetRefFlavorArray[i] = in.fJetRefFlavorArray[i];
-    fGenJetPtArray[i] = in.fGenJetPtArray[i];
-    fGenJetPhiArray[i] = in.fGenJetPhiArray[i];
-    fGenJetWTAPhiArray[i] = in.fGenJetWTAPhiArray[i];
-    fGenJetEtaArray[i] = in.fGenJetEtaArray[i];
-    fGenJetWTAEtaArray[i] = in.fGenJetWTAEtaArray[i];
-    fCaloJetPtArray[i] = in.fCaloJetPtArray[i];
-    fCaloJetPhiArray[i] = in.fCaloJetPhiArray[i];
-    fCaloJetEtaArray[i] = in.fCaloJetEtaArray[i];
-  }
+  fJetPtArray = in.fJetPtArray;
+  fJetPhiArray = in.fJetPhiArray;
+  fJetWTAPhiArray = in.fJetWTAPhiArray;
+  fJetEtaArray = in.fJetEtaArray;
+  fJetWTAEtaArray = in.fJetWTAEtaArray;
+  fJetRawPtArray = in.fJetRawPtArray;
+  fJetMaxTrackPtArray = in.fJetMaxTrackPtArray;
+  fJetRefPtArray = in.fJetRefPtArray;
+  fJetRefEtaArray = in.fJetRefEtaArray;
+  fJetRefPhiArray = in.fJetRefPhiArray;
+  fJetRefFlavorArray = in.fJetRefFlavorArray;
+  fGenJetPtArray = in.fGenJetPtArray;
+  fGenJetPhiArray = in.fGenJetPhiArray;
+  fGenJetWTAPhiArray = in.fGenJetWTAPhiArray;
+  fGenJetEtaArray = in.fGenJetEtaArray;
+  fGenJetWTAEtaArray = in.fGenJetWTAEtaArray;
+  fCaloJetPtArray = in.fCaloJetPtArray;
+  fCaloJetPhiArray = in.fCaloJetPhiArray;
+  fCaloJetEtaArray = in.fCaloJetEtaArray;
   
   // Copy the track vectors
   fTrackPtVector = in.fTrackPtVector;
@@ -489,11 +568,16 @@ MonteCarloForestReader& MonteCarloForestReader::operator=(const MonteCarloForest
   
   // Copy the generator level particle vectors
   fnGenParticles = in.fnGenParticles;
-  fGenParticlePtArray = in.fGenParticlePtArray;
-  fGenParticlePhiArray = in.fGenParticlePhiArray;
-  fGenParticleEtaArray = in.fGenParticleEtaArray;
-  fGenParticleChargeArray = in.fGenParticleChargeArray;
-  fGenParticleSubeventArray = in.fGenParticleSubeventArray;
+  fGenParticlePtStorage = in.fGenParticlePtStorage;
+  fGenParticlePhiStorage = in.fGenParticlePhiStorage;
+  fGenParticleEtaStorage = in.fGenParticleEtaStorage;
+  fGenParticleChargeStorage = in.fGenParticleChargeStorage;
+  fGenParticleSubeventStorage = in.fGenParticleSubeventStorage;
+  fGenParticlePtArray = in.fGenParticlePtArray ? &fGenParticlePtStorage : 0;
+  fGenParticlePhiArray = in.fGenParticlePhiArray ? &fGenParticlePhiStorage : 0;
+  fGenParticleEtaArray = in.fGenParticleEtaArray ? &fGenParticleEtaStorage : 0;
+  fGenParticleChargeArray = in.fGenParticleChargeArray ? &fGenParticleChargeStorage : 0;
+  fGenParticleSubeventArray = in.fGenParticleSubeventArray ? &fGenParticleSubeventStorage : 0;
   
   return *this;
 }
@@ -503,6 +587,7 @@ MonteCarloForestReader& MonteCarloForestReader::operator=(const MonteCarloForest
  */
 MonteCarloForestReader::~MonteCarloForestReader(){
   // destructor
+  if(fInputFile) BurnForest();
 }
 
 /*
@@ -530,67 +615,113 @@ void MonteCarloForestReader::Initialize(){
   fSkimTree->SetBranchStatus("pclusterCompatibilityFilter",1);
   fSkimTree->SetBranchAddress("pclusterCompatibilityFilter", &fClusterCompatibilityFilterBit, &fClusterCompatibilityBranch);
   
-  // Connect the branches to the jet tree  
-  fJetTree->SetBranchStatus("*",0);
-  fJetTree->SetBranchStatus("jtpt",1);
-  fJetTree->SetBranchAddress("jtpt",&fJetPtArray,&fJetPtBranch);
-  
-  // Load jet phi with E-scheme and WTA axes
-  fJetTree->SetBranchStatus("jtphi",1);
-  fJetTree->SetBranchAddress("jtphi",&fJetPhiArray,&fJetPhiBranch);
-  fJetTree->SetBranchStatus("WTAphi",1);
-  fJetTree->SetBranchAddress("WTAphi",&fJetWTAPhiArray,&fJetWTAPhiBranch);
+  // Size the jet arrays such that they can hold the largest number of jets in any event of this file
+  ResizeJetArrays(GetMaximumCount(fJetTree, "nref"), GetMaximumCount(fJetTree, "ngen"), GetMaximumCount(fJetTree, "ncalo"));
   
-  // Load jet eta with E-scheme and WTA axes
-  fJetTree->SetBranchStatus("jteta",1);
-  fJetTree->SetBranchAddress("jteta",&fJetEtaArray,&fJetEtaBranch);
-  fJetTree->SetBranchStatus("WTAeta",1);
-  fJetTree->SetBranchAddress("WTAeta",&fJetWTAEtaArray,&fJetWTAEtaBranch);
+  // Connect the branches to the jet tree. Only the branch groups needed for the analysis are enabled
+  fJetTree->SetBranchStatus("*",0);
+  fPrunedBranches.clear();
+  fPrunedZipBytes = 0;
   
+  // Number of jets is always needed
   fJetTree->SetBranchStatus("nref",1);
   fJetTree->SetBranchAddress("nref",&fnJets,&fnJetsBranch);
-  fJetTree->SetBranchStatus("rawpt",1);
-  fJetTree->SetBranchAddress("rawpt",&fJetRawPtArray,&fJetRawPtBranch);
-  fJetTree->SetBranchStatus("trackMax",1);
-  fJetTree->SetBranchAddress("trackMax",&fJetMaxTrackPtArray,&fJetMaxTrackPtBranch);
-
-  // Connect the reference jet and gen jet arrays
-  fJetTree->SetBranchStatus("refpt",1);
-  fJetTree->SetBranchAddress("refpt",&fJetRefPtArray,&fJetRefPtBranch);
-  fJetTree->SetBranchStatus("refeta",1);
-  fJetTree->SetBranchAddress("refeta",&fJetRefEtaArray,&fJetRefEtaBranch);
-  fJetTree->SetBranchStatus("refphi",1);
-  fJetTree->SetBranchAddress("refphi",&fJetRefPhiArray,&fJetRefPhiBranch);
-  fJetTree->SetBranchStatus("matchedPartonFlavor",1);
-  fJetTree->SetBranchAddress("matchedPartonFlavor",&fJetRefFlavorArray,&fJetRefFlavorBranch);
-
-  fJetTree->SetBranchStatus("genpt",1);
-  fJetTree->SetBranchAddress("genpt",&fGenJetPtArray,&fGenJetPtBranch);
-    
-  // Load jet phi with E-scheme and WTA axes
-  fJetTree->SetBranchStatus("genphi",1);
-  fJetTree->SetBranchAddress("genphi",&fGenJetPhiArray,&fGenJetPhiBranch);
-  fJetTree->SetBranchStatus("WTAgenphi",1);
-  fJetTree->SetBranchAddress("WTAgenphi",&fGenJetWTAPhiArray,&fGenJetWTAPhiBranch);
-    
-  // Load jet eta with E-scheme and WTA axes
-  fJetTree->SetBranchStatus("geneta",1);
-  fJetTree->SetBranchAddress("geneta",&fGenJetEtaArray,&fGenJetEtaBranch);
-  fJetTree->SetBranchStatus("WTAgeneta",1);
-  fJetTree->SetBranchAddress("WTAgeneta",&fGenJetWTAEtaArray,&fGenJetWTAEtaBranch);
-    
-  fJetTree->SetBranchStatus("ngen",1);
-  fJetTree->SetBranchAddress("ngen",&fnGenJets,&fnGenJetsBranch);
+  
+  // Jet pT as stored in the forest
+  if(fBranchGroups.test(kForestJetPt)){
+    fJetTree->SetBranchStatus("jtpt",1);
+    fJetTree->SetBranchAddress("jtpt",fJetPtArray.data(),&fJetPtBranch);
+  } else {
+    PruneBranches(fJetTree, {"jtpt"});
+  }
+  
+  // Load jet phi and eta with E-scheme axis
+  if(fBranchGroups.test(kJetEScheme)){
+    fJetTree->SetBranchStatus("jtphi",1);
+    fJetTree->SetBranchAddress("jtphi",fJetPhiArray.data(),&fJetPhiBranch);
+    fJetTree->SetBranchStatus("jteta",1);
+    fJetTree->SetBranchAddress("jteta",fJetEtaArray.data(),&fJetEtaBranch);
+  } else {
+    PruneBranches(fJetTree, {"jtphi", "jteta"});
+  }
+  
+  // Load jet phi and eta with WTA axis
+  if(fBranchGroups.test(kJetWTA)){
+    fJetTree->SetBranchStatus("WTAphi",1);
+    fJetTree->SetBranchAddress("WTAphi",fJetWTAPhiArray.data(),&fJetWTAPhiBranch);
+    fJetTree->SetBranchStatus("WTAeta",1);
+    fJetTree->SetBranchAddress("WTAeta",fJetWTAEtaArray.data(),&fJetWTAEtaBranch);
+  } else {
+    PruneBranches(fJetTree, {"WTAphi", "WTAeta"});
+  }
+  
+  // Raw jet pT for manual jet energy correction
+  if(fBranchGroups.test(kJetRawPt)){
+    fJetTree->SetBranchStatus("rawpt",1);
+    fJetTree->SetBranchAddress("rawpt",fJetRawPtArray.data(),&fJetRawPtBranch);
+  } else {
+    PruneBranches(fJetTree, {"rawpt"});
+  }
+  
+  // Maximum track pT for jet quality cuts
+  if(fBranchGroups.test(kJetTrackMax)){
+    fJetTree->SetBranchStatus("trackMax",1);
+    fJetTree->SetBranchAddress("trackMax",fJetMaxTrackPtArray.data(),&fJetMaxTrackPtBranch);
+  } else {
+    PruneBranches(fJetTree, {"trackMax"});
+  }
+
+  // Connect the reference jet arrays
+  if(fBranchGroups.test(kReferenceJets)){
+    fJetTree->SetBranchStatus("refpt",1);
+    fJetTree->SetBranchAddress("refpt",fJetRefPtArray.data(),&fJetRefPtBranch);
+    fJetTree->SetBranchStatus("refeta",1);
+    fJetTree->SetBranchAddress("refeta",fJetRefEtaArray.data(),&fJetRefEtaBranch);
+    fJetTree->SetBranchStatus("refphi",1);
+    fJetTree->SetBranchAddress("refphi",fJetRefPhiArray.data(),&fJetRefPhiBranch);
+    fJetTree->SetBranchStatus("matchedPartonFlavor",1);
+    fJetTree->SetBranchAddress("matchedPartonFlavor",fJetRefFlavorArray.data(),&fJetRefFlavorBranch);
+  } else {
+    PruneBranches(fJetTree, {"refpt", "refeta", "refphi", "matchedPartonFlavor"});
+  }
+
+  // Connect the generator level jet arrays. E-scheme axis is always used for matching
+  if(fBranchGroups.test(kGeneratorJets)){
+    fJetTree->SetBranchStatus("ngen",1);
+    fJetTree->SetBranchAddress("ngen",&fnGenJets,&fnGenJetsBranch);
+    fJetTree->SetBranchStatus("genpt",1);
+    fJetTree->SetBranchAddress("genpt",fGenJetPtArray.data(),&fGenJetPtBranch);
+    fJetTree->SetBranchStatus("genphi",1);
+    fJetTree->SetBranchAddress("genphi",fGenJetPhiArray.data(),&fGenJetPhiBranch);
+    fJetTree->SetBranchStatus("geneta",1);
+    fJetTree->SetBranchAddress("geneta",fGenJetEtaArray.data(),&fGenJetEtaBranch);
+  } else {
+    PruneBranches(fJetTree, {"ngen", "genpt", "genphi", "geneta"});
+  }
+  
+  // Load generator level jet phi and eta with WTA axis
+  if(fBranchGroups.test(kGeneratorJetWTA)){
+    fJetTree->SetBranchStatus("WTAgenphi",1);
+    fJetTree->SetBranchAddress("WTAgenphi",fGenJetWTAPhiArray.data(),&fGenJetWTAPhiBranch);
+    fJetTree->SetBranchStatus("WTAgeneta",1);
+    fJetTree->SetBranchAddress("WTAgeneta",fGenJetWTAEtaArray.data(),&fGenJetWTAEtaBranch);
+  } else {
+    PruneBranches(fJetTree, {"WTAgenphi", "WTAgeneta"});
+  }
 
   // Load the variables for calo jets
-  fJetTree->SetBranchStatus("ncalo", 1);
-  fJetTree->SetBranchAddress("ncalo", &fnCaloJets, &fnCaloJetsBranch);
-  fJetTree->SetBranchStatus("calopt", 1);
-  fJetTree->SetBranchAddress("calopt", &fCaloJetPtArray, &fCaloJetPtBranch);
-  fJetTree->SetBranchStatus("calophi", 1);
-  fJetTree->SetBranchAddress("calophi", &fCaloJetPhiArray, &fCaloJetPhiBranch);
-  fJetTree->SetBranchStatus("caloeta", 1);
-  fJetTree->SetBranchAddress("caloeta", &fCaloJetEtaArray, &fCaloJetEtaBranch);
+  if(fBranchGroups.test(kCalorimeterJets)){
+    fJetTree->SetBranchStatus("ncalo", 1);
+    fJetTree->SetBranchAddress("ncalo", &fnCaloJets, &fnCaloJetsBranch);
+    fJetTree->SetBranchStatus("calopt", 1);
+    fJetTree->SetBranchAddress("calopt", fCaloJetPtArray.data(), &fCaloJetPtBranch);
+    fJetTree->SetBranchStatus("calophi", 1);
+    fJetTree->SetBranchAddress("calophi", fCaloJetPhiArray.data(), &fCaloJetPhiBranch);
+    fJetTree->SetBranchStatus("caloeta", 1);
+    fJetTree->SetBranchAddress("caloeta", fCaloJetEtaArray.data(), &fCaloJetEtaBranch);
+  } else {
+    PruneBranches(fJetTree, {"ncalo", "calopt", "calophi", "caloeta"});
+  }
   
   // Connect the branches to the track tree
   /*
@@ -633,18 +764,274 @@ void MonteCarloForestReader::Initialize(){
   */
   
   // Connect the branches to the generator level particle tree
+  // The vectors owned by the reader are given to the branches, such that ROOT fills them instead of allocating new ones.
+  // Reserving memory for a central HYDJET event in the beginning avoids reallocations while reading the first events.
   fGenParticleTree->SetBranchStatus("*",0);
-  fGenParticleTree->SetBranchStatus("pt",1);
-  fGenParticleTree->SetBranchAddress("pt",&fGenParticlePtArray,&fGenParticlePtBranch);
-  fGenParticleTree->SetBranchStatus("phi",1);
-  fGenParticleTree->SetBranchAddress("phi",&fGenParticlePhiArray,&fGenParticlePhiBranch);
-  fGenParticleTree->SetBranchStatus("eta",1);
-  fGenParticleTree->SetBranchAddress("eta",&fGenParticleEtaArray,&fGenParticleEtaBranch);
-  fGenParticleTree->SetBranchStatus("chg",1);
-  fGenParticleTree->SetBranchAddress("chg",&fGenParticleChargeArray,&fGenParticleChargeBranch);
-  fGenParticleTree->SetBranchStatus("sube",1);
-  fGenParticleTree->SetBranchAddress("sube",&fGenParticleSubeventArray,&fGenParticleSubeventBranch);
+  if(fBranchGroups.test(kGeneratorParticles)){
+    fGenParticlePtStorage.reserve(fnGenParticleReserve);
+    fGenParticlePhiStorage.reserve(fnGenParticleReserve);
+    fGenParticleEtaStorage.reserve(fnGenParticleReserve);
+    fGenParticleSubeventStorage.reserve(fnGenParticleReserve);
+    fGenParticlePtArray = &fGenParticlePtStorage;
+    fGenParticlePhiArray = &fGenParticlePhiStorage;
+    fGenParticleEtaArray = &fGenParticleEtaStorage;
+    fGenParticleSubeventArray = &fGenParticleSubeventStorage;
+    fGenParticleTree->SetBranchStatus("pt",1);
+    fGenParticleTree->SetBranchAddress("pt",&fGenParticlePtArray,&fGenParticlePtBranch);
+    fGenParticleTree->SetBranchStatus("phi",1);
+    fGenParticleTree->SetBranchAddress("phi",&fGenParticlePhiArray,&fGenParticlePhiBranch);
+    fGenParticleTree->SetBranchStatus("eta",1);
+    fGenParticleTree->SetBranchAddress("eta",&fGenParticleEtaArray,&fGenParticleEtaBranch);
+    fGenParticleTree->SetBranchStatus("sube",1);
+    fGenParticleTree->SetBranchAddress("sube",&fGenParticleSubeventArray,&fGenParticleSubeventBranch);
+  } else {
+    fGenParticlePtArray = NULL;
+    fGenParticlePhiArray = NULL;
+    fGenParticleEtaArray = NULL;
+    fGenParticleSubeventArray = NULL;
+    fGenParticlePtBranch = NULL;
+    fGenParticlePhiBranch = NULL;
+    fGenParticleEtaBranch = NULL;
+    fGenParticleSubeventBranch = NULL;
+    PruneBranches(fGenParticleTree, {"pt", "phi", "eta", "sube"});
+  }
+  
+  // Particle charge is read only if specifically requested
+  if(fBranchGroups.test(kGeneratorParticleCharge)){
+    fGenParticleChargeStorage.reserve(fnGenParticleReserve);
+    fGenParticleChargeArray = &fGenParticleChargeStorage;
+    fGenParticleTree->SetBranchStatus("chg",1);
+    fGenParticleTree->SetBranchAddress("chg",&fGenParticleChargeArray,&fGenParticleChargeBranch);
+  } else {
+    PruneBranches(fGenParticleTree, {"chg"});
+  }
+  
+  // Group the connected branches by tree and by the stage in which they are needed in staged loading
+  fHeavyIonBranches = {fHiVzBranch, fHiBinBranch, fPtHatBranch, fEventWeightBranch};
+  fSkimBranches = {fPrimaryVertexBranch, fHfCoincidenceBranch, fClusterCompatibilityBranch};
+  fJetPtBranches = {fnJetsBranch, fJetPtBranch, fJetRawPtBranch, fJetPhiBranch, fJetWTAPhiBranch, fJetEtaBranch, fJetWTAEtaBranch, fnGenJetsBranch, fGenJetPtBranch, fnCaloJetsBranch, fCaloJetPtBranch, fCaloJetPhiBranch, fCaloJetEtaBranch};
+  fJetBranches = {fJetMaxTrackPtBranch, fJetRefPtBranch, fJetRefEtaBranch, fJetRefPhiBranch, fJetRefFlavorBranch, fGenJetPhiBranch, fGenJetWTAPhiBranch, fGenJetEtaBranch, fGenJetWTAEtaBranch};
+  fGenParticleBranches = {fGenParticlePtBranch, fGenParticlePhiBranch, fGenParticleEtaBranch, fGenParticleChargeBranch, fGenParticleSubeventBranch};
+  
+  // Only the branches connected above are read to the cache for each tree
+  std::vector<TBranch*> allJetBranches(fJetPtBranches);
+  allJetBranches.insert(allJetBranches.end(), fJetBranches.begin(), fJetBranches.end());
+  ConfigureReadCache(fHeavyIonTree, fHeavyIonBranches);
+  ConfigureReadCache(fSkimTree, fSkimBranches);
+  ConfigureReadCache(fJetTree, allJetBranches);
+  ConfigureReadCache(fGenParticleTree, fGenParticleBranches);
+  
+}
+
+/*
+ * Size the jet arrays for the current file. The number of jets in the largest event in the file is read
+ * from the maximum value stored in the counter leaf of each jet collection, or from the column cache. The arrays
+ * are resized before the branch addresses are set, and they are not resized again while the file is read, which
+ * guarantees that the addresses given to the branches stay valid and that no event can overflow the arrays.
+ *
+ *  Arguments:
+ *   const Int_t nMaxJets = Largest number of reconstructed jets in an event
+ *   const Int_t nMaxGenJets = Largest number of generator level jets in an event
+ *   const Int_t nMaxCaloJets = Largest number of calorimeter jets in an event
+ */
+void MonteCarloForestReader::ResizeJetArrays(const Int_t nMaxJets, const Int_t nMaxGenJets, const Int_t nMaxCaloJets){
+  
+  // Reconstructed jet arrays
+  fJetPtArray.assign(nMaxJets, 0);
+  fJetPhiArray.assign(nMaxJets, 0);
+  fJetWTAPhiArray.assign(nMaxJets, 0);
+  fJetEtaArray.assign(nMaxJets, 0);
+  fJetWTAEtaArray.assign(nMaxJets, 0);
+  fJetRawPtArray.assign(nMaxJets, 0);
+  fJetMaxTrackPtArray.assign(nMaxJets, -1);
+  fJetRefPtArray.assign(nMaxJets, 0);
+  fJetRefEtaArray.assign(nMaxJets, 0);
+  fJetRefPhiArray.assign(nMaxJets, 0);
+  fJetRefFlavorArray.assign(nMaxJets, 0);
+  
+  // Generator level jet arrays
+  fGenJetPtArray.assign(nMaxGenJets, 0);
+  fGenJetPhiArray.assign(nMaxGenJets, 0);
+  fGenJetWTAPhiArray.assign(nMaxGenJets, 0);
+  fGenJetEtaArray.assign(nMaxGenJets, 0);
+  fGenJetWTAEtaArray.assign(nMaxGenJets, 0);
   
+  // Calorimeter jet arrays
+  fCaloJetPtArray.assign(nMaxCaloJets, 0);
+  fCaloJetPhiArray.assign(nMaxCaloJets, 0);
+  fCaloJetEtaArray.assign(nMaxCaloJets, 0);
+}
+
+/*
+ * Get the maximum value of a counter leaf in a tree. This is the maximum size of the arrays using the counter.
+ *
+ *  Arguments:
+ *   TTree* tree = Tree in which the counter leaf is
+ *   const char* leafName = Name of the counter leaf
+ *
+ *  return: Maximum value of the counter in the tree, at least one such that the arrays are never empty
+ */
+Int_t MonteCarloForestReader::GetMaximumCount(TTree* tree, const char* leafName) const{
+  TLeaf* counterLeaf = tree->GetLeaf(leafName);
+  if(!counterLeaf) return 1;
+  return TMath::Max(counterLeaf->GetMaximum(), 1);
+}
+
+/*
+ * Book keeping for branches that are not read from the forest. The names of the pruned branches and
+ * the compressed size of their baskets are recorded, such that the saved amount of reading can be reported.
+ *
+ *  Arguments:
+ *   TTree* tree = Tree to which the branches belong
+ *   std::vector<const char*> branchNames = Names of the branches that are not read
+ */
+void MonteCarloForestReader::PruneBranches(TTree* tree, std::vector<const char*> branchNames){
+  
+  TBranch* prunedBranch;
+  for(const char* branchName : branchNames){
+    
+    // Branches that do not exist in the forest do not need to be pruned
+    prunedBranch = tree->GetBranch(branchName);
+    if(!prunedBranch) continue;
+    
+    fPrunedBranches.push_back(Form("%s/%s", tree->GetName(), branchName));
+    fPrunedZipBytes += prunedBranch->GetZipBytes();
+  }
+}
+
+/*
+ * Check that a forest file has all the trees and branches needed to read it with the current branch groups.
+ * The reader is not connected to the file, so this can be used to check files before the analysis.
+ *
+ *  Arguments:
+ *   TFile* inputFile = Opened forest file
+ *   Long64_t& nEntries = Number of entries in the jet tree
+ *   Long64_t& zipBytes = Compressed size of all the trees read by the reader
+ *   Int_t& nClusters = Number of clusters in the jet tree
+ *   Double_t& meanParticles = Estimated mean number of generator level particles in an event
+ *   std::vector<Long64_t>* clusterStarts = If given, the first entry of each cluster in the jet tree is stored here
+ *
+ *  return: Empty string if the file can be read, otherwise a description of the problem
+ */
+TString MonteCarloForestReader::CheckForestFile(TFile* inputFile, Long64_t& nEntries, Long64_t& zipBytes, Int_t& nClusters, Double_t& meanParticles, std::vector<Long64_t>* clusterStarts) const{
+  
+  nEntries = 0;
+  zipBytes = 0;
+  nClusters = 0;
+  meanParticles = 0;
+  if(clusterStarts) clusterStarts->clear();
+  
+  // All the trees read by the reader need to exist
+  const Int_t nTrees = 4;
+  const char* treeNames[nTrees] = {"hiEvtAnalyzer/HiTree", "skimanalysis/HltTree", fJetTreeNames[fJetType], "HiGenParticleAna/hi"};
+  TTree* trees[nTrees];
+  for(Int_t iTree = 0; iTree < nTrees; iTree++){
+    trees[iTree] = (TTree*)inputFile->Get(treeNames[iTree]);
+    if(!trees[iTree]) return Form("Tree %s not found", treeNames[iTree]);
+  }
+  
+  // The trees are read with the same entry number, so they need to have the same number of entries
+  nEntries = trees[2]->GetEntries();
+  for(Int_t iTree = 0; iTree < nTrees; iTree++){
+    if(trees[iTree]->GetEntries() != nEntries) return Form("Tree %s has %lld entries, while the jet tree has %lld entries", treeNames[iTree], trees[iTree]->GetEntries(), nEntries);
+    zipBytes += trees[iTree]->GetZipBytes();
+  }
+  
+  // Branches connected in Initialize for the enabled branch groups
+  std::vector<const char*> requiredBranches[nTrees];
+  requiredBranches[0] = {"vz", "hiBin", "pthat", "weight"};
+  requiredBranches[1] = {"pprimaryVertexFilter", "pphfCoincFilter2Th4", "pclusterCompatibilityFilter"};
+  requiredBranches[2] = {"nref"};
+  if(fBranchGroups.test(kForestJetPt)) requiredBranches[2].insert(requiredBranches[2].end(), {"jtpt"});
+  if(fBranchGroups.test(kJetEScheme)) requiredBranches[2].insert(requiredBranches[2].end(), {"jtphi", "jteta"});
+  if(fBranchGroups.test(kJetWTA)) requiredBranches[2].insert(requiredBranches[2].end(), {"WTAphi", "WTAeta"});
+  if(fBranchGroups.test(kJetRawPt)) requiredBranches[2].insert(requiredBranches[2].end(), {"rawpt"});
+  if(fBranchGroups.test(kJetTrackMax)) requiredBranches[2].insert(requiredBranches[2].end(), {"trackMax"});
+  if(fBranchGroups.test(kReferenceJets)) requiredBranches[2].insert(requiredBranches[2].end(), {"refpt", "refeta", "refphi", "matchedPartonFlavor"});
+  if(fBranchGroups.test(kGeneratorJets)) requiredBranches[2].insert(requiredBranches[2].end(), {"ngen", "genpt", "genphi", "geneta"});
+  if(fBranchGroups.test(kGeneratorJetWTA)) requiredBranches[2].insert(requiredBranches[2].end(), {"WTAgenphi", "WTAgeneta"});
+  if(fBranchGroups.test(kCalorimeterJets)) requiredBranches[2].insert(requiredBranches[2].end(), {"ncalo", "calopt", "calophi", "caloeta"});
+  if(fBranchGroups.test(kGeneratorParticles)) requiredBranches[3].insert(requiredBranches[3].end(), {"pt", "phi", "eta", "sube"});
+  if(fBranchGroups.test(kGeneratorParticleCharge)) requiredBranches[3].insert(requiredBranches[3].end(), {"chg"});
+  
+  for(Int_t iTree = 0; iTree < nTrees; iTree++){
+    for(const char* branchName : requiredBranches[iTree]){
+      if(!trees[iTree]->GetBranch(branchName)) return Form("Branch %s not found from tree %s", branchName, treeNames[iTree]);
+    }
+  }
+  
+  // The uncompressed size of the particle pT branch tells the mean particle multiplicity without reading the entries.
+  // The few bytes of overhead stored for each entry make this a slight overestimate, which is fine for estimating the work.
+  TBranch* particlePtBranch = trees[3]->GetBranch("pt");
+  if(particlePtBranch && nEntries > 0) meanParticles = particlePtBranch->GetTotBytes() / (Double_t)(nEntries * sizeof(Float_t));
+  
+  // Count the clusters in the jet tree. Each cluster is read from the file with one request
+  TTree::TClusterIterator clusterIterator = trees[2]->GetClusterIterator(0);
+  Long64_t clusterStart;
+  while((clusterStart = clusterIterator()) < nEntries){
+    if(clusterStarts) clusterStarts->push_back(clusterStart);
+    nClusters++;
+  }
+  
+  return "";
+}
+
+/*
+ * Print the branches that are not read from the current forest together with the size of their baskets
+ */
+void MonteCarloForestReader::PrintPrunedBranches() const{
+  
+  cout << "Pruned branches:";
+  for(const TString& branchName : fPrunedBranches){
+    cout << " " << branchName.Data();
+  }
+  cout << endl;
+  cout << "Not reading " << fPrunedZipBytes/(1024*1024) << " MB of compressed baskets from pruned branches" << endl;
+}
+
+/*
+ * Set the branch groups that are read from the forest. Must be called before reading the forest from a file.
+ *
+ *  Arguments:
+ *   std::bitset<knBranchGroups> branchGroups = Bit for each branch group in enumBranchGroup. Branches are read only for the groups with the bit set.
+ */
+void MonteCarloForestReader::SetBranchGroups(std::bitset<knBranchGroups> branchGroups){
+  fBranchGroups = branchGroups;
+}
+
+// Getter for the groups of branches that are read from the forest
+std::bitset<MonteCarloForestReader::knBranchGroups> MonteCarloForestReader::GetBranchGroups() const{
+  return fBranchGroups;
+}
+
+/*
+ * Set up a read cache for a tree
+ *
+ * Without a cache, each basket of each branch is a separate read from the file, which is very slow
+ * when the files are read over xrootd. With a cache, the baskets of all the given branches belonging to
+ * the same cluster are read with a single vectored read. If asynchronous prefetching is enabled for
+ * TFile, the next cluster is read while the current one is being analyzed. If parallel unzipping is
+ * enabled, the baskets in the cache are also decompressed in parallel.
+ *
+ *  Arguments:
+ *   TTree* tree = Tree for which the cache is set up
+ *   std::vector<TBranch*> cachedBranches = Branches that are read to the cache
+ */
+void MonteCarloForestReader::ConfigureReadCache(TTree* tree, std::vector<TBranch*> cachedBranches){
+  
+  // Do not set up a cache if the cache size is not positive
+  if(fReadCacheSize <= 0) return;
+  
+  // Create the cache for the tree
+  tree->SetCacheSize(fReadCacheSize);
+  
+  // Add all the connected branches to the cache
+  for(TBranch* branch : cachedBranches){
+    if(branch) tree->AddBranchToCache(branch, kTRUE);
+  }
+  
+  // We already know which branches are going to be read, so there is no need to learn that from the first entries
+  tree->StopCacheLearningPhase();
 }
 
 
@@ -653,61 +1040,848 @@ void MonteCarloForestReader::Initialize(){
  */
 void MonteCarloForestReader::ReadForestFromFile(TFile* inputFile){
   
+  // Release the trees connected before. If they are from the same file, they are connected again below.
+  ReleaseTrees();
+  
   // Connect a trees from the file to the reader
   fHeavyIonTree = (TTree*)inputFile->Get("hiEvtAnalyzer/HiTree");
   fSkimTree = (TTree*)inputFile->Get("skimanalysis/HltTree");
   
-  // Possible jet trees to be read
-  const char *treeName[3] = {"none","none","none"};
-  treeName[0] = "akPu4CaloJetAnalyzer/t";     // Tree for calo jets
-  treeName[1] = "akCs4PFJetAnalyzer/t";       // Tree for csPF jets
-  treeName[2] = "akFlowPuCs4PFJetAnalyzer/t"; // Tree for flow subtracted csPF jets
-  
-  fJetTree = (TTree*)inputFile->Get(treeName[fJetType]);
+  // Jet tree for the selected jet collection
+  fJetTree = (TTree*)inputFile->Get(fJetTreeNames[fJetType]);
   
   // Read track and generator level particle trees
   //fTrackTree = (TTree*)inputFile->Get("PbPbTracks/trackTree");
   fGenParticleTree = (TTree*)inputFile->Get("HiGenParticleAna/hi");
   
   Initialize();
+  
+  // For aligned reading, join all the trees as friends of the jet tree
+  if(fAlignedReading) AlignTrees();
+}
+
+/*
+ * Join the heavy ion, skim and generator level particle trees as friends of the jet tree
+ *
+ * After this, loading an entry from the jet tree loads the same entry from all the other trees,
+ * so there is no need to do the bookkeeping separately for each tree. This requires that all the
+ * trees have exactly the same number of entries. If this is not the case, the forest is broken
+ * and the analysis is stopped.
+ */
+void MonteCarloForestReader::AlignTrees(){
+  
+  // Check that all the trees have the same number of entries as the jet tree
+  const Long64_t nJetTreeEntries = fJetTree->GetEntries();
+  TTree* alignedTrees[3] = {fHeavyIonTree, fSkimTree, fGenParticleTree};
+  for(TTree* alignedTree : alignedTrees){
+    if(alignedTree->GetEntries() != nJetTreeEntries){
+      cout << "Error! Tree " << alignedTree->GetName() << " has " << alignedTree->GetEntries() << " entries, while the jet tree has " << nJetTreeEntries << " entries." << endl;
+      cout << "Cannot read the trees in aligned mode!" << endl;
+      assert(0);
+    }
+  }
+  
+  // Join the trees as friends of the jet tree. If the same trees are connected again, the old friends are replaced.
+  for(TTree* alignedTree : alignedTrees){
+    fJetTree->RemoveFriend(alignedTree);
+    fJetTree->AddFriend(alignedTree);
+  }
 }
 
 /*
  * Connect a new tree to the reader
  */
 void MonteCarloForestReader::ReadForestFromFileList(std::vector<TString> fileList){
+  BurnForest();
   TFile *inputFile = TFile::Open(fileList.at(0));
   ReadForestFromFile(inputFile);
+  
+  // The reader opened the file, so it also closes it
+  fInputFile = inputFile;
+}
+
+/*
+ * Set the size of the read cache for each tree. Must be called before reading the forest from a file.
+ *
+ *  Arguments:
+ *   Long64_t cacheSize = Size of the read cache in bytes. If not positive, the cache is not used.
+ */
+void MonteCarloForestReader::SetReadCacheSize(Long64_t cacheSize){
+  fReadCacheSize = cacheSize;
+}
+
+/*
+ * Restrict the read caches of the trees to the given entries. The caches then only fetch the baskets that contain
+ * at least one of the entries, so the baskets of the events rejected before reading are not read from the file.
+ * The entries can still be loaded one by one with the tree entry numbers. Nothing is done when reading from a
+ * column cache. The entry lists are released together with the trees.
+ *
+ *  Arguments:
+ *   const std::vector<Long64_t>& entries = Sorted entries of the current file that will be read
+ */
+void MonteCarloForestReader::SetEntryList(const std::vector<Long64_t>& entries){
+  
+  // Remove the entry lists set for the previous selection
+  ReleaseEntryLists();
+  
+  if(!fJetTree) return;
+  
+  // Each tree needs its own entry list, since the list is connected to the tree it is set to
+  TTree* connectedTrees[4] = {fHeavyIonTree, fSkimTree, fJetTree, fGenParticleTree};
+  TEntryList* entryList;
+  for(TTree* tree : connectedTrees){
+    if(!tree) continue;
+    entryList = new TEntryList(Form("%sEntries", tree->GetName()), "Entries read from the tree", tree);
+    for(const Long64_t entry : entries) entryList->Enter(entry);
+    tree->SetEntryList(entryList);
+    fEntryLists.push_back(entryList);
+  }
+}
+
+/*
+ * Detach the entry lists from the trees and delete them
+ */
+void MonteCarloForestReader::ReleaseEntryLists(){
+  
+  if(fEntryLists.empty()) return;
+  
+  TTree* connectedTrees[4] = {fHeavyIonTree, fSkimTree, fJetTree, fGenParticleTree};
+  for(TTree* tree : connectedTrees){
+    if(tree) tree->SetEntryList(NULL);
+  }
+  
+  for(TEntryList* entryList : fEntryLists) delete entryList;
+  fEntryLists.clear();
+}
+
+/*
+ * Set the flag for aligned reading. Must be called before reading the forest from a file.
+ *
+ *  Arguments:
+ *   Bool_t alignedReading = True: All trees are friends of the jet tree and read with one entry load. False: Each tree is read separately.
+ */
+void MonteCarloForestReader::SetAlignedReading(Bool_t alignedReading){
+  fAlignedReading = alignedReading;
 }
 
 /*
- * Burn the current forest.
+ * Release the trees and read caches of the current file. The trees belong to the file, so this must be called
+ * before the file is closed. If the reader opened the file itself in ReadForestFromFileList, the file is closed here.
+ * The buffers of the reader are kept, since they are reused for the next file.
  */
 void MonteCarloForestReader::BurnForest(){
-  fHeavyIonTree->Delete();
-  fSkimTree->Delete();
-  fJetTree->Delete();
-  //fTrackTree->Delete();
-  fGenParticleTree->Delete();
+  ReleaseTrees();
+  if(fInputFile){
+    fInputFile->Close();
+    delete fInputFile;
+    fInputFile = NULL;
+  }
+}
+
+/*
+ * Disconnect the reader from the trees of the current file. The read caches of the trees are deleted and
+ * the branch addresses pointing to the reader are reset, such that nothing in the file refers to the reader.
+ */
+void MonteCarloForestReader::ReleaseTrees(){
+  
+  // Events are read from the trees, not from a column cache
+  fColumnCache = NULL;
+  
+  // The entry lists refer to the trees
+  ReleaseEntryLists();
+  
+  TTree* connectedTrees[4] = {fHeavyIonTree, fSkimTree, fJetTree, fGenParticleTree};
+  
+  // The friends of the jet tree refer to the other trees
+  if(fJetTree && fAlignedReading){
+    for(Int_t iTree = 0; iTree < 4; iTree++){
+      if(connectedTrees[iTree] && connectedTrees[iTree] != fJetTree) fJetTree->RemoveFriend(connectedTrees[iTree]);
+    }
+  }
+  
+  for(TTree* tree : connectedTrees){
+    if(!tree) continue;
+    tree->SetCacheSize(0);
+    tree->ResetBranchAddresses();
+  }
+  
+  fHeavyIonTree = NULL;
+  fSkimTree = NULL;
+  fJetTree = NULL;
+  fGenParticleTree = NULL;
+  fPrunedBranches.clear();
+  fPrunedZipBytes = 0;
 }
 
 /*
  * Load an event to memory
  */
 void MonteCarloForestReader::GetEvent(Int_t iEvent){
-  fHeavyIonTree->GetEntry(iEvent);
-  fSkimTree->GetEntry(iEvent);
-  fJetTree->GetEntry(iEvent);
-  //fTrackTree->GetEntry(iEvent);
-  fGenParticleTree->GetEntry(iEvent);
+  
+  // With a column cache, all the stages are copied from the memory map
+  if(fColumnCache){
+    LoadEventInformationFromCache(iEvent);
+    LoadJetPtFromCache(iEvent);
+    LoadFullEventFromCache(iEvent);
+    return;
+  }
+  
+  // In aligned mode, all the other trees are friends of the jet tree and are loaded together with it
+  if(fAlignedReading){
+    fJetTree->GetEntry(iEvent);
+  } else {
+    fHeavyIonTree->GetEntry(iEvent);
+    fSkimTree->GetEntry(iEvent);
+    fJetTree->GetEntry(iEvent);
+    //fTrackTree->GetEntry(iEvent);
+    fGenParticleTree->GetEntry(iEvent);
+  }
    
   // Read the numbers of generator level particles for this event
-  fnGenParticles = fGenParticlePtArray->size();
+  fnGenParticles = fGenParticlePtArray ? fGenParticlePtArray->size() : 0;
+}
+
+/*
+ * Staged loading, stage 1: Load the event information from the heavy ion tree and the filter bits from the skim tree.
+ * This is everything that is needed to apply the pT hat and event selection cuts.
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadEventInformation(Int_t iEvent){
+  if(fColumnCache){
+    LoadEventInformationFromCache(iEvent);
+    return;
+  }
+  LoadBranches(fHeavyIonTree, fHeavyIonBranches, iEvent);
+  LoadBranches(fSkimTree, fSkimBranches, iEvent);
+}
+
+/*
+ * Staged loading, stage 2: Load only the jet multiplicities and pT:s for reconstructed, generator level and calorimeter jets.
+ * For reconstructed and calorimeter jets also the angles are loaded, and the raw pT for reconstructed jets, such that the
+ * jet energy correction can be done exactly as in the analysis. These are enough to decide if any jet in the event passes
+ * the jet pT cuts.
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadJetPt(Int_t iEvent){
+  if(fColumnCache){
+    LoadJetPtFromCache(iEvent);
+    return;
+  }
+  LoadBranches(fJetTree, fJetPtBranches, iEvent);
+}
+
+/*
+ * Staged loading, stage 3: Load all the remaining jet branches and the generator level particles.
+ * Stages 1 and 2 must be loaded for the same event before this.
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadFullEvent(Int_t iEvent){
+  if(fColumnCache){
+    LoadFullEventFromCache(iEvent);
+    return;
+  }
+  LoadBranches(fJetTree, fJetBranches, iEvent);
+  LoadBranches(fGenParticleTree, fGenParticleBranches, iEvent);
+  
+  // Read the numbers of generator level particles for this event
+  fnGenParticles = fGenParticlePtArray ? fGenParticlePtArray->size() : 0;
+}
+
+/*
+ * Load only the generator level particles for the i:th event. This can be done independently of the other stages.
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadGenParticles(Int_t iEvent){
+  if(fColumnCache){
+    LoadGenParticlesFromCache(iEvent);
+    return;
+  }
+  LoadBranches(fGenParticleTree, fGenParticleBranches, iEvent);
+  fnGenParticles = fGenParticlePtArray ? fGenParticlePtArray->size() : 0;
+}
+
+/*
+ * Copy the event information of the currently loaded event to an event view
+ *
+ *  Arguments:
+ *   EventView* eventView = Event view to which the information is copied
+ */
+void MonteCarloForestReader::FillEventInformation(EventView* eventView) const{
+  eventView->fVz = GetVz();
+  eventView->fCentrality = GetCentrality();
+  eventView->fHiBin = GetHiBin();
+  eventView->fPtHat = GetPtHat();
+  eventView->fEventWeight = GetEventWeight();
+  eventView->fPrimaryVertexFilterBit = GetPrimaryVertexFilterBit();
+  eventView->fHfCoincidenceFilterBit = GetHfCoincidenceFilterBit();
+  eventView->fClusterCompatibilityFilterBit = GetClusterCompatibilityFilterBit();
+}
+
+/*
+ * Copy the jet collections of the currently loaded event to an event view and give the particles to it.
+ * The selected jet axis is resolved and the reconstructed and generator level jets are matched to each other
+ * here once per event, such that the analysis does not need to do this separately for each access.
+ *
+ *  Arguments:
+ *   EventView* eventView = Event view to which the collections are copied
+ *   const Bool_t copyParticles = True: Copy the particles to the view. False: Point the view to the particle branch memory
+ */
+void MonteCarloForestReader::FillEventCollections(EventView* eventView, const Bool_t copyParticles) const{
+  
+  // The jet arrays are sized from the maximum number of jets in the file, so this should never happen
+  if(fnJets > (Int_t)fJetRawPtArray.size() || fnGenJets > (Int_t)fGenJetPtArray.size() || fnCaloJets > (Int_t)fCaloJetPtArray.size()){
+    cout << "Error! Number of jets in the event exceeds the size of the jet arrays!" << endl;
+    cout << "Reconstructed jets: " << fnJets << ", generator level jets: " << fnGenJets << ", calorimeter jets: " << fnCaloJets << endl;
+    assert(0);
+  }
+  
+  // Resolve the jet axis once for the whole event
+  const Float_t* jetPhi = (fJetAxis == 0) ? fJetPhiArray.data() : fJetWTAPhiArray.data();
+  const Float_t* jetEta = (fJetAxis == 0) ? fJetEtaArray.data() : fJetWTAEtaArray.data();
+  const Float_t* genJetPhi = (fJetAxis == 0) ? fGenJetPhiArray.data() : fGenJetWTAPhiArray.data();
+  const Float_t* genJetEta = (fJetAxis == 0) ? fGenJetEtaArray.data() : fGenJetWTAEtaArray.data();
+  
+  Int_t matchedIndex;
+  
+  // Reconstructed jets matched to generator level jets
+  EventViewJets& recoJets = eventView->fReconstructedJets;
+  recoJets.Resize(fnJets);
+  for(Int_t iJet = 0; iJet < fnJets; iJet++){
+    matchedIndex = GetMatchingGenIndex(iJet);
+    recoJets.fPt[iJet] = fJetRawPtArray[iJet];
+    recoJets.fPhi[iJet] = jetPhi[iJet];
+    recoJets.fEta[iJet] = jetEta[iJet];
+    recoJets.fMaxTrackPt[iJet] = fJetMaxTrackPtArray[iJet];
+    recoJets.fFlavor[iJet] = fJetRefFlavorArray[iJet];
+    recoJets.fHasMatch[iJet] = HasMatchingGenJet(iJet);
+    recoJets.fMatchedIndex[iJet] = matchedIndex;
+    recoJets.fMatchedPt[iJet] = (matchedIndex < 0) ? -999 : fGenJetPtArray[matchedIndex];
+    recoJets.fMatchedPhi[iJet] = (matchedIndex < 0) ? -999 : genJetPhi[matchedIndex];
+    recoJets.fMatchedEta[iJet] = (matchedIndex < 0) ? -999 : genJetEta[matchedIndex];
+  }
+  
+  // Generator level jets matched to reconstructed jets
+  EventViewJets& genJets = eventView->fGeneratorJets;
+  genJets.Resize(fnGenJets);
+  for(Int_t iJet = 0; iJet < fnGenJets; iJet++){
+    matchedIndex = GetMatchingRecoIndex(iJet);
+    genJets.fPt[iJet] = fGenJetPtArray[iJet];
+    genJets.fPhi[iJet] = genJetPhi[iJet];
+    genJets.fEta[iJet] = genJetEta[iJet];
+    genJets.fMaxTrackPt[iJet] = -999;
+    genJets.fFlavor[iJet] = (matchedIndex < 0) ? -999 : fJetRefFlavorArray[matchedIndex];
+    genJets.fHasMatch[iJet] = (matchedIndex >= 0);
+    genJets.fMatchedIndex[iJet] = matchedIndex;
+    genJets.fMatchedPt[iJet] = (matchedIndex < 0) ? -999 : fJetRawPtArray[matchedIndex];
+    genJets.fMatchedPhi[iJet] = (matchedIndex < 0) ? -999 : jetPhi[matchedIndex];
+    genJets.fMatchedEta[iJet] = (matchedIndex < 0) ? -999 : jetEta[matchedIndex];
+  }
+  
+  // Calorimeter jets do not have matching or flavor information
+  EventViewJets& caloJets = eventView->fCalorimeterJets;
+  caloJets.Resize(fnCaloJets);
+  for(Int_t iJet = 0; iJet < fnCaloJets; iJet++){
+    caloJets.fPt[iJet] = fCaloJetPtArray[iJet];
+    caloJets.fPhi[iJet] = fCaloJetPhiArray[iJet];
+    caloJets.fEta[iJet] = fCaloJetEtaArray[iJet];
+    caloJets.fMaxTrackPt[iJet] = -999;
+    caloJets.fFlavor[iJet] = -999;
+    caloJets.fHasMatch[iJet] = 0;
+    caloJets.fMatchedIndex[iJet] = -1;
+    caloJets.fMatchedPt[iJet] = -999;
+    caloJets.fMatchedPhi[iJet] = -999;
+    caloJets.fMatchedEta[iJet] = -999;
+  }
+  
+  // Generator level particles
+  FillEventParticles(eventView, copyParticles);
+}
+
+/*
+ * Give the generator level particles of the currently loaded event to an event view. By default the view points
+ * to the memory where the particle branches are read, so no copies are made and the particles are valid until the
+ * next event is loaded. If the event is analyzed after the reader has moved on, the particles are copied.
+ *
+ *  Arguments:
+ *   EventView* eventView = Event view to which the particles are given
+ *   const Bool_t copyParticles = True: Copy the particles to the memory of the view. False: Point the view to the branch memory
+ */
+void MonteCarloForestReader::FillEventParticles(EventView* eventView, const Bool_t copyParticles) const{
+  const ROOT::RVec<Float_t> particlePt = GetGenParticlePtView();
+  const ROOT::RVec<Float_t> particlePhi = GetGenParticlePhiView();
+  const ROOT::RVec<Float_t> particleEta = GetGenParticleEtaView();
+  const ROOT::RVec<Int_t> particleSubevent = GetGenParticleSubeventView();
+  if(particlePt.empty()){
+    eventView->fParticles.Clear();
+  } else if(copyParticles){
+    eventView->fParticles.Copy(particlePt.size(), particlePt.data(), particlePhi.data(), particleEta.data(), particleSubevent.data());
+  } else {
+    eventView->fParticles.Point(particlePt.size(), particlePt.data(), particlePhi.data(), particleEta.data(), particleSubevent.data());
+  }
+}
+
+/*
+ * Load the i:th entry only for the given branches of a tree. The baskets of the other branches are not decompressed.
+ * The tree is positioned to the entry first, such that the read cache knows which cluster to fetch.
+ *
+ *  Arguments:
+ *   TTree* tree = Tree to which the branches belong
+ *   const std::vector<TBranch*>& branches = Branches that are loaded
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadBranches(TTree* tree, const std::vector<TBranch*>& branches, Int_t iEvent){
+  Long64_t localEntry = tree->LoadTree(iEvent);
+  for(TBranch* branch : branches){
+    if(branch) branch->GetEntry(localEntry);
+  }
+}
+
+/*
+ * Connect the reader to a column cache instead of the forest trees. After this, the events are copied from the
+ * memory mapped cache to the same arrays that are used with the trees, so all the getters work in the same way.
+ *
+ *  Arguments:
+ *   ForestColumnCache* columnCache = Opened column cache. The reader does not take the ownership
+ *   TFile* forestFile = Opened forest file the cache should describe. Only the UUID, the size and the number of entries are read from it. NULL = Trust the UUID and size stored in the cache
+ *   const TString sourceFile = Name of the forest file the cache should describe
+ *
+ *  return: True if the cache matches the forest file and the reader configuration, false otherwise
+ */
+Bool_t MonteCarloForestReader::ReadForestFromCache(ForestColumnCache* columnCache, TFile* forestFile, const TString sourceFile){
+  
+  // The cache must describe the same forest file and the same jet collection. If the forest file is given, it
+  // must also be the same version of the file.
+  if(!columnCache->MatchesConfiguration(sourceFile, fJetType)) return false;
+  if(forestFile){
+    TTree* jetTree = (TTree*)forestFile->Get(fJetTreeNames[fJetType]);
+    if(!jetTree) return false;
+    if(!columnCache->Matches(sourceFile, forestFile->GetUUID().AsString(), forestFile->GetSize(), jetTree->GetEntries(), fJetType)) return false;
+  }
+  
+  // Generator level particle charges are not stored in the cache
+  if(fBranchGroups.test(kGeneratorParticleCharge)){
+    cout << "Warning! Generator level particle charge is not stored in the column cache. Reading the forest instead." << endl;
+    return false;
+  }
+  
+  ReleaseTrees();
+  fColumnCache = columnCache;
+  
+  // Size the arrays according to the largest events in the cache
+  ResizeJetArrays(TMath::Max(fColumnCache->GetMaximumCount(ForestColumnCache::kReconstructedJets), 1), TMath::Max(fColumnCache->GetMaximumCount(ForestColumnCache::kGeneratorJets), 1), TMath::Max(fColumnCache->GetMaximumCount(ForestColumnCache::kCalorimeterJets), 1));
+  
+  // Generator level particles are copied to the storage vectors
+  fGenParticlePtArray = &fGenParticlePtStorage;
+  fGenParticlePhiArray = &fGenParticlePhiStorage;
+  fGenParticleEtaArray = &fGenParticleEtaStorage;
+  fGenParticleSubeventArray = &fGenParticleSubeventStorage;
+  fGenParticleChargeArray = NULL;
+  
+  fnJets = 0;
+  fnGenJets = 0;
+  fnCaloJets = 0;
+  fnGenParticles = 0;
+  
+  return true;
+}
+
+/*
+ * Write the currently loaded event to a column cache. All the branch groups stored in the cache must be read.
+ *
+ *  Arguments:
+ *   ForestColumnCache* columnCache = Column cache to which the event is written
+ */
+void MonteCarloForestReader::FillColumnCache(ForestColumnCache* columnCache) const{
+  
+  // Event information
+  columnCache->Fill(ForestColumnCache::kVz, &fVertexZ);
+  columnCache->Fill(ForestColumnCache::kHiBin, &fHiBin);
+  columnCache->Fill(ForestColumnCache::kPtHat, &fPtHat);
+  columnCache->Fill(ForestColumnCache::kEventWeight, &fEventWeight);
+  columnCache->Fill(ForestColumnCache::kPrimaryVertexFilterBit, &fPrimaryVertexFilterBit);
+  columnCache->Fill(ForestColumnCache::kHfCoincidenceFilterBit, &fHfCoincidenceFilterBit);
+  columnCache->Fill(ForestColumnCache::kClusterCompatibilityFilterBit, &fClusterCompatibilityFilterBit);
+  
+  // Reconstructed jets
+  columnCache->SetCount(ForestColumnCache::kReconstructedJets, fnJets);
+  columnCache->Fill(ForestColumnCache::kJetPt, fJetPtArray.data());
+  columnCache->Fill(ForestColumnCache::kJetPhi, fJetPhiArray.data());
+  columnCache->Fill(ForestColumnCache::kJetWTAPhi, fJetWTAPhiArray.data());
+  columnCache->Fill(ForestColumnCache::kJetEta, fJetEtaArray.data());
+  columnCache->Fill(ForestColumnCache::kJetWTAEta, fJetWTAEtaArray.data());
+  columnCache->Fill(ForestColumnCache::kJetRawPt, fJetRawPtArray.data());
+  columnCache->Fill(ForestColumnCache::kJetMaxTrackPt, fJetMaxTrackPtArray.data());
+  columnCache->Fill(ForestColumnCache::kJetRefPt, fJetRefPtArray.data());
+  columnCache->Fill(ForestColumnCache::kJetRefEta, fJetRefEtaArray.data());
+  columnCache->Fill(ForestColumnCache::kJetRefPhi, fJetRefPhiArray.data());
+  columnCache->Fill(ForestColumnCache::kJetRefFlavor, fJetRefFlavorArray.data());
+  
+  // Generator level jets
+  columnCache->SetCount(ForestColumnCache::kGeneratorJets, fnGenJets);
+  columnCache->Fill(ForestColumnCache::kGenJetPt, fGenJetPtArray.data());
+  columnCache->Fill(ForestColumnCache::kGenJetPhi, fGenJetPhiArray.data());
+  columnCache->Fill(ForestColumnCache::kGenJetWTAPhi, fGenJetWTAPhiArray.data());
+  columnCache->Fill(ForestColumnCache::kGenJetEta, fGenJetEtaArray.data());
+  columnCache->Fill(ForestColumnCache::kGenJetWTAEta, fGenJetWTAEtaArray.data());
+  
+  // Calorimeter jets
+  columnCache->SetCount(ForestColumnCache::kCalorimeterJets, fnCaloJets);
+  columnCache->Fill(ForestColumnCache::kCaloJetPt, fCaloJetPtArray.data());
+  columnCache->Fill(ForestColumnCache::kCaloJetPhi, fCaloJetPhiArray.data());
+  columnCache->Fill(ForestColumnCache::kCaloJetEta, fCaloJetEtaArray.data());
+  
+  // Generator level particles
+  columnCache->SetCount(ForestColumnCache::kGeneratorParticles, fnGenParticles);
+  columnCache->Fill(ForestColumnCache::kGenParticlePt, fGenParticlePtArray->data());
+  columnCache->Fill(ForestColumnCache::kGenParticlePhi, fGenParticlePhiArray->data());
+  columnCache->Fill(ForestColumnCache::kGenParticleEta, fGenParticleEtaArray->data());
+  columnCache->Fill(ForestColumnCache::kGenParticleSubevent, fGenParticleSubeventArray->data());
+  
+  columnCache->FinishEvent();
+}
+
+/*
+ * Staged loading from the column cache, stage 1: Copy the event information
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadEventInformationFromCache(Int_t iEvent){
+  fVertexZ = *fColumnCache->GetFloatValues(ForestColumnCache::kVz, iEvent);
+  fHiBin = *fColumnCache->GetIntValues(ForestColumnCache::kHiBin, iEvent);
+  fPtHat = *fColumnCache->GetFloatValues(ForestColumnCache::kPtHat, iEvent);
+  fEventWeight = *fColumnCache->GetFloatValues(ForestColumnCache::kEventWeight, iEvent);
+  fPrimaryVertexFilterBit = *fColumnCache->GetIntValues(ForestColumnCache::kPrimaryVertexFilterBit, iEvent);
+  fHfCoincidenceFilterBit = *fColumnCache->GetIntValues(ForestColumnCache::kHfCoincidenceFilterBit, iEvent);
+  fClusterCompatibilityFilterBit = *fColumnCache->GetIntValues(ForestColumnCache::kClusterCompatibilityFilterBit, iEvent);
+}
+
+/*
+ * Staged loading from the column cache, stage 2: Copy the jet multiplicities and jet pT:s
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadJetPtFromCache(Int_t iEvent){
+  fnJets = fColumnCache->GetCount(ForestColumnCache::kReconstructedJets, iEvent);
+  fnGenJets = fColumnCache->GetCount(ForestColumnCache::kGeneratorJets, iEvent);
+  fnCaloJets = fColumnCache->GetCount(ForestColumnCache::kCalorimeterJets, iEvent);
+  CopyFromCache(ForestColumnCache::kJetPt, iEvent, fnJets, fJetPtArray.data());
+  CopyFromCache(ForestColumnCache::kGenJetPt, iEvent, fnGenJets, fGenJetPtArray.data());
+  CopyFromCache(ForestColumnCache::kCaloJetPt, iEvent, fnCaloJets, fCaloJetPtArray.data());
+  
+  // Angles and raw pT for the jet energy correction of reconstructed jets
+  if(fBranchGroups.test(kJetEScheme)){
+    CopyFromCache(ForestColumnCache::kJetPhi, iEvent, fnJets, fJetPhiArray.data());
+    CopyFromCache(ForestColumnCache::kJetEta, iEvent, fnJets, fJetEtaArray.data());
+  }
+  if(fBranchGroups.test(kJetWTA)){
+    CopyFromCache(ForestColumnCache::kJetWTAPhi, iEvent, fnJets, fJetWTAPhiArray.data());
+    CopyFromCache(ForestColumnCache::kJetWTAEta, iEvent, fnJets, fJetWTAEtaArray.data());
+  }
+  if(fBranchGroups.test(kJetRawPt)) CopyFromCache(ForestColumnCache::kJetRawPt, iEvent, fnJets, fJetRawPtArray.data());
+  
+  // Angles for the jet energy correction of calorimeter jets
+  if(fBranchGroups.test(kCalorimeterJets)){
+    CopyFromCache(ForestColumnCache::kCaloJetPhi, iEvent, fnCaloJets, fCaloJetPhiArray.data());
+    CopyFromCache(ForestColumnCache::kCaloJetEta, iEvent, fnCaloJets, fCaloJetEtaArray.data());
+  }
+}
+
+/*
+ * Staged loading from the column cache, stage 3: Copy the remaining jet properties and the generator level particles.
+ * Only the columns of the enabled branch groups are copied.
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadFullEventFromCache(Int_t iEvent){
+  
+  // Reconstructed jets. The angles and raw pT are copied in stage 2.
+  if(fBranchGroups.test(kJetTrackMax)) CopyFromCache(ForestColumnCache::kJetMaxTrackPt, iEvent, fnJets, fJetMaxTrackPtArray.data());
+  if(fBranchGroups.test(kReferenceJets)){
+    CopyFromCache(ForestColumnCache::kJetRefPt, iEvent, fnJets, fJetRefPtArray.data());
+    CopyFromCache(ForestColumnCache::kJetRefEta, iEvent, fnJets, fJetRefEtaArray.data());
+    CopyFromCache(ForestColumnCache::kJetRefPhi, iEvent, fnJets, fJetRefPhiArray.data());
+    CopyFromCache(ForestColumnCache::kJetRefFlavor, iEvent, fnJets, fJetRefFlavorArray.data());
+  }
+  
+  // Generator level jets
+  if(fBranchGroups.test(kGeneratorJets)){
+    CopyFromCache(ForestColumnCache::kGenJetPhi, iEvent, fnGenJets, fGenJetPhiArray.data());
+    CopyFromCache(ForestColumnCache::kGenJetEta, iEvent, fnGenJets, fGenJetEtaArray.data());
+  }
+  if(fBranchGroups.test(kGeneratorJetWTA)){
+    CopyFromCache(ForestColumnCache::kGenJetWTAPhi, iEvent, fnGenJets, fGenJetWTAPhiArray.data());
+    CopyFromCache(ForestColumnCache::kGenJetWTAEta, iEvent, fnGenJets, fGenJetWTAEtaArray.data());
+  }
+  
+  // Generator level particles. The calorimeter jets are fully copied in stage 2.
+  LoadGenParticlesFromCache(iEvent);
+}
+
+/*
+ * Copy the generator level particles from the column cache, if the generator level particle branch group is enabled
+ *
+ *  Arguments:
+ *   Int_t iEvent = Index of the loaded event
+ */
+void MonteCarloForestReader::LoadGenParticlesFromCache(Int_t iEvent){
+  fnGenParticles = 0;
+  if(fBranchGroups.test(kGeneratorParticles)){
+    fnGenParticles = fColumnCache->GetCount(ForestColumnCache::kGeneratorParticles, iEvent);
+    const Float_t* particlePt = fColumnCache->GetFloatValues(ForestColumnCache::kGenParticlePt, iEvent);
+    const Float_t* particlePhi = fColumnCache->GetFloatValues(ForestColumnCache::kGenParticlePhi, iEvent);
+    const Float_t* particleEta = fColumnCache->GetFloatValues(ForestColumnCache::kGenParticleEta, iEvent);
+    const Int_t* particleSubevent = fColumnCache->GetIntValues(ForestColumnCache::kGenParticleSubevent, iEvent);
+    fGenParticlePtStorage.assign(particlePt, particlePt + fnGenParticles);
+    fGenParticlePhiStorage.assign(particlePhi, particlePhi + fnGenParticles);
+    fGenParticleEtaStorage.assign(particleEta, particleEta + fnGenParticles);
+    fGenParticleSubeventStorage.assign(particleSubevent, particleSubevent + fnGenParticles);
+  }
+}
+
+/*
+ * Copy the values of one column for an event from the column cache to a jet array
+ *
+ *  Arguments:
+ *   const Int_t column = Column in the cache
+ *   const Int_t iEvent = Index of the loaded event
+ *   const Int_t nValues = Number of values for the event
+ *   void* target = Jet array to which the values are copied
+ */
+void MonteCarloForestReader::CopyFromCache(const Int_t column, const Int_t iEvent, const Int_t nValues, void* target) const{
+  if(nValues > 0) memcpy(target, fColumnCache->GetIntValues(column, iEvent), sizeof(Int_t)*nValues);
+}
+
+/*
+ * Chain the forest trees of the given files for reading them with a data frame. The jet tree is the main tree, and
+ * the other trees are added as its friends with the aliases used in the column names from GetDataFrameColumn.
+ * The chains are owned by the caller.
+ *
+ *  Arguments:
+ *   const std::vector<TString>& fileNames = Files from which the trees are chained
+ *   std::vector<TChain*>& chains = Filled with the chains. The first one is the jet tree chain with the others as friends
+ */
+void MonteCarloForestReader::CreateForestChains(const std::vector<TString>& fileNames, std::vector<TChain*>& chains) const{
+  
+  const Int_t nTrees = 4;
+  const char* treeNames[nTrees] = {fJetTreeNames[fJetType], "hiEvtAnalyzer/HiTree", "skimanalysis/HltTree", "HiGenParticleAna/hi"};
+  const char* friendAliases[nTrees] = {"", "heavyIon", "skim", "particles"};
+  
+  chains.clear();
+  for(Int_t iTree = 0; iTree < nTrees; iTree++){
+    chains.push_back(new TChain(treeNames[iTree]));
+    for(const TString& fileName : fileNames) chains.back()->AddFile(fileName);
+    if(iTree > 0) chains.at(0)->AddFriend(chains.back(), friendAliases[iTree]);
+  }
+}
+
+/*
+ * Name of the branch of a cache column in the chains made by CreateForestChains
+ *
+ *  Arguments:
+ *   const Int_t column = Column from ForestColumnCache::enumCacheColumn
+ *
+ *  return: Name of the branch, or NULL if the branch group of the column is not read
+ */
+const char* MonteCarloForestReader::GetDataFrameColumn(const Int_t column) const{
+  if(fColumnBranchGroups[column] >= 0 && !fBranchGroups.test(fColumnBranchGroups[column])) return NULL;
+  return fDataFrameColumns[column];
+}
+
+/*
+ * Name of the branch giving the number of jets in a jet collection in the chains made by CreateForestChains
+ *
+ *  Arguments:
+ *   const Int_t collection = Jet collection from ForestColumnCache::enumCacheCollection
+ *
+ *  return: Name of the branch, or NULL if the collection is not read
+ */
+const char* MonteCarloForestReader::GetDataFrameCountColumn(const Int_t collection) const{
+  if(collection == ForestColumnCache::kReconstructedJets) return "nref";
+  if(collection == ForestColumnCache::kGeneratorJets && fBranchGroups.test(kGeneratorJets)) return "ngen";
+  if(collection == ForestColumnCache::kCalorimeterJets && fBranchGroups.test(kCalorimeterJets)) return "ncalo";
+  return NULL;
+}
+
+/*
+ * Prepare the reader for events given column by column from a data frame. No trees are connected to the reader,
+ * so the jet arrays can grow whenever an event has more jets than they can hold.
+ */
+void MonteCarloForestReader::ReadForestFromColumns(){
+  
+  ReleaseTrees();
+  ResizeJetArrays(1, 1, 1);
+  
+  // Generator level particles are copied to the storage vectors
+  fGenParticlePtArray = &fGenParticlePtStorage;
+  fGenParticlePhiArray = &fGenParticlePhiStorage;
+  fGenParticleEtaArray = &fGenParticleEtaStorage;
+  fGenParticleSubeventArray = &fGenParticleSubeventStorage;
+  fGenParticleChargeArray = NULL;
+  
+  fnJets = 0;
+  fnGenJets = 0;
+  fnCaloJets = 0;
+  fnGenParticles = 0;
+}
+
+/*
+ * Set the event information of the current event from the columns of a data frame
+ *
+ *  Arguments:
+ *   const Float_t vz = Vertex z position
+ *   const Int_t hiBin = CMS hiBin
+ *   const Float_t ptHat = pT hat
+ *   const Float_t eventWeight = Event weight
+ *   const Int_t primaryVertexFilterBit = Primary vertex filter bit
+ *   const Int_t hfCoincidenceFilterBit = Hadronic forward coincidence filter bit
+ *   const Int_t clusterCompatibilityFilterBit = Cluster compatibility filter bit
+ */
+void MonteCarloForestReader::LoadEventInformationFromColumns(const Float_t vz, const Int_t hiBin, const Float_t ptHat, const Float_t eventWeight, const Int_t primaryVertexFilterBit, const Int_t hfCoincidenceFilterBit, const Int_t clusterCompatibilityFilterBit){
+  fVertexZ = vz;
+  fHiBin = hiBin;
+  fPtHat = ptHat;
+  fEventWeight = eventWeight;
+  fPrimaryVertexFilterBit = primaryVertexFilterBit;
+  fHfCoincidenceFilterBit = hfCoincidenceFilterBit;
+  fClusterCompatibilityFilterBit = clusterCompatibilityFilterBit;
+}
+
+/*
+ * Set the number of jets in a jet collection for the current event. The arrays of the collection grow if needed,
+ * keeping the values already copied, so the collections can be set in any order.
+ *
+ *  Arguments:
+ *   const Int_t collection = Jet collection from ForestColumnCache::enumCacheCollection
+ *   const Int_t count = Number of jets in the collection
+ */
+void MonteCarloForestReader::SetCollectionSize(const Int_t collection, const Int_t count){
+  
+  if(collection == ForestColumnCache::kReconstructedJets){
+    fnJets = count;
+    if(count <= (Int_t)fJetRawPtArray.size()) return;
+    fJetPtArray.resize(count, 0);
+    fJetPhiArray.resize(count, 0);
+    fJetWTAPhiArray.resize(count, 0);
+    fJetEtaArray.resize(count, 0);
+    fJetWTAEtaArray.resize(count, 0);
+    fJetRawPtArray.resize(count, 0);
+    fJetMaxTrackPtArray.resize(count, -1);
+    fJetRefPtArray.resize(count, 0);
+    fJetRefEtaArray.resize(count, 0);
+    fJetRefPhiArray.resize(count, 0);
+    fJetRefFlavorArray.resize(count, 0);
+  } else if(collection == ForestColumnCache::kGeneratorJets){
+    fnGenJets = count;
+    if(count <= (Int_t)fGenJetPtArray.size()) return;
+    fGenJetPtArray.resize(count, 0);
+    fGenJetPhiArray.resize(count, 0);
+    fGenJetWTAPhiArray.resize(count, 0);
+    fGenJetEtaArray.resize(count, 0);
+    fGenJetWTAEtaArray.resize(count, 0);
+  } else if(collection == ForestColumnCache::kCalorimeterJets){
+    fnCaloJets = count;
+    if(count <= (Int_t)fCaloJetPtArray.size()) return;
+    fCaloJetPtArray.resize(count, 0);
+    fCaloJetPhiArray.resize(count, 0);
+    fCaloJetEtaArray.resize(count, 0);
+  }
+}
+
+/*
+ * Copy the values of one column for the current event from a data frame to the reader. For the jet columns, the
+ * size of the collection needs to be set first with SetCollectionSize. The generator level particle columns set the
+ * number of particles.
+ *
+ *  Arguments:
+ *   const Int_t column = Column from ForestColumnCache::enumCacheColumn
+ *   const Int_t nValues = Number of values in the column for the current event
+ *   const void* values = Values of the column. Each value has 4 bytes, either Float_t or Int_t
+ */
+void MonteCarloForestReader::LoadColumnValues(const Int_t column, const Int_t nValues, const void* values){
+  
+  // Generator level particles
+  const Float_t* floatValues = (const Float_t*)values;
+  const Int_t* intValues = (const Int_t*)values;
+  switch(column){
+    case ForestColumnCache::kGenParticlePt:
+      fGenParticlePtStorage.assign(floatValues, floatValues + nValues);
+      fnGenParticles = nValues;
+      return;
+    case ForestColumnCache::kGenParticlePhi:
+      fGenParticlePhiStorage.assign(floatValues, floatValues + nValues);
+      return;
+    case ForestColumnCache::kGenParticleEta:
+      fGenParticleEtaStorage.assign(floatValues, floatValues + nValues);
+      return;
+    case ForestColumnCache::kGenParticleSubevent:
+      fGenParticleSubeventStorage.assign(intValues, intValues + nValues);
+      return;
+  }
+  
+  // Jets. The arrays of the collection of the column are sized with SetCollectionSize.
+  Int_t arraySize = fCaloJetPtArray.size();
+  if(column <= ForestColumnCache::kJetRefFlavor){
+    arraySize = fJetRawPtArray.size();
+  } else if(column <= ForestColumnCache::kGenJetWTAEta){
+    arraySize = fGenJetPtArray.size();
+  }
+  if(nValues > arraySize){
+    cout << "Error! Column " << column << " has " << nValues << " values, but the collection size is " << arraySize << endl;
+    assert(0);
+  }
+  if(nValues > 0) memcpy(GetColumnArray(column), values, sizeof(Int_t)*nValues);
+}
+
+/*
+ * Jet array to which the values of a cache column are copied
+ *
+ *  Arguments:
+ *   const Int_t column = Jet column from ForestColumnCache::enumCacheColumn
+ *
+ *  return: Pointer to the beginning of the array
+ */
+void* MonteCarloForestReader::GetColumnArray(const Int_t column){
+  switch(column){
+    case ForestColumnCache::kJetPt: return fJetPtArray.data();
+    case ForestColumnCache::kJetPhi: return fJetPhiArray.data();
+    case ForestColumnCache::kJetWTAPhi: return fJetWTAPhiArray.data();
+    case ForestColumnCache::kJetEta: return fJetEtaArray.data();
+    case ForestColumnCache::kJetWTAEta: return fJetWTAEtaArray.data();
+    case ForestColumnCache::kJetRawPt: return fJetRawPtArray.data();
+    case ForestColumnCache::kJetMaxTrackPt: return fJetMaxTrackPtArray.data();
+    case ForestColumnCache::kJetRefPt: return fJetRefPtArray.data();
+    case ForestColumnCache::kJetRefEta: return fJetRefEtaArray.data();
+    case ForestColumnCache::kJetRefPhi: return fJetRefPhiArray.data();
+    case ForestColumnCache::kJetRefFlavor: return fJetRefFlavorArray.data();
+    case ForestColumnCache::kGenJetPt: return fGenJetPtArray.data();
+    case ForestColumnCache::kGenJetPhi: return fGenJetPhiArray.data();
+    case ForestColumnCache::kGenJetWTAPhi: return fGenJetWTAPhiArray.data();
+    case ForestColumnCache::kGenJetEta: return fGenJetEtaArray.data();
+    case ForestColumnCache::kGenJetWTAEta: return fGenJetWTAEtaArray.data();
+    case ForestColumnCache::kCaloJetPt: return fCaloJetPtArray.data();
+    case ForestColumnCache::kCaloJetPhi: return fCaloJetPhiArray.data();
+    case ForestColumnCache::kCaloJetEta: return fCaloJetEtaArray.data();
+  }
+  cout << "Error! Column " << column << " is not a jet column!" << endl;
+  assert(0);
+  return NULL;
 }
 
 // Getter for number of events in the tree
 Int_t MonteCarloForestReader::GetNEvents() const{
-  return fJetPtBranch->GetEntries();
+  if(fColumnCache) return fColumnCache->GetNEntries();
+  return fJetTree->GetEntries();
 }
 
 // Getter for number of jets
@@ -1218,6 +2392,33 @@ Int_t MonteCarloForestReader::GetGenParticleSubevent(Int_t iTrack) const{
   return fGenParticleSubeventArray->at(iTrack);
 }
 
+/*
+ * Non-owning view to the generator level particle pT:s. The view points directly to the memory where the
+ * branch is read, so no copies are made. It is valid until the next event is loaded.
+ */
+const ROOT::RVec<Float_t> MonteCarloForestReader::GetGenParticlePtView() const{
+  if(!fGenParticlePtArray) return ROOT::RVec<Float_t>();
+  return ROOT::RVec<Float_t>(fGenParticlePtArray->data(), fnGenParticles);
+}
+
+// Non-owning view to the generator level particle phis
+const ROOT::RVec<Float_t> MonteCarloForestReader::GetGenParticlePhiView() const{
+  if(!fGenParticlePhiArray) return ROOT::RVec<Float_t>();
+  return ROOT::RVec<Float_t>(fGenParticlePhiArray->data(), fnGenParticles);
+}
+
+// Non-owning view to the generator level particle etas
+const ROOT::RVec<Float_t> MonteCarloForestReader::GetGenParticleEtaView() const{
+  if(!fGenParticleEtaArray) return ROOT::RVec<Float_t>();
+  return ROOT::RVec<Float_t>(fGenParticleEtaArray->data(), fnGenParticles);
+}
+
+// Non-owning view to the generator level particle subevent indices
+const ROOT::RVec<Int_t> MonteCarloForestReader::GetGenParticleSubeventView() const{
+  if(!fGenParticleSubeventArray) return ROOT::RVec<Int_t>();
+  return ROOT::RVec<Int_t>(fGenParticleSubeventArray->data(), fnGenParticles);
+}
+
 // Getter for reconstructed jet flavor
 Int_t MonteCarloForestReader::GetRecoJetFlavor(Int_t iJet) const{
   return fJetRefFlavorArray[iJet];
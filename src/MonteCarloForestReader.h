@@ -13,29 +13,44 @@
 #include <iostream>
 #include <assert.h>
 #include <vector>
+#include <bitset>
+#include <algorithm>
+#include <cstring>
 
 // Root includes
 #include <TString.h>
+#include <ROOT/RVec.hxx>
 #include <TTree.h>
 #include <TChain.h>
+#include <TEntryList.h>
 #include <TBranch.h>
 #include <TFile.h>
+#include <TLeaf.h>
+#include <TMath.h>
 
 // Own includes
 #include "JetBackgroundHistograms.h"
+#include "EventView.h"
+#include "ForestColumnCache.h"
 
 using namespace std;
 
 class MonteCarloForestReader{
   
 private:
-  static const Int_t fnMaxJet = 250;        // Maximum number of jets in an event
+  static const Int_t fnGenParticleReserve = 50000; // Number of generator level particles for which memory is reserved in the beginning
+  static const char* fJetTreeNames[3];             // Names of the jet trees for each jet collection
+  static const char* fDataFrameColumns[ForestColumnCache::knCacheColumns]; // Names of the branches of the cache columns in the chains for a data frame
+  static const Int_t fColumnBranchGroups[ForestColumnCache::knCacheColumns]; // Branch group of each cache column. -1 if the column is always read
   
 public:
   
   // Possible data types to be read with the reader class
   enum enumJetType {kReconstructedJet, kGeneratorLevelJet, knJetTypes};
   
+  // Groups of branches that can be enabled or pruned from reading depending on the analysis configuration
+  enum enumBranchGroup {kForestJetPt, kJetEScheme, kJetWTA, kJetRawPt, kJetTrackMax, kReferenceJets, kGeneratorJets, kGeneratorJetWTA, kCalorimeterJets, kGeneratorParticles, kGeneratorParticleCharge, knBranchGroups};
+  
   // Constructors and destructors
   MonteCarloForestReader();                                              // Default constructor
   MonteCarloForestReader(Int_t jetType, Int_t jetAxis);                  // Custom constructor
@@ -45,10 +60,35 @@ public:
   
   // Methods
   void GetEvent(Int_t iEvent);                 // Get the i:th event in tree
+  void LoadEventInformation(Int_t iEvent);     // Staged loading, stage 1: Load only the event information and the filter bits for the i:th event
+  void LoadJetPt(Int_t iEvent);                // Staged loading, stage 2: Load only the jet multiplicities, pT:s and what is needed for their correction for the i:th event
+  void LoadFullEvent(Int_t iEvent);            // Staged loading, stage 3: Load all the remaining jet and particle information for the i:th event
+  void FillEventInformation(EventView* eventView) const; // Copy the event information of the loaded event to an event view
+  void FillEventCollections(EventView* eventView, const Bool_t copyParticles = false) const; // Copy the jet collections of the loaded event to an event view and give the particles to it
+  void LoadGenParticles(Int_t iEvent);         // Load only the generator level particles for the i:th event
+  void FillEventParticles(EventView* eventView, const Bool_t copyParticles = false) const; // Give the generator level particles of the loaded event to an event view
   Int_t GetNEvents() const;                    // Get the number of events
   void ReadForestFromFile(TFile *inputFile);   // Read the forest from a file
   void ReadForestFromFileList(std::vector<TString> fileList);   // Read the forest from a file list
-  void BurnForest();                           // Burn the forest
+  Bool_t ReadForestFromCache(ForestColumnCache* columnCache, TFile* forestFile, const TString sourceFile); // Read the events from a column cache instead of the forest
+  void FillColumnCache(ForestColumnCache* columnCache) const;   // Write the loaded event to a column cache
+  void BurnForest();                           // Release the trees, read caches and the file owned by the reader
+  void SetReadCacheSize(Long64_t cacheSize);   // Set the size of the read cache used for each tree
+  void SetAlignedReading(Bool_t alignedReading); // Set the flag for reading all trees as friends of the jet tree
+  void SetEntryList(const std::vector<Long64_t>& entries); // Restrict the read caches to the given entries of the current file
+  void SetBranchGroups(std::bitset<knBranchGroups> branchGroups); // Set the groups of branches that are read from the forest
+  std::bitset<knBranchGroups> GetBranchGroups() const;            // Getter for the groups of branches that are read from the forest
+  void PrintPrunedBranches() const;            // Print the branches that are not read from the current forest
+  TString CheckForestFile(TFile* inputFile, Long64_t& nEntries, Long64_t& zipBytes, Int_t& nClusters, Double_t& meanParticles, std::vector<Long64_t>* clusterStarts = NULL) const; // Check that a file has everything needed to read it
+  
+  // Methods for reading the events from the columns of a data frame
+  void CreateForestChains(const std::vector<TString>& fileNames, std::vector<TChain*>& chains) const; // Chain the forest trees for a data frame, with the other trees as friends of the jet tree
+  const char* GetDataFrameColumn(const Int_t column) const;          // Name of the branch of a cache column in the forest chains. NULL if the branch is not read
+  const char* GetDataFrameCountColumn(const Int_t collection) const; // Name of the branch giving the size of a jet collection. NULL if the branch is not read
+  void ReadForestFromColumns();                                      // Take the events from the columns of a data frame instead of the forest
+  void LoadEventInformationFromColumns(const Float_t vz, const Int_t hiBin, const Float_t ptHat, const Float_t eventWeight, const Int_t primaryVertexFilterBit, const Int_t hfCoincidenceFilterBit, const Int_t clusterCompatibilityFilterBit); // Set the event information of the current event
+  void SetCollectionSize(const Int_t collection, const Int_t count); // Set the number of jets in a collection for the current event
+  void LoadColumnValues(const Int_t column, const Int_t nValues, const void* values); // Copy the values of a column for the current event
   
   // Getters for leaves in heavy ion tree
   Float_t GetVz() const;              // Getter for vertex z position
@@ -146,9 +186,35 @@ private:
   
   // Methods
   void Initialize();      // Connect the branches to the tree
+  void ConfigureReadCache(TTree* tree, std::vector<TBranch*> cachedBranches); // Set up the read cache for the connected branches of a tree
+  void AlignTrees();      // Check that the trees are aligned and join them as friends of the jet tree
+  void ReleaseTrees();    // Disconnect the reader from the trees of the current file
+  void ReleaseEntryLists(); // Detach the entry lists from the trees and delete them
+  void LoadBranches(TTree* tree, const std::vector<TBranch*>& branches, Int_t iEvent); // Load the i:th entry for the given branches of a tree
+  void PruneBranches(TTree* tree, std::vector<const char*> branchNames); // Book keeping for branches that are not read
+  void ResizeJetArrays(const Int_t nMaxJets, const Int_t nMaxGenJets, const Int_t nMaxCaloJets);  // Size the jet arrays according to the largest number of jets in an event in the current file
+  void LoadEventInformationFromCache(Int_t iEvent); // Copy the event information from the column cache
+  void LoadJetPtFromCache(Int_t iEvent);            // Copy the jet multiplicities, pT:s and angles from the column cache
+  void LoadFullEventFromCache(Int_t iEvent);        // Copy the remaining jet and particle information from the column cache
+  void LoadGenParticlesFromCache(Int_t iEvent);     // Copy the generator level particles from the column cache
+  void CopyFromCache(const Int_t column, const Int_t iEvent, const Int_t nValues, void* target) const; // Copy the values of one column to a jet array
+  void* GetColumnArray(const Int_t column);         // Jet array to which the values of a column are copied
+  Int_t GetMaximumCount(TTree* tree, const char* leafName) const; // Get the maximum value of a counter leaf in a tree
+  const ROOT::RVec<Float_t> GetGenParticlePtView() const;    // Non-owning view to generator level particle pT:s, valid until the next event is loaded
+  const ROOT::RVec<Float_t> GetGenParticlePhiView() const;   // Non-owning view to generator level particle phis
+  const ROOT::RVec<Float_t> GetGenParticleEtaView() const;   // Non-owning view to generator level particle etas
+  const ROOT::RVec<Int_t> GetGenParticleSubeventView() const; // Non-owning view to generator level particle subevent indices
     
   Int_t fJetType;         // Choose the type of jets used for analysis. 0 = Calo PU jets, 1 = PF CS jets, 2 = Flow subtracted Pf CS jets
   Int_t fJetAxis;         // Jet axis used for the jets. 0 = Anti-kT, 1 = WTA
+  Long64_t fReadCacheSize; // Size of the read cache in bytes for each tree. 0 = No read cache
+  Bool_t fAlignedReading;  // Flag for reading all trees as friends of the jet tree with a single entry load
+  std::bitset<knBranchGroups> fBranchGroups; // Groups of branches that are read from the forest
+  std::vector<TString> fPrunedBranches;      // Names of the branches in the current forest that are not read
+  Long64_t fPrunedZipBytes;                  // Compressed size of the baskets in the pruned branches
+  ForestColumnCache* fColumnCache;           // Column cache from which the events are read. NULL when reading the forest trees
+  TFile* fInputFile;                         // File opened by the reader in ReadForestFromFileList. NULL if the file is owned by the caller
+  std::vector<TEntryList*> fEntryLists;      // Entry lists restricting the read caches of the trees. Empty if all entries are cached
   
   // Trees in the forest
   TTree* fHeavyIonTree;    // Tree for heavy ion event information
@@ -220,6 +286,13 @@ private:
   TBranch* fGenParticleEtaBranch;       // Branch for generator level particle etas
   TBranch* fGenParticleChargeBranch;    // Branch for generator level particle charges
   TBranch* fGenParticleSubeventBranch;  // Branch for generator level particle subevent indices (0 = PYTHIA, (>0) = HYDJET)
+  
+  // Connected branches grouped by tree and loading stage
+  std::vector<TBranch*> fHeavyIonBranches;    // Connected branches in the heavy ion tree
+  std::vector<TBranch*> fSkimBranches;        // Connected branches in the skim tree
+  std::vector<TBranch*> fJetPtBranches;       // Jet multiplicity, pT and angle branches in the jet tree needed for the jet pT cuts
+  std::vector<TBranch*> fJetBranches;         // All the other connected branches in the jet tree
+  std::vector<TBranch*> fGenParticleBranches; // Connected branches in the generator level particle tree
 
   // Leaves for heavy ion tree
   Float_t fVertexZ;    // Vertex z-position
@@ -237,28 +310,29 @@ private:
   Int_t fnCaloJets;      // Number of calo jets in an event
   Float_t fEventWeight;  // jet weight in the MC tree
   
-  Float_t fJetPtArray[fnMaxJet] = {0};         // pT:s of all the jets in an event
-  Float_t fJetPhiArray[fnMaxJet] = {0};        // phis of all the jets in an event
-  Float_t fJetWTAPhiArray[fnMaxJet] = {0};     // WTA phis of all the jets in an event
-  Float_t fJetEtaArray[fnMaxJet] = {0};        // etas of all the jets in an event
-  Float_t fJetWTAEtaArray[fnMaxJet] = {0};     // WTA etas of all the jets in an event
-  Float_t fJetRawPtArray[fnMaxJet] = {0};      // raw jet pT for all the jets in an event
-  Float_t fJetMaxTrackPtArray[fnMaxJet] = {0}; // maximum track pT inside a jet for all the jets in an event
+  // Jet arrays are sized separately for each file based on the maximum number of jets in any event in the file
+  std::vector<Float_t> fJetPtArray;            // pT:s of all the jets in an event
+  std::vector<Float_t> fJetPhiArray;           // phis of all the jets in an event
+  std::vector<Float_t> fJetWTAPhiArray;        // WTA phis of all the jets in an event
+  std::vector<Float_t> fJetEtaArray;           // etas of all the jets in an event
+  std::vector<Float_t> fJetWTAEtaArray;        // WTA etas of all the jets in an event
+  std::vector<Float_t> fJetRawPtArray;         // raw jet pT for all the jets in an event
+  std::vector<Float_t> fJetMaxTrackPtArray;    // maximum track pT inside a jet for all the jets in an event
    
-  Float_t fJetRefPtArray[fnMaxJet] = {0};      // reference generator level pT for a reconstructed jet
-  Float_t fJetRefEtaArray[fnMaxJet] = {0};     // reference generator level eta for a reconstructed jet
-  Float_t fJetRefPhiArray[fnMaxJet] = {0};     // reference generator level phi for a reconstructed jet
-  Int_t fJetRefFlavorArray[fnMaxJet] = {0};    // flavor for initiating parton for the reference gen jet
+  std::vector<Float_t> fJetRefPtArray;         // reference generator level pT for a reconstructed jet
+  std::vector<Float_t> fJetRefEtaArray;        // reference generator level eta for a reconstructed jet
+  std::vector<Float_t> fJetRefPhiArray;        // reference generator level phi for a reconstructed jet
+  std::vector<Int_t> fJetRefFlavorArray;       // flavor for initiating parton for the reference gen jet
 
-  Float_t fGenJetPtArray[fnMaxJet] = {0};       // pT:s of the generator level jets in an event
-  Float_t fGenJetPhiArray[fnMaxJet] = {0};      // phis of the generator level jets in an event
-  Float_t fGenJetWTAPhiArray[fnMaxJet] = {0};   // WTA phis of the generator level jets in an event
-  Float_t fGenJetEtaArray[fnMaxJet] = {0};      // etas of the generator level jets in an event
-  Float_t fGenJetWTAEtaArray[fnMaxJet] = {0};   // WTA etas of the generator level jets in an event
+  std::vector<Float_t> fGenJetPtArray;          // pT:s of the generator level jets in an event
+  std::vector<Float_t> fGenJetPhiArray;         // phis of the generator level jets in an event
+  std::vector<Float_t> fGenJetWTAPhiArray;      // WTA phis of the generator level jets in an event
+  std::vector<Float_t> fGenJetEtaArray;         // etas of the generator level jets in an event
+  std::vector<Float_t> fGenJetWTAEtaArray;      // WTA etas of the generator level jets in an event
 
-  Float_t fCaloJetPtArray[fnMaxJet] = {0};      // pT:s of the calorimeter jets in an event
-  Float_t fCaloJetPhiArray[fnMaxJet] = {0};     // phis of the calorimeter jets in an event
-  Float_t fCaloJetEtaArray[fnMaxJet] = {0};     // etas of the calorimeter jets in an event
+  std::vector<Float_t> fCaloJetPtArray;         // pT:s of the calorimeter jets in an event
+  std::vector<Float_t> fCaloJetPhiArray;        // phis of the calorimeter jets in an event
+  std::vector<Float_t> fCaloJetEtaArray;        // etas of the calorimeter jets in an event
   
   // Leaves for the track tree regardless of forest type
   Int_t fnTracks;  // Number of tracks
@@ -287,6 +361,13 @@ private:
   vector<float>* fGenParticleEtaArray;     // Array for generator level particle etas
   vector<int>* fGenParticleChargeArray;    // Array for generator level particle charges
   vector<int>* fGenParticleSubeventArray;  // Array for generator level particle subevent indices (0 = PYTHIA, (>0) = HYDJET)
+  
+  // Storage for the generator level particle arrays. The branches are read into these, such that the memory is reused between events
+  vector<float> fGenParticlePtStorage;     // Storage for generator level particle pT:s
+  vector<float> fGenParticlePhiStorage;    // Storage for generator level particle phis
+  vector<float> fGenParticleEtaStorage;    // Storage for generator level particle etas
+  vector<int> fGenParticleChargeStorage;   // Storage for generator level particle charges
+  vector<int> fGenParticleSubeventStorage; // Storage for generator level particle subevent indices
 };
 
 #endif
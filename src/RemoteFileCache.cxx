@@ -0,0 +1,318 @@
+// Local disk cache for input files read over xrootd
+
+// Own includes
+#include "RemoteFileCache.h"
+
+/*
+ * Custom constructor
+ *
+ *  Arguments:
+ *   const TString cacheDirectory = Directory where the local copies are kept
+ *   const Long64_t maxCacheSizeMB = Maximum total size of the local copies in MB
+ *   const Int_t readAheadFiles = Number of files downloaded ahead of the file that is currently needed
+ *   const Bool_t revalidate = True: Check the size and UUID of the remote file before a local copy is used. False: Use local copies without contacting the remote server
+ */
+RemoteFileCache::RemoteFileCache(const TString cacheDirectory, const Long64_t maxCacheSizeMB, const Int_t readAheadFiles, const Bool_t revalidate) :
+  fCacheDirectory(cacheDirectory),
+  fMaxCacheSize(maxCacheSizeMB*1024*1024),
+  fReadAheadFiles(TMath::Max(readAheadFiles, 1)),
+  fRevalidate(revalidate),
+  fFileNames(),
+  fLocalFileNames(),
+  fDownloadDone(),
+  fnRequestedFiles(0),
+  fStopDownloads(false),
+  fMutex(),
+  fCondition(),
+  fDownloadThread()
+{
+  // Custom constructor
+  gSystem->mkdir(fCacheDirectory, kTRUE);
+}
+
+/*
+ * Destructor
+ */
+RemoteFileCache::~RemoteFileCache(){
+  // destructor
+
+  // A download that is already running is finished, but no new downloads are started
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStopDownloads = true;
+  }
+  fCondition.notify_all();
+  if(fDownloadThread.joinable()) fDownloadThread.join();
+}
+
+/*
+ * Start downloading the files in the background in the given order
+ *
+ *  Arguments:
+ *   const std::vector<TString> fileNames = Names of the files in the order they are needed
+ */
+void RemoteFileCache::StartDownloads(const std::vector<TString> fileNames){
+
+  if(fDownloadThread.joinable()){
+    cout << "Error! The downloads for the remote file cache are already started." << endl;
+    assert(0);
+  }
+
+  fFileNames = fileNames;
+  fLocalFileNames.assign(fileNames.size(), "");
+  fDownloadDone.assign(fileNames.size(), false);
+  fnRequestedFiles = 0;
+
+  // The files are opened in the background thread, so ROOT needs to protect its global state
+  ROOT::EnableThreadSafety();
+  fDownloadThread = std::thread(&RemoteFileCache::DownloadFiles, this);
+}
+
+/*
+ * Get the name from which the file should be opened. For files in the download list this waits until the download
+ * of the file is finished. Files that are not in the list are copied right away.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the needed file
+ *
+ *  return: Name of the local copy of the file, or the original name if the file is local or could not be copied
+ */
+TString RemoteFileCache::GetLocalFile(const TString fileName){
+
+  if(!IsRemoteFile(fileName)) return fileName;
+
+  TString localFileName;
+  std::vector<TString>::iterator listPosition = std::find(fFileNames.begin(), fFileNames.end(), fileName);
+  if(listPosition == fFileNames.end()){
+    localFileName = DownloadFile(fileName);
+  } else {
+
+    // Let the background thread know that this file is needed now and wait for the download
+    const Int_t iFile = listPosition - fFileNames.begin();
+    std::unique_lock<std::mutex> lock(fMutex);
+    fnRequestedFiles = TMath::Max(fnRequestedFiles, iFile+1);
+    fCondition.notify_all();
+    fCondition.wait(lock, [this, iFile]{ return (Bool_t)fDownloadDone.at(iFile); });
+    localFileName = fLocalFileNames.at(iFile);
+  }
+
+  // Use the remote file if there is no local copy
+  if(localFileName == "" || gSystem->AccessPathName(localFileName)) return fileName;
+  return localFileName;
+}
+
+/*
+ * Download the files in the list until all are downloaded or the cache is deleted. The downloads are kept at most
+ * fReadAheadFiles files ahead of the latest requested file, such that files that are still needed are not evicted
+ * to make space for files that are needed much later.
+ */
+void RemoteFileCache::DownloadFiles(){
+
+  TString localFileName;
+  for(Int_t iFile = 0; iFile < (Int_t)fFileNames.size(); iFile++){
+
+    // Wait until the file is close enough to the requested files
+    {
+      std::unique_lock<std::mutex> lock(fMutex);
+      fCondition.wait(lock, [this, iFile]{ return fStopDownloads || iFile < fnRequestedFiles + fReadAheadFiles; });
+      if(fStopDownloads) break;
+    }
+
+    localFileName = IsRemoteFile(fFileNames.at(iFile)) ? DownloadFile(fFileNames.at(iFile)) : "";
+
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fLocalFileNames.at(iFile) = localFileName;
+      fDownloadDone.at(iFile) = true;
+    }
+    fCondition.notify_all();
+  }
+
+  // If the downloads were stopped, nobody waits for the remaining files anymore, but mark them done for consistency
+  std::lock_guard<std::mutex> lock(fMutex);
+  fDownloadDone.assign(fDownloadDone.size(), true);
+}
+
+/*
+ * Make a local copy of a remote file unless there is a matching copy already. The remote file is only opened if
+ * there is no complete copy, or if revalidation is requested. The copy is first written to a temporary file and
+ * renamed when it is complete, and the info file is written last, such that an interrupted download is never used.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the remote file
+ *
+ *  return: Name of the local copy. Empty string if the file could not be copied
+ */
+TString RemoteFileCache::DownloadFile(const TString fileName){
+
+  const TString cacheFileName = GetCacheFileName(fileName);
+  const TString infoFileName = GetInfoFileName(cacheFileName);
+
+  // Read the size and UUID of the remote file at the time the copy was made
+  Long64_t cachedSize = -1;
+  TString cachedUUID = "";
+  std::ifstream infoFile(infoFileName.Data());
+  if(infoFile.is_open()){
+    std::string uuidString;
+    if(infoFile >> cachedSize >> uuidString) cachedUUID = uuidString.c_str();
+    else cachedSize = -1;
+  }
+  infoFile.close();
+
+  // A copy is complete if its size matches the stored size of the remote file
+  FileStat_t fileInfo;
+  const Bool_t hasCopy = cachedSize >= 0 && gSystem->GetPathInfo(cacheFileName, fileInfo) == 0 && fileInfo.fSize == cachedSize;
+
+  // Without revalidation a complete copy is used without contacting the remote server. If the remote server cannot
+  // be reached for revalidation, the existing copy is used.
+  Long64_t fileSize = cachedSize;
+  TString uuid = cachedUUID;
+  if(!hasCopy || fRevalidate){
+    if(!ReadRemoteFileInfo(fileName, fileSize, uuid)) return hasCopy ? cacheFileName : "";
+  }
+
+  // If there is a matching copy, mark it as recently used
+  if(hasCopy && fileSize == cachedSize && uuid == cachedUUID){
+    gSystem->Utime(cacheFileName, time(NULL), 0);
+    return cacheFileName;
+  }
+
+  // Remove an outdated copy before downloading the new one
+  gSystem->Unlink(infoFileName);
+  gSystem->Unlink(cacheFileName);
+
+  // Files that do not fit to the cache are streamed
+  if(fileSize > fMaxCacheSize) return "";
+  EvictFiles(fileSize);
+
+  // Copy the file in large blocks to a temporary file that is renamed when the copy is complete
+  const TString temporaryFileName = Form("%s.part%d", cacheFileName.Data(), gSystem->GetPid());
+  const UInt_t copyBufferSize = 8*1024*1024;
+  if(!TFile::Cp(fileName, temporaryFileName, kFALSE, copyBufferSize) || gSystem->GetPathInfo(temporaryFileName, fileInfo) != 0 || fileInfo.fSize != fileSize){
+    cout << "Warning! Could not copy " << fileName.Data() << " to the remote file cache. Reading it over the network." << endl;
+    gSystem->Unlink(temporaryFileName);
+    return "";
+  }
+  gSystem->Rename(temporaryFileName, cacheFileName);
+
+  // Store the size and UUID of the remote file next to the copy
+  std::ofstream outputInfoFile(infoFileName.Data());
+  outputInfoFile << fileSize << " " << uuid.Data() << endl;
+  outputInfoFile.close();
+  if(outputInfoFile.fail()){
+    cout << "Warning! Could not write the info file for " << cacheFileName.Data() << ". The copy is downloaded again in the next run." << endl;
+    gSystem->Unlink(infoFileName);
+  }
+
+  return cacheFileName;
+}
+
+/*
+ * Read the size and UUID of a remote file from the file header
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the remote file
+ *   Long64_t& fileSize = Size of the remote file in bytes
+ *   TString& uuid = UUID of the remote file
+ *
+ *  return: True if the remote file could be opened
+ */
+Bool_t RemoteFileCache::ReadRemoteFileInfo(const TString fileName, Long64_t& fileSize, TString& uuid) const{
+  TFile* remoteFile = TFile::Open(fileName);
+  if(!remoteFile || !remoteFile->IsOpen() || remoteFile->IsZombie()){
+    if(remoteFile) delete remoteFile;
+    return false;
+  }
+  fileSize = remoteFile->GetSize();
+  uuid = remoteFile->GetUUID().AsString();
+  remoteFile->Close();
+  delete remoteFile;
+  return true;
+}
+
+/*
+ * Delete the least recently used files from the cache directory until a new file of the given size fits to the
+ * size limit. The current file and the files downloaded ahead of it are never deleted.
+ *
+ *  Arguments:
+ *   const Long64_t neededBytes = Size of the file that is added to the cache
+ */
+void RemoteFileCache::EvictFiles(const Long64_t neededBytes){
+
+  // Files that are still needed in this run
+  std::vector<TString> protectedFiles;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for(Int_t iFile = TMath::Max(fnRequestedFiles-1, 0); iFile < (Int_t)fLocalFileNames.size(); iFile++){
+      if(fLocalFileNames.at(iFile) != "") protectedFiles.push_back(fLocalFileNames.at(iFile));
+    }
+  }
+
+  // Collect the complete copies in the cache directory together with their last use time
+  std::vector<std::pair<Long_t,TString>> cachedFiles;
+  Long64_t cacheSize = 0;
+  FileStat_t fileInfo;
+  TString entryName;
+  void* directory = gSystem->OpenDirectory(fCacheDirectory);
+  if(!directory) return;
+  const char* entry;
+  while((entry = gSystem->GetDirEntry(directory)) != NULL){
+    entryName = entry;
+    if(!entryName.EndsWith(".root")) continue;
+    entryName.Prepend(fCacheDirectory + "/");
+    if(gSystem->GetPathInfo(entryName, fileInfo) != 0) continue;
+    cacheSize += fileInfo.fSize;
+    if(std::find(protectedFiles.begin(), protectedFiles.end(), entryName) != protectedFiles.end()) continue;
+    cachedFiles.push_back(std::make_pair(fileInfo.fMtime, entryName));
+  }
+  gSystem->FreeDirectory(directory);
+
+  // Delete the oldest files first
+  std::sort(cachedFiles.begin(), cachedFiles.end());
+  for(std::pair<Long_t,TString> cachedFile : cachedFiles){
+    if(cacheSize + neededBytes <= fMaxCacheSize) break;
+    if(gSystem->GetPathInfo(cachedFile.second, fileInfo) != 0) continue;
+    gSystem->Unlink(GetInfoFileName(cachedFile.second));
+    if(gSystem->Unlink(cachedFile.second) == 0) cacheSize -= fileInfo.fSize;
+  }
+}
+
+/*
+ * Name of the local copy of a file. The name contains a hash of the full URL.
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the remote file
+ *
+ *  return: Name of the local copy in the cache directory
+ */
+TString RemoteFileCache::GetCacheFileName(const TString fileName) const{
+  TString baseName = gSystem->BaseName(fileName);
+  baseName.ReplaceAll(".root", "");
+  return Form("%s/%s_%08x.root", fCacheDirectory.Data(), baseName.Data(), fileName.Hash());
+}
+
+/*
+ * Name of the file with the size and UUID of the remote file, kept next to the local copy
+ *
+ *  Arguments:
+ *   const TString cacheFileName = Name of the local copy
+ *
+ *  return: Name of the info file
+ */
+TString RemoteFileCache::GetInfoFileName(const TString cacheFileName) const{
+  TString infoFileName = cacheFileName;
+  if(infoFileName.EndsWith(".root")) infoFileName.Remove(infoFileName.Length()-5);
+  return infoFileName + ".info";
+}
+
+/*
+ * Check if the file is read over the network
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the file
+ *
+ *  return: True if the file name is a URL of a remote protocol
+ */
+Bool_t RemoteFileCache::IsRemoteFile(const TString fileName){
+  return fileName.Contains("://") && !fileName.BeginsWith("file://");
+}
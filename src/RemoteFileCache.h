@@ -0,0 +1,85 @@
+// Local disk cache for input files read over xrootd
+
+#ifndef REMOTEFILECACHE_H
+#define REMOTEFILECACHE_H
+
+// C++ includes
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TFile.h>
+#include <TUUID.h>
+#include <TSystem.h>
+#include <TROOT.h>
+#include <TMath.h>
+
+using namespace std;
+
+/*
+ * Read-through cache that keeps local copies of remote input files in a directory on local disk.
+ *
+ * The files in the list are downloaded in a background thread in the order they are analyzed, at most a given
+ * number of files ahead of the file that is currently needed. When a file is needed, the cache waits for its
+ * download and gives the name of the local copy, which is then opened instead of the remote file. If the download
+ * fails, the remote file name is given back and the file is streamed as before.
+ *
+ * The local copy is named after the file URL. The size and the UUID of the remote file are written to an info file
+ * next to the copy, such that a cached file can be used without contacting the remote server. If revalidation is
+ * requested, the size and UUID of the remote file are compared to the stored ones before a copy is used, and a
+ * remote file that is replaced by a new one with the same name is downloaded again. When the total size of the
+ * cache directory would go above the size limit, the least recently used files are deleted.
+ */
+class RemoteFileCache{
+
+public:
+
+  // Constructors and destructor
+  RemoteFileCache(const TString cacheDirectory, const Long64_t maxCacheSizeMB, const Int_t readAheadFiles, const Bool_t revalidate = false); // Custom constructor
+  RemoteFileCache(const RemoteFileCache& in) = delete;             // The cache owns a background thread and cannot be copied
+  ~RemoteFileCache();                                              // Destructor
+  RemoteFileCache& operator=(const RemoteFileCache& obj) = delete; // The cache owns a background thread and cannot be copied
+
+  // Methods
+  void StartDownloads(const std::vector<TString> fileNames); // Start downloading the files in the background in the given order
+  TString GetLocalFile(const TString fileName);              // Get the name from which the file should be opened
+
+  // Static helper methods
+  static Bool_t IsRemoteFile(const TString fileName);        // Check if the file is read over the network
+
+private:
+
+  // Methods
+  void DownloadFiles();                                      // Download the files in the list until all are downloaded or the cache is deleted
+  TString DownloadFile(const TString fileName);              // Make a local copy of a remote file unless there is one already
+  void EvictFiles(const Long64_t neededBytes);               // Delete least recently used files until there is space for a new file
+  TString GetCacheFileName(const TString fileName) const;    // Name of the local copy of a file
+  TString GetInfoFileName(const TString cacheFileName) const; // Name of the file with the size and UUID of the remote file
+  Bool_t ReadRemoteFileInfo(const TString fileName, Long64_t& fileSize, TString& uuid) const; // Read the size and UUID of a remote file from the file header
+
+  // Data members
+  TString fCacheDirectory;                 // Directory where the local copies are kept
+  Long64_t fMaxCacheSize;                  // Maximum total size of the cache directory in bytes
+  Int_t fReadAheadFiles;                   // Number of files downloaded ahead of the file that is currently needed
+  Bool_t fRevalidate;                      // Flag for checking the size and UUID of the remote file before a local copy is used
+  std::vector<TString> fFileNames;         // Names of the files in the download list
+  std::vector<TString> fLocalFileNames;    // Names of the local copies. Empty if the file could not be copied
+  std::vector<Bool_t> fDownloadDone;       // Flag for finished downloads
+  Int_t fnRequestedFiles;                  // Number of files in the list that have been requested so far
+  Bool_t fStopDownloads;                   // Flag for stopping the background thread
+  std::mutex fMutex;                       // Protects the download list and the flags shared with the background thread
+  std::condition_variable fCondition;      // Signals finished downloads and new requests
+  std::thread fDownloadThread;             // Background thread downloading the files
+
+};
+
+#endif
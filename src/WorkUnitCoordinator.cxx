@@ -0,0 +1,305 @@
+// Coordinator serving ranges of entries to analysis workers over a socket and merging the histograms they send back
+
+// Own includes
+#include "WorkUnitCoordinator.h"
+
+/*
+ * Custom constructor
+ *
+ *  Arguments:
+ *   const Int_t port = Port in which the coordinator listens for workers
+ *   const TString outputFileName = File to which the histograms from the workers are merged
+ */
+WorkUnitCoordinator::WorkUnitCoordinator(const Int_t port, const TString outputFileName) :
+  fServerSocket(NULL),
+  fMonitor(NULL),
+  fOutputFileName(outputFileName),
+  fMerger(NULL),
+  fFileNames(),
+  fFirstEntries(),
+  fLastEntries(),
+  fUnitDone(),
+  fPendingUnits(),
+  fnDoneUnits(0),
+  fWorkers(),
+  fWorkerUnits(),
+  fWorkerDeadlines(),
+  fWorkerUnitCounts(),
+  fIdleWorkers(),
+  fUnitTimeout(0),
+  fnReassignedUnits(0)
+{
+  // Custom constructor
+
+  // Listen for the workers. The address can be reused right after a previous coordinator has stopped.
+  fServerSocket = new TServerSocket(port, kTRUE);
+  if(!fServerSocket->IsValid()){
+    cout << "Error! Could not listen for workers in port " << port << endl;
+    assert(0);
+  }
+
+  fMonitor = new TMonitor();
+  fMonitor->Add(fServerSocket);
+}
+
+/*
+ * Destructor
+ */
+WorkUnitCoordinator::~WorkUnitCoordinator(){
+  // destructor
+  for(TSocket* worker : fWorkers) delete worker;
+  if(fMerger) delete fMerger;
+  delete fMonitor;
+  delete fServerSocket;
+}
+
+/*
+ * Add a range of entries in a file to the work
+ *
+ *  Arguments:
+ *   const TString fileName = Name of the file
+ *   const Int_t firstEntry = First entry of the range
+ *   const Int_t lastEntry = Entry after the last entry of the range. -1 = End of the file
+ */
+void WorkUnitCoordinator::AddUnit(const TString fileName, const Int_t firstEntry, const Int_t lastEntry){
+  fPendingUnits.push_back(fFileNames.size());
+  fFileNames.push_back(fileName);
+  fFirstEntries.push_back(firstEntry);
+  fLastEntries.push_back(lastEntry);
+  fUnitDone.push_back(false);
+}
+
+/*
+ * Setter for the time a worker can use for one unit. If the result has not arrived by then, the unit is given to
+ * another worker. The first result that arrives is merged and the other one is dropped.
+ *
+ *  Arguments:
+ *   const Int_t unitTimeout = Time in seconds. 0 = No limit
+ */
+void WorkUnitCoordinator::SetUnitTimeout(const Int_t unitTimeout){
+  fUnitTimeout = unitTimeout;
+}
+
+// Getter for the number of units
+Int_t WorkUnitCoordinator::GetNUnits() const{
+  return fFileNames.size();
+}
+
+/*
+ * Stop listening for new workers. A worker process forked from the coordinator process calls this to close its copy
+ * of the listening socket.
+ */
+void WorkUnitCoordinator::Close(){
+  fServerSocket->Close();
+}
+
+/*
+ * Serve the units to the workers until the results of all units are merged to the output file
+ */
+void WorkUnitCoordinator::Run(){
+
+  // Results are added to the output file one unit at a time. The memory usage histograms only describe a single
+  // unit, so they are not merged.
+  fMerger = new TFileMerger(false);
+  fMerger->OutputFile(fOutputFileName, "RECREATE");
+  fMerger->AddObjectNames("fileMemory peakMemory");
+
+  TSocket* socket;
+  TMessage* message;
+  char messageText[1024];
+
+  while(fnDoneUnits < GetNUnits()){
+
+    // Wake up regularly to notice workers that do not send their results in time
+    socket = fMonitor->Select(fSelectTimeout);
+    CheckDeadlines();
+    if(socket == (TSocket*)-1) continue;
+
+    // New worker
+    if(socket == fServerSocket){
+      TSocket* worker = fServerSocket->Accept();
+      if(worker && worker->IsValid()){
+        fMonitor->Add(worker);
+        fWorkers.push_back(worker);
+        fWorkerUnitCounts[worker] = 0;
+      }
+      continue;
+    }
+
+    // A closed connection means that the worker has stopped
+    if(socket->Recv(message) <= 0){
+      RemoveWorker(socket);
+      continue;
+    }
+
+    if(message->What() == kMESS_STRING){
+      message->ReadString(messageText, sizeof(messageText));
+      if(TString(messageText) == "ready") SendNextUnit(socket);
+    } else if(message->What() == kMESS_ANY){
+      MergeResult(socket, message);
+      SendNextUnit(socket);
+    }
+
+    delete message;
+  }
+
+  // All the work is done, so all the connected workers can stop. This includes workers whose ready message has not
+  // been read yet and workers that are still analyzing a unit that timed out.
+  for(TSocket* worker : fWorkers){
+    worker->Send("done", kMESS_STRING);
+    fMonitor->Remove(worker);
+    worker->Close();
+    delete worker;
+  }
+  fWorkers.clear();
+  fIdleWorkers.clear();
+  fWorkerUnits.clear();
+  fWorkerDeadlines.clear();
+
+  fMerger->CloseOutputFile();
+
+  Int_t iWorker = 0;
+  for(std::pair<TSocket* const, Int_t>& workerUnitCount : fWorkerUnitCounts){
+    cout << "Worker " << iWorker++ << " analyzed " << workerUnitCount.second << " units" << endl;
+  }
+  if(fnReassignedUnits > 0) cout << fnReassignedUnits << " units were analyzed again after their worker was lost or timed out" << endl;
+}
+
+/*
+ * Send the next unit to a worker. If all units are given out, the worker waits in case a unit is returned by a failing worker.
+ *
+ *  Arguments:
+ *   TSocket* worker = Worker asking for work
+ */
+void WorkUnitCoordinator::SendNextUnit(TSocket* worker){
+
+  // A unit that was given again after a timeout might have been merged from the first worker in the meantime
+  while(!fPendingUnits.empty() && fUnitDone.at(fPendingUnits.front())) fPendingUnits.pop_front();
+
+  if(fPendingUnits.empty()){
+    fIdleWorkers.push_back(worker);
+    return;
+  }
+
+  const Int_t unitIndex = fPendingUnits.front();
+  fPendingUnits.pop_front();
+  fWorkerUnits[worker] = unitIndex;
+  if(fUnitTimeout > 0) fWorkerDeadlines[worker] = std::chrono::steady_clock::now() + std::chrono::seconds(fUnitTimeout);
+  worker->Send(FormatUnit(unitIndex, fFileNames.at(unitIndex), fFirstEntries.at(unitIndex), fLastEntries.at(unitIndex)), kMESS_STRING);
+}
+
+/*
+ * Add the histograms sent by a worker to the output file
+ *
+ *  Arguments:
+ *   TSocket* worker = Worker that sent the result
+ *   TMessage* message = Message with the unit index and the result file
+ */
+void WorkUnitCoordinator::MergeResult(TSocket* worker, TMessage* message){
+
+  Int_t unitIndex;
+  Long64_t fileSize;
+  message->ReadInt(unitIndex);
+  message->ReadLong64(fileSize);
+  fWorkerUnits.erase(worker);
+  fWorkerDeadlines.erase(worker);
+
+  // The same unit might be sent twice if a worker was thought to be lost, but it is merged only once
+  if(unitIndex < 0 || unitIndex >= GetNUnits() || fUnitDone.at(unitIndex)) return;
+
+  // The result file is in the message right after the size
+  TMemFile* resultFile = new TMemFile(Form("unit%d.root", unitIndex), message->Buffer() + message->Length(), fileSize);
+  message->SetBufferOffset(message->Length() + fileSize);
+
+  fMerger->AddAdoptFile(resultFile);
+  if(!fMerger->PartialMerge(TFileMerger::kAllIncremental | TFileMerger::kSkipListed)){
+    cout << "Error! Could not merge the result of unit " << unitIndex << " to " << fOutputFileName.Data() << endl;
+    assert(0);
+  }
+
+  fUnitDone.at(unitIndex) = true;
+  fnDoneUnits++;
+  fWorkerUnitCounts[worker]++;
+  cout << "Merged unit " << unitIndex << " (" << fnDoneUnits << "/" << GetNUnits() << "): " << fFileNames.at(unitIndex).Data() << " entries " << fFirstEntries.at(unitIndex) << "-" << fLastEntries.at(unitIndex) << endl;
+}
+
+/*
+ * Remove a disconnected worker. The unit it was analyzing is given to a waiting worker, or to the next worker asking for work.
+ *
+ *  Arguments:
+ *   TSocket* worker = Worker that has disconnected
+ */
+void WorkUnitCoordinator::RemoveWorker(TSocket* worker){
+  fMonitor->Remove(worker);
+  fWorkers.erase(std::remove(fWorkers.begin(), fWorkers.end(), worker), fWorkers.end());
+  fIdleWorkers.erase(std::remove(fIdleWorkers.begin(), fIdleWorkers.end(), worker), fIdleWorkers.end());
+  fWorkerDeadlines.erase(worker);
+
+  if(fWorkerUnits.count(worker) > 0){
+    const Int_t unitIndex = fWorkerUnits[worker];
+    fWorkerUnits.erase(worker);
+    if(!fUnitDone.at(unitIndex)){
+      cout << "Lost the worker analyzing unit " << unitIndex << ". The unit is given to another worker." << endl;
+      ReassignUnit(unitIndex);
+    }
+  }
+
+  worker->Close();
+  delete worker;
+}
+
+/*
+ * Put a unit back to the front of the queue and give it to a waiting worker right away if there is one
+ *
+ *  Arguments:
+ *   const Int_t unitIndex = Unit that is given to another worker
+ */
+void WorkUnitCoordinator::ReassignUnit(const Int_t unitIndex){
+  fPendingUnits.push_front(unitIndex);
+  fnReassignedUnits++;
+
+  if(!fIdleWorkers.empty()){
+    TSocket* idleWorker = fIdleWorkers.back();
+    fIdleWorkers.pop_back();
+    SendNextUnit(idleWorker);
+  }
+}
+
+/*
+ * Give the units of the workers that have not sent their result before the deadline to other workers. The late
+ * worker stays connected. If it still sends the result, the first result to arrive is merged, and the worker
+ * gets a new unit as usual.
+ */
+void WorkUnitCoordinator::CheckDeadlines(){
+  if(fWorkerDeadlines.empty()) return;
+
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  std::vector<TSocket*> lateWorkers;
+  for(std::pair<TSocket* const, std::chrono::steady_clock::time_point>& workerDeadline : fWorkerDeadlines){
+    if(workerDeadline.second < now) lateWorkers.push_back(workerDeadline.first);
+  }
+
+  for(TSocket* worker : lateWorkers){
+    const Int_t unitIndex = fWorkerUnits[worker];
+    fWorkerUnits.erase(worker);
+    fWorkerDeadlines.erase(worker);
+    if(fUnitDone.at(unitIndex)) continue;
+    cout << "Unit " << unitIndex << " was not finished in " << fUnitTimeout << " seconds. The unit is given to another worker." << endl;
+    ReassignUnit(unitIndex);
+  }
+}
+
+/*
+ * Message sending a unit to a worker
+ *
+ *  Arguments:
+ *   const Int_t unitIndex = Index of the unit
+ *   const TString fileName = File of the unit
+ *   const Int_t firstEntry = First entry of the unit
+ *   const Int_t lastEntry = Entry after the last entry of the unit. -1 = End of the file
+ *
+ *  return: Message text
+ */
+TString WorkUnitCoordinator::FormatUnit(const Int_t unitIndex, const TString fileName, const Int_t firstEntry, const Int_t lastEntry){
+  return Form("unit %d %d %d %s", unitIndex, firstEntry, lastEntry, fileName.Data());
+}
@@ -0,0 +1,98 @@
+// Coordinator serving ranges of entries to analysis workers over a socket and merging the histograms they send back
+
+#ifndef WORKUNITCOORDINATOR_H
+#define WORKUNITCOORDINATOR_H
+
+// C++ includes
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TServerSocket.h>
+#include <TSocket.h>
+#include <TMonitor.h>
+#include <TMessage.h>
+#include <TMemFile.h>
+#include <TFileMerger.h>
+
+using namespace std;
+
+/*
+ * Coordinator for analyzing the files with workers that can run on several machines.
+ *
+ * The work is divided into units, each of which is a range of entries in one file. The workers connect to the
+ * coordinator, ask for a unit, analyze it and send the histograms back as an in-memory ROOT file. The coordinator
+ * adds the histograms to the output file as they arrive and answers with the next unit, so fast workers analyze
+ * more units than slow ones. If a worker disconnects before sending the result, or does not send it before the unit
+ * timeout, its unit is given to another worker. A result that arrives for a unit that is already merged is dropped.
+ *
+ * Messages between the coordinator and the workers:
+ *   worker -> coordinator: kMESS_STRING "ready" when the worker has connected
+ *   coordinator -> worker: kMESS_STRING "unit <index> <firstEntry> <lastEntry> <fileName>" or "done"
+ *   worker -> coordinator: kMESS_ANY with the unit index, the size of the result file and the result file
+ */
+class WorkUnitCoordinator{
+
+public:
+
+  // Constructors and destructor
+  WorkUnitCoordinator(const Int_t port, const TString outputFileName);       // Custom constructor
+  WorkUnitCoordinator(const WorkUnitCoordinator& in) = delete;               // The sockets cannot be copied
+  ~WorkUnitCoordinator();                                                    // Destructor
+  WorkUnitCoordinator& operator=(const WorkUnitCoordinator& obj) = delete;   // The sockets cannot be copied
+
+  // Methods
+  void AddUnit(const TString fileName, const Int_t firstEntry, const Int_t lastEntry); // Add a range of entries in a file to the work
+  void SetUnitTimeout(const Int_t unitTimeout); // Setter for the time in seconds a worker can use for one unit
+  Int_t GetNUnits() const;           // Getter for the number of units
+  void Close();                      // Stop listening for new workers. Needed in forked worker processes
+  void Run();                        // Serve the units to the workers until the results of all units are merged
+
+  // Static helper methods
+  static TString FormatUnit(const Int_t unitIndex, const TString fileName, const Int_t firstEntry, const Int_t lastEntry); // Message sending a unit to a worker
+
+private:
+
+  void SendNextUnit(TSocket* worker);               // Send the next unit to a worker, or keep the worker waiting if no units are left
+  void MergeResult(TSocket* worker, TMessage* message); // Add the histograms sent by a worker to the output file
+  void RemoveWorker(TSocket* worker);               // Give the unit of a disconnected worker to other workers
+  void ReassignUnit(const Int_t unitIndex);         // Put a unit back to the queue and give it to a waiting worker
+  void CheckDeadlines();                            // Give the units of workers that have passed their deadline to other workers
+
+  static const Long_t fSelectTimeout = 1000;       // Time in milliseconds after which the deadlines are checked if no messages arrive
+
+  // Sockets
+  TServerSocket* fServerSocket;                    // Socket accepting new workers
+  TMonitor* fMonitor;                              // Monitor waiting for messages from all sockets
+
+  // Output
+  TString fOutputFileName;                         // File to which the histograms are merged
+  TFileMerger* fMerger;                            // Merger adding the results to the output file
+
+  // Units
+  std::vector<TString> fFileNames;                 // File of each unit
+  std::vector<Int_t> fFirstEntries;                // First entry of each unit
+  std::vector<Int_t> fLastEntries;                 // Entry after the last entry of each unit. -1 = End of the file
+  std::vector<Bool_t> fUnitDone;                   // Flag for units with merged results
+  std::deque<Int_t> fPendingUnits;                 // Units not given to any worker
+  Int_t fnDoneUnits;                               // Number of units with merged results
+
+  // Workers
+  std::vector<TSocket*> fWorkers;                  // All connected workers
+  std::map<TSocket*, Int_t> fWorkerUnits;          // Unit each worker is analyzing
+  std::map<TSocket*, std::chrono::steady_clock::time_point> fWorkerDeadlines; // Time by which each worker should send the result of its unit
+  std::map<TSocket*, Int_t> fWorkerUnitCounts;     // Number of units finished by each worker
+  std::vector<TSocket*> fIdleWorkers;              // Workers waiting for units that might be returned by failing workers
+  Int_t fUnitTimeout;                              // Time in seconds a worker can use for one unit. 0 = No limit
+  Int_t fnReassignedUnits;                         // Number of units given again after a worker was lost or timed out
+
+};
+
+#endif
@@ -0,0 +1,109 @@
+// Worker asking units of work from WorkUnitCoordinator, analyzing them and sending the histograms back
+
+// Own includes
+#include "WorkUnitWorker.h"
+
+/*
+ * Custom constructor
+ *
+ *  Arguments:
+ *   const TString host = Host in which the coordinator runs
+ *   const Int_t port = Port in which the coordinator listens
+ *   ConfigurationCard* newCard = Configuration card for the analysis
+ */
+WorkUnitWorker::WorkUnitWorker(const TString host, const Int_t port, ConfigurationCard* newCard) :
+  fHost(host),
+  fPort(port),
+  fCard(newCard),
+  fSocket(NULL)
+{
+  // Custom constructor
+}
+
+/*
+ * Destructor
+ */
+WorkUnitWorker::~WorkUnitWorker(){
+  // destructor
+  if(fSocket) delete fSocket;
+}
+
+/*
+ * Connect to the coordinator and analyze the units it gives until all the work is done
+ *
+ *  return: Number of units analyzed by this worker
+ */
+Int_t WorkUnitWorker::Run(){
+
+  fSocket = new TSocket(fHost, fPort);
+  if(!fSocket->IsValid()){
+    cout << "Error! Could not connect to the coordinator at " << fHost.Data() << ":" << fPort << endl;
+    assert(0);
+  }
+  fSocket->Send("ready", kMESS_STRING);
+
+  TMessage* message;
+  char messageText[4096];
+  std::string command;
+  Int_t unitIndex, firstEntry, lastEntry;
+  std::string fileName;
+  Int_t nUnits = 0;
+
+  while(true){
+
+    // If the coordinator goes away, there is no one to send the results to
+    if(fSocket->Recv(message) <= 0){
+      cout << "Error! Lost the connection to the coordinator" << endl;
+      assert(0);
+    }
+
+    message->ReadString(messageText, sizeof(messageText));
+    delete message;
+
+    std::istringstream messageStream(messageText);
+    messageStream >> command;
+    if(command == "done") break;
+
+    if(command != "unit" || !(messageStream >> unitIndex >> firstEntry >> lastEntry >> fileName)){
+      cout << "Error! Could not understand the message from the coordinator: " << messageText << endl;
+      assert(0);
+    }
+
+    AnalyzeUnit(unitIndex, fileName.c_str(), firstEntry, lastEntry);
+    nUnits++;
+  }
+
+  fSocket->Close();
+  return nUnits;
+}
+
+/*
+ * Analyze one unit and send the histograms to the coordinator as an in-memory ROOT file
+ *
+ *  Arguments:
+ *   const Int_t unitIndex = Index of the unit given by the coordinator
+ *   const TString fileName = File to be analyzed
+ *   const Int_t firstEntry = First entry to be analyzed
+ *   const Int_t lastEntry = Entry after the last entry to be analyzed. -1 = End of the file
+ */
+void WorkUnitWorker::AnalyzeUnit(const Int_t unitIndex, const TString fileName, const Int_t firstEntry, const Int_t lastEntry){
+
+  JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(std::vector<TString>(1, fileName), fCard);
+  jetBackgroundAnalysis->RunAnalysis(firstEntry, lastEntry);
+
+  // Write the histograms to a file in memory
+  TMemFile* resultFile = new TMemFile(Form("unit%d.root", unitIndex), "RECREATE");
+  jetBackgroundAnalysis->GetHistograms()->Write();
+  resultFile->Write();
+
+  // Send the file together with the unit index and the size of the file
+  TMessage resultMessage(kMESS_ANY);
+  resultMessage.WriteInt(unitIndex);
+  resultMessage.WriteLong64(resultFile->GetEND());
+  resultFile->CopyTo(resultMessage);
+  fSocket->Send(resultMessage);
+
+  resultFile->Close();
+  delete resultFile;
+  delete jetBackgroundAnalysis;
+}
@@ -0,0 +1,56 @@
+// Worker asking units of work from WorkUnitCoordinator, analyzing them and sending the histograms back
+
+#ifndef WORKUNITWORKER_H
+#define WORKUNITWORKER_H
+
+// C++ includes
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <assert.h>
+
+// Root includes
+#include <Rtypes.h>
+#include <TString.h>
+#include <TSocket.h>
+#include <TMessage.h>
+#include <TMemFile.h>
+
+// Own includes
+#include "ConfigurationCard.h"
+#include "JetBackgroundAnalyzer.h"
+#include "JetBackgroundHistograms.h"
+
+using namespace std;
+
+/*
+ * Worker for the coordinated analysis. The worker connects to the coordinator, analyzes the units of work it is given
+ * one at a time and sends the histograms of each unit back, until the coordinator tells that all the work is done.
+ * See WorkUnitCoordinator for the messages.
+ */
+class WorkUnitWorker{
+
+public:
+
+  // Constructors and destructor
+  WorkUnitWorker(const TString host, const Int_t port, ConfigurationCard* newCard); // Custom constructor
+  WorkUnitWorker(const WorkUnitWorker& in) = delete;               // The socket cannot be copied
+  ~WorkUnitWorker();                                               // Destructor
+  WorkUnitWorker& operator=(const WorkUnitWorker& obj) = delete;   // The socket cannot be copied
+
+  // Methods
+  Int_t Run();                       // Analyze units until the coordinator has no more work. Returns the number of analyzed units
+
+private:
+
+  void AnalyzeUnit(const Int_t unitIndex, const TString fileName, const Int_t firstEntry, const Int_t lastEntry); // Analyze one unit and send the histograms to the coordinator
+
+  TString fHost;                     // Host in which the coordinator runs
+  Int_t fPort;                       // Port in which the coordinator listens
+  ConfigurationCard* fCard;          // Configuration card for the analysis
+  TSocket* fSocket;                  // Connection to the coordinator
+
+};
+
+#endif
@@ -0,0 +1,84 @@
+// C++ includes
+#include <iostream>   // Input/output stream. Needed for cout.
+#include <stdlib.h>   // Standard utility libraries
+#include <vector>     // C++ vector class
+
+// Includes from Root
+#include <TString.h>
+
+// Own includes
+#include "src/JetBackgroundAnalyzer.h"
+#include "src/ConfigurationCard.h"
+#include "src/FileListReader.h"
+#include "src/FileManifest.h"
+
+using namespace std;
+
+/*
+ *  Check all the files in a file list before the analysis and write a manifest of the good and bad files
+ *
+ *  Command line arguments:
+ *  argv[1] = List of files to be checked, given in text file
+ *  argv[2] = Card file with the configuration for the analysis
+ *  argv[3] = Name of the manifest file that is written
+ *  argv[4] = Index for the EOS location from where the input files are searched
+ *  argv[5] = True: Search input files from local machine. False (default): Search input files from grid with xrootd
+ *  argv[6] = Number of threads used to check the files. Default: 4
+ */
+int main(int argc, char **argv) {
+  
+  //==== Read arguments =====
+  if ( argc<5 ) {
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout<<"+ Usage of the macro: " << endl;
+    cout<<"+  "<<argv[0]<<" [fileNameFile] [configurationCard] [manifestFile] [fileLocation] <runLocal> <nThreads>"<<endl;
+    cout<<"+  fileNameFile: Text file containing the list of files that are checked." <<endl;
+    cout<<"+  configurationCard: Card file with the configuration for the analysis. Only branches needed with this configuration are checked." <<endl;
+    cout<<"+  manifestFile: Text file to which the manifest is written. It can be given to the analysis in place of the file list." <<endl;
+    cout<<"+  fileLocation: Where to find analysis files: 0 = Purdue EOS, 1 = CERN EOS, 2 = Vanderbilt T2, 3 = Use xrootd to find the data." << endl;
+    cout<<"+  runLocal: True: Search input files from local machine. False (default): Search input files from grid with xrootd." << endl;
+    cout<<"+  nThreads: Number of threads used to check the files. Default: 4." << endl;
+    cout<<"+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++"<<endl;
+    cout << endl << endl;
+    exit(1);
+  }
+  
+  // Read the command line arguments
+  TString fileNameFile = argv[1];
+  const char* cardName = argv[2];
+  TString manifestFileName = argv[3];
+  const int fileSearchIndex = atoi(argv[4]);
+  bool runLocal = false;
+  if(argc >= 6) runLocal = checkBool(argv[5]);
+  int nThreads = 4;
+  if(argc >= 7) nThreads = atoi(argv[6]);
+  
+  // Read the card
+  ConfigurationCard *configurationCard = new ConfigurationCard(cardName);
+  int debugLevel = configurationCard->Get("DebugLevel");
+  
+  // Read the file names that are checked to a vector
+  std::vector<TString> fileNameVector;
+  fileNameVector.clear();
+  ReadFileList(fileNameVector,fileNameFile,debugLevel,fileSearchIndex,runLocal);
+  
+  // Check the files and write the result to the manifest
+  JetBackgroundAnalyzer* jetBackgroundAnalysis = new JetBackgroundAnalyzer(fileNameVector, configurationCard);
+  FileManifest manifest = jetBackgroundAnalysis->ValidateFiles(nThreads);
+  manifest.Write(manifestFileName);
+  
+  // Print a summary of the check
+  int nGoodFiles = manifest.GetGoodFiles().size();
+  Long64_t nGoodEntries = 0;
+  for(int iFile = 0; iFile < manifest.GetNFiles(); iFile++){
+    if(manifest.IsGood(iFile)) nGoodEntries += manifest.fnEntries.at(iFile);
+  }
+  cout << "Checked " << manifest.GetNFiles() << " files: " << nGoodFiles << " good with " << nGoodEntries << " events, " << manifest.GetNFiles() - nGoodFiles << " bad" << endl;
+  manifest.PrintBadFiles();
+  cout << "Manifest written to " << manifestFileName.Data() << endl;
+  
+  // Delete all created objects
+  delete configurationCard;
+  delete jetBackgroundAnalysis;
+  
+}